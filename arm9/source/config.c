@@ -492,6 +492,41 @@ static int configIniHandler(void* user, const char* section, const char* name, c
             CHECK_PARSE_OPTION(parseBoolOption(&opt, value));
             cfg->bottomScreenFilter.invert = opt;
             return 1;
+        } else if (strcmp(name, "screen_filters_night_mode_enabled") == 0) {
+            bool opt;
+            CHECK_PARSE_OPTION(parseBoolOption(&opt, value));
+            cfg->screenFiltersNightMode.enabled = opt;
+            return 1;
+        } else if (strcmp(name, "screen_filters_night_mode_start_min") == 0) {
+            s64 opt;
+            CHECK_PARSE_OPTION(parseDecIntOption(&opt, value, 0, 1439));
+            cfg->screenFiltersNightMode.startMinutes = (u16)opt;
+            return 1;
+        } else if (strcmp(name, "screen_filters_night_mode_end_min") == 0) {
+            s64 opt;
+            CHECK_PARSE_OPTION(parseDecIntOption(&opt, value, 0, 1439));
+            cfg->screenFiltersNightMode.endMinutes = (u16)opt;
+            return 1;
+        } else if (strcmp(name, "screen_filters_night_mode_transition_min") == 0) {
+            s64 opt;
+            CHECK_PARSE_OPTION(parseDecIntOption(&opt, value, 0, 720));
+            cfg->screenFiltersNightMode.transitionMinutes = (u16)opt;
+            return 1;
+        } else if (strcmp(name, "screen_filters_night_mode_cct") == 0) {
+            s64 opt;
+            CHECK_PARSE_OPTION(parseDecIntOption(&opt, value, 1000, 25100));
+            cfg->screenFiltersNightMode.cct = (u16)opt;
+            return 1;
+        } else if (strcmp(name, "screen_filters_night_mode_gamma") == 0) {
+            s64 opt;
+            CHECK_PARSE_OPTION(parseDecFloatOption(&opt, value, 0, 1411 * FLOAT_CONV_MULT));
+            cfg->screenFiltersNightMode.gammaEnc = opt;
+            return 1;
+        } else if (strcmp(name, "screen_filters_night_mode_brightness") == 0) {
+            s64 opt;
+            CHECK_PARSE_OPTION(parseDecFloatOption(&opt, value, -1 * FLOAT_CONV_MULT, 1 * FLOAT_CONV_MULT));
+            cfg->screenFiltersNightMode.brightnessEnc = opt;
+            return 1;
         } else {
             CHECK_PARSE_OPTION(-1);
         }
@@ -579,6 +614,11 @@ static size_t saveLumaIniConfigToStr(char *out)
     encodedFloatToString(bottomScreenFilterContrastStr, cfg->bottomScreenFilter.contrastEnc);
     encodedFloatToString(bottomScreenFilterBrightnessStr, cfg->bottomScreenFilter.brightnessEnc);
 
+    char nightModeGammaStr[32];
+    char nightModeBrightnessStr[32];
+    encodedFloatToString(nightModeGammaStr, cfg->screenFiltersNightMode.gammaEnc);
+    encodedFloatToString(nightModeBrightnessStr, cfg->screenFiltersNightMode.brightnessEnc);
+
     int n = sprintf(
         out, (const char *)config_template_ini,
         lumaVerStr, lumaRevSuffixStr,
@@ -602,6 +642,11 @@ static size_t saveLumaIniConfigToStr(char *out)
         topScreenFilterBrightnessStr, bottomScreenFilterBrightnessStr,
         (int)cfg->topScreenFilter.invert, (int)cfg->bottomScreenFilter.invert,
 
+        (int)cfg->screenFiltersNightMode.enabled,
+        (int)cfg->screenFiltersNightMode.startMinutes, (int)cfg->screenFiltersNightMode.endMinutes,
+        (int)cfg->screenFiltersNightMode.transitionMinutes, (int)cfg->screenFiltersNightMode.cct,
+        nightModeGammaStr, nightModeBrightnessStr,
+
         cfg->autobootTwlTitleId, (int)cfg->autobootCtrAppmemtype,
 
         (int)CONFIG(PATCHUNITINFO), (int)CONFIG(DISABLEARM11EXCHANDLERS),
@@ -611,7 +656,7 @@ static size_t saveLumaIniConfigToStr(char *out)
     return n < 0 ? 0 : (size_t)n;
 }
 
-static char tmpIniBuffer[0x2000];
+static char tmpIniBuffer[0x3000];
 
 static bool readLumaIniConfig(void)
 {
@@ -713,6 +758,11 @@ bool readConfig(void)
         configData.topScreenFilter.gammaEnc = 1 * FLOAT_CONV_MULT; // 1.0f
         configData.topScreenFilter.contrastEnc = 1 * FLOAT_CONV_MULT; // 1.0f
         configData.bottomScreenFilter = configData.topScreenFilter;
+        configData.screenFiltersNightMode.startMinutes = 21 * 60;
+        configData.screenFiltersNightMode.endMinutes = 7 * 60;
+        configData.screenFiltersNightMode.transitionMinutes = 30;
+        configData.screenFiltersNightMode.cct = 2700;
+        configData.screenFiltersNightMode.gammaEnc = 1 * FLOAT_CONV_MULT; // 1.0f
         configData.autobootTwlTitleId = AUTOBOOT_DEFAULT_TWL_TID;
         ret = false;
     }
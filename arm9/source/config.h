@@ -36,7 +36,7 @@
 
 #define CONFIG_FILE         "config.bin"
 #define CONFIG_VERSIONMAJOR 3
-#define CONFIG_VERSIONMINOR 5
+#define CONFIG_VERSIONMINOR 6
 
 #define BOOTCFG_NAND         BOOTCONFIG(0, 7)
 #define BOOTCFG_FIRM         BOOTCONFIG(3, 7)
@@ -137,6 +137,7 @@ u32 installK11Extension(u8 *pos, u32 size, bool needToInitSd, u32 baseK11VA, u32
 
             ScreenFiltersCfgData topScreenFilter;
             ScreenFiltersCfgData bottomScreenFilter;
+            ScreenFiltersNightModeCfgData screenFiltersNightMode;
 
             u64 autobootTwlTitleId;
             u8 autobootCtrAppmemtype;
@@ -217,6 +218,7 @@ u32 installK11Extension(u8 *pos, u32 size, bool needToInitSd, u32 baseK11VA, u32
     info->ntpTzOffetMinutes = configData.ntpTzOffetMinutes;
     info->topScreenFilter = configData.topScreenFilter;
     info->bottomScreenFilter = configData.bottomScreenFilter;
+    info->screenFiltersNightMode = configData.screenFiltersNightMode;
     info->autobootTwlTitleId = configData.autobootTwlTitleId;
     info->autobootCtrAppmemtype = configData.autobootCtrAppmemtype;
     info->versionMajor = VERSION_MAJOR;
@@ -69,6 +69,15 @@ typedef struct ScreenFiltersCfgData {
     s64 brightnessEnc;
 } ScreenFiltersCfgData;
 
+typedef struct ScreenFiltersNightModeCfgData {
+    bool enabled;
+    u16 startMinutes, endMinutes; // since midnight
+    u16 transitionMinutes;
+    u16 cct;
+    s64 gammaEnc;
+    s64 brightnessEnc;
+} ScreenFiltersNightModeCfgData;
+
 typedef struct CfgData {
     u16 formatVersionMajor, formatVersionMinor;
 
@@ -82,6 +91,7 @@ typedef struct CfgData {
 
     ScreenFiltersCfgData topScreenFilter;
     ScreenFiltersCfgData bottomScreenFilter;
+    ScreenFiltersNightModeCfgData screenFiltersNightMode;
 
     u64 autobootTwlTitleId;
     u8 autobootCtrAppmemtype;
@@ -136,6 +136,15 @@ typedef struct ScreenFiltersCfgData {
     s64 brightnessEnc;
 } ScreenFiltersCfgData;
 
+typedef struct ScreenFiltersNightModeCfgData {
+    bool enabled;
+    u16 startMinutes, endMinutes; // since midnight
+    u16 transitionMinutes;
+    u16 cct;
+    s64 gammaEnc;
+    s64 brightnessEnc;
+} ScreenFiltersNightModeCfgData;
+
 typedef struct CfwInfo
 {
     char magic[4];
@@ -157,6 +166,7 @@ typedef struct CfwInfo
 
     ScreenFiltersCfgData topScreenFilter;
     ScreenFiltersCfgData bottomScreenFilter;
+    ScreenFiltersNightModeCfgData screenFiltersNightMode;
 
     u64 autobootTwlTitleId;
     u8 autobootCtrAppmemtype;
@@ -110,6 +110,27 @@ Result GetSystemInfoHook(s64 *out, s32 type, s32 param)
                 case 0x10C:
                     *out = (s64)cfwInfo.bottomScreenFilter.invert;
                     break;
+                case 0x10D:
+                    *out = (s64)cfwInfo.screenFiltersNightMode.enabled;
+                    break;
+                case 0x10E:
+                    *out = cfwInfo.screenFiltersNightMode.startMinutes;
+                    break;
+                case 0x10F:
+                    *out = cfwInfo.screenFiltersNightMode.endMinutes;
+                    break;
+                case 0x110:
+                    *out = cfwInfo.screenFiltersNightMode.transitionMinutes;
+                    break;
+                case 0x111:
+                    *out = cfwInfo.screenFiltersNightMode.cct;
+                    break;
+                case 0x112:
+                    *out = cfwInfo.screenFiltersNightMode.gammaEnc;
+                    break;
+                case 0x113:
+                    *out = cfwInfo.screenFiltersNightMode.brightnessEnc;
+                    break;
                 case 0x180:
                     *out = cfwInfo.pluginLoaderFlags;
                     break;
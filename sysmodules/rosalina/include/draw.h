@@ -82,6 +82,9 @@
 
 #define DRAW_MAX_FORMATTED_STRING_SIZE  512
 
+// Dirty framebuffer columns closer than this are flushed together
+#define DRAW_DIRTY_MERGE_GAP            8
+
 void Draw_Init(void);
 
 void Draw_Lock(void);
@@ -103,9 +106,10 @@ u32 Draw_GetFramebufferCacheSize(void);
 u32 Draw_SetupFramebuffer(void);
 void Draw_RestoreFramebuffer(void);
 void Draw_FlushFramebuffer(void);
+// Only flushes the columns that have been drawn to since the latest flush
+void Draw_FlushDirtyFramebuffer(void);
 u32 Draw_GetCurrentFramebufferAddress(bool top, bool left);
 // Width is actually height as the 3ds screen is rotated 90 degrees
 void Draw_GetCurrentScreenInfo(u32 *width, bool *is3d, bool top);
 
-void Draw_CreateBitmapHeader(u8 *dst, u32 width, u32 heigth);
 void Draw_ConvertFrameBufferLines(u8 *buf, u32 width, u32 startingLine, u32 numLines, bool top, bool left);
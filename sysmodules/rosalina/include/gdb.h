@@ -18,15 +18,26 @@
 
 #define MAX_DEBUG           3
 #define MAX_DEBUG_THREAD    127
-#define MAX_BREAKPOINT      64
+#define GDB_BREAKPOINT_HASH_BITS    10
+#define GDB_BREAKPOINT_HASH_SIZE    (1u << GDB_BREAKPOINT_HASH_BITS)
+#define MAX_BREAKPOINT              (GDB_BREAKPOINT_HASH_SIZE / 2)
 
 #define MAX_TIO_OPEN_FILE   32
 
 // 512+24 is the ideal size as IDA will try to read exactly 0x100 bytes at a time. Add 4 to this, for $#<checksum>, see below.
 // IDA seems to want additional bytes as well.
 // 1024 is fine enough to put all regs in the 'T' stop reply packets
+// This is the size of the scratch buffers used to format small replies.
 #define GDB_BUF_LEN 1024
 
+// Packets themselves go through much larger per-context buffers (advertised with PacketSize), so that
+// memory reads and writes move a lot more data per round trip. These buffers are only allocated while
+// the debugger is enabled, see GDB_InitializeServer
+#define GDB_PACKET_BUF_LEN 0x4000
+
+// vFile:pread read-ahead buffer, shared by all contexts
+#define GDB_TIO_READ_AHEAD_LEN (2 * GDB_PACKET_BUF_LEN)
+
 #define GDB_HANDLER(name)           GDB_Handle##name
 #define GDB_QUERY_HANDLER(name)     GDB_HANDLER(Query##name)
 #define GDB_VERBOSE_HANDLER(name)   GDB_HANDLER(Verbose##name)
@@ -41,6 +52,8 @@ typedef struct Breakpoint
     u32 savedInstruction;
     u8 instructionSize;
     bool persistent;
+    bool enabled;   // as far as GDB knows
+    bool installed; // the breakpoint instruction is in memory
 } Breakpoint;
 
 typedef struct PackedGdbHioRequest
@@ -93,8 +106,34 @@ typedef struct ThreadInfo
 {
     u32 id;
     u32 tls;
+
+    // Snapshot of the thread parameters, taken on first use while the process is stopped.
+    // Only valid if snapshotGeneration == ctx->threadSnapshotGeneration
+    u32 snapshotGeneration;
+    u32 snapshotFetchedMask, snapshotValidMask; // one bit per DebugThreadParameter, bit 4 for the dynamic priority
+    u32 snapshotParams[4];
+    s32 snapshotDynamicPriority;
 } ThreadInfo;
 
+#define GDB_THREAD_CONTEXT_SNAPSHOTS    4
+
+typedef struct ThreadContextSnapshot
+{
+    u32 id; // 0 if unused
+    u32 generation;
+    ThreadContext regs;
+} ThreadContextSnapshot;
+
+// The larger per-context tables, about 14KB: like the packet buffers, they're only allocated while the debugger is
+// enabled (see GDB_InitializeServer), instead of taking room in Rosalina's own memory
+typedef struct GDBContextTables
+{
+    ThreadInfo threadInfos[MAX_DEBUG_THREAD];
+    ThreadContextSnapshot threadContextSnapshots[GDB_THREAD_CONTEXT_SNAPSHOTS];
+    Breakpoint breakpoints[MAX_BREAKPOINT];
+    u16 breakpointIndex[GDB_BREAKPOINT_HASH_SIZE];
+} GDBContextTables;
+
 struct GDBServer;
 
 typedef struct GDBContext
@@ -108,6 +147,7 @@ typedef struct GDBContext
     u32 flags;
     GDBState state;
     bool noAckSent;
+    bool ackPending; // the '+' for the packet being handled goes out with the reply, see GDB_DoSendPacket
 
     u32 pid;
     Handle debug;
@@ -116,11 +156,16 @@ typedef struct GDBContext
     FS_ProgramInfo launchedProgramInfo;
     u32 launchedProgramLaunchFlags;
 
-    ThreadInfo threadInfos[MAX_DEBUG_THREAD];
+    ThreadInfo *threadInfos; // MAX_DEBUG_THREAD entries, see GDBContextTables
     u32 nbThreads;
     u32 currentThreadId, selectedThreadId, selectedThreadIdForContinuing;
     u32 totalNbCreatedThreads;
 
+    // Thread parameters and contexts don't change while the process is stopped: they're only fetched once per stop
+    u32 threadSnapshotGeneration;
+    ThreadContextSnapshot *threadContextSnapshots; // GDB_THREAD_CONTEXT_SNAPSHOTS entries
+    u32 nextThreadContextSnapshot;
+
     Handle processAttachedEvent, continuedEvent;
     Handle eventToWaitFor;
 
@@ -132,8 +177,10 @@ typedef struct GDBContext
     DebugFlags continueFlags;
     u32 svcMask[8];
 
-    u32 nbBreakpoints;
-    Breakpoint breakpoints[MAX_BREAKPOINT];
+    // Unordered, breakpointIndex is an open-addressed hash table of (index + 1) by address
+    u32 nbBreakpoints, nbPendingBreakpoints;
+    Breakpoint *breakpoints; // MAX_BREAKPOINT entries
+    u16 *breakpointIndex; // GDB_BREAKPOINT_HASH_SIZE entries
 
     u32 nbWatchpoints;
     u32 watchpoints[2];
@@ -147,7 +194,11 @@ typedef struct GDBContext
     bool enableExternalMemoryAccess;
     char *commandData, *commandEnd;
     int latestSentPacketSize;
-    char buffer[GDB_BUF_LEN + 4];
+    char *buffer; // GDB_PACKET_BUF_LEN + 4 bytes, replies only, so that the latest sent packet can be sent again
+
+    // Received data (GDB_PACKET_BUF_LEN + 4 bytes), packets are parsed in place as soon as they are complete
+    char *recvBuffer;
+    u32 recvStart, recvEnd;
 
     char threadListData[0x800];
     u32 threadListDataPos;
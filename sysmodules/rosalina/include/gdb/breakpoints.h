@@ -13,8 +13,10 @@
 #define BREAKPOINT_INSTRUCTION_ARM      0xEF0000FF
 #define BREAKPOINT_INSTRUCTION_THUMB    0xDFFF
 
-u32 GDB_FindClosestBreakpointSlot(GDBContext *ctx, u32 address);
+Breakpoint *GDB_FindBreakpoint(GDBContext *ctx, u32 address);
 int GDB_GetBreakpointInstruction(u32 *instr, GDBContext *ctx, u32 address);
 int GDB_AddBreakpoint(GDBContext *ctx, u32 address, bool thumb, bool persist);
-int GDB_DisableBreakpointById(GDBContext *ctx, u32 id);
 int GDB_RemoveBreakpoint(GDBContext *ctx, u32 address);
+void GDB_SyncBreakpoints(GDBContext *ctx); // applies pending changes, call before the process runs
+void GDB_HidePendingBreakpoints(GDBContext *ctx, void *buf, u32 address, u32 len);
+void GDB_RemoveAllBreakpoints(GDBContext *ctx);
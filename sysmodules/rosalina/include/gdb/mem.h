@@ -9,6 +9,16 @@
 
 #include "gdb.h"
 
+#define GDB_SEARCH_MAX_PATTERN_LEN  0x1000
+#define GDB_SEARCH_MAX_PATTERNS     16
+
+typedef struct GDBSearchPattern
+{
+    const u8 *data;
+    const u8 *mask; // optional, bits set to 0 match anything
+    u32 len;
+} GDBSearchPattern;
+
 Result GDB_ReadTargetMemoryInPage(void *out, GDBContext *ctx, u32 addr, u32 len);
 Result GDB_WriteTargetMemoryInPage(GDBContext *ctx, const void *in, u32 addr, u32 len);
 u32 GDB_ReadTargetMemory(void *out, GDBContext *ctx, u32 addr, u32 len);
@@ -17,8 +27,10 @@ u32 GDB_WriteTargetMemory(GDBContext *ctx, const void *in, u32 addr, u32 len);
 int GDB_SendMemory(GDBContext *ctx, const char *prefix, u32 prefixLen, u32 addr, u32 len);
 int GDB_WriteMemory(GDBContext *ctx, const void *buf, u32 addr, u32 len);
 u32 GDB_SearchMemory(bool *found, GDBContext *ctx, u32 addr, u32 len, const void *pattern, u32 patternLen);
+u32 GDB_SearchMemoryEx(bool *found, u32 *patternId, GDBContext *ctx, u32 addr, u32 len, const GDBSearchPattern *patterns, u32 nbPatterns);
 
 GDB_DECLARE_HANDLER(ReadMemory);
+GDB_DECLARE_HANDLER(ReadMemoryRaw);
 GDB_DECLARE_HANDLER(WriteMemory);
 GDB_DECLARE_HANDLER(WriteMemoryRaw);
 GDB_DECLARE_QUERY_HANDLER(SearchMemory);
@@ -20,8 +20,11 @@ const char *GDB_ParseIntegerList(u32 *dst, const char *src, u32 nb, char sep, ch
 const char *GDB_ParseHexIntegerList(u32 *dst, const char *src, u32 nb, char lastSep);
 const char *GDB_ParseIntegerList64(u64 *dst, const char *src, u32 nb, char sep, char lastSep, u32 base, bool allowPrefix);
 const char *GDB_ParseHexIntegerList64(u64 *dst, const char *src, u32 nb, char lastSep);
-int GDB_ReceivePacket(GDBContext *ctx);
+int GDB_ReceivePacket(GDBContext *ctx); // reads what is available into ctx->recvBuffer
+int GDB_NextPacket(GDBContext *ctx, char **packet); // 0 if no complete packet has been received
+int GDB_FlushAck(GDBContext *ctx); // sends the acknowledgment of the latest packet if no reply did
 int GDB_SendPacket(GDBContext *ctx, const char *packetData, u32 len);
+int GDB_SendPacketFromBuffer(GDBContext *ctx, u32 len); // payload already at ctx->buffer + 1
 int GDB_SendFormattedPacket(GDBContext *ctx, const char *packetDataFmt, ...);
 int GDB_SendHexPacket(GDBContext *ctx, const void *packetData, u32 len);
 int GDB_SendStreamData(GDBContext *ctx, const char *streamData, u32 offset, u32 length, u32 totalSize, bool forceEmptyLast);
@@ -20,6 +20,7 @@ typedef struct GDBServer
     Handle statusUpdated;
     Handle statusUpdateReceived;
     GDBContext ctxs[MAX_DEBUG];
+    u8 *tioReadAheadBuffer;
 } GDBServer;
 
 Result GDB_InitializeServer(GDBServer *server);
@@ -23,6 +23,12 @@ const char *GDB_ParseThreadId(GDBContext *ctx, u32 *outPid, u32 *outTid, const c
 u32 GDB_ParseDecodeSingleThreadId(GDBContext *ctx, const char *str, char lastSep);
 int GDB_EncodeThreadId(GDBContext *ctx, char *outbuf, u32 tid);
 
+void GDB_InvalidateThreadSnapshots(GDBContext *ctx);
+Result GDB_GetThreadParam(u32 *out, GDBContext *ctx, u32 threadId, DebugThreadParameter param);
+Result GDB_GetThreadContext(ThreadContext *out, GDBContext *ctx, u32 threadId);
+Result GDB_SetThreadContext(GDBContext *ctx, u32 threadId, const ThreadContext *regs, ThreadContextControlFlags flags);
+s32 GDB_GetDynamicThreadPriority(GDBContext *ctx, u32 threadId);
+
 u32 GDB_GetCurrentThreadFromList(GDBContext *ctx, u32 *threadIds, u32 nbThreads);
 u32 GDB_GetCurrentThread(GDBContext *ctx);
 
@@ -29,10 +29,47 @@
 #include <3ds/types.h>
 #include "MyThread.h"
 
+// Versioned packets start with a header; bare 12 or 20-byte state packets are still accepted
+#define INPUT_REDIRECTION_MAGIC             0x31445249 // "IRD1"
+#define INPUT_REDIRECTION_FLAG_RESET        1 // sequence numbers restart from this packet
+
+#define INPUT_REDIRECTION_STATE_SIZE        20 // hid (12 bytes), ir (4 bytes), special buttons (4 bytes)
+#define INPUT_REDIRECTION_MAX_PACKET_SIZE   (sizeof(InputRedirectionPacketHeader) + INPUT_REDIRECTION_STATE_SIZE)
+
+#define INPUT_REDIRECTION_MAX_BATCH         32 // max. number of datagrams drained per wakeup
+#define INPUT_REDIRECTION_MIN_POLL_TIMEOUT  2  // ms
+#define INPUT_REDIRECTION_MAX_POLL_TIMEOUT  32 // ms
+
+typedef enum InputRedirectionPacketType
+{
+    INPUT_REDIRECTION_PACKET_STATE = 0,
+    INPUT_REDIRECTION_PACKET_STATS_REQUEST,
+    INPUT_REDIRECTION_PACKET_STATS_REPLY, // header followed by InputRedirectionStats, sent back to the requester
+} InputRedirectionPacketType;
+
+typedef struct InputRedirectionPacketHeader
+{
+    u32 magic;
+    u16 type;
+    u16 flags;
+    u32 sequence;       // state packets older than the latest applied one are dropped
+    u32 timestampUs;    // sender clock, only differences are used
+} InputRedirectionPacketHeader;
+
+typedef struct InputRedirectionStats
+{
+    u32 received, applied, stale, lost, malformed;
+    u32 lastSequence;
+    u32 jitterUs;       // smoothed interarrival jitter
+    u32 maxDelayUs;     // worst transit time, relative to the best one seen
+    s32 minTransitUs, lastTransitUs; // these depend on the clock offset between both ends
+} InputRedirectionStats;
+
 extern bool inputRedirectionEnabled;
 extern Handle inputRedirectionThreadStartedEvent;
 
 extern int inputRedirectionStartResult;
+extern InputRedirectionStats inputRedirectionStats;
 
 MyThread *inputRedirectionCreateThread(void);
 void inputRedirectionThreadMain(void);
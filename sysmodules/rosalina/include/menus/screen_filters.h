@@ -38,10 +38,31 @@ typedef struct ScreenFilter {
     float brightness;
 } ScreenFilter;
 
+// Both screens gradually switch to these settings between startMinutes and endMinutes
+typedef struct ScreenFilterNightMode {
+    bool enabled;
+    u16 startMinutes, endMinutes; // since midnight
+    u16 transitionMinutes;
+    u16 cct;
+    float gamma;
+    float brightness;
+} ScreenFilterNightMode;
+
 extern ScreenFilter topScreenFilter;
 extern ScreenFilter bottomScreenFilter;
+extern ScreenFilterNightMode screenFilterNightMode;
 
 void ScreenFiltersMenu_RestoreSettings(void);
+
+// Writes the color LUT of a screen for the given filter (which doesn't have to be the saved one).
+// LUTs are cached, this is cheap enough to be used at frame rate for transitions.
+void ScreenFiltersMenu_ApplyFilter(bool top, const ScreenFilter *filter);
+void ScreenFiltersMenu_InterpolateFilter(ScreenFilter *out, const ScreenFilter *from, const ScreenFilter *to, float t);
+
+// Called periodically from the menu thread, does nothing unless a night mode transition is due
+void ScreenFiltersMenu_UpdateNightMode(void);
+// Forces the next update to re-evaluate the schedule (e.g. after the saved filters were changed)
+void ScreenFiltersMenu_RefreshNightMode(void);
 void ScreenFiltersMenu_LoadConfig(void);
 
 void ScreenFiltersMenu_SetDefault(void);            // 6500K (default)
@@ -18,6 +18,16 @@
 #include <errno.h>
 
 #define SYNC_ERROR ENODEV
+
+// Pieces up to this size are coalesced by socSendv before being sent
+#define SOC_GATHER_BUF_LEN 0x200
+
+typedef struct SocBuffer
+{
+    const void *data;
+    size_t len;
+} SocBuffer;
+
 extern bool miniSocEnabled;
 
 Result miniSocInit(void);
@@ -37,6 +47,7 @@ int socAccept(int sockfd, struct sockaddr *addr, socklen_t *addrlen);
 int socConnect(int sockfd, const struct sockaddr *addr, socklen_t addrlen);
 int socPoll(struct pollfd *fds, nfds_t nfds, int timeout);
 int socSetsockopt(int sockfd, int level, int optname, const void *optval, socklen_t optlen);
+int socShutdown(int sockfd, int how);
 int socClose(int sockfd);
 long socGethostid(void);
 
@@ -52,3 +63,7 @@ static inline ssize_t socSend(int sockfd, const void *buf, size_t len, int flags
 {
     return socSendto(sockfd, buf, len, flags, NULL, 0);
 }
+
+// These loop on partial sends, and return the number of bytes sent (or the error if nothing was)
+ssize_t socSendAll(int sockfd, const void *buf, size_t len, int flags);
+ssize_t socSendv(int sockfd, const SocBuffer *bufs, u32 nbBufs, int flags);
@@ -67,10 +67,12 @@ typedef struct PACKED
 } _3gx_Header;
 
 
-Result  Check_3gx_Magic(IFile *file);
+// Only the header and then the whole file are read; everything else is parsed in place from the latter
+Result  Check_3gx_Magic(const _3gx_Header *header);
 Result  Read_3gx_Header(IFile *file, _3gx_Header *header);
-Result  Read_3gx_ParseHeader(IFile *file, _3gx_Header *header);
-Result  Read_3gx_LoadSegments(IFile *file, _3gx_Header *header, void *dst);
-Result  Read_3gx_EmbeddedPayloads(IFile *file, _3gx_Header *header);
+Result  Read_3gx_File(IFile *file, void *dst, u32 fileSize); // dst must be 4 bytes aligned
+Result  Read_3gx_ParseHeader(_3gx_Header *header, u32 fileSize);
+Result  Read_3gx_LoadSegments(_3gx_Header *header, u32 fileSize, void *dst);
+Result  Read_3gx_EmbeddedPayloads(_3gx_Header *header, u32 fileSize);
 Result  Set_3gx_LoadParams(u32* loadFunc, u32* params);
 void	Reset_3gx_LoadParams(void);
\ No newline at end of file
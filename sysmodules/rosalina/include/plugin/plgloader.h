@@ -10,6 +10,7 @@ void        PluginLoader__MenuCallback(void);
 void        PluginLoader__UpdateMenu(void);
 void        PluginLoader__HandleKernelEvent(u32 notifId);
 void        PluginLoader__HandleCommands(void *ctx);
+void        PluginLoader__InvalidatePluginIndex(void);
 
 void    PluginLoader__Error(const char *message, Result res);
 
@@ -18,6 +19,7 @@ Result     MemoryBlock__IsReady(void);
 Result     MemoryBlock__Free(void);
 Result     MemoryBlock__ToSwapFile(void);
 Result     MemoryBlock__FromSwapFile(void);
+void       MemoryBlock__InvalidateSwapFile(void);
 Result     MemoryBlock__MountInProcess(void);
 Result     MemoryBlock__UnmountFromProcess(void);
 Result     MemoryBlock__SetSwapSettings(u32* func, bool isDec, u32* params);
@@ -0,0 +1,48 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#pragma once
+
+#include <3ds/types.h>
+
+// Minimal streaming QOI (https://qoiformat.org) encoder for screenshots: lossless, and much smaller than BMP
+// on typical screen contents while being cheap enough to run line by line
+
+#define QOI_HEADER_SIZE                 14
+#define QOI_END_MARKER_SIZE             8
+#define QOI_MAX_ENCODED_LINE_SIZE(w)    (4 * (w) + 1) // QOI_OP_RGB for every pixel, plus a pending run
+
+typedef struct QoiEncoder
+{
+    u32 index[64];
+    u32 prev;
+    u32 run;
+} QoiEncoder;
+
+void Qoi_WriteHeader(u8 *dst, u32 width, u32 height); // 3 channels, sRGB
+void Qoi_InitEncoder(QoiEncoder *enc);
+u32 Qoi_EncodeBgr8Line(QoiEncoder *enc, u8 *dst, const u8 *src, u32 width); // returns the number of bytes written
+u32 Qoi_FinishEncoding(QoiEncoder *enc, u8 *dst); // at most 1 + QOI_END_MARKER_SIZE bytes
@@ -12,8 +12,19 @@
 #include <poll.h>
 #include <netinet/in.h>
 
+// Can be overridden at build time, poll_fds and ctx_ptrs are sized accordingly
+#ifndef MAX_PORTS
 #define MAX_PORTS (3+1)
+#endif
+#ifndef MAX_CTXS
 #define MAX_CTXS  (2 * MAX_PORTS)
+#endif
+
+// Upper bound on how long the server thread sleeps in socPoll. Termination doesn't depend on it
+// (see server_kill_connections), it only matters for the sleep mode/Wi-Fi checks
+#ifndef SOCK_POLL_TIMEOUT_MS
+#define SOCK_POLL_TIMEOUT_MS 1000
+#endif
 
 struct sock_server;
 struct sock_ctx;
@@ -75,6 +86,7 @@ Result server_init(struct sock_server *serv);
 Result server_bind(struct sock_server *serv, u16 port);
 void server_run(struct sock_server *serv);
 void server_kill_connections(struct sock_server *serv);
+void server_request_close(struct sock_ctx *ctx);
 void server_set_should_close_all(struct sock_server *serv);
 void server_finalize(struct sock_server *serv);
 bool Wifi__IsConnected(void);
\ No newline at end of file
@@ -41,9 +41,41 @@ static u32 framebufferCacheSize;
 static void *framebufferCache;
 static RecursiveLock lock;
 
+// Glyphs rotated like the framebuffer: one 10-bit mask per column, bit 0 being the bottom row
+static u16 fontColumns[256 * FONT_WIDTH];
+
+// Framebuffer columns (screen X coordinates) written to since the latest flush
+static u32 dirtyColumns[(SCREEN_BOT_WIDTH + 31) / 32];
+
+static void Draw_InitFontColumns(void)
+{
+    for(u32 c = 0; c < 256; c++)
+    {
+        for(u32 x = 0; x < FONT_WIDTH; x++)
+        {
+            u16 mask = 0;
+            for(u32 y = 0; y < FONT_HEIGHT; y++)
+                mask |= ((font[c * FONT_HEIGHT + y] >> (FONT_WIDTH - x)) & 1) << (FONT_HEIGHT - 1 - y);
+            fontColumns[c * FONT_WIDTH + x] = mask;
+        }
+    }
+}
+
+static inline void Draw_MarkColumnDirty(u32 x)
+{
+    if(x < SCREEN_BOT_WIDTH)
+        dirtyColumns[x / 32] |= 1u << (x % 32);
+}
+
+static void Draw_MarkAllColumnsDirty(void)
+{
+    memset(dirtyColumns, 0xFF, sizeof(dirtyColumns));
+}
+
 void Draw_Init(void)
 {
     RecursiveLock_Init(&lock);
+    Draw_InitFontColumns();
 }
 
 void Draw_Lock(void)
@@ -59,26 +91,33 @@ void Draw_Unlock(void)
 void Draw_DrawCharacter(u32 posX, u32 posY, u32 color, char character)
 {
     u16 *const fb = (u16 *)FB_BOTTOM_VRAM_ADDR;
+    const u16 *glyph = &fontColumns[(u8)character * FONT_WIDTH];
 
-    s32 y;
-    for(y = 0; y < 10; y++)
+    // Each glyph column is FONT_HEIGHT contiguous pixels in the (rotated) framebuffer. Only pixels that
+    // actually change are written, so that redrawing the same text leaves nothing to flush.
+    for(u32 x = 0; x < FONT_WIDTH; x++)
     {
-        char charPos = font[character * 10 + y];
+        u32 screenX = posX - 1 + x;
+        u16 *dst = fb + screenX * SCREEN_BOT_HEIGHT + (SCREEN_BOT_HEIGHT - FONT_HEIGHT - posY);
+        u32 mask = glyph[x];
+        u32 diff = 0;
 
-        s32 x;
-        for(x = 6; x >= 1; x--)
+        for(u32 y = 0; y < FONT_HEIGHT; y++)
         {
-            u32 screenPos = (posX * SCREEN_BOT_HEIGHT * 2 + (SCREEN_BOT_HEIGHT - y - posY - 1) * 2) + (5 - x) * 2 * SCREEN_BOT_HEIGHT;
-            u32 pixelColor = ((charPos >> x) & 1) ? color : COLOR_BLACK;
-            fb[screenPos / 2] = pixelColor;
+            u16 pixelColor = ((mask >> y) & 1) ? (u16)color : COLOR_BLACK;
+            diff |= dst[y] ^ pixelColor;
+            dst[y] = pixelColor;
         }
+
+        if(diff != 0)
+            Draw_MarkColumnDirty(screenX);
     }
 }
 
 
 u32 Draw_DrawString(u32 posX, u32 posY, u32 color, const char *string)
 {
-    for(u32 i = 0, line_i = 0; i < strlen(string); i++)
+    for(u32 i = 0, line_i = 0; string[i] != '\0'; i++)
         switch(string[i])
         {
             case '\n':
@@ -122,6 +161,7 @@ u32 Draw_DrawFormattedString(u32 posX, u32 posY, u32 color, const char *fmt, ...
 void Draw_FillFramebuffer(u32 value)
 {
     memset(FB_BOTTOM_VRAM_ADDR, value, FB_BOTTOM_SIZE);
+    Draw_MarkAllColumnsDirty();
 }
 
 void Draw_ClearFramebuffer(void)
@@ -225,6 +265,40 @@ void Draw_RestoreFramebuffer(void)
 void Draw_FlushFramebuffer(void)
 {
     svcFlushProcessDataCache(CUR_PROCESS_HANDLE, (u32)FB_BOTTOM_VRAM_ADDR, FB_BOTTOM_SIZE);
+    memset(dirtyColumns, 0, sizeof(dirtyColumns));
+}
+
+static inline bool Draw_IsColumnDirty(u32 x)
+{
+    return (dirtyColumns[x / 32] >> (x % 32)) & 1;
+}
+
+void Draw_FlushDirtyFramebuffer(void)
+{
+    // Columns are contiguous in memory: flush each run of dirty columns, merging runs separated by small gaps
+    // to save on SVC calls
+    u32 x = 0;
+    while(x < SCREEN_BOT_WIDTH)
+    {
+        if(!Draw_IsColumnDirty(x))
+        {
+            x++;
+            continue;
+        }
+
+        u32 start = x, end = x + 1;
+        for(x = end; x < SCREEN_BOT_WIDTH && x - end < DRAW_DIRTY_MERGE_GAP; x++)
+        {
+            if(Draw_IsColumnDirty(x))
+                end = x + 1;
+        }
+
+        u32 stride = SCREEN_BOT_HEIGHT * 2;
+        svcFlushProcessDataCache(CUR_PROCESS_HANDLE, (u32)FB_BOTTOM_VRAM_ADDR + start * stride, (end - start) * stride);
+        x = end;
+    }
+
+    memset(dirtyColumns, 0, sizeof(dirtyColumns));
 }
 
 u32 Draw_GetCurrentFramebufferAddress(bool top, bool left)
@@ -260,91 +334,199 @@ void Draw_GetCurrentScreenInfo(u32 *width, bool *is3d, bool top)
     }
 }
 
-static inline void Draw_WriteUnaligned(u8 *dst, u32 tmp, u32 size)
+// Framebuffer pixels are first expanded to 0x00RRGGBB, the BGR8 byte order once stored little-endian
+static inline u32 Draw_ExpandRgb565(u32 px)
 {
-    memcpy(dst, &tmp, size);
+    // thanks neobrain
+    u32 blue = px & 0x1F;
+    u32 green = (px >> 5) & 0x3F;
+    u32 red = (px >> 11) & 0x1F;
+
+    blue = (blue << 3) | (blue >> 2);
+    green = (green << 2) | (green >> 4);
+    red = (red << 3) | (red >> 2);
+
+    return blue | (green << 8) | (red << 16);
 }
 
-void Draw_CreateBitmapHeader(u8 *dst, u32 width, u32 heigth)
+static inline u32 Draw_ExpandRgb5a1(u32 px)
 {
-    static const u8 bmpHeaderTemplate[54] = {
-        0x42, 0x4D, 0xCC, 0xCC, 0xCC, 0xCC, 0x00, 0x00, 0x00, 0x00, 0x36, 0x00, 0x00, 0x00, 0x28, 0x00,
-        0x00, 0x00, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0x01, 0x00, 0x18, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0xCC, 0xCC, 0xCC, 0xCC, 0x12, 0x0B, 0x00, 0x00, 0x12, 0x0B, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-    };
+    u32 blue = (px >> 1) & 0x1F;
+    u32 green = (px >> 6) & 0x1F;
+    u32 red = (px >> 11) & 0x1F;
+
+    blue = (blue << 3) | (blue >> 2);
+    green = (green << 3) | (green >> 2);
+    red = (red << 3) | (red >> 2);
 
-    memcpy(dst, bmpHeaderTemplate, 54);
-    Draw_WriteUnaligned(dst + 2, 54 + 3 * width * heigth, 4);
-    Draw_WriteUnaligned(dst + 0x12, width, 4);
-    Draw_WriteUnaligned(dst + 0x16, heigth, 4);
-    Draw_WriteUnaligned(dst + 0x22, 3 * width * heigth, 4);
+    return blue | (green << 8) | (red << 16);
 }
 
-static inline void Draw_ConvertPixelToBGR8(u8 *dst, const u8 *src, GSPGPU_FramebufferFormat srcFormat)
+static inline u32 Draw_ExpandRgba4(u32 px)
 {
-    u8 red, green, blue;
-    switch(srcFormat)
+    u32 blue = (px >> 4) & 0xF;
+    u32 green = (px >> 8) & 0xF;
+    u32 red = (px >> 12) & 0xF;
+
+    return (blue * 0x11) | ((green * 0x11) << 8) | ((red * 0x11) << 16);
+}
+
+static inline void Draw_StoreBgr8(u8 *dst, u32 px)
+{
+    dst[0] = px & 0xFF;
+    dst[1] = (px >> 8) & 0xFF;
+    dst[2] = (px >> 16) & 0xFF;
+}
+
+// Stores 4 consecutive pixels as 3 words, dst must be word-aligned
+static inline void Draw_StoreBgr8Quad(u8 *dst, u32 px0, u32 px1, u32 px2, u32 px3)
+{
+    u32 *dst32 = (u32 *)dst;
+    dst32[0] = px0 | (px1 << 24);
+    dst32[1] = (px1 >> 8) | (px2 << 16);
+    dst32[2] = (px2 >> 16) | (px3 << 8);
+}
+
+// The framebuffers are rotated: each column of the source (screen line of the output) is contiguous.
+// The kernels below convert 4 columns at a time so that each output line gets whole words, and fall back
+// to converting pixel by pixel for what's left (or if things aren't aligned).
+// src points to the first line to convert in the first column.
+typedef void (*FrameBufferConvertKernel)(u8 *buf, const u8 *src, u32 width, u32 stride, u32 numLines);
+
+static inline bool Draw_CanConvertQuads(const u8 *buf, u32 width, u32 stride)
+{
+    return (((u32)buf | width | stride) & 3) == 0;
+}
+
+static void Draw_ConvertFrameBufferColumnsRgba8(u8 *buf, const u8 *src, u32 width, u32 stride, u32 numLines)
+{
+    u32 dstStride = width * 3;
+    u32 x = 0;
+
+    if(Draw_CanConvertQuads(buf, width, stride) && ((u32)src & 3) == 0)
     {
-        case GSP_RGBA8_OES:
+        for(; x < width; x += 4)
         {
-            u32 px = *(u32 *)src;
-            dst[0] = (px >>  8) & 0xFF;
-            dst[1] = (px >> 16) & 0xFF;
-            dst[2] = (px >> 24) & 0xFF;
-            break;
+            const u32 *src0 = (const u32 *)(src + x * stride);
+            const u32 *src1 = (const u32 *)(src + (x + 1) * stride);
+            const u32 *src2 = (const u32 *)(src + (x + 2) * stride);
+            const u32 *src3 = (const u32 *)(src + (x + 3) * stride);
+            u8 *dst = buf + x * 3;
+
+            for(u32 y = 0; y < numLines; y++, dst += dstStride)
+                Draw_StoreBgr8Quad(dst, src0[y] >> 8, src1[y] >> 8, src2[y] >> 8, src3[y] >> 8);
         }
-        case GSP_BGR8_OES:
-        {
-            dst[2] = src[2];
-            dst[1] = src[1];
-            dst[0] = src[0];
-            break;
-        }
-        case GSP_RGB565_OES:
-        {
-            // thanks neobrain
-            u16 px = *(u16 *)src;
-            blue = px & 0x1F;
-            green = (px >> 5) & 0x3F;
-            red = (px >> 11) & 0x1F;
+    }
 
-            dst[0] = (blue  << 3) | (blue  >> 2);
-            dst[1] = (green << 2) | (green >> 4);
-            dst[2] = (red   << 3) | (red   >> 2);
+    for(; x < width; x++)
+    {
+        for(u32 y = 0; y < numLines; y++)
+            Draw_StoreBgr8(buf + (x + width * y) * 3, *(const u32 *)(src + x * stride + y * 4) >> 8);
+    }
+}
 
-            break;
-        }
-        case GSP_RGB5_A1_OES:
-        {
-            u16 px = *(u16 *)src;
-            blue = (px >> 1) & 0x1F;
-            green = (px >> 6) & 0x1F;
-            red = (px >> 11) & 0x1F;
+static inline u32 Draw_LoadBgr8(const u8 *src)
+{
+    return src[0] | (src[1] << 8) | (src[2] << 16);
+}
 
-            dst[0] = (blue  << 3) | (blue  >> 2);
-            dst[1] = (green << 3) | (green >> 2);
-            dst[2] = (red   << 3) | (red   >> 2);
+static void Draw_ConvertFrameBufferColumnsBgr8(u8 *buf, const u8 *src, u32 width, u32 stride, u32 numLines)
+{
+    u32 dstStride = width * 3;
+    u32 x = 0;
 
-            break;
-        }
-        case GSP_RGBA4_OES:
+    if(Draw_CanConvertQuads(buf, width, stride))
+    {
+        for(; x < width; x += 4)
         {
-            u16 px = *(u32 *)src;
-            blue = (px >> 4) & 0xF;
-            green = (px >> 8) & 0xF;
-            red = (px >> 12) & 0xF;
-
-            dst[0] = (blue  << 4) | (blue  >> 0);
-            dst[1] = (green << 4) | (green >> 0);
-            dst[2] = (red   << 4) | (red   >> 0);
-
-            break;
+            const u8 *src0 = src + x * stride;
+            u8 *dst = buf + x * 3;
+
+            for(u32 y = 0; y < numLines * 3; y += 3, dst += dstStride)
+            {
+                Draw_StoreBgr8Quad(
+                    dst,
+                    Draw_LoadBgr8(src0 + y),
+                    Draw_LoadBgr8(src0 + stride + y),
+                    Draw_LoadBgr8(src0 + 2 * stride + y),
+                    Draw_LoadBgr8(src0 + 3 * stride + y)
+                );
+            }
         }
-        default: break;
+    }
+
+    for(; x < width; x++)
+    {
+        for(u32 y = 0; y < numLines; y++)
+            Draw_StoreBgr8(buf + (x + width * y) * 3, Draw_LoadBgr8(src + x * stride + y * 3));
     }
 }
 
+// 16-bit formats: one word load per column gives two lines at once
+#define DRAW_DEFINE_CONVERT_COLUMNS_16(name, expand)\
+static void Draw_ConvertFrameBufferColumns##name(u8 *buf, const u8 *src, u32 width, u32 stride, u32 numLines)\
+{\
+    u32 dstStride = width * 3;\
+    u32 x = 0;\
+\
+    if(Draw_CanConvertQuads(buf, width, stride))\
+    {\
+        for(; x < width; x += 4)\
+        {\
+            const u8 *src0 = src + x * stride;\
+            u8 *dst = buf + x * 3;\
+            u32 y = 0;\
+\
+            if(((u32)src0 & 2) != 0 && numLines > 0)\
+            {\
+                Draw_StoreBgr8Quad(\
+                    dst,\
+                    expand(*(const u16 *)src0),\
+                    expand(*(const u16 *)(src0 + stride)),\
+                    expand(*(const u16 *)(src0 + 2 * stride)),\
+                    expand(*(const u16 *)(src0 + 3 * stride))\
+                );\
+                y = 1;\
+                dst += dstStride;\
+            }\
+\
+            for(; y + 2 <= numLines; y += 2, dst += 2 * dstStride)\
+            {\
+                u32 px0 = *(const u32 *)(src0 + y * 2);\
+                u32 px1 = *(const u32 *)(src0 + stride + y * 2);\
+                u32 px2 = *(const u32 *)(src0 + 2 * stride + y * 2);\
+                u32 px3 = *(const u32 *)(src0 + 3 * stride + y * 2);\
+\
+                Draw_StoreBgr8Quad(dst, expand(px0 & 0xFFFF), expand(px1 & 0xFFFF), expand(px2 & 0xFFFF), expand(px3 & 0xFFFF));\
+                Draw_StoreBgr8Quad(dst + dstStride, expand(px0 >> 16), expand(px1 >> 16), expand(px2 >> 16), expand(px3 >> 16));\
+            }\
+\
+            if(y < numLines)\
+            {\
+                Draw_StoreBgr8Quad(\
+                    dst,\
+                    expand(*(const u16 *)(src0 + y * 2)),\
+                    expand(*(const u16 *)(src0 + stride + y * 2)),\
+                    expand(*(const u16 *)(src0 + 2 * stride + y * 2)),\
+                    expand(*(const u16 *)(src0 + 3 * stride + y * 2))\
+                );\
+            }\
+        }\
+    }\
+\
+    for(; x < width; x++)\
+    {\
+        for(u32 y = 0; y < numLines; y++)\
+            Draw_StoreBgr8(buf + (x + width * y) * 3, expand(*(const u16 *)(src + x * stride + y * 2)));\
+    }\
+}
+
+DRAW_DEFINE_CONVERT_COLUMNS_16(Rgb565, Draw_ExpandRgb565)
+DRAW_DEFINE_CONVERT_COLUMNS_16(Rgb5a1, Draw_ExpandRgb5a1)
+DRAW_DEFINE_CONVERT_COLUMNS_16(Rgba4, Draw_ExpandRgba4)
+
+#undef DRAW_DEFINE_CONVERT_COLUMNS_16
+
 typedef struct FrameBufferConvertArgs {
     u8 *buf;
     u32 width;
@@ -357,22 +539,24 @@ typedef struct FrameBufferConvertArgs {
 static void Draw_ConvertFrameBufferLinesKernel(const FrameBufferConvertArgs *args)
 {
     static const u8 formatSizes[] = { 4, 3, 2, 2, 2 };
+    static const FrameBufferConvertKernel kernels[] = {
+        Draw_ConvertFrameBufferColumnsRgba8,
+        Draw_ConvertFrameBufferColumnsBgr8,
+        Draw_ConvertFrameBufferColumnsRgb565,
+        Draw_ConvertFrameBufferColumnsRgb5a1,
+        Draw_ConvertFrameBufferColumnsRgba4,
+    };
 
     GSPGPU_FramebufferFormat fmt = args->top ? (GSPGPU_FramebufferFormat)(GPU_FB_TOP_FMT & 7) : (GSPGPU_FramebufferFormat)(GPU_FB_BOTTOM_FMT & 7);
-    u32 width = args->width;
     u32 stride = args->top ? GPU_FB_TOP_STRIDE : GPU_FB_BOTTOM_STRIDE;
 
+    if((u32)fmt >= sizeof(kernels) / sizeof(kernels[0]))
+        return;
+
     u32 pa = Draw_GetCurrentFramebufferAddress(args->top, args->left);
-    u8 *addr = (u8 *)KERNPA2VA(pa);
+    const u8 *addr = (const u8 *)KERNPA2VA(pa);
 
-    for (u32 y = args->startingLine; y < args->startingLine + args->numLines; y++)
-    {
-        for(u32 x = 0; x < width; x++)
-        {
-            __builtin_prefetch(addr + x * stride + y * formatSizes[fmt], 0, 3);
-            Draw_ConvertPixelToBGR8(args->buf + (x + width * y) * 3 , addr + x * stride + y * formatSizes[fmt], fmt);
-        }
-    }
+    kernels[fmt](args->buf, addr + args->startingLine * formatSizes[fmt], args->width, stride, args->numLines);
 }
 
 void Draw_ConvertFrameBufferLines(u8 *buf, u32 width, u32 startingLine, u32 numLines, bool top, bool left)
@@ -103,13 +103,7 @@ Result GDB_AttachToProcess(GDBContext *ctx)
 void GDB_DetachFromProcess(GDBContext *ctx)
 {
     DebugEventInfo dummy;
-    for(u32 i = 0; i < ctx->nbBreakpoints; i++)
-    {
-        if(!ctx->breakpoints[i].persistent)
-            GDB_DisableBreakpointById(ctx, i);
-    }
-    memset(&ctx->breakpoints, 0, sizeof(ctx->breakpoints));
-    ctx->nbBreakpoints = 0;
+    GDB_RemoveAllBreakpoints(ctx);
 
     for(u32 i = 0; i < ctx->nbWatchpoints; i++)
     {
@@ -158,7 +152,7 @@ void GDB_DetachFromProcess(GDBContext *ctx)
     ctx->selectedThreadIdForContinuing = 0;
     ctx->nbThreads = 0;
     ctx->totalNbCreatedThreads = 0;
-    memset(ctx->threadInfos, 0, sizeof(ctx->threadInfos));
+    memset(ctx->threadInfos, 0, MAX_DEBUG_THREAD * sizeof(ThreadInfo));
 
     ctx->currentHioRequestTargetAddr = 0;
     memset(&ctx->currentHioRequest, 0, sizeof(PackedGdbHioRequest));
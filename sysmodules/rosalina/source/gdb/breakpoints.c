@@ -10,39 +10,96 @@
 #define _REENT_ONLY
 #include <errno.h>
 
-u32 GDB_FindClosestBreakpointSlot(GDBContext *ctx, u32 address)
+/*
+    GDB removes all of its breakpoints when the process stops, and inserts them all again before continuing.
+    Adding and removing breakpoints only updates the table: memory is only patched when the process is about to
+    run again (GDB_SyncBreakpoints), and a breakpoint removed then added back in the meantime costs nothing.
+    An entry which is installed but not enabled is pending removal, one which is enabled but not installed is
+    pending installation.
+*/
+
+static inline u32 GDB_HashBreakpointAddress(u32 address)
 {
-    if(ctx->nbBreakpoints == 0 || address <= ctx->breakpoints[0].address)
-        return 0;
-    else if(address > ctx->breakpoints[ctx->nbBreakpoints - 1].address)
-        return ctx->nbBreakpoints;
+    return ((address >> 1) * 2654435761u) >> (32 - GDB_BREAKPOINT_HASH_BITS);
+}
+
+// Returns the hash table slot of the breakpoint, or the empty slot where it would go
+static u32 GDB_FindBreakpointSlot(GDBContext *ctx, u32 address)
+{
+    u32 slot;
+    for(slot = GDB_HashBreakpointAddress(address); ctx->breakpointIndex[slot] != 0; slot = (slot + 1) % GDB_BREAKPOINT_HASH_SIZE)
+    {
+        if(ctx->breakpoints[ctx->breakpointIndex[slot] - 1].address == address)
+            break;
+    }
 
-    u32 a = 0, b = ctx->nbBreakpoints - 1, m;
+    return slot;
+}
+
+Breakpoint *GDB_FindBreakpoint(GDBContext *ctx, u32 address)
+{
+    u32 slot = GDB_FindBreakpointSlot(ctx, address & ~1);
+    return ctx->breakpointIndex[slot] == 0 ? NULL : &ctx->breakpoints[ctx->breakpointIndex[slot] - 1];
+}
+
+static void GDB_DeleteBreakpoint(GDBContext *ctx, Breakpoint *bkpt)
+{
+    u32 slot = GDB_FindBreakpointSlot(ctx, bkpt->address);
+    u32 id = bkpt - ctx->breakpoints;
+
+    // Backward shift deletion: move back the following entries of the cluster which can't be found anymore otherwise
+    u32 hole = slot;
+    ctx->breakpointIndex[hole] = 0;
+    for(slot = (hole + 1) % GDB_BREAKPOINT_HASH_SIZE; ctx->breakpointIndex[slot] != 0; slot = (slot + 1) % GDB_BREAKPOINT_HASH_SIZE)
+    {
+        u32 home = GDB_HashBreakpointAddress(ctx->breakpoints[ctx->breakpointIndex[slot] - 1].address);
+        if(((slot - home) % GDB_BREAKPOINT_HASH_SIZE) >= ((slot - hole) % GDB_BREAKPOINT_HASH_SIZE))
+        {
+            ctx->breakpointIndex[hole] = ctx->breakpointIndex[slot];
+            ctx->breakpointIndex[slot] = 0;
+            hole = slot;
+        }
+    }
 
-    do
+    // Move the last entry into the free one
+    u32 last = --ctx->nbBreakpoints;
+    if(id != last)
     {
-        m = (a + b) / 2;
-        if(ctx->breakpoints[m].address < address)
-            a = m;
-        else if(ctx->breakpoints[m].address > address)
-            b = m;
-        else
-            return m;
+        ctx->breakpointIndex[GDB_FindBreakpointSlot(ctx, ctx->breakpoints[last].address)] = id + 1;
+        ctx->breakpoints[id] = ctx->breakpoints[last];
     }
-    while(b - a > 1);
 
-    return b;
+    memset(&ctx->breakpoints[last], 0, sizeof(Breakpoint));
+}
+
+static int GDB_InstallBreakpoint(GDBContext *ctx, Breakpoint *bkpt)
+{
+    u32 instr = bkpt->instructionSize == 2 ? BREAKPOINT_INSTRUCTION_THUMB : BREAKPOINT_INSTRUCTION_ARM;
+    if(R_FAILED(svcWriteProcessMemory(ctx->debug, &instr, bkpt->address, bkpt->instructionSize)))
+        return -EFAULT;
+
+    bkpt->installed = true;
+    return 0;
+}
+
+static int GDB_UninstallBreakpoint(GDBContext *ctx, Breakpoint *bkpt)
+{
+    if(R_FAILED(svcWriteProcessMemory(ctx->debug, &bkpt->savedInstruction, bkpt->address, bkpt->instructionSize)))
+        return -EFAULT;
+
+    bkpt->installed = false;
+    return 0;
 }
 
 int GDB_GetBreakpointInstruction(u32 *instruction, GDBContext *ctx, u32 address)
 {
-    u32 id = GDB_FindClosestBreakpointSlot(ctx, address);
+    Breakpoint *bkpt = GDB_FindBreakpoint(ctx, address);
 
-    if(id == ctx->nbBreakpoints || ctx->breakpoints[id].address != address)
+    if(bkpt == NULL || bkpt->address != address)
         return -EINVAL;
 
     if(instruction != NULL)
-        *instruction = ctx->breakpoints[id].savedInstruction;
+        *instruction = bkpt->savedInstruction;
 
     return 0;
 }
@@ -54,63 +111,132 @@ int GDB_AddBreakpoint(GDBContext *ctx, u32 address, bool thumb, bool persist)
 
     address &= ~1;
 
-    u32 id = GDB_FindClosestBreakpointSlot(ctx, address);
+    u8 size = thumb ? 2 : 4;
+    Breakpoint *bkpt = GDB_FindBreakpoint(ctx, address);
 
-    if(id != ctx->nbBreakpoints && ctx->breakpoints[id].instructionSize != 0 && ctx->breakpoints[id].address == address)
+    if(bkpt != NULL && bkpt->enabled)
         return 0;
-    else if(ctx->nbBreakpoints == MAX_BREAKPOINT)
-        return -EBUSY;
-
-    for(u32 i = ctx->nbBreakpoints; i > id && i != 0; i--)
-        ctx->breakpoints[i] = ctx->breakpoints[i - 1];
+    else if(bkpt != NULL && bkpt->instructionSize == size)
+    {
+        // Still installed, cancel its removal
+        bkpt->enabled = true;
+        bkpt->persistent = persist;
+        ctx->nbPendingBreakpoints--;
+        return 0;
+    }
+    else if(bkpt != NULL)
+    {
+        // Pending removal with another instruction size: restore the original instruction first
+        int r = GDB_UninstallBreakpoint(ctx, bkpt);
+        if(r != 0)
+            return r;
 
-    ctx->nbBreakpoints++;
+        GDB_DeleteBreakpoint(ctx, bkpt);
+        ctx->nbPendingBreakpoints--;
+    }
 
-    Breakpoint *bkpt = &ctx->breakpoints[id];
-    u32 instr = thumb ? BREAKPOINT_INSTRUCTION_THUMB : BREAKPOINT_INSTRUCTION_ARM;
-    if(R_FAILED(svcReadProcessMemory(&bkpt->savedInstruction, ctx->debug, address, thumb ? 2 : 4)) ||
-       R_FAILED(svcWriteProcessMemory(ctx->debug, &instr, address, thumb ? 2 : 4)))
-    {
-        for(u32 i = id; i < ctx->nbBreakpoints - 1; i++)
-            ctx->breakpoints[i] = ctx->breakpoints[i + 1];
+    if(ctx->nbBreakpoints == MAX_BREAKPOINT)
+        return -EBUSY;
 
-        memset(&ctx->breakpoints[--ctx->nbBreakpoints], 0, sizeof(Breakpoint));
+    // Fail now rather than when the process is continued if the address is invalid
+    u32 savedInstruction = 0;
+    if(R_FAILED(svcReadProcessMemory(&savedInstruction, ctx->debug, address, size)))
         return -EFAULT;
-    }
 
-    bkpt->instructionSize = thumb ? 2 : 4;
+    u32 id = ctx->nbBreakpoints++;
+    bkpt = &ctx->breakpoints[id];
     bkpt->address = address;
+    bkpt->savedInstruction = savedInstruction;
+    bkpt->instructionSize = size;
     bkpt->persistent = persist;
+    bkpt->enabled = true;
+    bkpt->installed = false;
 
-    return 0;
-}
+    ctx->breakpointIndex[GDB_FindBreakpointSlot(ctx, address)] = id + 1;
+    ctx->nbPendingBreakpoints++;
 
-int GDB_DisableBreakpointById(GDBContext *ctx, u32 id)
-{
-    Breakpoint *bkpt = &ctx->breakpoints[id];
-    if(R_FAILED(svcWriteProcessMemory(ctx->debug, &bkpt->savedInstruction, bkpt->address, bkpt->instructionSize)))
-        return -EFAULT;
-    else return 0;
+    return 0;
 }
 
 int GDB_RemoveBreakpoint(GDBContext *ctx, u32 address)
 {
-    address &= ~1;
-
-    u32 id = GDB_FindClosestBreakpointSlot(ctx, address);
-    if(id == ctx->nbBreakpoints || ctx->breakpoints[id].address != address)
+    Breakpoint *bkpt = GDB_FindBreakpoint(ctx, address);
+    if(bkpt == NULL || !bkpt->enabled)
         return -EINVAL;
 
-    int r = GDB_DisableBreakpointById(ctx, id);
-    if(r != 0)
-        return r;
+    bkpt->enabled = false;
+    if(bkpt->installed)
+        ctx->nbPendingBreakpoints++;
     else
     {
-        for(u32 i = id; i < ctx->nbBreakpoints - 1; i++)
-            ctx->breakpoints[i] = ctx->breakpoints[i + 1];
+        // Never made it to memory
+        GDB_DeleteBreakpoint(ctx, bkpt);
+        ctx->nbPendingBreakpoints--;
+    }
+
+    return 0;
+}
+
+void GDB_SyncBreakpoints(GDBContext *ctx)
+{
+    if(ctx->nbPendingBreakpoints == 0)
+        return;
+
+    // Backwards, as deleting an entry moves the last one in its place
+    for(u32 i = ctx->nbBreakpoints; i > 0; i--)
+    {
+        Breakpoint *bkpt = &ctx->breakpoints[i - 1];
+
+        if(bkpt->enabled && !bkpt->installed)
+        {
+            if(GDB_InstallBreakpoint(ctx, bkpt) != 0)
+                GDB_DeleteBreakpoint(ctx, bkpt);
+        }
+        else if(!bkpt->enabled && bkpt->installed)
+        {
+            GDB_UninstallBreakpoint(ctx, bkpt);
+            GDB_DeleteBreakpoint(ctx, bkpt);
+        }
+    }
 
-        memset(&ctx->breakpoints[--ctx->nbBreakpoints], 0, sizeof(Breakpoint));
+    ctx->nbPendingBreakpoints = 0;
+}
 
-        return 0;
+void GDB_HidePendingBreakpoints(GDBContext *ctx, void *buf, u32 address, u32 len)
+{
+    // Breakpoints GDB has removed may still be in memory, show their original instruction instead
+    if(ctx->nbPendingBreakpoints == 0)
+        return;
+
+    for(u32 i = 0; i < ctx->nbBreakpoints; i++)
+    {
+        const Breakpoint *bkpt = &ctx->breakpoints[i];
+        if(bkpt->enabled || !bkpt->installed || bkpt->address >= address + len || bkpt->address + bkpt->instructionSize <= address)
+            continue;
+
+        for(u32 j = 0; j < bkpt->instructionSize; j++)
+        {
+            u32 off = bkpt->address + j - address;
+            if(off < len)
+                ((u8 *)buf)[off] = (u8)(bkpt->savedInstruction >> (8 * j));
+        }
+    }
+}
+
+void GDB_RemoveAllBreakpoints(GDBContext *ctx)
+{
+    for(u32 i = 0; i < ctx->nbBreakpoints; i++)
+    {
+        // Persistent breakpoints stay after detaching
+        Breakpoint *bkpt = &ctx->breakpoints[i];
+        if(bkpt->installed && (!bkpt->persistent || !bkpt->enabled))
+            GDB_UninstallBreakpoint(ctx, bkpt);
+        else if(!bkpt->installed && bkpt->persistent && bkpt->enabled)
+            GDB_InstallBreakpoint(ctx, bkpt);
     }
+
+    memset(ctx->breakpoints, 0, MAX_BREAKPOINT * sizeof(Breakpoint));
+    memset(ctx->breakpointIndex, 0, GDB_BREAKPOINT_HASH_SIZE * sizeof(u16));
+    ctx->nbBreakpoints = 0;
+    ctx->nbPendingBreakpoints = 0;
 }
@@ -14,6 +14,7 @@
 #include "gdb/mem.h"
 #include "gdb/hio.h"
 #include "gdb/watchpoints.h"
+#include "gdb/breakpoints.h"
 #include "fmt.h"
 
 #include <stdlib.h>
@@ -217,7 +218,9 @@ GDB_DECLARE_HANDLER(Break)
 void GDB_ContinueExecution(GDBContext *ctx)
 {
     ctx->selectedThreadId = ctx->selectedThreadIdForContinuing = 0;
+    GDB_SyncBreakpoints(ctx);
     svcContinueDebugEvent(ctx->debug, ctx->continueFlags);
+    GDB_InvalidateThreadSnapshots(ctx);
     ctx->flags |= GDB_FLAG_PROCESS_CONTINUING;
 }
 
@@ -251,11 +254,11 @@ GDB_DECLARE_HANDLER(Continue)
         if(GDB_ParseHexIntegerList(&addr, ctx->commandData + 3, 1, 0) == NULL)
             return GDB_ReplyErrno(ctx, EILSEQ);
 
-        Result r = svcGetDebugThreadContext(&regs, ctx->debug, ctx->currentThreadId, THREADCONTEXT_CONTROL_CPU_SPRS);
+        Result r = GDB_GetThreadContext(&regs, ctx, ctx->currentThreadId);
         if(R_SUCCEEDED(r))
         {
             regs.cpu_registers.pc = addr;
-            r = svcSetDebugThreadContext(ctx->debug, ctx->currentThreadId, &regs, THREADCONTEXT_CONTROL_CPU_SPRS);
+            r = GDB_SetThreadContext(ctx, ctx->currentThreadId, &regs, THREADCONTEXT_CONTROL_CPU_SPRS);
         }
     }
 
@@ -326,9 +329,8 @@ static int GDB_ParseCommonThreadInfo(char *out, GDBContext *ctx, int sig)
 {
     u32 threadId = ctx->currentThreadId;
     ThreadContext regs;
-    s64 dummy;
     u32 core;
-    Result r = svcGetDebugThreadContext(&regs, ctx->debug, threadId, THREADCONTEXT_CONTROL_ALL);
+    Result r = GDB_GetThreadContext(&regs, ctx, threadId);
 
     char tidbuf[32];
     GDB_EncodeThreadId(ctx, tidbuf, ctx->currentThreadId);
@@ -337,7 +339,7 @@ static int GDB_ParseCommonThreadInfo(char *out, GDBContext *ctx, int sig)
     if(R_FAILED(r))
         return n;
 
-    r = svcGetDebugThreadParam(&dummy, &core, ctx->debug, ctx->currentThreadId, DBGTHREAD_PARAMETER_CPU_CREATOR); // Creator = "first ran, and running the thread"
+    r = GDB_GetThreadParam(&core, ctx, ctx->currentThreadId, DBGTHREAD_PARAMETER_CPU_CREATOR); // Creator = "first ran, and running the thread"
 
     if(R_SUCCEEDED(r))
         n += sprintf(out + n, "nucleo:%lx;", core);
@@ -378,6 +380,7 @@ void GDB_PreprocessDebugEvent(GDBContext *ctx, DebugEventInfo *info)
             else
             {
                 ++ctx->totalNbCreatedThreads;
+                memset(ctx->threadInfos + ctx->nbThreads, 0, sizeof(ThreadInfo));
                 ctx->threadInfos[ctx->nbThreads].id = info->thread_id;
                 ctx->threadInfos[ctx->nbThreads++].tls = info->attach_thread.thread_local_storage;
             }
@@ -434,11 +437,11 @@ void GDB_PreprocessDebugEvent(GDBContext *ctx, DebugEventInfo *info)
                 {
                     // kernel bugfix for thumb mode
                     ThreadContext regs;
-                    Result r = svcGetDebugThreadContext(&regs, ctx->debug, info->thread_id, THREADCONTEXT_CONTROL_CPU_SPRS);
+                    Result r = GDB_GetThreadContext(&regs, ctx, info->thread_id);
                     if(R_SUCCEEDED(r) && (regs.cpu_registers.cpsr & 0x20) != 0)
                     {
                         regs.cpu_registers.pc += 2;
-                        r = svcSetDebugThreadContext(ctx->debug, info->thread_id, &regs, THREADCONTEXT_CONTROL_CPU_SPRS);
+                        r = GDB_SetThreadContext(ctx, info->thread_id, &regs, THREADCONTEXT_CONTROL_CPU_SPRS);
                     }
 
                     break;
@@ -592,10 +595,9 @@ int GDB_SendStopReply(GDBContext *ctx, const DebugEventInfo *info)
                     }
 
                     u32 currentThreadId = nbThreads > 0 ? GDB_GetCurrentThreadFromList(ctx, threadIds, nbThreads) : GDB_GetCurrentThread(ctx);
-                    s64 dummy;
                     u32 mask = 0;
 
-                    svcGetDebugThreadParam(&dummy, &mask, ctx->debug, currentThreadId, DBGTHREAD_PARAMETER_SCHEDULING_MASK_LOW);
+                    GDB_GetThreadParam(&mask, ctx, currentThreadId, DBGTHREAD_PARAMETER_SCHEDULING_MASK_LOW);
 
                     if(mask == 1)
                         ctx->currentThreadId = currentThreadId;
@@ -652,7 +654,7 @@ int GDB_SendStopReply(GDBContext *ctx, const DebugEventInfo *info)
                 int total = 0;
                 while(remaining > 0)
                 {
-                    u32 pending = (GDB_BUF_LEN - 1) / 2;
+                    u32 pending = (GDB_PACKET_BUF_LEN - 1) / 2;
                     pending = pending < remaining ? pending : remaining;
 
                     int res = GDB_SendMemory(ctx, "O", 1, addr + sent, pending);
@@ -694,6 +696,8 @@ int GDB_HandleDebugEvents(GDBContext *ctx)
     if(R_FAILED(rdbg))
         return -1;
 
+    // New stop: threads may have run since the last one
+    GDB_InvalidateThreadSnapshots(ctx);
     GDB_PreprocessDebugEvent(ctx, &info);
 
     int ret = 0;
@@ -708,7 +712,11 @@ int GDB_HandleDebugEvents(GDBContext *ctx)
         Result r = 0;
         ret = GDB_SendStopReply(ctx, &info);
         if(info.flags & 1)
+        {
+            GDB_SyncBreakpoints(ctx);
             r = svcContinueDebugEvent(ctx->debug, ctx->continueFlags);
+            GDB_InvalidateThreadSnapshots(ctx);
+        }
 
         if(r == (Result)0xD8A02008) // process ended
             return -2;
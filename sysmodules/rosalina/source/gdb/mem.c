@@ -7,11 +7,14 @@
 
 #include "gdb/mem.h"
 #include "gdb/net.h"
+#include "gdb/breakpoints.h"
 #include "utils.h"
 
 static void *k_memcpy_no_interrupt(void *dst, const void *src, u32 len)
 {
+#ifdef __arm__ // not when built for the host tests
     __asm__ volatile("cpsid aif");
+#endif
     return memcpy(dst, src, len);
 }
 
@@ -21,7 +24,12 @@ Result GDB_ReadTargetMemoryInPage(void *out, GDBContext *ctx, u32 addr, u32 len)
     svcGetSystemInfo(&TTBCR, 0x10002, 0);
 
     if(addr < (1u << (32 - (u32)TTBCR))) // Note: UB with user-mapped MMIO (uses memcpy).
-        return svcReadProcessMemory(out, ctx->debug, addr, len);
+    {
+        Result r = svcReadProcessMemory(out, ctx->debug, addr, len);
+        if(R_SUCCEEDED(r))
+            GDB_HidePendingBreakpoints(ctx, out, addr, len);
+        return r;
+    }
     else if(!ctx->enableExternalMemoryAccess)
         return -1;
     else if(addr >= 0x80000000 && addr < 0xB0000000)
@@ -147,6 +155,9 @@ u32 GDB_WriteTargetMemory(GDBContext *ctx, const void *in, u32 addr, u32 len)
 {
     Result r = 0;
     u32 remaining = len, total = 0;
+
+    // Don't let breakpoint changes pending from before overwrite this
+    GDB_SyncBreakpoints(ctx);
     do
     {
         u32 nb = (remaining > 0x1000 - (addr & 0xFFF)) ? 0x1000 - (addr & 0xFFF) : remaining;
@@ -165,24 +176,25 @@ u32 GDB_WriteTargetMemory(GDBContext *ctx, const void *in, u32 addr, u32 len)
 
 int GDB_SendMemory(GDBContext *ctx, const char *prefix, u32 prefixLen, u32 addr, u32 len)
 {
-    char buf[GDB_BUF_LEN];
-    u8 membuf[GDB_BUF_LEN / 2];
-
-    if(prefix != NULL)
-        memcpy(buf, prefix, prefixLen);
-    else
+    if(prefix == NULL)
         prefixLen = 0;
 
-    if(prefixLen + 2 * len > GDB_BUF_LEN) // gdb shouldn't send requests which responses don't fit in a packet
+    if(prefixLen + 2 * len > GDB_PACKET_BUF_LEN) // gdb shouldn't send requests which responses don't fit in a packet
         return prefix == NULL ? GDB_ReplyErrno(ctx, ENOMEM) : -1;
 
+    // Read the data at the end of the packet buffer, then hex-encode it forward in place:
+    // the encoded data never catches up with the data not yet encoded.
+    char *buf = ctx->buffer + 1;
+    u8 *membuf = (u8 *)ctx->buffer + GDB_PACKET_BUF_LEN + 4 - len;
+
     u32 total = GDB_ReadTargetMemory(membuf, ctx, addr, len);
     if(total == 0)
         return prefix == NULL ? GDB_ReplyErrno(ctx, EFAULT) : -EFAULT;
     else
     {
+        memcpy(buf, prefix, prefixLen);
         GDB_EncodeHex(buf + prefixLen, membuf, total);
-        return GDB_SendPacket(ctx, buf, prefixLen + 2 * total);
+        return GDB_SendPacketFromBuffer(ctx, prefixLen + 2 * total);
     }
 }
 
@@ -195,49 +207,133 @@ int GDB_WriteMemory(GDBContext *ctx, const void *buf, u32 addr, u32 len)
         return GDB_ReplyOk(ctx);
 }
 
-u32 GDB_SearchMemory(bool *found, GDBContext *ctx, u32 addr, u32 len, const void *pattern, u32 patternLen)
+static Result GDB_SearchReadPage(void *out, GDBContext *ctx, u32 addr, u32 len, u32 TTBCR)
 {
-    u8 buf[0x1000 + 0x1000 * ((GDB_BUF_LEN + 0xFFF) / 0x1000)];
-    u32 maxNbPages = 1 + ((GDB_BUF_LEN + 0xFFF) / 0x1000);
-    u32 curAddr = addr;
+    if(addr >= (1u << (32 - TTBCR)))
+    {
+        // Don't touch IO
+        u32 PA = svcConvertVAToPA((const void *)addr, false);
+        if(PA == 0 || (PA >= 0x10000000 && PA <= 0x18000000))
+            return -1;
+    }
 
-    s64 TTBCR;
-    svcGetSystemInfo(&TTBCR, 0x10002, 0);
-    while(curAddr < addr + len)
+    return GDB_ReadTargetMemoryInPage(out, ctx, addr, len);
+}
+
+static inline bool GDB_SearchPatternMatches(const u8 *data, const GDBSearchPattern *pattern)
+{
+    if(pattern->mask == NULL)
+        return memcmp(data, pattern->data, pattern->len) == 0;
+
+    for(u32 i = 0; i < pattern->len; i++)
     {
-        u32 nbPages;
-        u32 addrBase = curAddr & ~0xFFF, addrDispl = curAddr & 0xFFF;
+        if((data[i] ^ pattern->data[i]) & pattern->mask[i])
+            return false;
+    }
+
+    return true;
+}
 
-        for(nbPages = 0; nbPages < maxNbPages; nbPages++)
+// Returns the offset of the first match starting in buf[0..nbPositions), or nbPositions
+static u32 GDB_SearchChunk(u32 *patternId, u8 *buf, u32 bufLen, u32 nbPositions, const GDBSearchPattern *patterns, u32 nbPatterns)
+{
+    if(nbPatterns == 1 && patterns[0].mask == NULL)
+    {
+        u32 size = nbPositions - 1 + patterns[0].len;
+        size = size > bufLen ? bufLen : size;
+        if(size < patterns[0].len)
+            return nbPositions;
+
+        u8 *pos = memsearch(buf, patterns[0].data, size, patterns[0].len);
+        *patternId = 0;
+        return pos == NULL ? nbPositions : pos - buf;
+    }
+
+    for(u32 off = 0; off < nbPositions; off++)
+    {
+        for(u32 i = 0; i < nbPatterns; i++)
         {
-            if(addr >= (1u << (32 - (u32)TTBCR)))
+            const GDBSearchPattern *pattern = &patterns[i];
+            if(off + pattern->len <= bufLen && GDB_SearchPatternMatches(buf + off, pattern))
             {
-                u32 PA = svcConvertVAToPA((const void *)addr, false);
-                if(PA == 0 || (PA >= 0x10000000 && PA <= 0x18000000))
-                    break;
+                *patternId = i;
+                return off;
             }
-
-            if(R_FAILED(GDB_ReadTargetMemoryInPage(buf + 0x1000 * nbPages, ctx, addrBase + nbPages * 0x1000, 0x1000)))
-                break;
         }
+    }
+
+    return nbPositions;
+}
+
+u32 GDB_SearchMemoryEx(bool *found, u32 *patternId, GDBContext *ctx, u32 addr, u32 len, const GDBSearchPattern *patterns, u32 nbPatterns)
+{
+    // Each page is read once. The last maxPatternLen - 1 bytes, which may be the beginning of a match, are carried over
+    // to the next page instead of being searched right away, so that the lowest match address is always found first.
+    u8 buf[GDB_SEARCH_MAX_PATTERN_LEN - 1 + 0x1000];
+    u32 bufAddr = addr, bufLen = 0;
+    u32 maxPatternLen = 0;
+
+    *found = false;
+    for(u32 i = 0; i < nbPatterns; i++)
+        maxPatternLen = patterns[i].len > maxPatternLen ? patterns[i].len : maxPatternLen;
+
+    if(maxPatternLen == 0 || maxPatternLen > GDB_SEARCH_MAX_PATTERN_LEN)
+        return 0;
+
+    s64 TTBCR;
+    svcGetSystemInfo(&TTBCR, 0x10002, 0);
+
+    u32 curAddr = addr, remaining = len;
+    while(remaining > 0)
+    {
+        u32 nb = 0x1000 - (curAddr & 0xFFF);
+        nb = nb > remaining ? remaining : nb;
 
-        u8 *pos = NULL;
-        if(addrDispl + patternLen <= 0x1000 * nbPages)
-            pos = memsearch(buf + addrDispl, pattern, 0x1000 * nbPages - addrDispl, patternLen);
+        bool readable = R_SUCCEEDED(GDB_SearchReadPage(buf + bufLen, ctx, curAddr, nb, (u32)TTBCR));
+        curAddr += nb;
+        remaining -= nb;
 
-        if(pos != NULL)
+        if(readable)
         {
-            *found = true;
-            return addrBase + (pos - buf);
+            if(bufLen == 0)
+                bufAddr = curAddr - nb;
+            bufLen += nb;
         }
 
-        curAddr = addrBase + 0x1000;
+        // Matches can't span an unreadable page, nor go past the end of the range: search what's left in these cases
+        bool last = !readable || remaining == 0;
+        u32 nbPositions;
+        if(last)
+            nbPositions = bufLen;
+        else
+            nbPositions = bufLen >= maxPatternLen ? bufLen - (maxPatternLen - 1) : 0;
+
+        if(nbPositions > 0)
+        {
+            u32 off = GDB_SearchChunk(patternId, buf, bufLen, nbPositions, patterns, nbPatterns);
+            if(off < nbPositions)
+            {
+                *found = true;
+                return bufAddr + off;
+            }
+
+            memmove(buf, buf + nbPositions, bufLen - nbPositions);
+            bufAddr += nbPositions;
+            bufLen -= nbPositions;
+        }
     }
 
-    *found = false;
     return 0;
 }
 
+u32 GDB_SearchMemory(bool *found, GDBContext *ctx, u32 addr, u32 len, const void *pattern, u32 patternLen)
+{
+    GDBSearchPattern p = { .data = (const u8 *)pattern, .mask = NULL, .len = patternLen };
+    u32 patternId;
+
+    return GDB_SearchMemoryEx(found, &patternId, ctx, addr, len, &p, 1);
+}
+
 GDB_DECLARE_HANDLER(ReadMemory)
 {
     u32 lst[2];
@@ -250,6 +346,49 @@ GDB_DECLARE_HANDLER(ReadMemory)
     return GDB_SendMemory(ctx, NULL, 0, addr, len);
 }
 
+GDB_DECLARE_HANDLER(ReadMemoryRaw)
+{
+    u32 lst[2];
+    if(GDB_ParseHexIntegerList(lst, ctx->commandData, 2, 0) == NULL)
+        return GDB_ReplyErrno(ctx, EILSEQ);
+
+    u32 addr = lst[0];
+    u32 len = lst[1];
+
+    // "b" followed by the escaped data. Each chunk of target memory is read right where it needs to be for it to be
+    // escaped forward in place into its final location in the packet buffer (no more than twice its size), so
+    // unescaped data fills the entire packet. GDB handles replies shorter than requested.
+    char *out = ctx->buffer + 2;
+    char *end = ctx->buffer + 1 + GDB_PACKET_BUF_LEN;
+    u32 total = 0;
+
+    while(total < len)
+    {
+        u32 nb = 0x1000 - (addr & 0xFFF);
+        u32 room = (end - out) / 2;
+        nb = nb > len - total ? len - total : nb;
+        nb = nb > room ? room : nb;
+        if(nb == 0)
+            break;
+
+        u8 *chunk = (u8 *)end - nb;
+        if(R_FAILED(GDB_ReadTargetMemoryInPage(chunk, ctx, addr, nb)))
+            break;
+
+        u32 encodedCount;
+        GDB_EscapeBinaryData(&encodedCount, out, chunk, nb, end - out);
+        out += encodedCount;
+        addr += nb;
+        total += nb;
+    }
+
+    if(total == 0 && len != 0)
+        return GDB_ReplyErrno(ctx, EFAULT);
+
+    ctx->buffer[1] = 'b';
+    return GDB_SendPacketFromBuffer(ctx, out - (ctx->buffer + 1));
+}
+
 GDB_DECLARE_HANDLER(WriteMemory)
 {
     u32 lst[2];
@@ -261,10 +400,11 @@ GDB_DECLARE_HANDLER(WriteMemory)
     u32 addr = lst[0];
     u32 len = lst[1];
 
-    if(dataStart + 2 * len >= ctx->buffer + 4 + GDB_BUF_LEN)
+    if(dataStart + 2 * len > ctx->commandEnd)
         return GDB_ReplyErrno(ctx, ENOMEM);
 
-    u8 data[GDB_BUF_LEN / 2];
+    // Decode in place, the packet buffer is large enough for any request
+    u8 *data = (u8 *)dataStart;
     u32 n = GDB_DecodeHex(data, dataStart, len);
 
     if(n != len)
@@ -284,11 +424,11 @@ GDB_DECLARE_HANDLER(WriteMemoryRaw)
     u32 addr = lst[0];
     u32 len = lst[1];
 
-    if(dataStart + len >= ctx->buffer + 4 + GDB_BUF_LEN)
+    if(dataStart + len > ctx->commandEnd)
         return GDB_ReplyErrno(ctx, ENOMEM);
 
-    u8 data[GDB_BUF_LEN];
-    u32 n = GDB_UnescapeBinaryData(data, dataStart, len);
+    u8 *data = (u8 *)dataStart;
+    u32 n = GDB_UnescapeBinaryData(data, dataStart, ctx->commandEnd - dataStart);
 
     if(n != len)
         return GDB_ReplyErrno(ctx, n);
@@ -296,17 +436,78 @@ GDB_DECLARE_HANDLER(WriteMemoryRaw)
     return GDB_WriteMemory(ctx, data, addr, len);
 }
 
+// qSearch:patterns:<addr>;<length>;<pattern>[:<mask>][;<pattern>[:<mask>]]... (hex-encoded), Luma3DS extension.
+// Masked-out bits match anything. Replies with "1,<address>,<pattern index>" for the lowest match, or "0".
+static int GDB_SearchMemoryPatterns(GDBContext *ctx)
+{
+    GDBSearchPattern patterns[GDB_SEARCH_MAX_PATTERNS];
+    u32 nbPatterns = 0;
+    u32 lst[2];
+    bool found;
+    u32 patternId;
+
+    char *pos = (char *)GDB_ParseIntegerList(lst, ctx->commandData, 2, ';', ';', 16, false);
+    if(pos == NULL || *pos != ';')
+        return GDB_ReplyErrno(ctx, EILSEQ);
+
+    // Decode everything in place
+    while(*pos == ';')
+    {
+        if(nbPatterns >= GDB_SEARCH_MAX_PATTERNS)
+            return GDB_ReplyErrno(ctx, ENOMEM);
+
+        GDBSearchPattern *p = &patterns[nbPatterns++];
+        char *data = ++pos;
+        for(; *pos != ';' && *pos != ':' && *pos != 0; pos++);
+
+        u32 hexLen = pos - data;
+        if(hexLen / 2 > GDB_SEARCH_MAX_PATTERN_LEN)
+            return GDB_ReplyErrno(ctx, EINVAL);
+        else if(hexLen == 0 || hexLen % 2 != 0 || GDB_DecodeHex(data, data, hexLen / 2) != hexLen / 2)
+            return GDB_ReplyErrno(ctx, EILSEQ);
+
+        p->data = (const u8 *)data;
+        p->mask = NULL;
+        p->len = hexLen / 2;
+
+        if(*pos == ':')
+        {
+            char *mask = ++pos;
+            for(; *pos != ';' && *pos != 0; pos++);
+
+            if((u32)(pos - mask) != hexLen || GDB_DecodeHex(mask, mask, hexLen / 2) != hexLen / 2)
+                return GDB_ReplyErrno(ctx, EILSEQ);
+            p->mask = (const u8 *)mask;
+        }
+    }
+
+    if(*pos != 0)
+        return GDB_ReplyErrno(ctx, EILSEQ);
+
+    u32 foundAddr = GDB_SearchMemoryEx(&found, &patternId, ctx, lst[0], lst[1], patterns, nbPatterns);
+
+    if(found)
+        return GDB_SendFormattedPacket(ctx, "1,%lx,%lx", foundAddr, patternId);
+    else
+        return GDB_SendPacket(ctx, "0", 1);
+}
+
 GDB_DECLARE_QUERY_HANDLER(SearchMemory)
 {
     u32 lst[2];
     u32 addr, len;
-    u8 pattern[GDB_BUF_LEN];
+    u8 *pattern;
     const char *patternStart;
     u32 patternLen;
     bool found;
     u32 foundAddr;
 
-    if(strncmp(ctx->commandData, "memory:", 7) != 0)
+    if(strncmp(ctx->commandData, "patterns:", 9) == 0)
+    {
+        ctx->commandData += 9;
+        return GDB_SearchMemoryPatterns(ctx);
+    }
+    else if(strncmp(ctx->commandData, "memory:", 7) != 0)
         return GDB_ReplyErrno(ctx, EILSEQ);
 
     ctx->commandData += 7;
@@ -320,9 +521,12 @@ GDB_DECLARE_QUERY_HANDLER(SearchMemory)
     patternStart++;
     patternLen = ctx->commandEnd - patternStart;
 
+    pattern = (u8 *)patternStart;
     patternLen = GDB_UnescapeBinaryData(pattern, patternStart, patternLen);
+    if(patternLen == 0 || patternLen > GDB_SEARCH_MAX_PATTERN_LEN)
+        return GDB_ReplyErrno(ctx, EINVAL);
 
-    foundAddr = GDB_SearchMemory(&found, ctx, addr, len, patternStart, patternLen);
+    foundAddr = GDB_SearchMemory(&found, ctx, addr, len, pattern, patternLen);
 
     if(found)
         return GDB_SendFormattedPacket(ctx, "1,%x", foundAddr);
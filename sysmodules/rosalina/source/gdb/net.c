@@ -13,11 +13,54 @@
 
 u8 GDB_ComputeChecksum(const char *packetData, u32 len)
 {
-    u8 cksum = 0;
-    for(u32 i = 0; i < len; i++)
-        cksum += (u8)packetData[i];
+    const u8 *data = (const u8 *)packetData;
+    u32 cksum = 0;
+
+    for(; len > 0 && ((uintptr_t)data & 3) != 0; len--)
+        cksum += *data++;
+
+#ifdef __ARM_FEATURE_SIMD32
+    // usada8 adds the 4 bytes of a word to the accumulator at once
+    for(; len >= 4; len -= 4, data += 4)
+    {
+        u32 w;
+        memcpy(&w, data, 4);
+        __asm__("usada8 %0, %1, %2, %0" : "+r"(cksum) : "r"(w), "r"(0));
+    }
+#else
+    // Sum bytes 0/2 and 1/3 in 16-bit lanes, folding them before they can overflow
+    while(len >= 4)
+    {
+        u32 lanes = 0;
+        for(u32 n = 0; len >= 4 && n < 128; n++, len -= 4, data += 4)
+        {
+            u32 w;
+            memcpy(&w, data, 4);
+            lanes += (w & 0x00FF00FF) + ((w >> 8) & 0x00FF00FF);
+        }
+        cksum += (lanes & 0xFFFF) + (lanes >> 16);
+    }
+#endif
 
-    return cksum;
+    for(; len > 0; len--)
+        cksum += *data++;
+
+    return (u8)cksum;
+}
+
+// Converts each nibble (in its own byte lane) to a lowercase hex digit
+static inline u32 GDB_NibblesToHexDigits(u32 n)
+{
+#ifdef __ARM_FEATURE_SIMD32
+    // uadd8 sets the GE flag of the lanes which are >= 10, sel then picks the right offset for each lane
+    u32 tmp, offset;
+    __asm__("uadd8 %0, %2, %3\n\tsel %1, %4, %5" : "=&r"(tmp), "=r"(offset) : "r"(n), "r"(0xF6F6F6F6), "r"(0x57575757), "r"(0x30303030) : "cc");
+    (void)tmp;
+    return n + offset;
+#else
+    u32 mask = ((n + 0x06060606) >> 4) & 0x01010101;
+    return n + 0x30303030 + 0x27 * mask;
+#endif
 }
 
 void GDB_EncodeHex(char *dst, const void *src, u32 len)
@@ -25,6 +68,21 @@ void GDB_EncodeHex(char *dst, const void *src, u32 len)
     static const char *alphabet = "0123456789abcdef";
     const u8 *src8 = (u8 *)src;
 
+    // 4 bytes at a time (little-endian). Each word is read before its digits are written, so this can be done in place
+    // as long as dst + 2 * len <= src + len
+    for(; len >= 4; len -= 4, src8 += 4, dst += 8)
+    {
+        u32 w, hi, lo, out[2];
+        memcpy(&w, src8, 4);
+
+        hi = GDB_NibblesToHexDigits((w >> 4) & 0x0F0F0F0F);
+        lo = GDB_NibblesToHexDigits(w & 0x0F0F0F0F);
+
+        out[0] = (hi & 0xFF) | ((lo & 0xFF) << 8) | ((hi & 0xFF00) << 8) | ((lo & 0xFF00) << 16);
+        out[1] = ((hi >> 16) & 0xFF) | ((lo >> 8) & 0xFF00) | ((hi & 0xFF000000) >> 8) | (lo & 0xFF000000);
+        memcpy(dst, out, 8);
+    }
+
     for(u32 i = 0; i < len; i++)
     {
         dst[2 * i] = alphabet[(src8[i] & 0xf0) >> 4];
@@ -32,28 +90,36 @@ void GDB_EncodeHex(char *dst, const void *src, u32 len)
     }
 }
 
-static inline u32 GDB_DecodeHexDigit(char src, bool *ok)
+// 0x10 | value of each hex digit, 0 for anything else (including NUL)
+static const u8 gdbHexDigitValues[256] =
 {
-    *ok = true;
-    if(src >= '0' && src <= '9') return src - '0';
-    else if(src >= 'a' && src <= 'f') return 0xA + (src - 'a');
-    else if(src >= 'A' && src <= 'F') return 0xA + (src - 'A');
-    else
-    {
-        *ok = false;
-        return 0;
-    }
-}
+    ['0'] = 0x10, ['1'] = 0x11, ['2'] = 0x12, ['3'] = 0x13, ['4'] = 0x14, ['5'] = 0x15, ['6'] = 0x16, ['7'] = 0x17,
+    ['8'] = 0x18, ['9'] = 0x19,
+    ['a'] = 0x1A, ['b'] = 0x1B, ['c'] = 0x1C, ['d'] = 0x1D, ['e'] = 0x1E, ['f'] = 0x1F,
+    ['A'] = 0x1A, ['B'] = 0x1B, ['C'] = 0x1C, ['D'] = 0x1D, ['E'] = 0x1E, ['F'] = 0x1F,
+};
 
 u32 GDB_DecodeHex(void *dst, const char *src, u32 len)
 {
-    u32 i = 0;
-    bool ok = true;
+    u32 i;
     u8 *dst8 = (u8 *)dst;
-    for(i = 0; i < len && ok && src[2 * i] != 0 && src[2 * i + 1] != 0; i++)
-        dst8[i] = (GDB_DecodeHexDigit(src[2 * i], &ok) << 4) | GDB_DecodeHexDigit(src[2 * i + 1], &ok);
+    const u8 *src8 = (const u8 *)src;
+
+    // Stops at the first invalid digit or NUL, the second digit isn't read if the first one is invalid
+    for(i = 0; i < len; i++)
+    {
+        u32 hi = gdbHexDigitValues[src8[2 * i]];
+        if(hi == 0)
+            break;
+
+        u32 lo = gdbHexDigitValues[src8[2 * i + 1]];
+        if(lo == 0)
+            break;
+
+        dst8[i] = ((hi & 0xF) << 4) | (lo & 0xF);
+    }
 
-    return (!ok) ? i - 1 : i;
+    return i;
 }
 
 u32 GDB_EscapeBinaryData(u32 *encodedCount, void *dst, const void *src, u32 len, u32 maxLen)
@@ -61,9 +127,8 @@ u32 GDB_EscapeBinaryData(u32 *encodedCount, void *dst, const void *src, u32 len,
     u8 *dst8 = (u8 *)dst;
     const u8 *src8 = (const u8 *)src;
 
-    maxLen = maxLen >= len ? len : maxLen;
-
-    while((uintptr_t)dst8 < (uintptr_t)dst + maxLen)
+    // maxLen bounds the output, which may be larger than the input. Safe in place when dst + 2 * len <= src + len
+    while((uintptr_t)src8 < (uintptr_t)src + len && (uintptr_t)dst8 < (uintptr_t)dst + maxLen)
     {
         if(*src8 == '$' || *src8 == '#' || *src8 == '}' || *src8 == '*')
         {
@@ -173,133 +238,158 @@ const char *GDB_ParseHexIntegerList64(u64 *dst, const char *src, u32 nb, char la
 
 int GDB_ReceivePacket(GDBContext *ctx)
 {
-    char backupbuf[GDB_BUF_LEN + 4];
-    memcpy(backupbuf, ctx->buffer, ctx->latestSentPacketSize);
-    memset(ctx->buffer, 0, sizeof(ctx->buffer));
+    // Move the beginning of the packet being received, if any, to the start of the buffer
+    if(ctx->recvStart != 0)
+    {
+        memmove(ctx->recvBuffer, ctx->recvBuffer + ctx->recvStart, ctx->recvEnd - ctx->recvStart);
+        ctx->recvEnd -= ctx->recvStart;
+        ctx->recvStart = 0;
+    }
 
-    int r = socRecv(ctx->super.sockfd, ctx->buffer, sizeof(ctx->buffer), MSG_PEEK);
-    if(r < 1)
+    if(ctx->recvEnd == GDB_PACKET_BUF_LEN + 4) // packet too large
         return -1;
-    if(ctx->buffer[0] == '+') // GDB sometimes acknowleges TCP acknowledgment packets (yes...). IDA does it properly
-    {
-        if(ctx->flags & GDB_FLAG_NOACK)
-            return -1;
 
-        // Consume it
-        r = socRecv(ctx->super.sockfd, ctx->buffer, 1, 0);
-        if(r != 1)
-            return -1;
+    int r = socRecv(ctx->super.sockfd, ctx->recvBuffer + ctx->recvEnd, GDB_PACKET_BUF_LEN + 4 - ctx->recvEnd, 0);
+    if(r < 1)
+        return -1;
 
-        ctx->buffer[0] = 0;
+    ctx->recvEnd += r;
+    return r;
+}
 
-        r = socRecv(ctx->super.sockfd, ctx->buffer, sizeof(ctx->buffer), MSG_PEEK);
+static int GDB_AcknowledgePacket(GDBContext *ctx, bool ok)
+{
+    // A '+' is sent along with the reply, if any: that saves a send per packet
+    if(ctx->flags & GDB_FLAG_NOACK)
+        return ok ? 0 : -1;
+    else if(ok)
+        ctx->ackPending = true;
+    else if(socSend(ctx->super.sockfd, "-", 1, 0) != 1)
+        return -1;
 
-        if(r == -1)
-            goto packet_error;
-    }
-    else if(ctx->buffer[0] == '-')
+    if(ok && ctx->noAckSent)
     {
-        socSend(ctx->super.sockfd, backupbuf, ctx->latestSentPacketSize, 0);
-        return 0;
+        ctx->flags |= GDB_FLAG_NOACK;
+        ctx->noAckSent = false;
     }
-    int maxlen = r > (int)sizeof(ctx->buffer) ? (int)sizeof(ctx->buffer) : r;
 
-    if(ctx->buffer[0] == '$') // normal packet
-    {
-        char *pos;
-        for(pos = ctx->buffer; pos < ctx->buffer + maxlen && *pos != '#'; pos++);
+    return 0;
+}
 
-        if(pos == ctx->buffer + maxlen) // malformed packet
-            return -1;
+int GDB_NextPacket(GDBContext *ctx, char **packet)
+{
+    while(ctx->recvStart < ctx->recvEnd)
+    {
+        char *start = ctx->recvBuffer + ctx->recvStart;
+        u32 available = ctx->recvEnd - ctx->recvStart;
 
-        else
+        if(*start == '+') // GDB sometimes acknowleges TCP acknowledgment packets (yes...). IDA does it properly
+        {
+            if(ctx->flags & GDB_FLAG_NOACK)
+                return -1;
+            ctx->recvStart++;
+        }
+        else if(*start == '-')
+        {
+            ctx->recvStart++;
+            socSendAll(ctx->super.sockfd, ctx->buffer, ctx->latestSentPacketSize, 0);
+        }
+        else if(*start == '$') // normal packet
         {
             u8 checksum;
-            r = socRecv(ctx->super.sockfd, ctx->buffer, 3 + pos - ctx->buffer, 0);
-            if(r != 3 + pos - ctx->buffer || GDB_DecodeHex(&checksum, pos + 1, 1) != 1)
-                goto packet_error;
-            else if(GDB_ComputeChecksum(ctx->buffer + 1, pos - ctx->buffer - 1) != checksum)
-                goto packet_error;
+            char *pos = (char *)memchr(start, '#', available);
+            if(pos == NULL || pos + 3 > start + available)
+                return 0; // not fully received yet
+
+            ctx->recvStart += pos + 3 - start;
+
+            if(GDB_DecodeHex(&checksum, pos + 1, 1) != 1 || GDB_ComputeChecksum(start + 1, pos - start - 1) != checksum)
+            {
+                if(GDB_AcknowledgePacket(ctx, false) == -1)
+                    return -1;
+                continue;
+            }
 
             ctx->commandEnd = pos;
             *pos = 0; // replace trailing '#' by a NUL character
+            *packet = start;
+            return GDB_AcknowledgePacket(ctx, true) == -1 ? -1 : (int)(pos + 3 - start);
+        }
+        else if(*start == '\x03')
+        {
+            ctx->recvStart++;
+            ctx->commandEnd = start;
+            *packet = start;
+            return GDB_AcknowledgePacket(ctx, true) == -1 ? -1 : 1;
         }
+        else
+            ctx->recvStart++; // garbage
     }
-    else if(ctx->buffer[0] == '\x03')
-    {
-        r = socRecv(ctx->super.sockfd, ctx->buffer, 1, 0);
-        if(r != 1)
-            goto packet_error;
 
-        ctx->commandEnd = ctx->buffer;
-    }
+    return 0;
+}
 
-    if(!(ctx->flags & GDB_FLAG_NOACK))
-    {
-        int r2 = socSend(ctx->super.sockfd, "+", 1, 0);
-        if(r2 != 1)
-            return -1;
-    }
+int GDB_FlushAck(GDBContext *ctx)
+{
+    if(!ctx->ackPending)
+        return 0;
 
-    if(ctx->noAckSent)
-    {
-        ctx->flags |= GDB_FLAG_NOACK;
-        ctx->noAckSent = false;
-    }
+    ctx->ackPending = false;
+    return socSend(ctx->super.sockfd, "+", 1, 0) == 1 ? 0 : -1;
+}
 
-    return r;
+static int GDB_DoSendPacket(GDBContext *ctx, u32 len)
+{
+    int r;
 
-packet_error:
-    if(!(ctx->flags & GDB_FLAG_NOACK))
+    if(ctx->ackPending)
     {
-        r = socSend(ctx->super.sockfd, "-", 1, 0);
-        if(r != 1)
-            return -1;
-        else
-            return 0;
+        SocBuffer bufs[] = { { "+", 1 }, { ctx->buffer, len } };
+
+        ctx->ackPending = false;
+        r = socSendv(ctx->super.sockfd, bufs, 2, 0);
+        r = r > 0 ? r - 1 : r; // don't count the '+'
     }
     else
-        return -1;
-}
-
-static int GDB_DoSendPacket(GDBContext *ctx, u32 len)
-{
-    int r = socSend(ctx->super.sockfd, ctx->buffer, len, 0);
+        r = socSendAll(ctx->super.sockfd, ctx->buffer, len, 0);
 
     if(r > 0)
         ctx->latestSentPacketSize = r;
     return r;
 }
 
-int GDB_SendPacket(GDBContext *ctx, const char *packetData, u32 len)
+int GDB_SendPacketFromBuffer(GDBContext *ctx, u32 len)
 {
     ctx->buffer[0] = '$';
 
-    memcpy(ctx->buffer + 1, packetData, len);
-
     char *checksumLoc = ctx->buffer + len + 1;
     *checksumLoc++ = '#';
 
-    hexItoa(GDB_ComputeChecksum(packetData, len), checksumLoc, 2, false);
+    hexItoa(GDB_ComputeChecksum(ctx->buffer + 1, len), checksumLoc, 2, false);
     return GDB_DoSendPacket(ctx, 4 + len);
 }
 
+int GDB_SendPacket(GDBContext *ctx, const char *packetData, u32 len)
+{
+    memmove(ctx->buffer + 1, packetData, len);
+    return GDB_SendPacketFromBuffer(ctx, len);
+}
+
 int GDB_SendFormattedPacket(GDBContext *ctx, const char *packetDataFmt, ...)
 {
     // It goes without saying you shouldn't use that with user-controlled data...
-    char buf[GDB_BUF_LEN + 1];
     va_list args;
     va_start(args, packetDataFmt);
-    int n = vsprintf(buf, packetDataFmt, args);
+    int n = vsprintf(ctx->buffer + 1, packetDataFmt, args); // formatted replies are way smaller than the buffer
     va_end(args);
 
-    if(n < 0) return -1;
-    else return GDB_SendPacket(ctx, buf, (u32)n);
+    if(n < 0 || n > GDB_PACKET_BUF_LEN) return -1;
+    else return GDB_SendPacketFromBuffer(ctx, (u32)n);
 }
 
 int GDB_SendHexPacket(GDBContext *ctx, const void *packetData, u32 len)
 {
-    if(4 + 2 * len > GDB_BUF_LEN)
+    if(2 * len > GDB_PACKET_BUF_LEN)
         return -1;
 
     ctx->buffer[0] = '$';
@@ -314,23 +404,22 @@ int GDB_SendHexPacket(GDBContext *ctx, const void *packetData, u32 len)
 
 int GDB_SendStreamData(GDBContext *ctx, const char *streamData, u32 offset, u32 length, u32 totalSize, bool forceEmptyLast)
 {
-    char buf[GDB_BUF_LEN];
-    if(length > GDB_BUF_LEN - 1)
-        length = GDB_BUF_LEN - 1;
+    char *buf = ctx->buffer + 1;
+    if(length > GDB_PACKET_BUF_LEN - 1)
+        length = GDB_PACKET_BUF_LEN - 1;
 
     if((forceEmptyLast && offset >= totalSize) || (!forceEmptyLast && offset + length >= totalSize))
     {
         length = offset >= totalSize ? 0 : totalSize - offset;
+        if(length > GDB_PACKET_BUF_LEN - 1)
+            length = GDB_PACKET_BUF_LEN - 1;
         buf[0] = 'l';
-        memcpy(buf + 1, streamData + offset, length);
-        return GDB_SendPacket(ctx, buf, 1 + length);
     }
     else
-    {
         buf[0] = 'm';
-        memcpy(buf + 1, streamData + offset, length);
-        return GDB_SendPacket(ctx, buf, 1 + length);
-    }
+
+    memcpy(buf + 1, streamData + offset, length);
+    return GDB_SendPacketFromBuffer(ctx, 1 + length);
 }
 
 int GDB_SendDebugString(GDBContext *ctx, const char *fmt, ...) // unsecure
@@ -106,9 +106,9 @@ GDB_DECLARE_QUERY_HANDLER(Supported)
         "PacketSize=%x;"
         "qXfer:features:read+;qXfer:osdata:read+;"
         "QStartNoAckMode+;QThreadEvents+;QCatchSyscalls+;"
-        "vContSupported+;swbreak+;multiprocess+",
+        "vContSupported+;swbreak+;multiprocess+;binary-upload+",
 
-        GDB_BUF_LEN // should have been sizeof(ctx->buffer) but GDB memory functions are bugged
+        GDB_PACKET_BUF_LEN
     );
 }
 
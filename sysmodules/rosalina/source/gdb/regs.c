@@ -7,6 +7,7 @@
 
 #include "gdb/regs.h"
 #include "gdb/net.h"
+#include "gdb/thread.h"
 
 GDB_DECLARE_HANDLER(ReadRegisters)
 {
@@ -14,7 +15,7 @@ GDB_DECLARE_HANDLER(ReadRegisters)
         ctx->selectedThreadId = ctx->currentThreadId;
 
     ThreadContext regs;
-    Result r = svcGetDebugThreadContext(&regs, ctx->debug, ctx->selectedThreadId, THREADCONTEXT_CONTROL_ALL);
+    Result r = GDB_GetThreadContext(&regs, ctx, ctx->selectedThreadId);
 
     if(R_FAILED(r))
         return GDB_ReplyErrno(ctx, EPERM);
@@ -32,7 +33,7 @@ GDB_DECLARE_HANDLER(WriteRegisters)
     if(GDB_DecodeHex(&regs, ctx->commandData, sizeof(ThreadContext)) != sizeof(ThreadContext))
         return GDB_ReplyErrno(ctx, EPERM);
 
-    Result r = svcSetDebugThreadContext(ctx->debug, ctx->selectedThreadId, &regs, THREADCONTEXT_CONTROL_ALL);
+    Result r = GDB_SetThreadContext(ctx, ctx->selectedThreadId, &regs, THREADCONTEXT_CONTROL_ALL);
     if(R_FAILED(r))
         return GDB_ReplyErrno(ctx, EPERM);
     else
@@ -84,7 +85,7 @@ GDB_DECLARE_HANDLER(ReadRegister)
     if(!flags)
         return GDB_ReplyErrno(ctx, EINVAL);
 
-    Result r = svcGetDebugThreadContext(&regs, ctx->debug, ctx->selectedThreadId, flags);
+    Result r = GDB_GetThreadContext(&regs, ctx, ctx->selectedThreadId);
 
     if(R_FAILED(r))
         return GDB_ReplyErrno(ctx, EPERM);
@@ -131,7 +132,7 @@ GDB_DECLARE_HANDLER(WriteRegister)
     else
         return GDB_ReplyErrno(ctx, EINVAL);
 
-    Result r = svcGetDebugThreadContext(&regs, ctx->debug, ctx->selectedThreadId, flags);
+    Result r = GDB_GetThreadContext(&regs, ctx, ctx->selectedThreadId);
 
     if(R_FAILED(r))
         return GDB_ReplyErrno(ctx, EPERM);
@@ -145,7 +146,7 @@ GDB_DECLARE_HANDLER(WriteRegister)
     else
         *(&regs.fpu_registers.fpscr + n) = value; // hacky
 
-    r = svcSetDebugThreadContext(ctx->debug, ctx->selectedThreadId, &regs, flags);
+    r = GDB_SetThreadContext(ctx, ctx->selectedThreadId, &regs, flags);
     if(R_FAILED(r))
         return GDB_ReplyErrno(ctx, EPERM);
     else
@@ -7,6 +7,7 @@
 
 #include "gdb/remote_command.h"
 #include "gdb/net.h"
+#include "gdb/thread.h"
 #include "csvc.h"
 #include "fmt.h"
 #include "gdb/breakpoints.h"
@@ -115,7 +116,7 @@ GDB_DECLARE_REMOTE_COMMAND_HANDLER(SyncRequestInfo)
 
     for(id = 0; id < MAX_DEBUG_THREAD && ctx->threadInfos[id].id != ctx->selectedThreadId; id++);
 
-    r = svcGetDebugThreadContext(&regs, ctx->debug, ctx->selectedThreadId, THREADCONTEXT_CONTROL_CPU_REGS);
+    r = GDB_GetThreadContext(&regs, ctx, ctx->selectedThreadId);
 
     if(R_FAILED(r) || id == MAX_DEBUG_THREAD)
     {
@@ -436,7 +437,6 @@ GDB_DECLARE_REMOTE_COMMAND_HANDLER(CatchSvc)
         return GDB_ReplyErrno(ctx, EILSEQ);
 }
 
-s32 GDB_GetDynamicThreadPriority(GDBContext *ctx, u32 threadId);
 GDB_DECLARE_REMOTE_COMMAND_HANDLER(GetThreadPriority)
 {
     int n;
@@ -455,7 +455,7 @@ GDB_DECLARE_QUERY_HANDLER(Rcmd)
     const char *errstr = "Comando no reconocido.\n";
     u32 len = strlen(ctx->commandData);
 
-    if(len == 0 || (len % 2) == 1 || GDB_DecodeHex(commandData, ctx->commandData, len / 2) != len / 2)
+    if(len == 0 || (len % 2) == 1 || len / 2 >= sizeof(commandData) || GDB_DecodeHex(commandData, ctx->commandData, len / 2) != len / 2)
         return GDB_ReplyErrno(ctx, EILSEQ);
     commandData[len / 2] = 0;
 
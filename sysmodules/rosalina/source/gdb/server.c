@@ -18,13 +18,30 @@
 #include "gdb/breakpoints.h"
 #include "gdb/stop_point.h"
 #include "task_runner.h"
+#include "csvc.h"
+
+// The vFile:pread read-ahead buffer, then the tables and packet buffers of all contexts, in the SYSTEM region:
+// they take about 170KB, which Rosalina can't afford to keep in its own memory when the debugger isn't used
+#define GDB_CONTEXT_BUFFER_SIZE     (GDB_PACKET_BUF_LEN + 4)
+#define GDB_BUFFERS_ADDR            0x0C000000
+#define GDB_TABLES_ADDR             (GDB_BUFFERS_ADDR + GDB_TIO_READ_AHEAD_LEN)
+#define GDB_PACKET_BUFFERS_ADDR     (GDB_TABLES_ADDR + MAX_DEBUG * sizeof(GDBContextTables))
+#define GDB_BUFFERS_SIZE            ((GDB_PACKET_BUFFERS_ADDR - GDB_BUFFERS_ADDR + 2 * MAX_DEBUG * GDB_CONTEXT_BUFFER_SIZE + 0xFFF) & ~0xFFF)
 
 Result GDB_InitializeServer(GDBServer *server)
 {
+    u32 tmp;
     Result ret = server_init(&server->super);
     if(ret != 0)
         return ret;
 
+    ret = svcControlMemoryEx(&tmp, GDB_BUFFERS_ADDR, 0, GDB_BUFFERS_SIZE, MEMOP_ALLOC, MEMREGION_SYSTEM | MEMPERM_READWRITE, true);
+    if(R_FAILED(ret))
+    {
+        server_finalize(&server->super);
+        return ret;
+    }
+
     server->super.host = 0;
 
     server->super.accept_cb = (sock_accept_cb)GDB_AcceptClient;
@@ -40,8 +57,21 @@ Result GDB_InitializeServer(GDBServer *server)
     svcCreateEvent(&server->statusUpdated, RESET_ONESHOT);
     svcCreateEvent(&server->statusUpdateReceived, RESET_STICKY);
 
+    server->tioReadAheadBuffer = (u8 *)GDB_BUFFERS_ADDR;
     for(u32 i = 0; i < sizeof(server->ctxs) / sizeof(GDBContext); i++)
+    {
+        GDBContextTables *tables = (GDBContextTables *)GDB_TABLES_ADDR + i;
+        char *buffers = (char *)GDB_PACKET_BUFFERS_ADDR + 2 * i * GDB_CONTEXT_BUFFER_SIZE;
+
+        memset(tables, 0, sizeof(GDBContextTables));
         GDB_InitializeContext(server->ctxs + i);
+        server->ctxs[i].threadInfos = tables->threadInfos;
+        server->ctxs[i].threadContextSnapshots = tables->threadContextSnapshots;
+        server->ctxs[i].breakpoints = tables->breakpoints;
+        server->ctxs[i].breakpointIndex = tables->breakpointIndex;
+        server->ctxs[i].buffer = buffers;
+        server->ctxs[i].recvBuffer = buffers + GDB_CONTEXT_BUFFER_SIZE;
+    }
 
     GDB_ResetWatchpoints();
 
@@ -50,13 +80,22 @@ Result GDB_InitializeServer(GDBServer *server)
 
 void GDB_FinalizeServer(GDBServer *server)
 {
+    u32 tmp;
     server_finalize(&server->super);
 
     // Kill the "next application" context if needed
     for (u32 i = 0; i < MAX_DEBUG; i++) {
         if (server->ctxs[i].debug != 0)
             GDB_CloseClient(&server->ctxs[i]);
+        server->ctxs[i].buffer = server->ctxs[i].recvBuffer = NULL;
+        server->ctxs[i].threadInfos = NULL;
+        server->ctxs[i].threadContextSnapshots = NULL;
+        server->ctxs[i].breakpoints = NULL;
+        server->ctxs[i].breakpointIndex = NULL;
     }
+    server->tioReadAheadBuffer = NULL;
+    svcControlMemory(&tmp, GDB_BUFFERS_ADDR, 0, GDB_BUFFERS_SIZE, MEMOP_FREE, 0);
+
     svcCloseHandle(server->statusUpdated);
     svcCloseHandle(server->statusUpdateReceived);
 }
@@ -168,6 +207,8 @@ int GDB_AcceptClient(GDBContext *ctx)
     RecursiveLock_Lock(&ctx->lock);
     ctx->state = GDB_STATE_CONNECTED;
     ctx->latestSentPacketSize = 0;
+    ctx->ackPending = false;
+    ctx->recvStart = ctx->recvEnd = 0;
 
     if (ctx->flags & GDB_FLAG_SELECTED)
         r = GDB_AttachToProcess(ctx);
@@ -308,6 +349,7 @@ static const struct
     { 'R', GDB_HANDLER(Restart) },
     { 'T', GDB_HANDLER(IsThreadAlive) },
     { 'v', GDB_HANDLER(VerboseCommand) },
+    { 'x', GDB_HANDLER(ReadMemoryRaw) },
     { 'X', GDB_HANDLER(WriteMemoryRaw) },
     { 'z', GDB_HANDLER(ToggleStopPoint) },
     { 'Z', GDB_HANDLER(ToggleStopPoint) },
@@ -325,55 +367,69 @@ static inline GDBCommandHandler GDB_GetCommandHandler(char command)
 
 int GDB_DoPacket(GDBContext *ctx)
 {
-    int ret;
+    int ret = 0;
 
-    RecursiveLock_Lock(&ctx->lock);
-    u32 oldFlags = ctx->flags;
-
-    if(ctx->state == GDB_STATE_DISCONNECTED)
+    // Only this thread uses the receive buffer, don't hold the lock while waiting for the data
+    if(GDB_ReceivePacket(ctx) == -1)
         return -1;
 
-    int r = GDB_ReceivePacket(ctx);
-    if(r == 0)
-        ret = 0;
-    else if(r == -1)
-        ret = -1;
-    else if(ctx->buffer[0] == '\x03')
-    {
-        GDB_HandleBreak(ctx);
-        ret = 0;
-    }
-    else if(ctx->buffer[0] == '$')
-    {
-        GDBCommandHandler handler = GDB_GetCommandHandler(ctx->buffer[1]);
-        ctx->commandData = ctx->buffer + 2;
-        ret = handler(ctx);
-    }
-    else
-        ret = 0;
+    RecursiveLock_Lock(&ctx->lock);
 
-    if(ctx->state == GDB_STATE_DETACHING)
+    // Handle all the complete packets received so far, the next ones won't necessarily cause another poll event
+    while(ret != -1)
     {
-        if(ctx->flags & GDB_FLAG_EXTENDED_REMOTE)
+        u32 oldFlags = ctx->flags;
+        char *packet;
+
+        if(ctx->state == GDB_STATE_DISCONNECTED)
         {
-            ctx->state = GDB_STATE_CONNECTED;
-            RecursiveLock_Unlock(&ctx->lock);
-            return ret;
+            ret = -1;
+            break;
+        }
+
+        int r = GDB_NextPacket(ctx, &packet);
+        if(r == 0)
+            break;
+        else if(r == -1)
+            ret = -1;
+        else if(packet[0] == '\x03')
+        {
+            GDB_HandleBreak(ctx);
+            ret = 0;
         }
         else
         {
-            RecursiveLock_Unlock(&ctx->lock);
-            return -1;
+            GDBCommandHandler handler = GDB_GetCommandHandler(packet[1]);
+            ctx->commandData = packet + 2;
+            ret = handler(ctx);
         }
-    }
 
-    if((oldFlags & GDB_FLAG_PROCESS_CONTINUING) && !(ctx->flags & GDB_FLAG_PROCESS_CONTINUING))
-    {
-        if(R_FAILED(svcBreakDebugProcess(ctx->debug)))
-            ctx->flags |= GDB_FLAG_PROCESS_CONTINUING;
+        // The handler may not have replied right away (e.g. 'c')
+        if(GDB_FlushAck(ctx) == -1)
+            ret = -1;
+
+        if(ctx->state == GDB_STATE_DETACHING)
+        {
+            if(ctx->flags & GDB_FLAG_EXTENDED_REMOTE)
+            {
+                ctx->state = GDB_STATE_CONNECTED;
+                continue;
+            }
+            else
+            {
+                ret = -1;
+                break;
+            }
+        }
+
+        if((oldFlags & GDB_FLAG_PROCESS_CONTINUING) && !(ctx->flags & GDB_FLAG_PROCESS_CONTINUING))
+        {
+            if(R_FAILED(svcBreakDebugProcess(ctx->debug)))
+                ctx->flags |= GDB_FLAG_PROCESS_CONTINUING;
+        }
+        else if(!(oldFlags & GDB_FLAG_PROCESS_CONTINUING) && (ctx->flags & GDB_FLAG_PROCESS_CONTINUING))
+            svcSignalEvent(ctx->continuedEvent);
     }
-    else if(!(oldFlags & GDB_FLAG_PROCESS_CONTINUING) && (ctx->flags & GDB_FLAG_PROCESS_CONTINUING))
-        svcSignalEvent(ctx->continuedEvent);
 
     RecursiveLock_Unlock(&ctx->lock);
     return ret;
@@ -107,7 +107,93 @@ int GDB_EncodeThreadId(GDBContext *ctx, char *outbuf, u32 tid)
         return sprintf(outbuf, "%lx", tid);
 }
 
-s32 GDB_GetDynamicThreadPriority(GDBContext *ctx, u32 threadId)
+void GDB_InvalidateThreadSnapshots(GDBContext *ctx)
+{
+    ctx->threadSnapshotGeneration++;
+}
+
+static ThreadInfo *GDB_GetThreadSnapshot(GDBContext *ctx, u32 threadId)
+{
+    for(u32 i = 0; i < ctx->nbThreads; i++)
+    {
+        ThreadInfo *info = &ctx->threadInfos[i];
+        if(info->id != threadId)
+            continue;
+
+        if(info->snapshotGeneration != ctx->threadSnapshotGeneration)
+        {
+            info->snapshotGeneration = ctx->threadSnapshotGeneration;
+            info->snapshotFetchedMask = info->snapshotValidMask = 0;
+        }
+
+        return info;
+    }
+
+    return NULL;
+}
+
+Result GDB_GetThreadParam(u32 *out, GDBContext *ctx, u32 threadId, DebugThreadParameter param)
+{
+    s64 dummy;
+    ThreadInfo *info = GDB_GetThreadSnapshot(ctx, threadId);
+    if(info == NULL) // unknown thread, don't cache anything
+        return svcGetDebugThreadParam(&dummy, out, ctx->debug, threadId, param);
+
+    u32 bit = 1u << (u32)param;
+    if(!(info->snapshotFetchedMask & bit))
+    {
+        Result r = svcGetDebugThreadParam(&dummy, &info->snapshotParams[param], ctx->debug, threadId, param);
+        info->snapshotFetchedMask |= bit;
+        if(R_SUCCEEDED(r))
+            info->snapshotValidMask |= bit;
+    }
+
+    if(!(info->snapshotValidMask & bit))
+        return -1;
+
+    *out = info->snapshotParams[param];
+    return 0;
+}
+
+Result GDB_GetThreadContext(ThreadContext *out, GDBContext *ctx, u32 threadId)
+{
+    for(u32 i = 0; i < GDB_THREAD_CONTEXT_SNAPSHOTS; i++)
+    {
+        ThreadContextSnapshot *snapshot = &ctx->threadContextSnapshots[i];
+        if(snapshot->id == threadId && snapshot->generation == ctx->threadSnapshotGeneration)
+        {
+            *out = snapshot->regs;
+            return 0;
+        }
+    }
+
+    Result r = svcGetDebugThreadContext(out, ctx->debug, threadId, THREADCONTEXT_CONTROL_ALL);
+    if(R_SUCCEEDED(r))
+    {
+        ThreadContextSnapshot *snapshot = &ctx->threadContextSnapshots[ctx->nextThreadContextSnapshot];
+        ctx->nextThreadContextSnapshot = (ctx->nextThreadContextSnapshot + 1) % GDB_THREAD_CONTEXT_SNAPSHOTS;
+
+        snapshot->id = threadId;
+        snapshot->generation = ctx->threadSnapshotGeneration;
+        snapshot->regs = *out;
+    }
+
+    return r;
+}
+
+Result GDB_SetThreadContext(GDBContext *ctx, u32 threadId, const ThreadContext *regs, ThreadContextControlFlags flags)
+{
+    // Only some parts of the context may have been written, just drop the snapshot
+    for(u32 i = 0; i < GDB_THREAD_CONTEXT_SNAPSHOTS; i++)
+    {
+        if(ctx->threadContextSnapshots[i].id == threadId)
+            ctx->threadContextSnapshots[i].id = 0;
+    }
+
+    return svcSetDebugThreadContext(ctx->debug, threadId, regs, flags);
+}
+
+static s32 GDB_FetchDynamicThreadPriority(GDBContext *ctx, u32 threadId)
 {
     Handle process, thread;
     Result r;
@@ -130,6 +216,21 @@ cleanup:
     return prio;
 }
 
+s32 GDB_GetDynamicThreadPriority(GDBContext *ctx, u32 threadId)
+{
+    ThreadInfo *info = GDB_GetThreadSnapshot(ctx, threadId);
+    if(info == NULL)
+        return GDB_FetchDynamicThreadPriority(ctx, threadId);
+
+    if(!(info->snapshotFetchedMask & BIT(4)))
+    {
+        info->snapshotDynamicPriority = GDB_FetchDynamicThreadPriority(ctx, threadId);
+        info->snapshotFetchedMask |= BIT(4);
+    }
+
+    return info->snapshotDynamicPriority;
+}
+
 struct ThreadIdWithCtx
 {
     GDBContext *ctx;
@@ -145,12 +246,11 @@ static int thread_compare_func(const void *a_, const void *b_)
     s32 prioAStatic = 65, prioBStatic = 65;
     s32 prioADynamic = GDB_GetDynamicThreadPriority(a->ctx, a->id);
     s32 prioBDynamic = GDB_GetDynamicThreadPriority(b->ctx, b->id);
-    s64 dummy;
 
-    svcGetDebugThreadParam(&dummy, &maskA, a->ctx->debug, a->id, DBGTHREAD_PARAMETER_SCHEDULING_MASK_LOW);
-    svcGetDebugThreadParam(&dummy, &maskB, b->ctx->debug, b->id, DBGTHREAD_PARAMETER_SCHEDULING_MASK_LOW);
-    svcGetDebugThreadParam(&dummy, (u32 *)&prioAStatic, a->ctx->debug, a->id, DBGTHREAD_PARAMETER_PRIORITY);
-    svcGetDebugThreadParam(&dummy, (u32 *)&prioBStatic, b->ctx->debug, b->id, DBGTHREAD_PARAMETER_PRIORITY);
+    GDB_GetThreadParam(&maskA, a->ctx, a->id, DBGTHREAD_PARAMETER_SCHEDULING_MASK_LOW);
+    GDB_GetThreadParam(&maskB, b->ctx, b->id, DBGTHREAD_PARAMETER_SCHEDULING_MASK_LOW);
+    GDB_GetThreadParam((u32 *)&prioAStatic, a->ctx, a->id, DBGTHREAD_PARAMETER_PRIORITY);
+    GDB_GetThreadParam((u32 *)&prioBStatic, b->ctx, b->id, DBGTHREAD_PARAMETER_PRIORITY);
 
     if(maskA == 1 && maskB != 1)
         return -1;
@@ -225,14 +325,13 @@ GDB_DECLARE_HANDLER(SetThreadId)
 
 GDB_DECLARE_HANDLER(IsThreadAlive)
 {
-    s64 dummy;
     u32 mask;
 
     u32 tid = GDB_ParseDecodeSingleThreadId(ctx, ctx->commandData, 0);
     if (tid == 0)
         return GDB_ReplyErrno(ctx, EILSEQ);
 
-    Result r = svcGetDebugThreadParam(&dummy, &mask, ctx->debug, tid, DBGTHREAD_PARAMETER_SCHEDULING_MASK_LOW);
+    Result r = GDB_GetThreadParam(&mask, ctx, tid, DBGTHREAD_PARAMETER_SCHEDULING_MASK_LOW);
     if(R_SUCCEEDED(r) && mask != 2)
         return GDB_ReplyOk(ctx);
     else
@@ -256,10 +355,9 @@ static void GDB_GenerateThreadListData(GDBContext *ctx)
 
     for(u32 i = 0; i < ctx->nbThreads; i++)
     {
-        s64 dummy;
         u32 mask;
 
-        Result r = svcGetDebugThreadParam(&dummy, &mask, ctx->debug, ctx->threadInfos[i].id, DBGTHREAD_PARAMETER_SCHEDULING_MASK_LOW);
+        Result r = GDB_GetThreadParam(&mask, ctx, ctx->threadInfos[i].id, DBGTHREAD_PARAMETER_SCHEDULING_MASK_LOW);
         if(R_SUCCEEDED(r) && mask != 2)
             aliveThreadIds[nbAliveThreads++] = ctx->threadInfos[i].id;
     }
@@ -283,11 +381,11 @@ static int GDB_SendThreadData(GDBContext *ctx)
     u32 len;
     if(ctx->threadListDataPos >= sz)
         len = 0;
-    else if(sz - ctx->threadListDataPos <= GDB_BUF_LEN - 1)
+    else if(sz - ctx->threadListDataPos <= GDB_PACKET_BUF_LEN - 1)
         len = sz - ctx->threadListDataPos;
     else
     {
-        for(len = GDB_BUF_LEN - 1; ctx->threadListData[ctx->threadListDataPos + len] != ',' && len > 0; len--);
+        for(len = GDB_PACKET_BUF_LEN - 1; ctx->threadListData[ctx->threadListDataPos + len] != ',' && len > 0; len--);
         if(len > 0)
             len--;
     }
@@ -336,7 +434,6 @@ GDB_DECLARE_QUERY_HANDLER(ThreadEvents)
 GDB_DECLARE_QUERY_HANDLER(ThreadExtraInfo)
 {
     u32 id;
-    s64 dummy;
     u32 val;
     Result r;
     int n;
@@ -358,7 +455,7 @@ GDB_DECLARE_QUERY_HANDLER(ThreadExtraInfo)
             tls = ctx->threadInfos[i].tls;
     }
 
-    r = svcGetDebugThreadParam(&dummy, &val, ctx->debug, id, DBGTHREAD_PARAMETER_SCHEDULING_MASK_LOW);
+    r = GDB_GetThreadParam(&val, ctx, id, DBGTHREAD_PARAMETER_SCHEDULING_MASK_LOW);
     sStatus = R_SUCCEEDED(r) ? (val == 1 ? ", ejecutandose, " : ", idle, ") : "";
 
     val = (u32)GDB_GetDynamicThreadPriority(ctx, id);
@@ -367,19 +464,19 @@ GDB_DECLARE_QUERY_HANDLER(ThreadExtraInfo)
     else
         sprintf(sThreadDynamicPriority, "Prio. dinamica: %ld, ", (s32)val);
 
-    r = svcGetDebugThreadParam(&dummy, &val, ctx->debug, id, DBGTHREAD_PARAMETER_PRIORITY);
+    r = GDB_GetThreadParam(&val, ctx, id, DBGTHREAD_PARAMETER_PRIORITY);
     if(R_FAILED(r))
         sThreadStaticPriority[0] = 0;
     else
         sprintf(sThreadStaticPriority, "Prio. estatica: %ld, ", (s32)val);
 
-    r = svcGetDebugThreadParam(&dummy, &val, ctx->debug, id, DBGTHREAD_PARAMETER_CPU_IDEAL);
+    r = GDB_GetThreadParam(&val, ctx, id, DBGTHREAD_PARAMETER_CPU_IDEAL);
     if(R_FAILED(r))
         sCoreIdeal[0] = 0;
     else
         sprintf(sCoreIdeal, "nucleo ideal: %lu, ", val);
 
-    r = svcGetDebugThreadParam(&dummy, &val, ctx->debug, id, DBGTHREAD_PARAMETER_CPU_CREATOR); // Creator = "first ran, and running the thread"
+    r = GDB_GetThreadParam(&val, ctx, id, DBGTHREAD_PARAMETER_CPU_CREATOR); // Creator = "first ran, and running the thread"
     if(R_FAILED(r))
         sCoreCreator[0] = 0;
     else
@@ -10,6 +10,7 @@
 #include "gdb/tio.h"
 #include "gdb/hio.h"
 #include "gdb/net.h"
+#include "gdb/server.h"
 #include "gdb/mem.h"
 #include "gdb/debug.h"
 #include "fmt.h"
@@ -136,6 +137,28 @@ static int GDB_TioConvertResult(Result res)
     }
 }
 
+// vFile:pread read-ahead. All contexts are served by the same thread, so one buffer is shared by all open files:
+// GDB transfers files one at a time, in sequential chunks, and the part of a chunk that didn't fit in a reply
+// (escaped data takes more room) is then served from here instead of being read again.
+// The data itself is in the server's tioReadAheadBuffer (GDB_TIO_READ_AHEAD_LEN bytes).
+typedef struct GdbTioReadAhead
+{
+    GDBContext *ctx;
+    int fd;
+    u32 size;
+    u64 offset;
+} GdbTioReadAhead;
+
+static GdbTioReadAhead tioReadAhead;
+
+// ctx == NULL: the contents of some file changed. The buffer isn't keyed on the host path, and the same file may be
+// open in another context or through another fd, so drop it whatever it holds.
+static void GDB_TioInvalidateReadAhead(GDBContext *ctx, int fd)
+{
+    if (ctx == NULL || (tioReadAhead.ctx == ctx && (fd < 0 || tioReadAhead.fd == fd)))
+        tioReadAhead.ctx = NULL;
+}
+
 static GdbTioFileInfo *GDB_TioConvertFd(GDBContext *ctx, int fd)
 {
     if (fd < 3 || fd - 3 >= MAX_TIO_OPEN_FILE)
@@ -155,6 +178,7 @@ static int GDB_TioRegisterFile(GDBContext *ctx, Handle h, int gdbOpenFlags)
 
     GdbTioFileInfo *slot = &ctx->openTioFileInfos[fd - 3];
     memset(slot, 0, sizeof(GdbTioFileInfo));
+    GDB_TioInvalidateReadAhead(ctx, fd);
     slot->f.handle = h;
     slot->flags = gdbOpenFlags;
 
@@ -166,6 +190,7 @@ static int GDB_MakeUtf16Path(FS_Path *outPath, const char *pathData)
 {
     size_t pathDataLen = strlen(pathData);
     if (pathDataLen % 2 == 1) return GDBHIO_EINVAL;
+    else if (pathDataLen / 2 > PATH_MAX) return GDBHIO_ENAMETOOLONG;
 
     char path[PATH_MAX + 1];
     u32 count = GDB_DecodeHex(path, pathData, pathDataLen / 2);
@@ -275,6 +300,7 @@ GDB_DECLARE_TIO_HANDLER(Open)
     
     if((flags & GDBHIO_O_ACCMODE) != GDBHIO_O_RDONLY && (flags & GDBHIO_O_TRUNC))
     {
+        GDB_TioInvalidateReadAhead(NULL, -1);
         f.size = 0;
         err = GDB_TioConvertResult(FSFILE_SetSize(f.handle, 0));
         if (err != 0)
@@ -304,6 +330,8 @@ GDB_DECLARE_TIO_HANDLER(Close)
 
     int err = GDB_TioConvertResult(IFile_Close(&fi->f));
     memset(fi, 0, sizeof(GdbTioFileInfo));
+    GDB_TioInvalidateReadAhead(ctx, fd);
+    ctx->numOpenTioFiles--;
 
     if (err != 0)
         return GDB_TioReplyErrno(ctx, err);
@@ -313,42 +341,57 @@ GDB_DECLARE_TIO_HANDLER(Close)
 
 GDB_DECLARE_TIO_HANDLER(Read)
 {
-    // GDB, with it code quality we're all aware of, always ask to read GDB_BUF_LEN, even if the packet can't fit...
-    // "$F<num>;<data>#XX"
-    char buf2[GDB_BUF_LEN - 4];
-    u8 buf[sizeof(buf2) - 2 - 8];
-
+    // "$F<num>;<data>#XX", GDB asks for as much as the negotiated packet size allows
     u32 args[3];
     if (GDB_ParseHexIntegerList(args, ctx->commandData, 3, 0) == NULL)
         return GDB_ReplyErrno(ctx, EILSEQ);
 
-    u64 numRead = 0;
     int fd = (int)args[0];
-    u32 count = args[1] > sizeof(buf) ? sizeof(buf) : args[1];
+    u32 count = args[1] > GDB_PACKET_BUF_LEN - 10 ? GDB_PACKET_BUF_LEN - 10 : args[1];
     u32 offset = args[2];
 
     GdbTioFileInfo *fi = GDB_TioConvertFd(ctx, fd);
     if (fi == NULL)
         return GDB_TioReplyErrno(ctx, GDBHIO_EBADF);
 
-    fi->f.pos = offset;
+    GdbTioReadAhead *ra = &tioReadAhead;
+    u8 *data = ctx->parent->tioReadAheadBuffer;
+    bool hit = ra->ctx == ctx && ra->fd == fd && offset >= ra->offset && offset <= ra->offset + ra->size;
 
-    int err = GDB_TioConvertResult(IFile_Read(&fi->f, &numRead, buf, count));
-    if (err != 0)
-        return GDB_TioReplyErrno(ctx, err);
+    // Also refill when the request is only partially buffered, unless the end of the file has been reached
+    if (!hit || ((u64)offset + count > ra->offset + ra->size && ra->size == GDB_TIO_READ_AHEAD_LEN))
+    {
+        u64 numRead = 0;
+        ra->ctx = NULL;
+        fi->f.pos = offset;
 
-    char hdr[16];
+        int err = GDB_TioConvertResult(IFile_Read(&fi->f, &numRead, data, GDB_TIO_READ_AHEAD_LEN));
+        if (err != 0)
+            return GDB_TioReplyErrno(ctx, err);
+
+        ra->ctx = ctx;
+        ra->fd = fd;
+        ra->offset = offset;
+        ra->size = (u32)numRead;
+    }
+
+    u32 available = (u32)(ra->offset + ra->size - offset);
+    count = count > available ? available : count;
+
+    // Escape straight from the read-ahead buffer into the packet buffer
     u32 encodedCount;
-    u32 actualCount = GDB_EscapeBinaryData(&encodedCount, buf2 + 10, buf, (u32)numRead, sizeof(buf));
+    u32 actualCount = GDB_EscapeBinaryData(&encodedCount, ctx->buffer + 11, data + (offset - ra->offset), count,
+                                           GDB_PACKET_BUF_LEN - 10);
+
+    char hdr[16];
     sprintf(hdr, "F%08lx;", (u32)actualCount); // buffer might not fit the entire read data
-    memcpy(buf2, hdr, 10);
+    memcpy(ctx->buffer + 1, hdr, 10);
 
-    return GDB_SendPacket(ctx, buf2, 10 + encodedCount);
+    return GDB_SendPacketFromBuffer(ctx, 10 + encodedCount);
 }
 
 GDB_DECLARE_TIO_HANDLER(Write)
 {
-    u8 buf[GDB_BUF_LEN];
     u32 args[2];
     const char *comma = GDB_ParseHexIntegerList(args, ctx->commandData, 2, ',');
     if (comma == NULL)
@@ -358,6 +401,8 @@ GDB_DECLARE_TIO_HANDLER(Write)
     u32 offset = args[1];
     const char *escData = comma + 1;
 
+    // Unescape in place, the data can be as large as the packet buffer
+    u8 *buf = (u8 *)escData;
     u32 count = GDB_UnescapeBinaryData(buf, escData, ctx->commandEnd - escData);
 
     GdbTioFileInfo *fi = GDB_TioConvertFd(ctx, fd);
@@ -365,7 +410,7 @@ GDB_DECLARE_TIO_HANDLER(Write)
         return GDB_TioReplyErrno(ctx, GDBHIO_EBADF);
     
     fi->f.pos = offset;
-
+    GDB_TioInvalidateReadAhead(NULL, -1);
 
     u64 written;
     int err = GDB_TioConvertResult(IFile_Write(&fi->f, &written, buf, count, 0));
@@ -460,6 +505,7 @@ GDB_DECLARE_TIO_HANDLER(Unlink)
     if (err != 0)
         return GDB_TioReplyErrno(ctx, err);
 
+    GDB_TioInvalidateReadAhead(NULL, -1);
     err = GDB_TioConvertResult(FSUSER_DeleteFile(ar, fsPath));
     FSUSER_CloseArchive(ar);
     if (err != 0)
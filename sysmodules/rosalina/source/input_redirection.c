@@ -54,6 +54,98 @@ static u32 hidData[] = { 0x00000FFF, 0x02000000, 0x007FF7FF, 0x00000000, 0x00000
 static u32 irData[] = { 0x80800081 }; // Default: C-Stick at the center, no buttons.
 
 int inputRedirectionStartResult;
+InputRedirectionStats inputRedirectionStats;
+
+static u32 *hidDataPhys, *irDataPhys;
+static u32 specialButtons;
+
+static u32 InputRedirection_GetTimeUs(void)
+{
+    u64 ticks = svcGetSystemTick();
+    return (u32)((ticks / SYSCLOCK_ARM11) * 1000000 + ((ticks % SYSCLOCK_ARM11) * 1000000) / SYSCLOCK_ARM11);
+}
+
+static void InputRedirection_UpdateSpecialButtons(u32 newSpecialButtons)
+{
+    u32 oldSpecialButtons = specialButtons;
+    specialButtons = newSpecialButtons;
+
+    if(!(oldSpecialButtons & 1) && (specialButtons & 1)) // HOME button pressed
+        srvPublishToSubscriber(0x204, 0);
+    else if((oldSpecialButtons & 1) && !(specialButtons & 1)) // HOME button released
+        srvPublishToSubscriber(0x205, 0);
+
+    if(!(oldSpecialButtons & 2) && (specialButtons & 2)) // POWER button pressed
+        srvPublishToSubscriber(0x202, 0);
+
+    if(!(oldSpecialButtons & 4) && (specialButtons & 4)) // POWER button held long
+        srvPublishToSubscriber(0x203, 0);
+}
+
+// RFC 3550-style interarrival jitter: this doesn't need the clocks of both ends to be synchronized
+static void InputRedirection_UpdateLatencyStats(u32 sentUs, u32 receivedUs, bool first)
+{
+    InputRedirectionStats *stats = &inputRedirectionStats;
+    s32 transit = (s32)(receivedUs - sentUs);
+
+    if(first)
+    {
+        stats->minTransitUs = transit;
+        stats->lastTransitUs = transit;
+        return;
+    }
+
+    s32 d = transit - stats->lastTransitUs;
+    s32 jitter = (s32)stats->jitterUs;
+    stats->lastTransitUs = transit;
+    stats->jitterUs = jitter + ((d < 0 ? -d : d) - jitter) / 16;
+
+    if(transit < stats->minTransitUs)
+        stats->minTransitUs = transit;
+    if((u32)(transit - stats->minTransitUs) > stats->maxDelayUs)
+        stats->maxDelayUs = transit - stats->minTransitUs;
+}
+
+// Returns true if the packet is to be applied
+static bool InputRedirection_AcceptPacket(const InputRedirectionPacketHeader *hdr, u32 receivedUs, bool *synced)
+{
+    InputRedirectionStats *stats = &inputRedirectionStats;
+    bool restarted = !*synced || (hdr->flags & INPUT_REDIRECTION_FLAG_RESET);
+    s32 delta = (s32)(hdr->sequence - stats->lastSequence);
+
+    if(!restarted && delta <= 0)
+    {
+        stats->stale++; // reordered or duplicated, newer state has already been applied
+        return false;
+    }
+
+    if(!restarted)
+        stats->lost += delta - 1;
+
+    InputRedirection_UpdateLatencyStats(hdr->timestampUs, receivedUs, restarted);
+    stats->lastSequence = hdr->sequence;
+    *synced = true;
+    return true;
+}
+
+static void InputRedirection_SendStats(int sock, const struct sockaddr_in *addr, const InputRedirectionPacketHeader *req)
+{
+    struct
+    {
+        InputRedirectionPacketHeader hdr;
+        InputRedirectionStats stats;
+    } reply;
+
+    reply.hdr.magic = INPUT_REDIRECTION_MAGIC;
+    reply.hdr.type = INPUT_REDIRECTION_PACKET_STATS_REPLY;
+    reply.hdr.flags = 0;
+    reply.hdr.sequence = req->sequence;
+    reply.hdr.timestampUs = InputRedirection_GetTimeUs();
+    reply.stats = inputRedirectionStats;
+
+    socSendto(sock, &reply, sizeof(reply), 0, (const struct sockaddr *)addr, sizeof(struct sockaddr_in));
+}
+
 
 void inputRedirectionThreadMain(void)
 {
@@ -109,13 +201,19 @@ void inputRedirectionThreadMain(void)
     inputRedirectionEnabled = true;
     svcSignalEvent(inputRedirectionThreadStartedEvent);
 
-    u32 *hidDataPhys = PA_FROM_VA_PTR(hidData);
+    hidDataPhys = PA_FROM_VA_PTR(hidData);
     hidDataPhys += 5; // skip to +20
 
-    u32 *irDataPhys = PA_FROM_VA_PTR(irData);
+    irDataPhys = PA_FROM_VA_PTR(irData);
+
+    specialButtons = 0;
+    memset(&inputRedirectionStats, 0, sizeof(InputRedirectionStats));
+
+    u8 buf[INPUT_REDIRECTION_MAX_PACKET_SIZE];
+    u8 state[INPUT_REDIRECTION_STATE_SIZE];
+    bool synced = false;
+    int pollTimeout = INPUT_REDIRECTION_MIN_POLL_TIMEOUT;
 
-    char buf[20];
-    u32 oldSpecialButtons = 0, specialButtons = 0;
     while(inputRedirectionEnabled && !preTerminationRequested)
     {
         struct pollfd pfd;
@@ -130,36 +228,89 @@ void inputRedirectionThreadMain(void)
                 svcSleepThread(1000000000ULL);
         }
 
-        int pollres = socPoll(&pfd, 1, 10);
-        if(pollres > 0 && (pfd.revents & POLLIN))
+        // socPoll returns as soon as a datagram arrives, the timeout only bounds how long it takes to notice that
+        // we've been disabled. Keep it short while packets are flowing, back off when idle
+        int pollres = socPoll(&pfd, 1, pollTimeout);
+        if(pollres < -10000)
+            break;
+        else if(pollres <= 0 || !(pfd.revents & POLLIN))
+        {
+            if(pollTimeout < INPUT_REDIRECTION_MAX_POLL_TIMEOUT)
+                pollTimeout *= 2;
+            continue;
+        }
+
+        pollTimeout = INPUT_REDIRECTION_MIN_POLL_TIMEOUT;
+
+        // Drain everything that is queued, only the newest state is written to the shared buffers
+        u32 stateSize = 0, nbRead;
+        for(nbRead = 0; nbRead < INPUT_REDIRECTION_MAX_BATCH; nbRead++)
         {
-            int n = socRecvfrom(sock, buf, 20, 0, NULL, 0);
-            if(n < 0)
+            struct sockaddr_in srcAddr;
+            socklen_t srcAddrLen = sizeof(struct sockaddr_in);
+
+            int n = socRecvfrom(sock, buf, sizeof(buf), nbRead == 0 ? 0 : MSG_DONTWAIT, (struct sockaddr *)&srcAddr, &srcAddrLen);
+            if(n < 0) // nothing left to read (or an actual error if this was the first read)
                 break;
-            else if(n < 12)
-                continue;
 
-            memcpy(hidDataPhys, buf, 12);
-            if(n >= 20)
-            {
-                memcpy(irDataPhys, buf + 12, 4);
+            u32 now = InputRedirection_GetTimeUs();
+            InputRedirectionPacketHeader hdr;
+            const u8 *payload = buf;
+            u32 payloadSize = (u32)n;
 
-                oldSpecialButtons = specialButtons;
-                memcpy(&specialButtons, buf + 16, 4);
+            memcpy(&hdr, buf, sizeof(hdr));
+            if(payloadSize >= sizeof(hdr) && hdr.magic == INPUT_REDIRECTION_MAGIC)
+            {
+                payload += sizeof(hdr);
+                payloadSize -= sizeof(hdr);
+
+                if(hdr.type == INPUT_REDIRECTION_PACKET_STATS_REQUEST)
+                {
+                    InputRedirection_SendStats(sock, &srcAddr, &hdr);
+                    continue;
+                }
+                else if(hdr.type != INPUT_REDIRECTION_PACKET_STATE || payloadSize < 12)
+                {
+                    inputRedirectionStats.malformed++;
+                    continue;
+                }
+
+                inputRedirectionStats.received++;
+                if(!InputRedirection_AcceptPacket(&hdr, now, &synced))
+                    continue;
+            }
+            else if(payloadSize >= 12) // legacy, unversioned packet: always the newest
+                inputRedirectionStats.received++;
+            else
+            {
+                inputRedirectionStats.malformed++;
+                continue;
+            }
 
-                if(!(oldSpecialButtons & 1) && (specialButtons & 1)) // HOME button pressed
-                    srvPublishToSubscriber(0x204, 0);
-                else if((oldSpecialButtons & 1) && !(specialButtons & 1)) // HOME button released
-                    srvPublishToSubscriber(0x205, 0);
+            if(payloadSize > INPUT_REDIRECTION_STATE_SIZE)
+                payloadSize = INPUT_REDIRECTION_STATE_SIZE;
 
-                if(!(oldSpecialButtons & 2) && (specialButtons & 2)) // POWER button pressed
-                    srvPublishToSubscriber(0x202, 0);
+            memcpy(state, payload, payloadSize);
 
-                if(!(oldSpecialButtons & 4) && (specialButtons & 4)) // POWER button held long
-                    srvPublishToSubscriber(0x203, 0);
+            // Button edges must not be lost when intermediate states are skipped
+            if(payloadSize >= INPUT_REDIRECTION_STATE_SIZE)
+            {
+                u32 newSpecialButtons;
+                memcpy(&newSpecialButtons, state + 16, 4);
+                InputRedirection_UpdateSpecialButtons(newSpecialButtons);
             }
+            stateSize = payloadSize;
+        }
+
+        if(stateSize != 0)
+        {
+            inputRedirectionStats.applied++;
+            memcpy(hidDataPhys, state, 12);
+            if(stateSize >= INPUT_REDIRECTION_STATE_SIZE)
+                memcpy(irDataPhys, state + 12, 4);
         }
-        else if(pollres < -10000)
+
+        if(nbRead == 0)
             break;
     }
 
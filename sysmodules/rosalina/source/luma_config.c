@@ -47,6 +47,7 @@ typedef struct CfgData {
 
     ScreenFilter topScreenFilter;
     ScreenFilter bottomScreenFilter;
+    ScreenFilterNightMode screenFiltersNightMode;
 
     u64 autobootTwlTitleId;
     u8 autobootCtrAppmemtype;
@@ -146,6 +147,11 @@ static size_t LumaConfig_SaveLumaIniConfigToStr(char *out, const CfgData *cfg)
     floatToString(bottomScreenFilterContrastStr, cfg->bottomScreenFilter.contrast, 6, false);
     floatToString(bottomScreenFilterBrightnessStr, cfg->bottomScreenFilter.brightness, 6, false);
 
+    char nightModeGammaStr[32];
+    char nightModeBrightnessStr[32];
+    floatToString(nightModeGammaStr, cfg->screenFiltersNightMode.gamma, 6, false);
+    floatToString(nightModeBrightnessStr, cfg->screenFiltersNightMode.brightness, 6, false);
+
     int n = sprintf(
         out, (const char *)config_template_ini,
         lumaVerStr, lumaRevSuffixStr,
@@ -169,6 +175,11 @@ static size_t LumaConfig_SaveLumaIniConfigToStr(char *out, const CfgData *cfg)
         topScreenFilterBrightnessStr, bottomScreenFilterBrightnessStr,
         (int)cfg->topScreenFilter.invert, (int)cfg->bottomScreenFilter.invert,
 
+        (int)cfg->screenFiltersNightMode.enabled,
+        (int)cfg->screenFiltersNightMode.startMinutes, (int)cfg->screenFiltersNightMode.endMinutes,
+        (int)cfg->screenFiltersNightMode.transitionMinutes, (int)cfg->screenFiltersNightMode.cct,
+        nightModeGammaStr, nightModeBrightnessStr,
+
         cfg->autobootTwlTitleId, (int)cfg->autobootCtrAppmemtype,
 
         (int)CONFIG(PATCHUNITINFO), (int)CONFIG(DISABLEARM11EXCHANDLERS),
@@ -184,7 +195,7 @@ void LumaConfig_RequestSaveSettings(void) {
 
 Result LumaConfig_SaveSettings(void)
 {
-    char inibuf[0x2000];
+    static char inibuf[0x3000]; // only used from the menu thread, too big for its stack
 
     Result res;
 
@@ -234,6 +245,7 @@ Result LumaConfig_SaveSettings(void)
     configData.ntpTzOffetMinutes = (s16)lastNtpTzOffset;
     configData.topScreenFilter = topScreenFilter;
     configData.bottomScreenFilter = bottomScreenFilter;
+    configData.screenFiltersNightMode = screenFilterNightMode;
     configData.autobootTwlTitleId = autobootTwlTitleId;
     configData.autobootCtrAppmemtype = autobootCtrAppmemtype;
 
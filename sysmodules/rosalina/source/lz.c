@@ -0,0 +1,205 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include <string.h>
+#include "lz.h"
+
+#define LZ_MIN_MATCH        4
+#define LZ_LAST_LITERALS    5   // the last bytes of a block are always literals
+#define LZ_MF_LIMIT         12  // no match may start in the last bytes of a block
+#define LZ_HASH_BITS        12
+#define LZ_SKIP_TRIGGER     6   // search faster through incompressible data
+
+static u16 lzHashTable[1 << LZ_HASH_BITS]; // positions, LZ_MAX_BLOCK_SIZE fits
+
+static inline u32 LZ_Read32(const u8 *p)
+{
+    u32 v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline u32 LZ_Hash(u32 seq)
+{
+    return (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// Number of bytes following the token for a literal or match length
+static inline u32 LZ_LengthSize(u32 len)
+{
+    return len >= 15 ? 1 + (len - 15) / 255 : 0;
+}
+
+static inline u8 *LZ_WriteLength(u8 *op, u32 len)
+{
+    for(; len >= 255; len -= 255)
+        *op++ = 255;
+    *op++ = (u8)len;
+    return op;
+}
+
+u32 LZ_Compress(u8 *dst, u32 dstCapacity, const u8 *src, u32 srcSize)
+{
+    const u8 *ip = src, *anchor = src, *end = src + srcSize;
+    u8 *op = dst, *opEnd = dst + dstCapacity;
+
+    if(srcSize > LZ_MAX_BLOCK_SIZE)
+        return 0;
+
+    if(srcSize > LZ_MF_LIMIT)
+    {
+        const u8 *mfLimit = end - LZ_MF_LIMIT, *matchLimit = end - LZ_LAST_LITERALS;
+
+        memset(lzHashTable, 0, sizeof(lzHashTable));
+        ip++;
+
+        while(ip < mfLimit)
+        {
+            u32 seq = LZ_Read32(ip);
+            u32 h = LZ_Hash(seq);
+            const u8 *ref = src + lzHashTable[h];
+
+            lzHashTable[h] = (u16)(ip - src);
+            if(ref >= ip || LZ_Read32(ref) != seq)
+            {
+                ip += 1 + ((u32)(ip - anchor) >> LZ_SKIP_TRIGGER);
+                continue;
+            }
+
+            // Extend the match backwards and forwards
+            while(ip > anchor && ref > src && ip[-1] == ref[-1])
+            {
+                ip--;
+                ref--;
+            }
+
+            const u8 *matchEnd = ip + LZ_MIN_MATCH;
+            for(const u8 *r = ref + LZ_MIN_MATCH; matchEnd < matchLimit && *matchEnd == *r; matchEnd++, r++);
+
+            u32 litLen = ip - anchor;
+            u32 matchLen = matchEnd - ip - LZ_MIN_MATCH;
+            u32 offset = ip - ref;
+
+            if((u32)(opEnd - op) < 1 + LZ_LengthSize(litLen) + litLen + 2 + LZ_LengthSize(matchLen))
+                return 0;
+
+            u8 *token = op++;
+            *token = (u8)((litLen >= 15 ? 15 : litLen) << 4);
+            if(litLen >= 15)
+                op = LZ_WriteLength(op, litLen - 15);
+            memcpy(op, anchor, litLen);
+            op += litLen;
+
+            *op++ = (u8)offset;
+            *op++ = (u8)(offset >> 8);
+
+            *token |= matchLen >= 15 ? 15 : matchLen;
+            if(matchLen >= 15)
+                op = LZ_WriteLength(op, matchLen - 15);
+
+            ip = anchor = matchEnd;
+        }
+    }
+
+    u32 litLen = end - anchor;
+    if((u32)(opEnd - op) < 1 + LZ_LengthSize(litLen) + litLen)
+        return 0;
+
+    *op++ = (u8)((litLen >= 15 ? 15 : litLen) << 4);
+    if(litLen >= 15)
+        op = LZ_WriteLength(op, litLen - 15);
+    memcpy(op, anchor, litLen);
+    op += litLen;
+
+    return op - dst;
+}
+
+static inline const u8 *LZ_ReadLength(const u8 *ip, const u8 *ipEnd, u32 *len)
+{
+    u8 b;
+    do
+    {
+        if(ip >= ipEnd)
+            return NULL;
+        b = *ip++;
+        *len += b;
+    }
+    while(b == 255);
+
+    return ip;
+}
+
+s32 LZ_Decompress(u8 *dst, u32 dstCapacity, const u8 *src, u32 srcSize)
+{
+    const u8 *ip = src, *ipEnd = src + srcSize;
+    u8 *op = dst, *opEnd = dst + dstCapacity;
+
+    while(ip < ipEnd)
+    {
+        u8 token = *ip++;
+        u32 len = token >> 4;
+
+        if(len == 15 && (ip = LZ_ReadLength(ip, ipEnd, &len)) == NULL)
+            return -1;
+        if(len > (u32)(ipEnd - ip) || len > (u32)(opEnd - op))
+            return -1;
+
+        memcpy(op, ip, len);
+        op += len;
+        ip += len;
+
+        if(ip == ipEnd) // the last sequence only has literals
+            break;
+        else if(ipEnd - ip < 2)
+            return -1;
+
+        u32 offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if(offset == 0 || offset > (u32)(op - dst))
+            return -1;
+
+        len = token & 15;
+        if(len == 15 && (ip = LZ_ReadLength(ip, ipEnd, &len)) == NULL)
+            return -1;
+        len += LZ_MIN_MATCH;
+        if(len > (u32)(opEnd - op))
+            return -1;
+
+        const u8 *ref = op - offset;
+        if(offset >= len)
+        {
+            memcpy(op, ref, len);
+            op += len;
+        }
+        else // overlapping, e.g. runs
+        {
+            while(len-- != 0)
+                *op++ = *ref++;
+        }
+    }
+
+    return op - dst;
+}
@@ -176,58 +176,171 @@ u32 waitCombo(void)
 static MyThread menuThread;
 static u8 ALIGN(8) menuThreadStack[0x3000];
 
-static float batteryPercentage;
-static float batteryVoltage;
-static u8 batteryTemperature;
+// System status shown by menuDraw, refreshed in the background while a menu is shown so that drawing
+// doesn't need any IPC
+typedef struct MenuStatus {
+    Result mcuInfoResult;
+    u8 batteryTemperature;
+    float batteryPercentage;
+    float batteryVoltage;
+    bool hasIp;
+    u32 ip;
+} MenuStatus;
+
+#define MENU_STATUS_REFRESH_INTERVAL    (1000 * 1000 * 1000LL)
+
+static MyThread menuStatusThread;
+static u8 ALIGN(8) menuStatusThreadStack[0x1000];
+static LightLock menuStatusLock;
+static Handle menuStatusWakeEvent; // signaled when a menu is shown
+static bool menuStatusActive; // protected by menuStatusLock
+static MenuStatus menuStatus = { .mcuInfoResult = -1 };
+
+static void menuGetStatus(MenuStatus *out)
+{
+    LightLock_Lock(&menuStatusLock);
+    *out = menuStatus;
+    LightLock_Unlock(&menuStatusLock);
+}
 
-static Result menuUpdateMcuInfo(void)
+// Drops the status if the menu has been closed while it was being read
+static void menuSetStatus(const MenuStatus *status)
 {
-    Result res = 0;
-    u8 data[4];
+    LightLock_Lock(&menuStatusLock);
+    if (menuStatusActive)
+        menuStatus = *status;
+    LightLock_Unlock(&menuStatusLock);
+}
 
-    if (!isServiceUsable("mcu::HWC"))
-        return -1;
+static bool menuIsStatusActive(void)
+{
+    LightLock_Lock(&menuStatusLock);
+    bool active = menuStatusActive;
+    LightLock_Unlock(&menuStatusLock);
+    return active;
+}
 
-    Handle *mcuHwcHandlePtr = mcuHwcGetSessionHandle();
-    *mcuHwcHandlePtr = 0;
+// Our own session: the libctru one (mcuHwcInit) may be in use by the menu thread at the same time
+static Handle menuOpenMcuHwcSession(void)
+{
+    Handle handle = 0;
+
+    if (!isServiceUsable("mcu::HWC"))
+        return 0;
 
-    res = srvGetServiceHandle(mcuHwcHandlePtr, "mcu::HWC");
+    Result res = srvGetServiceHandle(&handle, "mcu::HWC");
     // Try to steal the handle if some other process is using the service (custom SVC)
     if (R_FAILED(res))
-        res = svcControlService(SERVICEOP_STEAL_CLIENT_SESSION, mcuHwcHandlePtr, "mcu::HWC");
-    if (res != 0)
-        return res;
+        res = svcControlService(SERVICEOP_STEAL_CLIENT_SESSION, &handle, "mcu::HWC");
+
+    return R_SUCCEEDED(res) ? handle : 0;
+}
+
+static Result menuMcuHwcReadRegister(Handle handle, u8 reg, void *data, u32 size)
+{
+    u32 *cmdbuf = getThreadCommandBuffer();
+
+    cmdbuf[0] = IPC_MakeHeader(0x1, 2, 2); // ReadRegister
+    cmdbuf[1] = reg;
+    cmdbuf[2] = size;
+    cmdbuf[3] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+    cmdbuf[4] = (u32)data;
+
+    Result res = svcSendSyncRequest(handle);
+    return R_SUCCEEDED(res) ? (Result)cmdbuf[1] : res;
+}
+
+static void menuReadStatus(MenuStatus *status)
+{
+    u8 data[4];
+
+    // Only hold the session for the duration of the read: mcu::HWC has a limited number of sessions
+    // and we run with a blocking srv policy, so the menus must be able to get one at any time
+    Handle mcuHwcHandle = menuOpenMcuHwcSession();
 
     // Read single-byte mcu regs 0x0A to 0x0D directly
-    res = MCUHWC_ReadRegister(0xA, data, 4);
+    status->mcuInfoResult = mcuHwcHandle != 0 ? menuMcuHwcReadRegister(mcuHwcHandle, 0xA, data, 4) : -1;
+    if (mcuHwcHandle != 0)
+        svcCloseHandle(mcuHwcHandle);
 
-    if (R_SUCCEEDED(res))
+    if (R_SUCCEEDED(status->mcuInfoResult))
     {
-        batteryTemperature = data[0];
+        status->batteryTemperature = data[0];
 
         // The battery percentage isn't very precise... its precision ranges from 0.09% to 0.14% approx
         // Round to 0.1%
-        batteryPercentage = data[1] + data[2] / 256.0f;
-        batteryPercentage = (u32)((batteryPercentage + 0.05f) * 10.0f) / 10.0f;
+        status->batteryPercentage = data[1] + data[2] / 256.0f;
+        status->batteryPercentage = (u32)((status->batteryPercentage + 0.05f) * 10.0f) / 10.0f;
 
         // Round battery voltage to 0.01V
-        batteryVoltage = 0.02f * data[3];
-        batteryVoltage = (u32)((batteryVoltage + 0.005f) * 100.0f) / 100.0f;
+        status->batteryVoltage = 0.02f * data[3];
+        status->batteryVoltage = (u32)((status->batteryVoltage + 0.005f) * 100.0f) / 100.0f;
     }
 
-    // Read mcu fw version if not already done
-    if (mcuFwVersion == 0)
+    status->hasIp = miniSocEnabled;
+    status->ip = status->hasIp ? socGethostid() : 0;
+}
+
+static void menuStatusThreadMain(void)
+{
+    Handle handles[2] = { preTerminationEvent, menuStatusWakeEvent };
+    s32 idx;
+
+    while (!preTerminationRequested)
     {
-        u8 minor = 0, major = 0;
-        MCUHWC_GetFwVerHigh(&major);
-        MCUHWC_GetFwVerLow(&minor);
+        if (!menuIsStatusActive())
+        {
+            svcWaitSynchronizationN(&idx, handles, 2, false, -1LL);
+            continue;
+        }
+
+        MenuStatus status;
+        menuReadStatus(&status);
+        menuSetStatus(&status);
 
-        // If it has failed, mcuFwVersion will be set to 0 again
-        mcuFwVersion = SYSTEM_VERSION(major - 0x10, minor, 0);
+        // Refresh periodically, and right away if a menu is reopened in the meantime
+        svcWaitSynchronizationN(&idx, handles, 2, false, MENU_STATUS_REFRESH_INTERVAL);
     }
+}
+
+static void menuSetStatusActive(bool active)
+{
+    static const MenuStatus invalidStatus = { .mcuInfoResult = -1 };
+
+    LightLock_Lock(&menuStatusLock);
+    menuStatusActive = active;
+    if (!active)
+        menuStatus = invalidStatus; // don't show outdated info next time
+    LightLock_Unlock(&menuStatusLock);
+
+    if (active)
+        svcSignalEvent(menuStatusWakeEvent);
+}
+
+static void menuUpdateMcuFwVersion(void)
+{
+    // Read mcu fw version if not already done
+    if (mcuFwVersion != 0 || !isServiceUsable("mcu::HWC"))
+        return;
+
+    Handle *mcuHwcHandlePtr = mcuHwcGetSessionHandle();
+    *mcuHwcHandlePtr = 0;
+
+    Result res = srvGetServiceHandle(mcuHwcHandlePtr, "mcu::HWC");
+    // Try to steal the handle if some other process is using the service (custom SVC)
+    if (R_FAILED(res))
+        res = svcControlService(SERVICEOP_STEAL_CLIENT_SESSION, mcuHwcHandlePtr, "mcu::HWC");
+    if (res != 0)
+        return;
+
+    u8 minor = 0, major = 0;
+    MCUHWC_GetFwVerHigh(&major);
+    MCUHWC_GetFwVerLow(&minor);
+
+    // If it has failed, mcuFwVersion will be set to 0 again
+    mcuFwVersion = SYSTEM_VERSION(major - 0x10, minor, 0);
 
     svcCloseHandle(*mcuHwcHandlePtr);
-    return res;
 }
 
 static inline u32 menuAdvanceCursor(u32 pos, u32 numItems, s32 displ)
@@ -254,8 +367,16 @@ u32 menuCountItems(const Menu *menu)
 
 MyThread *menuCreateThread(void)
 {
+    LightLock_Init(&menuStatusLock);
+    if(R_FAILED(svcCreateEvent(&menuStatusWakeEvent, RESET_ONESHOT)))
+        svcBreak(USERBREAK_PANIC);
+
     if(R_FAILED(MyThread_Create(&menuThread, menuThreadMain, menuThreadStack, 0x3000, 52, CORE_SYSTEM)))
         svcBreak(USERBREAK_PANIC);
+    // Higher priority than the menu thread, so that the status is ready when a menu is first drawn.
+    // Joined by the menu thread.
+    if(R_FAILED(MyThread_Create(&menuStatusThread, menuStatusThreadMain, menuStatusThreadStack, sizeof(menuStatusThreadStack), 51, CORE_SYSTEM)))
+        svcBreak(USERBREAK_PANIC);
     return &menuThread;
 }
 
@@ -283,14 +404,18 @@ void menuThreadMain(void)
             continue;
 
         Cheat_ApplyCheats();
+        ScreenFiltersMenu_UpdateNightMode();
 
         if(((scanHeldKeys() & menuCombo) == menuCombo) && !g_blockMenuOpen)
         {
             menuEnter();
+            menuUpdateMcuFwVersion();
             if(isN3DS) N3DSMenu_UpdateStatus();
             PluginLoader__UpdateMenu();
+            PluginLoader__InvalidatePluginIndex(); // plugins may have been added or removed in the meantime
             menuShow(&rosalinaMenu);
             menuLeave();
+            ScreenFiltersMenu_RefreshNightMode(); // the saved filters may have been changed and applied as-is
         }
 
         if (saveSettingsRequest) {
@@ -298,6 +423,10 @@ void menuThreadMain(void)
             saveSettingsRequest = false;
         }
     }
+
+    svcSignalEvent(menuStatusWakeEvent);
+    MyThread_Join(&menuStatusThread, -1LL);
+    svcCloseHandle(menuStatusWakeEvent);
 }
 
 static s32 menuRefCount = 0;
@@ -317,7 +446,10 @@ void menuEnter(void)
             svcSleepThread(5 * 1000 * 100LL);
         }
         else
+        {
             Draw_SetupFramebuffer();
+            menuSetStatusActive(true);
+        }
     }
     Draw_Unlock();
 }
@@ -329,6 +461,7 @@ void menuLeave(void)
     Draw_Lock();
     if(--menuRefCount == 0)
     {
+        menuSetStatusActive(false);
         Draw_RestoreFramebuffer();
         Draw_FreeFramebufferCache();
         svcKernelSetState(0x10000, 2 | 1);
@@ -343,7 +476,8 @@ static void menuDraw(Menu *menu, u32 selected)
     u32 version, commitHash;
     bool isRelease;
 
-    Result mcuInfoRes = menuUpdateMcuInfo();
+    MenuStatus status;
+    menuGetStatus(&status);
 
     svcGetSystemInfo(&out, 0x10000, 0);
     version = (u32)out;
@@ -373,27 +507,26 @@ static void menuDraw(Menu *menu, u32 selected)
         dispY += SPACING_Y;
     }
 
-    if(miniSocEnabled)
+    if(miniSocEnabled && status.hasIp)
     {
         char ipBuffer[17];
-        u32 ip = socGethostid();
-        u8 *addr = (u8 *)&ip;
+        u8 *addr = (u8 *)&status.ip;
         int n = sprintf(ipBuffer, "%hhu.%hhu.%hhu.%hhu", addr[0], addr[1], addr[2], addr[3]);
         Draw_DrawString(SCREEN_BOT_WIDTH - 10 - SPACING_X * n, 10, COLOR_WHITE, ipBuffer);
     }
     else
         Draw_DrawFormattedString(SCREEN_BOT_WIDTH - 10 - SPACING_X * 15, 10, COLOR_WHITE, "%15s", "");
 
-    if(mcuInfoRes == 0)
+    if(status.mcuInfoResult == 0)
     {
-        u32 voltageInt = (u32)batteryVoltage;
-        u32 voltageFrac = (u32)(batteryVoltage * 100.0f) % 100u;
-        u32 percentageInt = (u32)batteryPercentage;
-        u32 percentageFrac = (u32)(batteryPercentage * 10.0f) % 10u;
+        u32 voltageInt = (u32)status.batteryVoltage;
+        u32 voltageFrac = (u32)(status.batteryVoltage * 100.0f) % 100u;
+        u32 percentageInt = (u32)status.batteryPercentage;
+        u32 percentageFrac = (u32)(status.batteryPercentage * 10.0f) % 10u;
 
         char buf[32];
         int n = sprintf(
-            buf, "   %02hhu\xF8""C  %lu.%02luV  %lu.%lu%%", batteryTemperature, // CP437
+            buf, "   %02hhu\xF8""C  %lu.%02luV  %lu.%lu%%", status.batteryTemperature, // CP437
             voltageInt, voltageFrac,
             percentageInt, percentageFrac
         );
@@ -407,7 +540,8 @@ static void menuDraw(Menu *menu, u32 selected)
     else
         Draw_DrawFormattedString(10, SCREEN_BOT_HEIGHT - 20, COLOR_TITLE, "Luma3DS %s-%08lx ESP", versionString, commitHash);
 
-    Draw_FlushFramebuffer();
+    // Most of the time, nothing has changed since the previous poll
+    Draw_FlushDirtyFramebuffer();
 }
 
 void menuShow(Menu *root)
@@ -29,6 +29,7 @@
 #include "menus.h"
 #include "menu.h"
 #include "draw.h"
+#include "qoi.h"
 #include "menus/process_list.h"
 #include "menus/n3ds.h"
 #include "menus/debugger.h"
@@ -355,6 +356,8 @@ void RosalinaMenu_PowerOff(void) // Soft shutdown.
 
 #define TRY(expr) if(R_FAILED(res = (expr))) goto end;
 
+#define SCREENSHOT_OUTPUT_BUFFER_SIZE   0x10000
+
 static s64 timeSpentConvertingScreenshot = 0;
 static s64 timeSpentWritingScreenshot = 0;
 
@@ -363,36 +366,74 @@ static Result RosalinaMenu_WriteScreenshot(IFile *file, u32 width, bool top, boo
     u64 total;
     Result res = 0;
     u32 lineSize = 3 * width;
-    u32 remaining = lineSize * 240;
+    u32 maxEncodedLineSize = QOI_MAX_ENCODED_LINE_SIZE(width);
+    QoiEncoder enc;
 
-    TRY(Draw_AllocateFramebufferCacheForScreenshot(remaining));
+    // Ideally the whole converted screen, plus room for the encoder output
+    TRY(Draw_AllocateFramebufferCacheForScreenshot(lineSize * 240 + SCREENSHOT_OUTPUT_BUFFER_SIZE));
 
     u8 *framebufferCache = (u8 *)Draw_GetFramebufferCache();
-    u8 *framebufferCacheEnd = framebufferCache + Draw_GetFramebufferCacheSize();
+    u32 cacheSize = Draw_GetFramebufferCacheSize();
+
+    // Our buffer might be smaller than that...
+    u32 outSize = cacheSize / 4 < SCREENSHOT_OUTPUT_BUFFER_SIZE ? cacheSize / 4 : SCREENSHOT_OUTPUT_BUFFER_SIZE;
+    u32 linesPerChunk = (cacheSize - outSize) / lineSize;
+    if(outSize < QOI_HEADER_SIZE + maxEncodedLineSize + 1 + QOI_END_MARKER_SIZE || linesPerChunk == 0)
+    {
+        res = MAKERESULT(RL_PERMANENT, RS_OUTOFRESOURCE, RM_APPLICATION, RD_OUT_OF_MEMORY);
+        goto end;
+    }
+    linesPerChunk = linesPerChunk > 240 ? 240 : linesPerChunk;
+
+    u8 *out = framebufferCache + linesPerChunk * lineSize;
+    u8 *outEnd = out + outSize;
+    u8 *outPos = out;
+
+    Qoi_WriteHeader(outPos, width, 240);
+    outPos += QOI_HEADER_SIZE;
+    Qoi_InitEncoder(&enc);
+
+    // Lines are converted bottom to top (like BMP), but QOI is stored top to bottom
+    u32 y = 240;
+    while (y != 0)
+    {
+        s64 t0 = svcGetSystemTick();
+        u32 nlines = y < linesPerChunk ? y : linesPerChunk;
+        y -= nlines;
+        Draw_ConvertFrameBufferLines(framebufferCache, width, y, nlines, top, left);
+
+        for (u32 i = nlines; i > 0; i--)
+        {
+            if ((u32)(outEnd - outPos) < maxEncodedLineSize)
+            {
+                s64 t1 = svcGetSystemTick();
+                timeSpentConvertingScreenshot += t1 - t0;
+                TRY(IFile_Write(file, &total, out, outPos - out, 0));
+                t0 = svcGetSystemTick();
+                timeSpentWritingScreenshot += t0 - t1;
+                outPos = out;
+            }
+
+            outPos += Qoi_EncodeBgr8Line(&enc, outPos, framebufferCache + (i - 1) * lineSize, width);
+        }
 
-    u8 *buf = framebufferCache;
-    Draw_CreateBitmapHeader(framebufferCache, width, 240);
-    buf += 54;
+        timeSpentConvertingScreenshot += svcGetSystemTick() - t0;
+    }
 
-    u32 y = 0;
-    // Our buffer might be smaller than the size of the screenshot...
-    while (remaining != 0)
+    if ((u32)(outEnd - outPos) < 1 + QOI_END_MARKER_SIZE)
     {
         s64 t0 = svcGetSystemTick();
-        u32 available = (u32)(framebufferCacheEnd - buf);
-        u32 size = available < remaining ? available : remaining;
-        u32 nlines = size / lineSize;
-        Draw_ConvertFrameBufferLines(buf, width, y, nlines, top, left);
-
-        s64 t1 = svcGetSystemTick();
-        timeSpentConvertingScreenshot += t1 - t0;
-        TRY(IFile_Write(file, &total, framebufferCache, (y == 0 ? 54 : 0) + lineSize * nlines, 0)); // don't forget to write the header
-        timeSpentWritingScreenshot += svcGetSystemTick() - t1;
-
-        y += nlines;
-        remaining -= lineSize * nlines;
-        buf = framebufferCache;
+        TRY(IFile_Write(file, &total, out, outPos - out, 0));
+        timeSpentWritingScreenshot += svcGetSystemTick() - t0;
+        outPos = out;
     }
+
+    outPos += Qoi_FinishEncoding(&enc, outPos);
+
+    s64 t0 = svcGetSystemTick();
+    TRY(IFile_Write(file, &total, out, outPos - out, 0));
+    timeSpentWritingScreenshot += svcGetSystemTick() - t0;
+
     end:
 
     Draw_FreeFramebufferCache();
@@ -442,19 +483,19 @@ void RosalinaMenu_TakeScreenshot(void)
 
     dateTimeToString(dateTimeStr, osGetTime(), true);
 
-    sprintf(filename, "/luma/screenshots/%s_superior.bmp", dateTimeStr);
+    sprintf(filename, "/luma/screenshots/%s_superior.qoi", dateTimeStr);
     TRY(IFile_Open(&file, archiveId, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, filename), FS_OPEN_CREATE | FS_OPEN_WRITE));
     TRY(RosalinaMenu_WriteScreenshot(&file, topWidth, true, true));
     TRY(IFile_Close(&file));
 
-    sprintf(filename, "/luma/screenshots/%s_inferior.bmp", dateTimeStr);
+    sprintf(filename, "/luma/screenshots/%s_inferior.qoi", dateTimeStr);
     TRY(IFile_Open(&file, archiveId, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, filename), FS_OPEN_CREATE | FS_OPEN_WRITE));
     TRY(RosalinaMenu_WriteScreenshot(&file, bottomWidth, false, true));
     TRY(IFile_Close(&file));
 
     if(is3d && (Draw_GetCurrentFramebufferAddress(true, true) != Draw_GetCurrentFramebufferAddress(true, false)))
     {
-        sprintf(filename, "/luma/screenshots/%s_sup_der.bmp", dateTimeStr);
+        sprintf(filename, "/luma/screenshots/%s_sup_der.qoi", dateTimeStr);
         TRY(IFile_Open(&file, archiveId, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, filename), FS_OPEN_CREATE | FS_OPEN_WRITE));
         TRY(RosalinaMenu_WriteScreenshot(&file, topWidth, true, false));
         TRY(IFile_Close(&file));
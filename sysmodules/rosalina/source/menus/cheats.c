@@ -38,6 +38,17 @@
 #define MAKE_QWORD(hi,low) \
     ((u64) ((((u64)(hi)) << 32) | (low)))
 
+#define CHEAT_NAME_MAX_LEN          38
+
+// Cheats live in a growable store in the SYSTEM memory region, committed page by page as the
+// cheat file is parsed: an index of record offsets, followed by the records themselves
+// (variable-length code arrays) interleaved with deduplicated names.
+#define CHEAT_STORE_ADDR            0x0A000000
+#define CHEAT_STORE_INDEX_SIZE      0x00010000 // 16384 cheats
+#define CHEAT_STORE_DATA_ADDR       (CHEAT_STORE_ADDR + CHEAT_STORE_INDEX_SIZE)
+#define CHEAT_STORE_DATA_SIZE       0x00200000
+#define CHEAT_STORE_NAME_BUCKETS    512
+
 typedef struct CheatDescription
 {
     struct {
@@ -46,24 +57,106 @@ typedef struct CheatDescription
         u8 hasKeyCode : 1;
         u8 activeStorage : 1;
     };
-    char name[39];
+    u8 _padding[3];
+    u32 nameOffset;
     u32 codesCount;
     u32 storage1;
     u32 storage2;
     u64 codes[0];
 } CheatDescription;
 
-typedef struct BufferedFile
+typedef struct CheatName
+{
+    u32 next; // offset of the next name in the same hash bucket, 0 if none
+    char str[0];
+} CheatName;
+
+typedef struct CheatStore
+{
+    u32 count;
+    u32 indexCommitted;
+    u32 dataCommitted;
+    u32 dataUsed;
+    u32 nameBuckets[CHEAT_STORE_NAME_BUCKETS];
+} CheatStore;
+
+// Cheat files are read in large chunks and split into lines in place
+#define CHEAT_FILE_BUFFER_SIZE      0x2000
+
+typedef struct CheatFileReader
 {
     IFile file;
-    u64 curPos;
-    u64 maxPos;
-    char buffer[512];
-} BufferedFile;
+    u64 end;
+    u32 start;
+    u32 len;
+    bool eof;
+} CheatFileReader;
+
+// Packed cheat database: many titles in one file, found with a bucketed TID index.
+// Layout: CheatDbHeader, then CheatDbEntry[titleCount] sorted by (bucket, titleId),
+// then the cheat texts (same format as the per-title .txt files).
+#define CHEAT_DB_PATH               "/cheats/cheats.db"
+#define CHEAT_DB_MAGIC              0x42444843 // "CHDB"
+#define CHEAT_DB_VERSION            1
+#define CHEAT_DB_BUCKET_COUNT       256
+#define CHEAT_DB_BUCKET(titleId)    (((titleId) >> 8) & 0xFF)
+
+typedef struct CheatDbHeader
+{
+    u32 magic;
+    u32 version;
+    u32 titleCount;
+    u32 reserved;
+    u32 bucketStart[CHEAT_DB_BUCKET_COUNT + 1]; // entry index range for each bucket
+} CheatDbHeader;
+
+typedef struct CheatDbEntry
+{
+    u64 titleId;
+    u32 offset;
+    u32 size;
+} CheatDbEntry;
 
-CheatDescription* cheats[1024] = { 0 };
-u8 cheatBuffer[32768] = { 0 };
+// Cheat engine profiler, per cheat and per opcode class (first nibble of the code)
+#define CHEAT_PROFILE_MAX_ENTRIES   64
+#define CHEAT_PROFILE_OPCODE_COUNT  16
+#define CHEAT_PROFILE_CSV_PATH      "/luma/cheats_profile.csv"
+
+typedef struct CheatProfileCounters
+{
+    u32 runs;
+    u32 failures;
+    u32 syscalls;
+    u64 ticks;
+} CheatProfileCounters;
+
+typedef struct CheatProfileEntry
+{
+    u32 cheatOffset;
+    CheatProfileCounters counters;
+} CheatProfileEntry;
+
+typedef struct CheatProfiler
+{
+    bool enabled;
+    u32 syscalls;
+
+    s32 curOpcode;
+    u64 curOpcodeTick;
+    u32 curOpcodeSyscalls;
+
+    u32 count;
+    CheatProfileEntry cheats[CHEAT_PROFILE_MAX_ENTRIES];
+    CheatProfileCounters others; // cheats that didn't fit in the table
+    CheatProfileCounters opcodes[CHEAT_PROFILE_OPCODE_COUNT];
+} CheatProfiler;
+
+static CheatStore cheatStore = { 0 };
+static u32 *const cheatIndex = (u32 *)CHEAT_STORE_ADDR;
+static u8 *const cheatData = (u8 *)CHEAT_STORE_DATA_ADDR;
 u8 cheatPage[0x1000] = { 0 };
+static char ALIGN(8) cheatFileBuffer[CHEAT_FILE_BUFFER_SIZE + 1] = { 0 };
+static CheatProfiler cheatProfiler = { .curOpcode = -1 };
 
 typedef struct CheatState
 {
@@ -94,7 +187,6 @@ typedef struct CheatState
 } CheatState;
 
 CheatState cheat_state = { 0 };
-u8 cheatCount = 0;
 u64 cheatTitleInfo = -1ULL;
 u64 cheatRngState = 0;
 
@@ -126,6 +218,7 @@ static bool Cheat_IsValidAddress(const Handle processHandle, u32 address, u32 si
     MemInfo info;
     PageInfo out;
 
+    cheatProfiler.syscalls++;
     Result res = svcQueryDebugProcessMemory(&info, &out, processHandle, address);
     if (R_SUCCEEDED(res) && info.state != MEMSTATE_FREE && info.base_addr > 0 && info.base_addr <= address && address <= info.base_addr + info.size - size) {
         return true;
@@ -148,6 +241,7 @@ static bool Cheat_Write8(const Handle processHandle, u32 offset, u8 value)
     if (Cheat_IsValidAddress(processHandle, addr, 1))
     {
         *((u8*) (&ReadWriteBuffer8)) = value;
+        cheatProfiler.syscalls++;
         return R_SUCCEEDED(svcWriteProcessMemory(processHandle, &ReadWriteBuffer8, addr, 1));
     }
     return false;
@@ -164,6 +258,7 @@ static bool Cheat_Write16(const Handle processHandle, u32 offset, u16 value)
     if (Cheat_IsValidAddress(processHandle, addr, 2))
     {
         *((u16*) (&ReadWriteBuffer16)) = value;
+        cheatProfiler.syscalls++;
         return R_SUCCEEDED(svcWriteProcessMemory(processHandle, &ReadWriteBuffer16, addr, 2));
     }
     return false;
@@ -180,6 +275,7 @@ static bool Cheat_Write32(const Handle processHandle, u32 offset, u32 value)
     if (Cheat_IsValidAddress(processHandle, addr, 4))
     {
         *((u32*) (&ReadWriteBuffer32)) = value;
+        cheatProfiler.syscalls++;
         return R_SUCCEEDED(svcWriteProcessMemory(processHandle, &ReadWriteBuffer32, addr, 4));
     }
     return false;
@@ -195,6 +291,7 @@ static bool Cheat_Read8(const Handle processHandle, u32 offset, u8* retValue)
     }
     if (Cheat_IsValidAddress(processHandle, addr, 1))
     {
+        cheatProfiler.syscalls++;
         Result res = svcReadProcessMemory(&ReadWriteBuffer8, processHandle, addr, 1);
         *retValue = *((u8*) (&ReadWriteBuffer8));
         return R_SUCCEEDED(res);
@@ -212,6 +309,7 @@ static bool Cheat_Read16(const Handle processHandle, u32 offset, u16* retValue)
     }
     if (Cheat_IsValidAddress(processHandle, addr, 2))
     {
+        cheatProfiler.syscalls++;
         Result res = svcReadProcessMemory(&ReadWriteBuffer16, processHandle, addr, 2);
         *retValue = *((u16*) (&ReadWriteBuffer16));
         return R_SUCCEEDED(res);
@@ -229,6 +327,7 @@ static bool Cheat_Read32(const Handle processHandle, u32 offset, u32* retValue)
     }
     if (Cheat_IsValidAddress(processHandle, addr, 4))
     {
+        cheatProfiler.syscalls++;
         Result res = svcReadProcessMemory(&ReadWriteBuffer32, processHandle, addr, 4);
         *retValue = *((u32*) (&ReadWriteBuffer32));
         return R_SUCCEEDED(res);
@@ -236,6 +335,57 @@ static bool Cheat_Read32(const Handle processHandle, u32 offset, u32* retValue)
     return false;
 }
 
+static void Cheat_ProfileEndOpcode(bool failed)
+{
+    if (cheatProfiler.curOpcode < 0)
+        return;
+
+    CheatProfileCounters* counters = &cheatProfiler.opcodes[cheatProfiler.curOpcode];
+    counters->ticks += svcGetSystemTick() - cheatProfiler.curOpcodeTick;
+    counters->syscalls += cheatProfiler.syscalls - cheatProfiler.curOpcodeSyscalls;
+    if (failed)
+        counters->failures++;
+
+    cheatProfiler.curOpcode = -1;
+}
+
+static inline void Cheat_ProfileBeginOpcode(u32 code)
+{
+    if (!cheatProfiler.enabled)
+        return;
+
+    Cheat_ProfileEndOpcode(false);
+    cheatProfiler.opcodes[code].runs++;
+    cheatProfiler.curOpcode = code;
+    cheatProfiler.curOpcodeSyscalls = cheatProfiler.syscalls;
+    cheatProfiler.curOpcodeTick = svcGetSystemTick();
+}
+
+static CheatProfileCounters* Cheat_GetProfileCounters(u32 cheatOffset)
+{
+    for (u32 i = 0; i < cheatProfiler.count; i++)
+    {
+        if (cheatProfiler.cheats[i].cheatOffset == cheatOffset)
+            return &cheatProfiler.cheats[i].counters;
+    }
+
+    if (cheatProfiler.count >= CHEAT_PROFILE_MAX_ENTRIES)
+        return &cheatProfiler.others;
+
+    CheatProfileEntry* entry = &cheatProfiler.cheats[cheatProfiler.count++];
+    memset(entry, 0, sizeof(CheatProfileEntry));
+    entry->cheatOffset = cheatOffset;
+    return &entry->counters;
+}
+
+static void Cheat_ResetProfile(void)
+{
+    bool enabled = cheatProfiler.enabled;
+    memset(&cheatProfiler, 0, sizeof(CheatProfiler));
+    cheatProfiler.enabled = enabled;
+    cheatProfiler.curOpcode = -1;
+}
+
 static u8 typeEMapping[] = { 4 << 3, 5 << 3, 6 << 3, 7 << 3, 0 << 3, 1 << 3, 2 << 3, 3 << 3 };
 
 static u8 Cheat_GetNextTypeE(const CheatDescription* cheat)
@@ -280,12 +430,15 @@ static u32 Cheat_ApplyCheat(const Handle processHandle, CheatDescription* const
         u32 arg1 = (u32) ((cheat->codes[cheat_state.index]) & 0x00000000FFFFFFFFULL);
         if (arg0 == 0 && arg1 == 0)
         {
+            Cheat_ProfileEndOpcode(false);
             return 0;
         }
         u32 code = ((arg0 >> 28) & 0x0F);
         u32 subcode = ((arg0 >> 24) & 0x0F);
         u32 codeArg = arg0 & 0x0F;
 
+        Cheat_ProfileBeginOpcode(code);
+
         switch (code)
         {
             case 0x0:
@@ -1638,6 +1791,8 @@ static Result Cheat_MapMemoryAndApplyCheat(u32 pid, CheatDescription* const chea
     Handle processHandle;
     Handle debugHandle;
     Result res;
+    u64 startTick = svcGetSystemTick();
+    u32 startSyscalls = cheatProfiler.syscalls;
     res = svcOpenProcess(&processHandle, pid);
     if (R_SUCCEEDED(res))
     {
@@ -1646,6 +1801,7 @@ static Result Cheat_MapMemoryAndApplyCheat(u32 pid, CheatDescription* const chea
         {
             Cheat_EatEvents(debugHandle);
             cheat->valid = Cheat_ApplyCheat(debugHandle, cheat);
+            Cheat_ProfileEndOpcode(!cheat->valid);
 
             svcCloseHandle(debugHandle);
             svcCloseHandle(processHandle);
@@ -1661,219 +1817,297 @@ static Result Cheat_MapMemoryAndApplyCheat(u32 pid, CheatDescription* const chea
     {
         sprintf(failureReason, "Proceso abierto fallo");
     }
+
+    CheatProfileCounters* counters = cheatProfiler.enabled ? Cheat_GetProfileCounters((u8 *)cheat - cheatData) : NULL;
+    if (counters != NULL)
+    {
+        counters->runs++;
+        counters->ticks += svcGetSystemTick() - startTick;
+        counters->syscalls += cheatProfiler.syscalls - startSyscalls;
+        if (R_FAILED(res) || !cheat->valid)
+            counters->failures++;
+    }
     return res;
 }
 
-static CheatDescription* Cheat_AllocCheat()
+static bool CheatStore_Commit(u32 base, u32 *committed, u32 needed, u32 maxSize)
 {
-    CheatDescription* cheat;
-    if (cheatCount == 0)
-    {
-        cheat = (CheatDescription*) cheatBuffer;
-    }
-    else
+    u32 tmp;
+
+    if (needed <= *committed)
+        return true;
+    if (needed > maxSize)
+        return false;
+
+    needed = (needed + 0xFFF) >> 12 << 12; // round-up
+    Result res = svcControlMemoryEx(&tmp, base + *committed, 0, needed - *committed, MEMOP_ALLOC, MEMREGION_SYSTEM | MEMPERM_READWRITE, true);
+    if (R_FAILED(res))
+        return false;
+
+    *committed = needed;
+    return true;
+}
+
+static void *CheatStore_Alloc(u32 size, u32 alignment)
+{
+    u32 offset = (cheatStore.dataUsed + alignment - 1) & ~(alignment - 1);
+    if (!CheatStore_Commit(CHEAT_STORE_DATA_ADDR, &cheatStore.dataCommitted, offset + size, CHEAT_STORE_DATA_SIZE))
+        return NULL;
+
+    cheatStore.dataUsed = offset + size;
+    return cheatData + offset;
+}
+
+static void CheatStore_Reset(void)
+{
+    u32 tmp;
+
+    if (cheatStore.indexCommitted != 0)
+        svcControlMemory(&tmp, CHEAT_STORE_ADDR, 0, cheatStore.indexCommitted, MEMOP_FREE, 0);
+    if (cheatStore.dataCommitted != 0)
+        svcControlMemory(&tmp, CHEAT_STORE_DATA_ADDR, 0, cheatStore.dataCommitted, MEMOP_FREE, 0);
+
+    memset(&cheatStore, 0, sizeof(cheatStore));
+    cheatStore.dataUsed = 8; // offset 0 is reserved as the "no name" sentinel
+
+    Cheat_ResetProfile();
+}
+
+static inline CheatDescription *Cheat_Get(u32 idx)
+{
+    return (CheatDescription *)(cheatData + cheatIndex[idx]);
+}
+
+static inline const char *Cheat_GetName(const CheatDescription *cheat)
+{
+    return cheat->nameOffset != 0 ? ((CheatName *)(cheatData + cheat->nameOffset))->str : "";
+}
+
+static u32 Cheat_InternName(const char *name)
+{
+    u32 len = strnlen(name, CHEAT_NAME_MAX_LEN);
+    u32 hash = 2166136261u; // FNV-1a
+
+    for (u32 i = 0; i < len; i++)
+        hash = (hash ^ (u8)name[i]) * 16777619u;
+
+    u32 *bucket = &cheatStore.nameBuckets[hash % CHEAT_STORE_NAME_BUCKETS];
+    for (u32 off = *bucket; off != 0; off = ((CheatName *)(cheatData + off))->next)
     {
-        CheatDescription* prev = cheats[cheatCount - 1];
-        cheat = (CheatDescription *) ((u8*) (prev) + sizeof(CheatDescription) + sizeof(u64) * (prev->codesCount));
+        const char *str = ((CheatName *)(cheatData + off))->str;
+        if (strncmp(str, name, len) == 0 && str[len] == '\0')
+            return off;
     }
+
+    CheatName *entry = (CheatName *)CheatStore_Alloc(sizeof(CheatName) + len + 1, 4);
+    if (entry == NULL)
+        return 0;
+
+    memcpy(entry->str, name, len);
+    entry->str[len] = '\0';
+    entry->next = *bucket;
+    *bucket = (u8 *)entry - cheatData;
+    return *bucket;
+}
+
+static CheatDescription* Cheat_AllocCheat(const char *name)
+{
+    u32 idxOffset = cheatStore.count * sizeof(u32);
+    if (!CheatStore_Commit(CHEAT_STORE_ADDR, &cheatStore.indexCommitted, idxOffset + sizeof(u32), CHEAT_STORE_INDEX_SIZE))
+        return NULL;
+
+    u32 nameOffset = Cheat_InternName(name);
+    CheatDescription* cheat = (CheatDescription *)CheatStore_Alloc(sizeof(CheatDescription), 8);
+    if (cheat == NULL)
+        return NULL;
+
     cheat->active = 0;
     cheat->valid = 1;
     cheat->codesCount = 0;
     cheat->hasKeyCode = 0;
     cheat->storage1 = 0;
     cheat->storage2 = 0;
-    cheat->name[0] = '\0';
+    cheat->nameOffset = nameOffset;
 
-    cheats[cheatCount] = cheat;
-    cheatCount++;
+    cheatIndex[cheatStore.count++] = (u8 *)cheat - cheatData;
     return cheat;
 }
 
-static void Cheat_AddCode(CheatDescription* cheat, u64 code)
+// Only valid for the last allocated cheat, while it has no codes yet
+static CheatDescription* Cheat_RenameLastCheat(const char *name)
 {
-    if (cheat)
-    {
-        cheat->codes[cheat->codesCount] = code;
-        (cheat->codesCount)++;
-    }
+    cheatStore.dataUsed = cheatIndex[--cheatStore.count];
+    return Cheat_AllocCheat(name);
 }
 
-static Result BufferedFile_Open(BufferedFile* file, FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, u32 flags)
+// Codes are appended in place, so this is only valid for the last allocated cheat
+static bool Cheat_AddCode(CheatDescription* cheat, u64 code)
 {
-    Result res = 0;
-    memset(file->buffer, '\0', sizeof(file->buffer));
-    res = IFile_Open(&file->file, archiveId, archivePath, filePath, flags);
-    if (R_SUCCEEDED(res))
-    {
-        file->curPos = 0;
-        res = IFile_Read(&file->file, &file->maxPos, file->buffer, sizeof(file->buffer));
-    }
-    return res;
+    u64 *dst = (u64 *)CheatStore_Alloc(sizeof(u64), 8);
+    if (dst == NULL)
+        return false;
+
+    *dst = code;
+    cheat->codesCount++;
+    return true;
 }
 
-static Result BufferedFile_Read(BufferedFile* file, u64* totalRead, void* buffer, u32 len)
+static Result CheatFileReader_Fill(CheatFileReader* reader)
 {
-    Result res = 0;
-    if (len == 0)
+    if (reader->start != 0)
     {
-        *totalRead = 0;
-        return 0;
-    }
-    else if (file->curPos + len < file->maxPos)
-    {
-        memcpy(buffer, file->buffer + file->curPos, len);
-        file->curPos += len;
-        *totalRead = len;
-    }
-    else
-    {
-        *totalRead = 0;
-        while(R_SUCCEEDED(res) && file->maxPos != 0 && *totalRead < len)
-        {
-            u32 toRead = file->maxPos - file->curPos < len - *totalRead ? file->maxPos - file->curPos : len - *totalRead;
-            memcpy(buffer + *totalRead, file->buffer + file->curPos, toRead);
-            *totalRead += toRead;
-            file->curPos += toRead;
-            if (file->curPos >= file->maxPos)
-            {
-                res = IFile_Read(&file->file, &file->maxPos, file->buffer, sizeof(file->buffer));
-                file->curPos = 0;
-            }
-        }
+        memmove(cheatFileBuffer, cheatFileBuffer + reader->start, reader->len - reader->start);
+        reader->len -= reader->start;
+        reader->start = 0;
     }
+
+    u64 total = 0;
+    u32 toRead = CHEAT_FILE_BUFFER_SIZE - reader->len;
+    if (reader->end - reader->file.pos < toRead)
+        toRead = (u32)(reader->end - reader->file.pos);
+
+    Result res = IFile_Read(&reader->file, &total, cheatFileBuffer + reader->len, toRead);
+    if (R_FAILED(res) || total == 0)
+        reader->eof = true;
+
+    reader->len += (u32)total;
     return res;
 }
 
-static Result Cheat_ReadLine(BufferedFile* file, char* line, u32 lineSize)
+// Returns the next line, NUL-terminated in place inside the read buffer, or NULL at the end of the file.
+// Lines longer than the buffer are split.
+static char* CheatFileReader_NextLine(CheatFileReader* reader)
 {
-    Result res = 0;
-
-    u32 idx = 0;
-    u64 total = 0;
-    bool lastWasCarriageReturn = false;
-    while (R_SUCCEEDED(res) && idx < lineSize)
+    while (true)
     {
-        res = BufferedFile_Read(file, &total, line + idx, 1);
-        if (total == 0)
+        char* line = cheatFileBuffer + reader->start;
+        char* end = (char *)memchr(line, '\n', reader->len - reader->start);
+
+        if (end == NULL && !reader->eof && (reader->start != 0 || reader->len < CHEAT_FILE_BUFFER_SIZE))
         {
-            line[idx] = '\0';
-            return -1;
+            CheatFileReader_Fill(reader);
+            continue;
         }
-        if (R_SUCCEEDED(res))
+
+        if (end == NULL)
         {
-            if (line[idx] == '\r')
-            {
-                lastWasCarriageReturn = true;
-            }
-            else if (line[idx] == '\n')
-            {
-                if (lastWasCarriageReturn)
-                {
-                    line[--idx] = '\0';
-                    return idx;
-                }
-                else
-                {
-                    line[idx] = '\0';
-                    return idx;
-                }
-            }
-            else if (line[idx] == '\0')
-            {
-                return -1;
-            }
-            else
-            {
-                lastWasCarriageReturn = false;
-            }
-            idx++;
+            if (reader->start == reader->len)
+                return NULL;
+            end = cheatFileBuffer + reader->len;
+            reader->start = reader->len;
+        }
+        else
+        {
+            reader->start = end - cheatFileBuffer + 1;
         }
+
+        *end = '\0';
+        if (end > line && end[-1] == '\r')
+            end[-1] = '\0';
+        return line;
     }
+}
+
+static Result CheatFileReader_Open(CheatFileReader* reader, const char* path, u64 offset, u64 size)
+{
+    Result res = IFile_Open(&reader->file, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, path), FS_OPEN_READ);
+    reader->file.pos = offset;
+    reader->end = size == 0 ? -1ULL : offset + size;
+    reader->start = 0;
+    reader->len = 0;
+    reader->eof = false;
     return res;
 }
 
-static bool Cheat_IsCodeLine(const char *line)
+static Result CheatFileReader_OpenFromDatabase(CheatFileReader* reader, u64 titleId)
 {
-    s32 len = strnlen(line, 1023);
-    if (len != 17)
-    {
-        return false;
-    }
-    if (line[8] != ' ')
-    {
-        return false;
-    }
+    CheatDbHeader* header = (CheatDbHeader *)cheatFileBuffer;
+    CheatDbEntry* entries = (CheatDbEntry *)cheatFileBuffer;
+    u64 total = 0;
+
+    Result res = CheatFileReader_Open(reader, CHEAT_DB_PATH, 0, 0);
+    if (R_FAILED(res))
+        return res;
+
+    res = IFile_Read(&reader->file, &total, header, sizeof(CheatDbHeader));
+    if (R_SUCCEEDED(res) && (total != sizeof(CheatDbHeader) || header->magic != CHEAT_DB_MAGIC || header->version != CHEAT_DB_VERSION))
+        res = -1;
 
-    int i;
-    for (i = 0; i < 8; i++)
+    u32 first = 0, count = 0;
+    if (R_SUCCEEDED(res))
     {
-        char c = line[i];
-        if (!(('0' <= c && c <= '9') || ('A' <= c && c <= 'F') || ('a' <= c && c <= 'f')))
-        {
-            return false;
-        }
+        first = header->bucketStart[CHEAT_DB_BUCKET(titleId)];
+        count = header->bucketStart[CHEAT_DB_BUCKET(titleId) + 1] - first;
+        if (first + count > header->titleCount)
+            res = -1;
     }
 
-    for (i = 9; i < 17; i++)
+    // Buckets are small, but don't assume they fit in the read buffer
+    reader->file.pos = sizeof(CheatDbHeader) + first * sizeof(CheatDbEntry);
+    while (R_SUCCEEDED(res) && count > 0)
     {
-        char c = line[i];
-        if (!(('0' <= c && c <= '9') || ('A' <= c && c <= 'F') || ('a' <= c && c <= 'f')))
+        u32 n = count < CHEAT_FILE_BUFFER_SIZE / sizeof(CheatDbEntry) ? count : CHEAT_FILE_BUFFER_SIZE / sizeof(CheatDbEntry);
+        res = IFile_Read(&reader->file, &total, entries, n * sizeof(CheatDbEntry));
+        if (R_SUCCEEDED(res) && total != n * sizeof(CheatDbEntry))
+            res = -1;
+
+        for (u32 i = 0; R_SUCCEEDED(res) && i < n; i++)
         {
-            return false;
+            if (entries[i].titleId == titleId)
+            {
+                reader->file.pos = entries[i].offset;
+                reader->end = (u64)entries[i].offset + entries[i].size;
+                return 0;
+            }
         }
+        count -= n;
     }
 
-    return true;
+    IFile_Close(&reader->file);
+    return R_FAILED(res) ? res : -1;
 }
 
-static u64 Cheat_GetCode(const char *line)
+static inline s32 Cheat_HexDigit(char c)
 {
-    u64 tmp = 0;
-    int i;
-    for (i = 0; i < 8; i++)
+    if ((u8)(c - '0') <= 9)
+        return c - '0';
+
+    c |= 0x20; // to lowercase
+    if ((u8)(c - 'a') <= 5)
+        return c - 'a' + 10;
+
+    return -1;
+}
+
+// Validates and parses a "XXXXXXXX YYYYYYYY" code line in a single pass
+static bool Cheat_ParseCodeLine(const char* line, u32 lineLen, u64* code)
+{
+    if (lineLen != 17 || line[8] != ' ')
     {
-        char c = line[i];
-        u8 code = 0;
-        if ('0' <= c && c <= '9')
-        {
-            code = c - '0';
-        }
-        if ('A' <= c && c <= 'F')
-        {
-            code = c - 'A' + 10;
-        }
-        if ('a' <= c && c <= 'f')
-        {
-            code = c - 'a' + 10;
-        }
-        tmp <<= 4;
-        tmp |= (code & 0xF);
+        return false;
     }
 
-    for (i = 9; i < 17; i++)
+    u64 tmp = 0;
+    for (u32 i = 0; i < 17; i++)
     {
-        char c = line[i];
-        u8 code = 0;
-        if ('0' <= c && c <= '9')
-        {
-            code = c - '0';
-        }
-        if ('A' <= c && c <= 'F')
+        if (i == 8)
         {
-            code = c - 'A' + 10;
+            continue;
         }
-        if ('a' <= c && c <= 'f')
+
+        s32 digit = Cheat_HexDigit(line[i]);
+        if (digit < 0)
         {
-            code = c - 'a' + 10;
+            return false;
         }
-        tmp <<= 4;
-        tmp |= (code & 0xF);
+        tmp = (tmp << 4) | (u32)digit;
     }
 
-    return tmp;
+    *code = tmp;
+    return true;
 }
 
-static char* stripWhitespace(char* in)
+static char* stripWhitespace(char* in, u32* outLen)
 {
     char* ret = in;
     while (*ret == ' ' || *ret == '\t')
@@ -1886,87 +2120,84 @@ static char* stripWhitespace(char* in)
         back--;
     }
     ret[back+1] = '\0';
+    *outLen = back + 1;
     return ret;
 }
 
 static void Cheat_LoadCheatsIntoMemory(u64 titleId)
 {
-    cheatCount = 0;
+    CheatStore_Reset();
     cheatTitleInfo = titleId;
 
     char path[64] = { 0 };
     sprintf(path, "/luma/titles/%016llX/cheats.txt", titleId);
 
-    BufferedFile file;
+    CheatFileReader reader;
 
-    if (R_FAILED(BufferedFile_Open(&file, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, path), FS_OPEN_READ)))
+    if (R_FAILED(CheatFileReader_Open(&reader, path, 0, 0)))
     {
         // OK, let's try another source
         sprintf(path, "/cheats/%016llX.txt", titleId);
-        if (R_FAILED(BufferedFile_Open(&file, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, path), FS_OPEN_READ))) return;
-    };
+        if (R_FAILED(CheatFileReader_Open(&reader, path, 0, 0)))
+        {
+            // And finally the packed cheat database
+            if (R_FAILED(CheatFileReader_OpenFromDatabase(&reader, titleId))) return;
+        }
+    }
 
-    char line[1024] = { 0 };
-    Result res = 0;
+    char* line;
     CheatDescription* cheat = 0;
-    u32 cheatSize = 0;
-    do
+    while ((line = CheatFileReader_NextLine(&reader)) != NULL)
     {
-        res = Cheat_ReadLine(&file, line, 1024);
-        // -1 is special; it can't be a normal result because of how results are constructed
-        // So let's just use it as a signal that this is the final line of a file
-        if (R_SUCCEEDED(res) || res == -1)
+        u32 lineLen;
+        char* strippedLine = stripWhitespace(line, &lineLen);
+        if (!lineLen)
         {
-            char* strippedLine = stripWhitespace(line);
-            s32 lineLen = strnlen(strippedLine, 1023);
-            if (!lineLen)
-            {
-                continue;
-            }
-            if (strippedLine[0] == '#')
-            {
-                continue;
-            }
-            if (Cheat_IsCodeLine(strippedLine))
+            continue;
+        }
+        if (strippedLine[0] == '#')
+        {
+            continue;
+        }
+
+        u64 tmp;
+        if (Cheat_ParseCodeLine(strippedLine, lineLen, &tmp))
+        {
+            if (cheat)
             {
-                if (cheatSize + sizeof(u64) >= sizeof(cheatBuffer))
+                if (!Cheat_AddCode(cheat, tmp))
                 {
-                    cheatCount--;
+                    cheatStore.count--;
                     break;
                 }
-                if (cheat)
+                if (((tmp >> 32) & 0xFFFFFFFF) == 0xDD000000)
                 {
-                    u64 tmp = Cheat_GetCode(strippedLine);
-                    Cheat_AddCode(cheat, tmp);
-                    cheatSize += sizeof(u64);
-                    if (((tmp >> 32) & 0xFFFFFFFF) == 0xDD000000)
-                    {
-                        cheat->hasKeyCode = 1;
-                    }
+                    cheat->hasKeyCode = 1;
                 }
             }
+        }
+        else
+        {
+            if (!cheat || cheat->codesCount > 0)
+            {
+                cheat = Cheat_AllocCheat(line);
+            }
             else
             {
-                if (!cheat || cheat->codesCount > 0)
-                {
-                    if (cheatSize + sizeof(CheatDescription) >= sizeof(cheatBuffer))
-                    {
-                        break;
-                    }
-                    cheat = Cheat_AllocCheat();
-                    cheatSize += sizeof(CheatDescription);
-                }
-                strncpy(cheat->name, line, 38);
-                cheat->name[38] = '\0';
+                cheat = Cheat_RenameLastCheat(line);
+            }
+            if (!cheat)
+            {
+                break;
             }
         }
-    } while (R_SUCCEEDED(res) && cheatSize < sizeof(cheatBuffer));
+    }
 
-    IFile_Close(&file.file);
+    IFile_Close(&reader.file);
 
-    if ((cheatCount > 0) && (cheats[cheatCount - 1]->codesCount == 0))
+    if ((cheatStore.count > 0) && (Cheat_Get(cheatStore.count - 1)->codesCount == 0))
     {
-        cheatCount--; // Remove last empty cheat
+        cheatStore.count--; // Remove last empty cheat
     }
 
     memset(cheatPage, 0, 0x1000);
@@ -1994,7 +2225,7 @@ void Cheat_SeedRng(u64 seed)
 
 void Cheat_ApplyCheats(void)
 {
-    if (!cheatCount)
+    if (!cheatStore.count)
     {
         return;
     }
@@ -2004,23 +2235,192 @@ void Cheat_ApplyCheats(void)
 
     if (!titleId)
     {
-        cheatCount = 0;
+        CheatStore_Reset();
         return;
     }
 
     if (titleId != cheatTitleInfo)
     {
-        cheatCount = 0;
+        CheatStore_Reset();
         return;
     }
 
-    for (int i = 0; i < cheatCount; i++)
+    for (u32 i = 0; i < cheatStore.count; i++)
+    {
+        CheatDescription* cheat = Cheat_Get(i);
+        if (cheat->active)
+        {
+            Cheat_MapMemoryAndApplyCheat(pid, cheat);
+        }
+    }
+}
+
+static inline u32 Cheat_TicksToMicroseconds(u64 ticks)
+{
+    return (u32)(ticks * 1000000ULL / SYSCLOCK_ARM11);
+}
+
+static Result Cheat_ExportProfile(u64 titleId)
+{
+    IFile file;
+    u64 total;
+    u32 n = 0;
+    Result res = IFile_Open(&file, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, CHEAT_PROFILE_CSV_PATH), FS_OPEN_CREATE | FS_OPEN_WRITE);
+    if (R_FAILED(res))
+        return res;
+
+    res = IFile_SetSize(&file, 0);
+
+    // The read buffer is free at this point, lines are flushed to the file when it fills up
+    n += sprintf(cheatFileBuffer + n, "titleId,kind,id,name,runs,ticks,us,syscalls,failures\n");
+    for (u32 i = 0; R_SUCCEEDED(res) && i < cheatProfiler.count + CHEAT_PROFILE_OPCODE_COUNT; i++)
     {
-        if (cheats[i]->active)
+        const CheatProfileCounters* counters;
+        if (i < cheatProfiler.count)
+        {
+            const CheatDescription* cheat = (const CheatDescription *)(cheatData + cheatProfiler.cheats[i].cheatOffset);
+            char name[CHEAT_NAME_MAX_LEN + 1];
+            strcpy(name, Cheat_GetName(cheat));
+            for (char* c = name; *c != '\0'; c++)
+            {
+                if (*c == '"')
+                    *c = '\'';
+            }
+
+            counters = &cheatProfiler.cheats[i].counters;
+            n += sprintf(cheatFileBuffer + n, "%016llX,cheat,%lu,\"%s\",", titleId, i, name);
+        }
+        else
+        {
+            counters = &cheatProfiler.opcodes[i - cheatProfiler.count];
+            if (counters->runs == 0)
+                continue;
+            n += sprintf(cheatFileBuffer + n, "%016llX,opcode,%lX,,", titleId, i - cheatProfiler.count);
+        }
+
+        n += sprintf(cheatFileBuffer + n, "%lu,%llu,%lu,%lu,%lu\n", counters->runs, counters->ticks,
+                     Cheat_TicksToMicroseconds(counters->ticks), counters->syscalls, counters->failures);
+
+        if (n >= CHEAT_FILE_BUFFER_SIZE - 256)
         {
-            Cheat_MapMemoryAndApplyCheat(pid, cheats[i]);
-        } 
+            res = IFile_Write(&file, &total, cheatFileBuffer, n, 0);
+            n = 0;
+        }
     }
+
+    if (cheatProfiler.others.runs != 0)
+    {
+        const CheatProfileCounters* counters = &cheatProfiler.others;
+        n += sprintf(cheatFileBuffer + n, "%016llX,cheat,others,\"(cheats beyond the first %lu)\",", titleId, (u32)CHEAT_PROFILE_MAX_ENTRIES);
+        n += sprintf(cheatFileBuffer + n, "%lu,%llu,%lu,%lu,%lu\n", counters->runs, counters->ticks,
+                     Cheat_TicksToMicroseconds(counters->ticks), counters->syscalls, counters->failures);
+    }
+
+    if (R_SUCCEEDED(res) && n > 0)
+        res = IFile_Write(&file, &total, cheatFileBuffer, n, 0);
+
+    IFile_Close(&file);
+    return res;
+}
+
+static void Cheat_ShowProfile(u64 titleId)
+{
+    #define PROFILE_ROWS 14
+
+    bool showOpcodes = false;
+    Result exportRes = 1; // nothing exported yet
+
+    Draw_Lock();
+    Draw_ClearFramebuffer();
+    Draw_FlushFramebuffer();
+    Draw_Unlock();
+
+    do
+    {
+        Draw_Lock();
+        Draw_DrawString(10, 10, COLOR_TITLE, "Perfil de trucos");
+        Draw_DrawFormattedString(10, 30, COLOR_WHITE, "Perfilado: %-12s  A: cambiar, Y: reiniciar", cheatProfiler.enabled ? "activado" : "desactivado");
+        Draw_DrawFormattedString(10, 30 + SPACING_Y, COLOR_WHITE, "%-30s  X: exportar CSV", showOpcodes ? "Por tipo de codigo (<, >)" : "Por truco (<, >)");
+        u32 posY = 30 + 3 * SPACING_Y;
+        posY = Draw_DrawFormattedString(10, posY, COLOR_TITLE, "%-22s %6s %8s %6s %5s", showOpcodes ? "Tipo" : "Truco", "Ejec", "us/ejec", "SVCs", "Fallo") + SPACING_Y;
+
+        u32 rows = 0;
+        if (showOpcodes)
+        {
+            for (u32 i = 0; i < CHEAT_PROFILE_OPCODE_COUNT && rows < PROFILE_ROWS; i++)
+            {
+                const CheatProfileCounters* counters = &cheatProfiler.opcodes[i];
+                if (counters->runs == 0)
+                    continue;
+                posY = Draw_DrawFormattedString(10, posY, COLOR_WHITE, "%X%-21s %6lu %8lu %6lu %5lu", i, "", counters->runs,
+                                                Cheat_TicksToMicroseconds(counters->ticks / counters->runs), counters->syscalls, counters->failures) + SPACING_Y;
+                rows++;
+            }
+        }
+        else
+        {
+            // Most expensive cheats first, the last row is kept for the cheats that weren't profiled individually
+            const CheatProfileCounters* others = &cheatProfiler.others;
+            u32 maxRows = others->runs != 0 ? PROFILE_ROWS - 1 : PROFILE_ROWS;
+            bool shown[CHEAT_PROFILE_MAX_ENTRIES] = { false };
+            for (; rows < maxRows && rows < cheatProfiler.count; rows++)
+            {
+                u32 best = CHEAT_PROFILE_MAX_ENTRIES;
+                for (u32 i = 0; i < cheatProfiler.count; i++)
+                {
+                    if (!shown[i] && (best == CHEAT_PROFILE_MAX_ENTRIES || cheatProfiler.cheats[i].counters.ticks > cheatProfiler.cheats[best].counters.ticks))
+                        best = i;
+                }
+                shown[best] = true;
+
+                const CheatProfileCounters* counters = &cheatProfiler.cheats[best].counters;
+                const CheatDescription* cheat = (const CheatDescription *)(cheatData + cheatProfiler.cheats[best].cheatOffset);
+                char name[23];
+                strncpy(name, Cheat_GetName(cheat), 22);
+                name[22] = '\0';
+                posY = Draw_DrawFormattedString(10, posY, cheat->valid ? COLOR_WHITE : COLOR_RED, "%-22s %6lu %8lu %6lu %5lu", name, counters->runs,
+                                                Cheat_TicksToMicroseconds(counters->runs != 0 ? counters->ticks / counters->runs : 0), counters->syscalls, counters->failures) + SPACING_Y;
+            }
+
+            if (others->runs != 0)
+            {
+                posY = Draw_DrawFormattedString(10, posY, COLOR_RED, "%-22s %6lu %8lu %6lu %5lu", "(otros trucos)", others->runs,
+                                                Cheat_TicksToMicroseconds(others->ticks / others->runs), others->syscalls, others->failures) + SPACING_Y;
+                rows++;
+            }
+        }
+
+        for (; rows < PROFILE_ROWS; rows++)
+            posY = Draw_DrawFormattedString(10, posY, COLOR_WHITE, "%50s", "") + SPACING_Y;
+
+        if (exportRes == 0)
+            Draw_DrawString(10, posY, COLOR_GREEN, "Exportado a " CHEAT_PROFILE_CSV_PATH "     ");
+        else if (R_FAILED(exportRes))
+            Draw_DrawFormattedString(10, posY, COLOR_RED, "Error al exportar: %08lx          ", exportRes);
+
+        Draw_FlushFramebuffer();
+        Draw_Unlock();
+
+        u32 pressed = waitInputWithTimeout(1000);
+
+        if (pressed & KEY_B)
+            break;
+        else if (pressed & KEY_A)
+            cheatProfiler.enabled = !cheatProfiler.enabled;
+        else if (pressed & KEY_Y)
+            Cheat_ResetProfile();
+        else if (pressed & KEY_X)
+            exportRes = Cheat_ExportProfile(titleId);
+        else if (pressed & (KEY_LEFT | KEY_RIGHT))
+        {
+            showOpcodes = !showOpcodes;
+            Draw_Lock();
+            Draw_ClearFramebuffer();
+            Draw_Unlock();
+        }
+    } while (!menuShouldExit);
+
+    #undef PROFILE_ROWS
 }
 
 void RosalinaMenu_Cheats(void)
@@ -2030,7 +2430,7 @@ void RosalinaMenu_Cheats(void)
 
     if (titleId != 0)
     {
-        if (cheatTitleInfo != titleId || cheatCount == 0)
+        if (cheatTitleInfo != titleId || cheatStore.count == 0)
         {
             Cheat_LoadCheatsIntoMemory(titleId);
         }
@@ -2041,7 +2441,7 @@ void RosalinaMenu_Cheats(void)
     Draw_FlushFramebuffer();
     Draw_Unlock();
 
-    if (titleId == 0 || cheatCount == 0)
+    if (titleId == 0 || cheatStore.count == 0)
     {
         do
         {
@@ -2063,6 +2463,7 @@ void RosalinaMenu_Cheats(void)
     else
     {
         s32 selected = 0, page = 0, pagePrev = 0;
+        s32 cheatCount = (s32)cheatStore.count;
 
         Result r = 0;
         do
@@ -2074,17 +2475,18 @@ void RosalinaMenu_Cheats(void)
             }
             if (R_SUCCEEDED(r))
             {
-                Draw_DrawFormattedString(10, 10, COLOR_TITLE, "Lista de trucos");
+                Draw_DrawFormattedString(10, 10, COLOR_TITLE, "Lista de trucos (Y: perfil)");
 
                 for (s32 i = 0; i < CHEATS_PER_MENU_PAGE && page * CHEATS_PER_MENU_PAGE + i < cheatCount; i++)
                 {
                     char buf[65] = { 0 };
                     s32 j = page * CHEATS_PER_MENU_PAGE + i;
-                    const char * checkbox = (cheats[j]->active ? "(x) " : "( ) ");
-                    const char * keyAct = (cheats[j]->hasKeyCode ? "*" : " ");
-                    sprintf(buf, "%s%s%s", checkbox, keyAct, cheats[j]->name);
+                    CheatDescription* cheat = Cheat_Get(j);
+                    const char * checkbox = (cheat->active ? "(x) " : "( ) ");
+                    const char * keyAct = (cheat->hasKeyCode ? "*" : " ");
+                    sprintf(buf, "%s%s%s", checkbox, keyAct, Cheat_GetName(cheat));
 
-                    Draw_DrawString(30, 30 + i * SPACING_Y, cheats[j]->valid ? COLOR_WHITE : COLOR_RED, buf);
+                    Draw_DrawString(30, 30 + i * SPACING_Y, cheat->valid ? COLOR_WHITE : COLOR_RED, buf);
                     Draw_DrawCharacter(10, 30 + i * SPACING_Y, COLOR_TITLE, j == selected ? '>' : ' ');
                 }
             }
@@ -2109,15 +2511,23 @@ void RosalinaMenu_Cheats(void)
                 break;
             else if ((pressed & KEY_A) && R_SUCCEEDED(r))
             {
-                if (cheats[selected]->active)
+                CheatDescription* cheat = Cheat_Get(selected);
+                if (cheat->active)
                 {
-                    cheats[selected]->active = 0;
+                    cheat->active = 0;
                 }
                 else
                 {
-                    r = Cheat_MapMemoryAndApplyCheat(pid, cheats[selected]);
+                    r = Cheat_MapMemoryAndApplyCheat(pid, cheat);
                 }
             }
+            else if ((pressed & KEY_Y) && R_SUCCEEDED(r))
+            {
+                Cheat_ShowProfile(titleId);
+                Draw_Lock();
+                Draw_ClearFramebuffer();
+                Draw_Unlock();
+            }
             else if (pressed & KEY_DOWN)
                 selected++;
             else if (pressed & KEY_UP)
@@ -34,6 +34,7 @@
 #include "utils.h"
 #include "fmt.h"
 #include "ifile.h"
+#include "lz.h"
 #include "gdb/server.h"
 #include "minisoc.h"
 #include <arpa/inet.h>
@@ -102,27 +103,15 @@ static inline int ProcessListMenu_FormatInfoLine(char *out, const ProcessInfo *i
     return sprintf(out, "%s%-4lu    %-8.8s    %s", checkbox, info->pid, info->name, commentBuf); // Theoritically PIDs are 32-bit ints, but we'll only justify 4 digits
 }
 
-static void ProcessListMenu_DumpMemory(const char *name, void *start, u32 size)
+static Result ProcessListMenu_OpenDumpFile(IFile *file, const char *name, const char *tag, const char *extension)
 {
-#define TRY(expr) if(R_FAILED(res = (expr))) goto end;
-
-    Draw_Lock();
-    Draw_DrawString(10, 10, COLOR_TITLE, "Dumpeo de memoria");
-    const char * wait_message = "Espere, esto puede tomar un tiempo...";
-    Draw_DrawString(10, 30, COLOR_WHITE, wait_message);
-    Draw_FlushFramebuffer();
-    Draw_Unlock();
-
-    u64 total;
-    IFile file;
-    Result res;
-
     char filename[100] = {0};
 
     FS_Archive archive;
     FS_ArchiveID archiveId;
     s64 out;
     bool isSdMode;
+    Result res;
 
     if(R_FAILED(svcGetSystemInfo(&out, 0x10000, 0x203))) svcBreak(USERBREAK_ASSERT);
     isSdMode = (bool)out;
@@ -184,8 +173,28 @@ static void ProcessListMenu_DumpMemory(const char *name, void *start, u32 size)
     days++;
     month++;
 
-    sprintf(filename, "/luma/dumps/memory/%.8s_0x%.8lx_%.4u-%.2u-%.2uT%.2u-%.2u-%.2u.bin", name, (u32)start, year, month, days, hours, minutes, seconds);
-    TRY(IFile_Open(&file, archiveId, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, filename), FS_OPEN_CREATE | FS_OPEN_WRITE));
+    sprintf(filename, "/luma/dumps/memory/%.8s_%s_%.4u-%.2u-%.2uT%.2u-%.2u-%.2u.%s", name, tag, year, month, days, hours, minutes, seconds, extension);
+    return IFile_Open(file, archiveId, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, filename), FS_OPEN_CREATE | FS_OPEN_WRITE);
+}
+
+static void ProcessListMenu_DumpMemory(const char *name, void *start, u32 size)
+{
+#define TRY(expr) if(R_FAILED(res = (expr))) goto end;
+
+    Draw_Lock();
+    Draw_DrawString(10, 10, COLOR_TITLE, "Dumpeo de memoria");
+    const char * wait_message = "Espere, esto puede tomar un tiempo...";
+    Draw_DrawString(10, 30, COLOR_WHITE, wait_message);
+    Draw_FlushFramebuffer();
+    Draw_Unlock();
+
+    u64 total;
+    IFile file;
+    Result res;
+    char tag[16];
+
+    sprintf(tag, "0x%.8lx", (u32)start);
+    TRY(ProcessListMenu_OpenDumpFile(&file, name, tag, "bin"));
     TRY(IFile_Write(&file, &total, start, size, 0));
     TRY(IFile_Close(&file));
 
@@ -215,6 +224,324 @@ end:
 #undef TRY
 }
 
+// A full process dump starts with a header and the index of all the non-free regions of the process (much like the
+// program headers of an ELF core), followed by the contents of each dumped region as PROCESS_DUMP_BLOCK_SIZE blocks.
+// Each block is prefixed by a word: 0 for a block of zeros, PROCESS_DUMP_BLOCK_RAW | size for stored data, otherwise
+// the size of its LZ-compressed data. tools/procdump.py reads, verifies and converts these files.
+#define PROCESS_DUMP_MAGIC              0x504D4452 // "RDMP"
+#define PROCESS_DUMP_VERSION            1
+#define PROCESS_DUMP_CANCELLED          1
+#define PROCESS_DUMP_TRUNCATED          2 // the index was full, the regions above the last indexed one are missing
+
+#define PROCESS_DUMP_BLOCK_SIZE         LZ_MAX_BLOCK_SIZE
+#define PROCESS_DUMP_BLOCK_RAW          0x80000000
+
+#define PROCESS_DUMP_REGION_SKIPPED     1 // unreadable or I/O memory, not dumped
+#define PROCESS_DUMP_REGION_INCOMPLETE  2 // couldn't be mapped entirely, or the dump was cancelled
+
+// Regions are mapped one window at a time, the output is written in large chunks
+#define PROCESS_DUMP_WINDOW_ADDR        0x00100000
+#define PROCESS_DUMP_WINDOW_SIZE        0x00100000
+#define PROCESS_DUMP_BUFFER_ADDR        0x0B000000
+#define PROCESS_DUMP_OUTPUT_SIZE        0x40000
+#define PROCESS_DUMP_INDEX_SIZE         0x2000
+#define PROCESS_DUMP_BUFFER_SIZE        (PROCESS_DUMP_OUTPUT_SIZE + PROCESS_DUMP_BLOCK_SIZE + PROCESS_DUMP_INDEX_SIZE)
+#define PROCESS_DUMP_MAX_REGIONS        (PROCESS_DUMP_INDEX_SIZE / sizeof(ProcessDumpRegion))
+
+typedef struct ProcessDumpHeader
+{
+    u32 magic;
+    u32 version;
+    u32 pid;
+    u32 numRegions;
+    u64 titleId;
+    char name[8];
+    u32 blockSize;
+    u32 flags;
+    u64 dumpedSize; // total size of the dumped region contents
+} ProcessDumpHeader;
+
+typedef struct ProcessDumpRegion
+{
+    u32 address;
+    u32 size;
+    u32 perm;
+    u32 state;
+    u32 flags;
+    u32 dataOffset;
+    u32 dataSize;
+    u32 checksum; // Adler-32 of the dumped contents
+} ProcessDumpRegion;
+
+typedef struct ProcessDumpContext
+{
+    IFile file;
+    u8 *out;
+    u32 outPos;
+    u8 *block;
+    u32 checksum;
+    u64 done, total;
+} ProcessDumpContext;
+
+static u32 ProcessListMenu_Adler32(u32 adler, const u8 *data, u32 len)
+{
+    u32 a = adler & 0xFFFF, b = adler >> 16;
+
+    while(len > 0)
+    {
+        u32 n = len < 5552 ? len : 5552; // largest n such that b can't overflow
+        len -= n;
+        while(n-- > 0)
+        {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+
+    return (b << 16) | a;
+}
+
+static inline u32 ProcessListMenu_Adler32Zeros(u32 adler, u32 len)
+{
+    u32 a = adler & 0xFFFF, b = adler >> 16;
+    b = (u32)((b + (u64)a * len) % 65521);
+    return (b << 16) | a;
+}
+
+static inline bool ProcessListMenu_IsZeroBlock(const u32 *data, u32 size)
+{
+    for(u32 i = 0; i < size / 4; i++)
+    {
+        if(data[i] != 0)
+            return false;
+    }
+
+    return true;
+}
+
+static Result ProcessListMenu_FlushDumpOutput(ProcessDumpContext *ctx)
+{
+    u64 total;
+    Result res = IFile_Write(&ctx->file, &total, ctx->out, ctx->outPos, 0);
+    ctx->outPos = 0;
+    return res;
+}
+
+static Result ProcessListMenu_DumpBlocks(ProcessDumpContext *ctx, const u8 *src, u32 size)
+{
+    Result res = 0;
+
+    for(u32 off = 0; off < size; off += PROCESS_DUMP_BLOCK_SIZE)
+    {
+        u32 blockSize = size - off < PROCESS_DUMP_BLOCK_SIZE ? size - off : PROCESS_DUMP_BLOCK_SIZE;
+        u32 word, len;
+        u8 *dst;
+
+        if(ctx->outPos + 4 + PROCESS_DUMP_BLOCK_SIZE > PROCESS_DUMP_OUTPUT_SIZE && R_FAILED(res = ProcessListMenu_FlushDumpOutput(ctx)))
+            break;
+
+        // The process keeps running: take a snapshot so that the checksum and the compressed data agree
+        memcpy(ctx->block, src + off, blockSize);
+        dst = ctx->out + ctx->outPos;
+
+        if(ProcessListMenu_IsZeroBlock((const u32 *)ctx->block, blockSize))
+        {
+            ctx->checksum = ProcessListMenu_Adler32Zeros(ctx->checksum, blockSize);
+            word = len = 0;
+        }
+        else
+        {
+            ctx->checksum = ProcessListMenu_Adler32(ctx->checksum, ctx->block, blockSize);
+            len = LZ_Compress(dst + 4, blockSize - 1, ctx->block, blockSize);
+            word = len;
+            if(len == 0)
+            {
+                memcpy(dst + 4, ctx->block, blockSize);
+                len = blockSize;
+                word = PROCESS_DUMP_BLOCK_RAW | blockSize;
+            }
+        }
+
+        memcpy(dst, &word, 4);
+        ctx->outPos += 4 + len;
+    }
+
+    return res;
+}
+
+static void ProcessListMenu_DumpProcess(const ProcessInfo *info)
+{
+#define TRY(expr) if(R_FAILED(res = (expr))) goto end;
+
+    ProcessDumpContext ctx = {0};
+    ProcessDumpHeader header = {0};
+    ProcessDumpRegion *regions = NULL;
+    Handle processHandle = 0;
+    u32 bufferAddr = 0, numRegions = 0, tmp;
+    u32 truncatedAddr = 0; // first region that didn't fit in the index
+    bool cancelled = false, truncated = false;
+    u64 total, fileSize = 0;
+    char tag[16];
+    Result res;
+
+    Draw_Lock();
+    Draw_ClearFramebuffer();
+    Draw_DrawString(10, 10, COLOR_TITLE, "Volcado del proceso");
+    Draw_DrawString(10, 30, COLOR_WHITE, "Espere, esto puede tomar un tiempo...");
+    Draw_DrawString(10, 30 + SPACING_Y, COLOR_WHITE, "Pulsa B para cancelar.");
+    Draw_FlushFramebuffer();
+    Draw_Unlock();
+
+    TRY(svcOpenProcess(&processHandle, info->pid));
+    TRY(svcControlMemoryEx(&tmp, PROCESS_DUMP_BUFFER_ADDR, 0, PROCESS_DUMP_BUFFER_SIZE, MEMOP_ALLOC, MEMREGION_SYSTEM | MEMPERM_READWRITE, true));
+    bufferAddr = PROCESS_DUMP_BUFFER_ADDR;
+    ctx.out = (u8 *)bufferAddr;
+    ctx.block = ctx.out + PROCESS_DUMP_OUTPUT_SIZE;
+    regions = (ProcessDumpRegion *)(ctx.block + PROCESS_DUMP_BLOCK_SIZE);
+
+    // Build the whole index first: it is written before the data, and gives the total for the progress display
+    for(u32 addr = 0; addr < 0x40000000;)
+    {
+        MemInfo mem;
+        PageInfo page;
+
+        if(R_FAILED(svcQueryProcessMemory(&mem, &page, processHandle, addr)) || mem.base_addr + mem.size <= addr)
+            break;
+
+        if(mem.state != MEMSTATE_FREE)
+        {
+            if(numRegions == PROCESS_DUMP_MAX_REGIONS)
+            {
+                truncated = true;
+                truncatedAddr = mem.base_addr;
+                break;
+            }
+
+            ProcessDumpRegion *region = &regions[numRegions++];
+
+            memset(region, 0, sizeof(ProcessDumpRegion));
+            region->address = mem.base_addr;
+            region->size = mem.size;
+            region->perm = mem.perm;
+            region->state = mem.state;
+
+            if(!(mem.perm & MEMPERM_READ) || mem.state == MEMSTATE_IO || mem.state == MEMSTATE_RESERVED)
+                region->flags = PROCESS_DUMP_REGION_SKIPPED;
+            else
+                ctx.total += mem.size;
+        }
+
+        addr = mem.base_addr + mem.size;
+    }
+
+    header.magic = PROCESS_DUMP_MAGIC;
+    header.version = PROCESS_DUMP_VERSION;
+    header.pid = info->pid;
+    header.numRegions = numRegions;
+    header.titleId = info->titleId;
+    memcpy(header.name, info->name, 8);
+    header.blockSize = PROCESS_DUMP_BLOCK_SIZE;
+
+    sprintf(tag, "pid%lu", info->pid);
+    TRY(ProcessListMenu_OpenDumpFile(&ctx.file, info->name, tag, "dmp"));
+    TRY(IFile_Write(&ctx.file, &total, &header, sizeof(ProcessDumpHeader), 0));
+    TRY(IFile_Write(&ctx.file, &total, regions, numRegions * sizeof(ProcessDumpRegion), 0));
+
+    for(u32 i = 0; i < numRegions && R_SUCCEEDED(res); i++)
+    {
+        ProcessDumpRegion *region = &regions[i];
+        u64 start = ctx.file.pos + ctx.outPos;
+
+        region->dataOffset = (u32)start;
+        if(region->flags & PROCESS_DUMP_REGION_SKIPPED)
+            continue;
+
+        ctx.checksum = 1;
+        for(u32 off = 0; off < region->size; off += PROCESS_DUMP_WINDOW_SIZE)
+        {
+            u32 windowSize = region->size - off < PROCESS_DUMP_WINDOW_SIZE ? region->size - off : PROCESS_DUMP_WINDOW_SIZE;
+
+            if(cancelled || R_FAILED(svcMapProcessMemoryEx(CUR_PROCESS_HANDLE, PROCESS_DUMP_WINDOW_ADDR, processHandle, region->address + off, windowSize)))
+            {
+                region->flags |= PROCESS_DUMP_REGION_INCOMPLETE;
+                break;
+            }
+
+            res = ProcessListMenu_DumpBlocks(&ctx, (const u8 *)PROCESS_DUMP_WINDOW_ADDR, windowSize);
+            svcUnmapProcessMemoryEx(CUR_PROCESS_HANDLE, PROCESS_DUMP_WINDOW_ADDR, windowSize);
+            if(R_FAILED(res))
+                break;
+
+            ctx.done += windowSize;
+            header.dumpedSize += windowSize;
+
+            Draw_Lock();
+            Draw_DrawFormattedString(10, 30 + 3 * SPACING_Y, COLOR_WHITE, "Region %lu/%lu: 0x%08lx        ", i + 1, numRegions, region->address);
+            Draw_DrawFormattedString(10, 30 + 4 * SPACING_Y, COLOR_WHITE, "%lu/%lu KiB (%lu%%)        ",
+                (u32)(ctx.done >> 10), (u32)(ctx.total >> 10), (u32)(100 * ctx.done / ctx.total));
+            Draw_FlushDirtyFramebuffer();
+            Draw_Unlock();
+
+            cancelled = (waitInputWithTimeout(1) & KEY_B) != 0;
+        }
+
+        region->dataSize = (u32)(ctx.file.pos + ctx.outPos - start);
+        region->checksum = ctx.checksum;
+    }
+
+    TRY(res);
+    TRY(ProcessListMenu_FlushDumpOutput(&ctx));
+    fileSize = ctx.file.pos;
+
+    // Now that the data offsets and checksums are known, write the header and index again
+    header.flags = (cancelled ? PROCESS_DUMP_CANCELLED : 0) | (truncated ? PROCESS_DUMP_TRUNCATED : 0);
+    ctx.file.pos = 0;
+    TRY(IFile_Write(&ctx.file, &total, &header, sizeof(ProcessDumpHeader), 0));
+    TRY(IFile_Write(&ctx.file, &total, regions, numRegions * sizeof(ProcessDumpRegion), 0));
+    TRY(IFile_Close(&ctx.file));
+
+end:
+    IFile_Close(&ctx.file);
+    if(bufferAddr != 0)
+        svcControlMemory(&tmp, bufferAddr, 0, PROCESS_DUMP_BUFFER_SIZE, MEMOP_FREE, 0);
+    if(processHandle != 0)
+        svcCloseHandle(processHandle);
+
+    Draw_Lock();
+    Draw_ClearFramebuffer();
+    Draw_Unlock();
+
+    do
+    {
+        Draw_Lock();
+        Draw_DrawString(10, 10, COLOR_TITLE, "Volcado del proceso");
+        if(R_FAILED(res))
+            Draw_DrawFormattedString(10, 30, COLOR_WHITE, "Operacion fallida (0x%.8lx).", res);
+        else
+        {
+            Draw_DrawString(10, 30, COLOR_WHITE, cancelled ? "Operacion cancelada." : "Operacion exitosa.");
+            Draw_DrawFormattedString(10, 30 + SPACING_Y, COLOR_WHITE, "%lu regiones, %lu KiB volcados.", numRegions, (u32)(header.dumpedSize >> 10));
+            Draw_DrawFormattedString(10, 30 + 2 * SPACING_Y, COLOR_WHITE, "Tamano del archivo: %lu KiB.", (u32)(fileSize >> 10));
+            if(truncated)
+                Draw_DrawFormattedString(10, 30 + 3 * SPACING_Y, COLOR_RED, "Indice lleno: faltan las regiones desde 0x%08lx.", truncatedAddr);
+        }
+        Draw_DrawString(10, 30 + 5 * SPACING_Y, COLOR_WHITE, "Pulsa B para volver.");
+
+        Draw_FlushFramebuffer();
+        Draw_Unlock();
+    }
+    while(!(waitInput() & KEY_B) && !menuShouldExit);
+
+    Draw_Lock();
+    Draw_ClearFramebuffer();
+    Draw_FlushFramebuffer();
+    Draw_Unlock();
+
+#undef TRY
+}
+
 static void ProcessListMenu_MemoryViewer(const ProcessInfo *info)
 {
     Handle processHandle;
@@ -638,7 +965,7 @@ static inline void ProcessListMenu_HandleSelected(const ProcessInfo *info)
         if((ctx->flags & GDB_FLAG_USED) && (ctx->flags & GDB_FLAG_SELECTED))
         {
             RecursiveLock_Lock(&ctx->lock);
-            ctx->super.should_close = true;
+            server_request_close(&ctx->super);
             RecursiveLock_Unlock(&ctx->lock);
 
             while(ctx->super.should_close)
@@ -724,6 +1051,8 @@ void RosalinaMenu_ProcessList(void)
             Draw_DrawCharacter(10, 30 + i * SPACING_Y, COLOR_TITLE, page * PROCESSES_PER_MENU_PAGE + i == selected ? '>' : ' ');
         }
 
+        Draw_DrawString(10, SCREEN_BOT_HEIGHT - 20, COLOR_TITLE, "Y: volcar el proceso completo");
+
         Draw_FlushFramebuffer();
         Draw_Unlock();
 
@@ -746,6 +1075,8 @@ void RosalinaMenu_ProcessList(void)
             break;
         else if(pressed & KEY_A)
             ProcessListMenu_HandleSelected(&infos[selected]);
+        else if(pressed & KEY_Y)
+            ProcessListMenu_DumpProcess(&infos[selected]);
         else if(pressed & KEY_DOWN)
             selected++;
         else if(pressed & KEY_UP)
@@ -44,6 +44,9 @@ typedef union {
 
 ScreenFilter topScreenFilter;
 ScreenFilter bottomScreenFilter;
+ScreenFilterNightMode screenFilterNightMode;
+
+static u64 nightModeNextUpdateTick;
 
 static inline bool ScreenFiltersMenu_IsDefaultSettings(void)
 {
@@ -53,13 +56,65 @@ static inline bool ScreenFiltersMenu_IsDefaultSettings(void)
     return ok1 && ok2;
 }
 
-static inline u8 ScreenFiltersMenu_GetColorLevel(int inLevel, float wp, float a, float b, float g)
+typedef struct ScreenFilterLutCache {
+    bool valid;
+    ScreenFilter filter; // filter the LUT below was computed from
+    u32 lut[256];        // what has been written to the hardware LUT
+} ScreenFilterLutCache;
+
+static ScreenFilterLutCache lutCaches[2]; // top, bottom
+
+// Fixed-point (Q24) tables used to approximate powf: log2(1 + i/256) and 2^(i/256)
+static u32 gammaLog2Table[257];
+static u32 gammaExp2Table[257];
+static bool gammaTablesInitialized;
+
+static void ScreenFiltersMenu_InitGammaTables(void)
+{
+    for (u32 i = 0; i <= 256; i++)
+    {
+        gammaLog2Table[i] = (u32)(log2(1.0 + i / 256.0) * 16777216.0 + 0.5);
+        gammaExp2Table[i] = (u32)(exp2(i / 256.0) * 16777216.0 + 0.5);
+    }
+
+    gammaTablesInitialized = true;
+}
+
+static inline u32 ScreenFiltersMenu_InterpolateGammaTable(const u32 *table, u32 idx, u32 frac, u32 fracBits)
+{
+    return frac == 0 ? table[idx] : table[idx] + (((table[idx + 1] - table[idx]) * frac) >> fracBits);
+}
+
+// x^gamma in Q16 for x in [0, 1], through log2/exp2 tables. Off by at most 1/255 from powf for LUT levels.
+static u32 ScreenFiltersMenu_FastPow(float x, float gamma)
 {
-    float level = inLevel / 255.0f;
-    level = a * wp * level + b;
-    level = powf(CLAMP(level, 0.0f, 1.0f), g);
-    s32 levelInt = (s32)(255.0f * level + 0.5f); // round to nearest integer
-    return levelInt <= 0 ? 0 : levelInt >= 255 ? 255 : (u8)levelInt; // clamp
+    if (!(x > 0.0f))
+        return gamma == 0.0f ? 0x10000 : 0; // powf(0, 0) is 1
+    else if (x >= 1.0f || gamma == 0.0f)
+        return 0x10000;
+    else if (gamma == 1.0f)
+        return (u32)(x * 65536.0f + 0.5f);
+
+    union {
+        float f;
+        u32 u;
+    } bits = { .f = x };
+
+    // log2(x) = exponent + log2(1.mantissa)
+    s32 exponent = (s32)(bits.u >> 23) - 127;
+    u32 mantissa = bits.u & 0x7FFFFF;
+    u32 log2Mantissa = ScreenFiltersMenu_InterpolateGammaTable(gammaLog2Table, mantissa >> 15, mantissa & 0x7FFF, 15);
+
+    // 2^y with y = gamma * log2(x) <= 0. Anything below 2^-24 rounds to 0 anyway.
+    float y = gamma * (exponent + log2Mantissa / 16777216.0f);
+    if (y <= -24.0f)
+        return 0;
+
+    u32 negY = (u32)(-y * 16777216.0f + 0.5f); // Q24
+    u32 shift = negY >> 24;
+    u32 u = 0x1000000 - (negY & 0xFFFFFF); // 2^-negY = 2^(u / 2^24) / 2^(shift + 1)
+    u32 res = ScreenFiltersMenu_InterpolateGammaTable(gammaExp2Table, u >> 16, (u >> 4) & 0xFFF, 12) >> (shift + 1);
+    return (res + 0x80) >> 8;
 }
 
 static u8 ScreenFilterMenu_CalculatePolynomialColorLutComponent(const float coeffs[][3], u32 component, float gamma, u32 dim, int inLevel)
@@ -75,17 +130,15 @@ static u8 ScreenFilterMenu_CalculatePolynomialColorLutComponent(const float coef
         xN *= x;
     }
 
-    level = powf(CLAMP(level, 0.0f, 1.0f), gamma);
-    s32 levelInt = (s32)(255.0f * level + 0.5f); // round up
-    return (u8)CLAMP(levelInt, 0, 255); // clamp again just to be sure
+    u32 levelQ16 = ScreenFiltersMenu_FastPow(CLAMP(level, 0.0f, 1.0f), gamma);
+    u32 levelInt = (255 * levelQ16 + 0x8000) >> 16; // round to nearest integer
+    return (u8)(levelInt >= 255 ? 255 : levelInt);
 }
 
-static void ScreenFilterMenu_WritePolynomialColorLut(bool top, const float coeffs[][3], bool invert, float gamma, u32 dim)
+static void ScreenFilterMenu_CalculatePolynomialColorLut(u32 *lut, const float coeffs[][3], bool invert, float gamma, u32 dim)
 {
-    if (top)
-        GPU_FB_TOP_COL_LUT_INDEX = 0;
-    else
-        GPU_FB_BOTTOM_COL_LUT_INDEX = 0;
+    if (!gammaTablesInitialized)
+        ScreenFiltersMenu_InitGammaTables();
 
     for (int i = 0; i <= 255; i++) {
         Pixel px;
@@ -94,17 +147,61 @@ static void ScreenFilterMenu_WritePolynomialColorLut(bool top, const float coeff
         px.g = ScreenFilterMenu_CalculatePolynomialColorLutComponent(coeffs, 1, gamma, dim, inLevel);
         px.b = ScreenFilterMenu_CalculatePolynomialColorLutComponent(coeffs, 2, gamma, dim, inLevel);
         px.z = 0;
+        lut[i] = px.raw;
+    }
+}
+
+// Only writes the elements that differ from what's cached (the index register auto-increments)
+static void ScreenFilterMenu_WriteColorLut(bool top, const u32 *lut)
+{
+    ScreenFilterLutCache *cache = &lutCaches[top ? 0 : 1];
+    u32 first = 0, last = 255;
+
+    if (cache->valid)
+    {
+        while (first <= 255 && cache->lut[first] == lut[first])
+            first++;
+        if (first > 255)
+            return;
+        while (cache->lut[last] == lut[last])
+            last--;
+    }
+
+    if (top)
+        GPU_FB_TOP_COL_LUT_INDEX = first;
+    else
+        GPU_FB_BOTTOM_COL_LUT_INDEX = first;
 
+    for (u32 i = first; i <= last; i++)
+    {
         if (top)
-            GPU_FB_TOP_COL_LUT_ELEM = px.raw;
+            GPU_FB_TOP_COL_LUT_ELEM = lut[i];
         else
-            GPU_FB_BOTTOM_COL_LUT_ELEM = px.raw;
+            GPU_FB_BOTTOM_COL_LUT_ELEM = lut[i];
     }
+
+    memcpy(cache->lut + first, lut + first, 4 * (last + 1 - first));
+    cache->valid = true;
 }
 
-static void ScreenFiltersMenu_ApplyColorSettings(bool top)
+static inline bool ScreenFiltersMenu_FiltersEqual(const ScreenFilter *a, const ScreenFilter *b)
+{
+    return a->cct == b->cct && a->invert == b->invert && a->gamma == b->gamma &&
+        a->contrast == b->contrast && a->brightness == b->brightness;
+}
+
+// Forces the next LUT writes to be complete, for when the hardware LUTs may have been overwritten (e.g. by GSP)
+static void ScreenFiltersMenu_InvalidateLutCaches(void)
+{
+    lutCaches[0].valid = false;
+    lutCaches[1].valid = false;
+}
+
+void ScreenFiltersMenu_ApplyFilter(bool top, const ScreenFilter *filter)
 {
-    const ScreenFilter *filter = top ? &topScreenFilter : &bottomScreenFilter;
+    ScreenFilterLutCache *cache = &lutCaches[top ? 0 : 1];
+    if (cache->valid && ScreenFiltersMenu_FiltersEqual(&cache->filter, filter))
+        return;
 
     float wp[3];
     colorramp_get_white_point(wp, filter->cct);
@@ -118,13 +215,137 @@ static void ScreenFiltersMenu_ApplyColorSettings(bool top)
         { a * wp[0], a * wp[1], a * wp[2] },    // x^1
     };
 
-    ScreenFilterMenu_WritePolynomialColorLut(top, poly, inv, g, 1);
+    u32 lut[256];
+    ScreenFilterMenu_CalculatePolynomialColorLut(lut, poly, inv, g, 1);
+    ScreenFilterMenu_WriteColorLut(top, lut);
+    cache->filter = *filter;
+}
+
+void ScreenFiltersMenu_InterpolateFilter(ScreenFilter *out, const ScreenFilter *from, const ScreenFilter *to, float t)
+{
+    t = CLAMP(t, 0.0f, 1.0f);
+    out->cct = (u16)(from->cct + (s32)((to->cct - from->cct) * t + (to->cct >= from->cct ? 0.5f : -0.5f)));
+    out->gamma = from->gamma + (to->gamma - from->gamma) * t;
+    out->contrast = from->contrast + (to->contrast - from->contrast) * t;
+    out->brightness = from->brightness + (to->brightness - from->brightness) * t;
+    out->invert = t < 0.5f ? from->invert : to->invert;
+}
+
+static void ScreenFiltersMenu_ApplyColorSettings(bool top)
+{
+    ScreenFiltersMenu_ApplyFilter(top, top ? &topScreenFilter : &bottomScreenFilter);
+}
+
+// Night mode progress (0 = saved filters, 1 = night filters) at a given time of the day, in seconds.
+// Also returns how many seconds it stays that way (1 during transitions).
+static float ScreenFiltersMenu_GetNightModeWeight(const ScreenFilterNightMode *nightMode, u32 timeOfDay, u32 *secondsUntilChange)
+{
+    const u32 secondsPerDay = 24 * 60 * 60;
+    u32 start = 60 * nightMode->startMinutes;
+    u32 nightDuration = 60 * ((24 * 60 + nightMode->endMinutes - nightMode->startMinutes) % (24 * 60));
+    u32 transition = 60 * nightMode->transitionMinutes;
+
+    // Transitions start at the start and end times and can't overlap
+    transition = transition > nightDuration ? nightDuration : transition;
+    transition = transition > secondsPerDay - nightDuration ? secondsPerDay - nightDuration : transition;
+
+    u32 elapsed = (timeOfDay + secondsPerDay - start) % secondsPerDay;
+    if (elapsed < transition)
+    {
+        *secondsUntilChange = 1;
+        return (float)elapsed / transition;
+    }
+    else if (elapsed < nightDuration)
+    {
+        *secondsUntilChange = nightDuration - elapsed;
+        return 1.0f;
+    }
+    else if (elapsed < nightDuration + transition)
+    {
+        *secondsUntilChange = 1;
+        return 1.0f - (float)(elapsed - nightDuration) / transition;
+    }
+    else
+    {
+        *secondsUntilChange = secondsPerDay - elapsed;
+        return 0.0f;
+    }
+}
+
+static void ScreenFiltersMenu_GetNightModeFilter(ScreenFilter *out, const ScreenFilter *filter, float weight)
+{
+    ScreenFilter nightFilter = *filter;
+    nightFilter.cct = screenFilterNightMode.cct;
+    nightFilter.gamma = screenFilterNightMode.gamma;
+    nightFilter.brightness = screenFilterNightMode.brightness;
+
+    ScreenFiltersMenu_InterpolateFilter(out, filter, &nightFilter, weight);
+}
+
+static u32 ScreenFiltersMenu_GetTimeOfDay(void)
+{
+    return (u32)((osGetTime() / 1000) % (24 * 60 * 60));
+}
+
+// Saved filters, with night mode applied
+static void ScreenFiltersMenu_ApplyScheduledColorSettings(void)
+{
+    ScreenFilter top = topScreenFilter, bottom = bottomScreenFilter;
+
+    if (screenFilterNightMode.enabled)
+    {
+        u32 secondsUntilChange;
+        float weight = ScreenFiltersMenu_GetNightModeWeight(&screenFilterNightMode, ScreenFiltersMenu_GetTimeOfDay(), &secondsUntilChange);
+        ScreenFiltersMenu_GetNightModeFilter(&top, &topScreenFilter, weight);
+        ScreenFiltersMenu_GetNightModeFilter(&bottom, &bottomScreenFilter, weight);
+    }
+
+    ScreenFiltersMenu_ApplyFilter(true, &top);
+    ScreenFiltersMenu_ApplyFilter(false, &bottom);
+}
+
+void ScreenFiltersMenu_UpdateNightMode(void)
+{
+    if (!screenFilterNightMode.enabled || svcGetSystemTick() < nightModeNextUpdateTick)
+        return;
+
+    u32 secondsUntilChange;
+    float weight = ScreenFiltersMenu_GetNightModeWeight(&screenFilterNightMode, ScreenFiltersMenu_GetTimeOfDay(), &secondsUntilChange);
+
+    // Still check every minute or so, in case the clock has been changed
+    secondsUntilChange = CLAMP(secondsUntilChange, 1, 60);
+    nightModeNextUpdateTick = svcGetSystemTick() + (u64)SYSCLOCK_ARM11 * secondsUntilChange;
+
+    ScreenFilter top, bottom;
+    ScreenFiltersMenu_GetNightModeFilter(&top, &topScreenFilter, weight);
+    ScreenFiltersMenu_GetNightModeFilter(&bottom, &bottomScreenFilter, weight);
+
+    ScreenFilterLutCache *topCache = &lutCaches[0], *bottomCache = &lutCaches[1];
+    if (topCache->valid && bottomCache->valid &&
+        ScreenFiltersMenu_FiltersEqual(&topCache->filter, &top) && ScreenFiltersMenu_FiltersEqual(&bottomCache->filter, &bottom))
+        return;
+
+    // See ScreenFiltersMenu_RestoreSettings, GPU work must be paused while the LUTs are changed
+    svcKernelSetState(0x10000, 2);
+    svcSleepThread(5 * 1000 * 100LL);
+
+    ScreenFiltersMenu_ApplyFilter(true, &top);
+    ScreenFiltersMenu_ApplyFilter(false, &bottom);
+
+    svcKernelSetState(0x10000, 2);
+    svcSleepThread(5 * 1000 * 100LL);
+}
+
+void ScreenFiltersMenu_RefreshNightMode(void)
+{
+    nightModeNextUpdateTick = 0;
 }
 
 static void ScreenFiltersMenu_SetCct(u16 cct)
 {
     topScreenFilter.cct = cct;
     bottomScreenFilter.cct = cct;
+    ScreenFiltersMenu_InvalidateLutCaches();
     ScreenFiltersMenu_ApplyColorSettings(true);
     ScreenFiltersMenu_ApplyColorSettings(false);
 }
@@ -158,7 +379,7 @@ void ScreenFiltersMenu_RestoreSettings(void)
     // Precondition: menu has not been entered
 
     // Not initialized/default: return
-    if (ScreenFiltersMenu_IsDefaultSettings())
+    if (ScreenFiltersMenu_IsDefaultSettings() && !screenFilterNightMode.enabled)
         return;
 
     // Wait for GSP to restore the CCT table
@@ -170,8 +391,8 @@ void ScreenFiltersMenu_RestoreSettings(void)
     svcKernelSetState(0x10000, 2);
     svcSleepThread(5 * 1000 * 100LL);
 
-    ScreenFiltersMenu_ApplyColorSettings(true);
-    ScreenFiltersMenu_ApplyColorSettings(false);
+    ScreenFiltersMenu_InvalidateLutCaches();
+    ScreenFiltersMenu_ApplyScheduledColorSettings();
 
     // Unpause GSP
     svcKernelSetState(0x10000, 2);
@@ -227,6 +448,39 @@ void ScreenFiltersMenu_LoadConfig(void)
 
     svcGetSystemInfo(&out, 0x10000, 0x10C);
     bottomScreenFilter.invert = (bool)out;
+
+    svcGetSystemInfo(&out, 0x10000, 0x10D);
+    screenFilterNightMode.enabled = (bool)out;
+
+    svcGetSystemInfo(&out, 0x10000, 0x10E);
+    screenFilterNightMode.startMinutes = (u16)out;
+    if (screenFilterNightMode.startMinutes >= 24 * 60)
+        screenFilterNightMode.startMinutes = 21 * 60;
+
+    svcGetSystemInfo(&out, 0x10000, 0x10F);
+    screenFilterNightMode.endMinutes = (u16)out;
+    if (screenFilterNightMode.endMinutes >= 24 * 60)
+        screenFilterNightMode.endMinutes = 7 * 60;
+
+    svcGetSystemInfo(&out, 0x10000, 0x110);
+    screenFilterNightMode.transitionMinutes = (u16)out;
+    if (screenFilterNightMode.transitionMinutes > 12 * 60)
+        screenFilterNightMode.transitionMinutes = 30;
+
+    svcGetSystemInfo(&out, 0x10000, 0x111);
+    screenFilterNightMode.cct = (u16)out;
+    if (screenFilterNightMode.cct < 1000 || screenFilterNightMode.cct > 25100)
+        screenFilterNightMode.cct = 2700;
+
+    svcGetSystemInfo(&out, 0x10000, 0x112);
+    screenFilterNightMode.gamma = (float)(out / FLOAT_CONV_MULT);
+    if (screenFilterNightMode.gamma < 0.0f || screenFilterNightMode.gamma > 1411.0f)
+        screenFilterNightMode.gamma = 1.0f;
+
+    svcGetSystemInfo(&out, 0x10000, 0x113);
+    screenFilterNightMode.brightness = (float)(out / FLOAT_CONV_MULT);
+    if (screenFilterNightMode.brightness < -1.0f || screenFilterNightMode.brightness > 1.0f)
+        screenFilterNightMode.brightness = 0.0f;
 }
 
 DEF_CCT_SETTER(6500, Default)
@@ -325,6 +579,11 @@ void ScreenFiltersMenu_AdvancedConfiguration(void)
 
     bool sync = true;
 
+    // Values are changed incrementally below, make sure we start from what's actually in the LUTs
+    ScreenFiltersMenu_InvalidateLutCaches();
+    ScreenFiltersMenu_ApplyColorSettings(true);
+    ScreenFiltersMenu_ApplyColorSettings(false);
+
     do
     {
         Draw_Lock();
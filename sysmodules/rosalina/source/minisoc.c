@@ -472,6 +472,34 @@ int socClose(int sockfd)
     return 0;
 }
 
+int socShutdown(int sockfd, int how)
+{
+    int ret = 0;
+    u32 *cmdbuf = getThreadCommandBuffer();
+
+    cmdbuf[0] = IPC_MakeHeader(0xC,2,2); // 0xC0082
+    cmdbuf[1] = (u32)sockfd;
+    cmdbuf[2] = (u32)how;
+    cmdbuf[3] = IPC_Desc_CurProcessId();
+
+    ret = svcSendSyncRequest(miniSocHandle);
+    if(ret != 0) {
+        //errno = SYNC_ERROR;
+        return ret;
+    }
+
+    ret = (int)cmdbuf[1];
+    if(ret == 0)
+        ret =_net_convert_error(cmdbuf[2]);
+
+    if(ret < 0) {
+        //errno = -ret;
+        return -1;
+    }
+
+    return 0;
+}
+
 int socSetsockopt(int sockfd, int level, int optname, const void *optval, socklen_t optlen)
 {
     int ret = 0;
@@ -762,3 +790,70 @@ ssize_t socSendto(int sockfd, const void *buf, size_t len, int flags, const stru
         return _socuipc_cmda(sockfd, buf, len, flags, dest_addr, addrlen);
     return _socuipc_cmd9(sockfd, buf, len, flags, dest_addr, addrlen);
 }
+
+ssize_t socSendAll(int sockfd, const void *buf, size_t len, int flags)
+{
+    const u8 *data = (const u8 *)buf;
+    size_t total = 0;
+
+    // Large payloads go through a single mapped-buffer IPC; only loop on partial sends
+    while(total < len)
+    {
+        ssize_t r = socSendto(sockfd, data + total, len - total, flags, NULL, 0);
+        if(r <= 0)
+            return total == 0 ? r : (ssize_t)total;
+        total += r;
+    }
+
+    return total;
+}
+
+static inline ssize_t socPartialSendResult(size_t total, ssize_t r)
+{
+    return total == 0 ? r : (ssize_t)total + (r > 0 ? r : 0);
+}
+
+ssize_t socSendv(int sockfd, const SocBuffer *bufs, u32 nbBufs, int flags)
+{
+    // Small pieces are coalesced so that headers, trailers and the like don't cost one IPC each
+    u8 gatherBuffer[SOC_GATHER_BUF_LEN];
+    size_t gathered = 0, total = 0;
+
+    for(u32 i = 0; i < nbBufs; i++)
+    {
+        const SocBuffer *b = &bufs[i];
+        ssize_t r;
+
+        if(gathered + b->len > sizeof(gatherBuffer) && gathered != 0)
+        {
+            r = socSendAll(sockfd, gatherBuffer, gathered, flags);
+            if(r != (ssize_t)gathered)
+                return socPartialSendResult(total, r);
+            total += gathered;
+            gathered = 0;
+        }
+
+        if(b->len <= sizeof(gatherBuffer))
+        {
+            memcpy(gatherBuffer + gathered, b->data, b->len);
+            gathered += b->len;
+        }
+        else
+        {
+            r = socSendAll(sockfd, b->data, b->len, flags);
+            if(r != (ssize_t)b->len)
+                return socPartialSendResult(total, r);
+            total += b->len;
+        }
+    }
+
+    if(gathered != 0)
+    {
+        ssize_t r = socSendAll(sockfd, gatherBuffer, gathered, flags);
+        if(r != (ssize_t)gathered)
+            return socPartialSendResult(total, r);
+        total += gathered;
+    }
+
+    return total;
+}
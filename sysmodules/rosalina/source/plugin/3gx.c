@@ -12,17 +12,11 @@ static inline u32 invertEndianness(u32 val)
     return ((val & 0xFF) << 24) | ((val & 0xFF00) << 8) | ((val & 0xFF0000) >> 8) | ((val & 0xFF000000) >> 24);
 }
 
-Result  Check_3gx_Magic(IFile *file)
+Result  Check_3gx_Magic(const _3gx_Header *header)
 {
-    u64     magic;
-    u64     total;
-    Result  res;
+    u64     magic = header->magic;
     int     verDif;
 
-    file->pos = 0;
-    if (R_FAILED((res = IFile_Read(file, &total, &magic, sizeof(u64)))))
-        return res;
-
     if ((u32)magic != (u32)_3GX_MAGIC) //Invalid file type
         return MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_LDR, 1);
 
@@ -39,35 +33,44 @@ Result  Read_3gx_Header(IFile *file, _3gx_Header *header)
 
     file->pos = 0;
     res = IFile_Read(file, &total, header, sizeof(_3gx_Header));
+    if (R_SUCCEEDED(res) && total != sizeof(_3gx_Header))
+        res = MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_LDR, 0);
 
     return res;
 }
 
-Result Read_3gx_ParseHeader(IFile *file, _3gx_Header *header)
+Result  Read_3gx_File(IFile *file, void *dst, u32 fileSize)
 {
     u64     total;
-    char *  dst;
     Result  res = 0;
 
-    // Read author
-    file->pos = (u32)header->infos.authorMsg;
-    dst = (char *)header + sizeof(_3gx_Header);
-    res = IFile_Read(file, &total, dst, header->infos.authorLen);
-    if (R_FAILED(res))
-        return res;
+    // Everything else is parsed from memory, in place: this is the only other read
+    file->pos = 0;
+    res = IFile_Read(file, &total, dst, fileSize);
+    if (R_SUCCEEDED(res) && total != fileSize)
+        res = MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_LDR, RD_INVALID_SIZE);
+
+    return res;
+}
 
-    // Relocate ptr
-    header->infos.authorMsg = dst;
+static inline bool  Is_3gx_RangeValid(u32 offset, u32 size, u32 fileSize)
+{
+    return offset <= fileSize && size <= fileSize - offset;
+}
 
-    // Read title
-    file->pos = (u32)header->infos.titleMsg;
-    dst += header->infos.authorLen;
-    res = IFile_Read(file, &total, dst, header->infos.titleLen);
-    if (R_FAILED(res))
-        return res;
+Result Read_3gx_ParseHeader(_3gx_Header *header, u32 fileSize)
+{
+    u8 *    file = (u8 *)header;
 
-    // Relocate ptr
-    header->infos.titleMsg = dst;
+    if (!Is_3gx_RangeValid((u32)header->infos.authorMsg, header->infos.authorLen, fileSize)
+        || !Is_3gx_RangeValid((u32)header->infos.titleMsg, header->infos.titleLen, fileSize)
+        || header->targets.count > fileSize / sizeof(u32)
+        || !Is_3gx_RangeValid((u32)header->targets.titles, header->targets.count * sizeof(u32), fileSize))
+        return MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_LDR, RD_INVALID_ADDRESS);
+
+    // Relocate ptrs
+    header->infos.authorMsg = (const char *)(file + (u32)header->infos.authorMsg);
+    header->infos.titleMsg = (const char *)(file + (u32)header->infos.titleMsg);
 
     // Declare other members as null (unused in our case)
     header->infos.summaryLen = 0;
@@ -75,31 +78,25 @@ Result Read_3gx_ParseHeader(IFile *file, _3gx_Header *header)
     header->infos.descriptionLen = 0;
     header->infos.descriptionMsg = NULL;
 
-    // Read targets compatibility
-    file->pos = (u32)header->targets.titles;
-    dst += header->infos.titleLen;
-    dst += 4 - ((u32)dst & 3); // 4 bytes aligned
-    res = IFile_Read(file, &total, dst, header->targets.count * sizeof(u32));
-    if (R_FAILED(res))
-        return res;
-
-    // Relocate ptr
-    header->targets.titles = (u32 *)dst;
+    // Targets compatibility (the file is loaded at a 4 bytes aligned address, the table is aligned within it)
+    header->targets.titles = (u32 *)(file + (u32)header->targets.titles);
 
-    return res;
+    return 0;
 }
 
-Result  Read_3gx_LoadSegments(IFile *file, _3gx_Header *header, void *dst)
+Result  Read_3gx_LoadSegments(_3gx_Header *header, u32 fileSize, void *dst)
 {
     u32                 size;
-    u64                 total;
     Result              res = 0;
     _3gx_Executable     *exeHdr = &header->executable;
     PluginLoaderContext *ctx = &PluginLoaderCtx;
 
-    file->pos = exeHdr->codeOffset;
     size = exeHdr->codeSize + exeHdr->rodataSize + exeHdr->dataSize;
-    res = IFile_Read(file, &total, dst, size);
+    if (size < exeHdr->codeSize || !Is_3gx_RangeValid(exeHdr->codeOffset, size, fileSize))
+        res = MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_LDR, RD_INVALID_SIZE);
+
+    // The file is at the end of the memory block, it may overlap with the destination if it's big enough
+    if (!res) memmove(dst, (u8 *)header + exeHdr->codeOffset, size);
     
     
     if (!res && !ctx->isExeLoadFunctionset) return MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_LDR, RD_NO_DATA);
@@ -110,28 +107,34 @@ Result  Read_3gx_LoadSegments(IFile *file, _3gx_Header *header, void *dst)
     return res;
 }
 
-Result Read_3gx_EmbeddedPayloads(IFile *file, _3gx_Header *header)
+// Copies the NOP-terminated function at offset, zero-padded if the file ends before 32 instructions
+static void     Read_3gx_Payload(u32 *dst, const _3gx_Header *header, u32 offset, u32 fileSize)
+{
+    u32     size = offset < fileSize ? fileSize - offset : 0;
+
+    size = size < 32 * sizeof(u32) ? size : 32 * sizeof(u32);
+    memset(dst, 0, 32 * sizeof(u32));
+    memcpy(dst, (const u8 *)header + offset, size);
+}
+
+Result Read_3gx_EmbeddedPayloads(_3gx_Header *header, u32 fileSize)
 {
     u32                 tempBuff[32];
     u32                 tempBuff2[4];
-    u64                 total;
     Result              res = 0;
     PluginLoaderContext *ctx = &PluginLoaderCtx;
     
     if (header->infos.embeddedExeLoadFunc) {
-        file->pos = header->executable.exeLoadFuncOffset;
-        res = IFile_Read(file, &total, tempBuff, sizeof(tempBuff));
+        Read_3gx_Payload(tempBuff, header, header->executable.exeLoadFuncOffset, fileSize);
         memcpy(tempBuff2, header->infos.builtInLoadExeArgs, sizeof(tempBuff2));
-        if (!res) res = Set_3gx_LoadParams(tempBuff, tempBuff2);
+        res = Set_3gx_LoadParams(tempBuff, tempBuff2);
         if (!res) ctx->isExeLoadFunctionset = true;
     }
     if (!res && header->infos.embeddedSwapSaveLoadFunc) {
-        file->pos = header->executable.swapSaveFuncOffset;
-        res = IFile_Read(file, &total, tempBuff, sizeof(tempBuff));
+        Read_3gx_Payload(tempBuff, header, header->executable.swapSaveFuncOffset, fileSize);
         memcpy(tempBuff2, header->infos.builtInSwapSaveLoadArgs, sizeof(tempBuff2));
-        if (!res) res = MemoryBlock__SetSwapSettings(tempBuff, false, tempBuff2);
-        file->pos = header->executable.swapLoadFuncOffset;
-        if (!res) res = IFile_Read(file, &total, tempBuff, sizeof(tempBuff));
+        res = MemoryBlock__SetSwapSettings(tempBuff, false, tempBuff2);
+        if (!res) Read_3gx_Payload(tempBuff, header, header->executable.swapLoadFuncOffset, fileSize);
         if (!res) res = MemoryBlock__SetSwapSettings(tempBuff, true, tempBuff2);
         if (!res) ctx->isSwapFunctionset = true;
     }
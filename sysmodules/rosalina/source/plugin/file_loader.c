@@ -14,6 +14,9 @@ static char        g_path[256];
 static const char *g_dirPath = "/luma/plugins/%016llX";
 static const char *g_defaultPath = "/luma/plugins/default.3gx";
 
+#define PLUGIN_INDEX_MAX_ENTRIES    128
+#define PLUGIN_NOT_FOUND_RESULT     MAKERESULT(28, 4, 0, 1018)
+
 // pluginLoader.s
 void        gamePatchFunc(void);
 
@@ -44,8 +47,11 @@ static Result   FindPluginFile(u64 tid)
     if (R_FAILED((res = FSUSER_OpenArchive(&sdmcArchive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, "")))))
         goto exit;
 
-    if (R_FAILED((res = FSUSER_OpenDirectory(&dir, sdmcArchive, fsMakePath(PATH_ASCII, g_path)))))
+    if (R_FAILED(FSUSER_OpenDirectory(&dir, sdmcArchive, fsMakePath(PATH_ASCII, g_path))))
+    {
+        res = PLUGIN_NOT_FOUND_RESULT;
         goto exit;
+    }
 
     strcat(g_path, "/");
     while (!found && R_SUCCEEDED(FSDIR_Read(dir, &entriesNb, 10, entries)))
@@ -84,7 +90,7 @@ static Result   FindPluginFile(u64 tid)
     }
 
     if (!found)
-        res = MAKERESULT(28, 4, 0, 1018);
+        res = PLUGIN_NOT_FOUND_RESULT;
     else
     {
         u32 len = strlen(g_path);
@@ -100,6 +106,35 @@ exit:
     return res;
 }
 
+// Titles known to have no plugin, and whether the default plugin is known to be missing.
+// Only negative results are cached: they stay valid until the next invalidation (menu opened,
+// plugin loader toggled), so plugins copied in the meantime (e.g. over FTP) are picked up then
+typedef struct
+{
+    bool    isValid;
+    bool    hasNoDefaultPlugin;
+    u32     count;
+    u64     titleIds[PLUGIN_INDEX_MAX_ENTRIES];
+}   PluginIndex;
+
+static PluginIndex g_pluginIndex;
+
+void    PluginLoader__InvalidatePluginIndex(void)
+{
+    g_pluginIndex.isValid = false;
+}
+
+static bool     PluginIndexHasNoPlugin(u64 tid)
+{
+    for (u32 i = 0; i < g_pluginIndex.count; ++i)
+    {
+        if (g_pluginIndex.titleIds[i] == tid)
+            return true;
+    }
+
+    return false;
+}
+
 static Result   OpenFile(IFile *file, const char *path)
 {
     return IFile_Open(file, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, path), FS_OPEN_READ);
@@ -107,11 +142,34 @@ static Result   OpenFile(IFile *file, const char *path)
 
 static Result   OpenPluginFile(u64 tid, IFile *plugin)
 {
-    if (R_FAILED(FindPluginFile(tid)) || OpenFile(plugin, g_path))
+    PluginIndex *   index = &g_pluginIndex;
+    Result          res = PLUGIN_NOT_FOUND_RESULT;
+
+    if (!index->isValid)
+    {
+        memset(index, 0, sizeof(PluginIndex));
+        index->isValid = true;
+    }
+
+    if (!PluginIndexHasNoPlugin(tid))
+    {
+        res = FindPluginFile(tid);
+
+        // Titles that don't fit are simply searched every time
+        if (res == PLUGIN_NOT_FOUND_RESULT && index->count < PLUGIN_INDEX_MAX_ENTRIES)
+            index->titleIds[index->count++] = tid;
+    }
+
+    if (R_FAILED(res) || OpenFile(plugin, g_path))
     {
         // Try to open default plugin
-        if (OpenFile(plugin, g_defaultPath))
+        if (index->hasNoDefaultPlugin)
+            return -1;
+        else if (OpenFile(plugin, g_defaultPath))
+        {
+            index->hasNoDefaultPlugin = true;
             return -1;
+        }
 
         PluginLoaderCtx.pluginPath = g_defaultPath;
         PluginLoaderCtx.header.isDefaultPlugin = 1;
@@ -187,7 +245,11 @@ bool     TryToLoadPlugin(Handle process)
     if (R_FAILED((res = IFile_GetSize(&plugin, &fileSize))))
         ctx->error.message = "Couldn't get file size";
 
-    if (!res && R_FAILED(res = Check_3gx_Magic(&plugin)))
+    // Read header, and check its magic
+    if (!res && R_FAILED(res = Read_3gx_Header(&plugin, &fileHeader)))
+        ctx->error.message = "Imposible leer el arch.";
+
+    if (!res && R_FAILED(res = Check_3gx_Magic(&fileHeader)))
     {
         const char * errors[] = 
         {
@@ -200,31 +262,34 @@ bool     TryToLoadPlugin(Handle process)
         ctx->error.message = errors[R_MODULE(res) == RM_LDR ? R_DESCRIPTION(res) : 0];
     }
 
-    // Read header
-    if (!res && R_FAILED((res = Read_3gx_Header(&plugin, &fileHeader))))
-        ctx->error.message = "Imposible leer el arch.";
-
     // Set memory region size according to header
     if (!res && R_FAILED((res = MemoryBlock__SetSize(memRegionSizes[fileHeader.infos.memoryRegionSize])))) {
         ctx->error.message = "Imposible establecer el\ntam. de la memoria.";
     }
+
+    if (!res && fileSize > g_memBlockSize - sizeof(PluginHeader))
+    {
+        res = MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_LDR, RD_TOO_LARGE);
+        ctx->error.message = "Arch. de plugin demasiado grande.";
+    }
     
     // Ensure memory block is mounted
     if (!res && R_FAILED((res = MemoryBlock__IsReady())))
         ctx->error.message = "Error al asignar memoria.";
 
-    // Plugins will not exceed 5MB so this is fine
+    // Read the whole file at the end of the memory block, in a single request
     if (!res) {
-        header = (_3gx_Header *)(ctx->memblock.memblock + g_memBlockSize - (u32)fileSize);
-        memcpy(header, &fileHeader, sizeof(_3gx_Header));
+        header = (_3gx_Header *)((u32)(ctx->memblock.memblock + g_memBlockSize - (u32)fileSize) & ~3);
+        if (R_FAILED((res = Read_3gx_File(&plugin, header, (u32)fileSize))))
+            ctx->error.message = "Imposible leer el arch.";
     }
 
     // Parse rest of header
-    if (!res && R_FAILED((res = Read_3gx_ParseHeader(&plugin, header))))
+    if (!res && R_FAILED((res = Read_3gx_ParseHeader(header, (u32)fileSize))))
         ctx->error.message = "Imposible leer el arch.";
 
     // Read embedded save/load functions
-    if (!res && R_FAILED((res = Read_3gx_EmbeddedPayloads(&plugin, header))))
+    if (!res && R_FAILED((res = Read_3gx_EmbeddedPayloads(header, (u32)fileSize))))
         ctx->error.message = "Payloads para guardar/cargar\nno validos.";
     
     // Save exe checksum
@@ -235,7 +300,7 @@ bool     TryToLoadPlugin(Handle process)
     if (!res) res = CheckPluginCompatibility(header, (u32)tid);
 
     // Read code
-    if (!res && R_FAILED(res = Read_3gx_LoadSegments(&plugin, header, ctx->memblock.memblock + sizeof(PluginHeader)))) {
+    if (!res && R_FAILED(res = Read_3gx_LoadSegments(header, (u32)fileSize, ctx->memblock.memblock + sizeof(PluginHeader)))) {
         if (res == MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_LDR, RD_NO_DATA)) ctx->error.message = "This plugin requires a loading function.";
         else if (res == MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_LDR, RD_INVALID_ADDRESS)) ctx->error.message = "This plugin file is corrupted.";
         else ctx->error.message = "Imposible leer codigo\ndel plugin";
@@ -247,9 +312,10 @@ bool     TryToLoadPlugin(Handle process)
         goto exitFail;
     }
 
-    pluginHeader->version = header->version;
+    // The file image may have been overwritten by the segments, use the copy of the header
+    pluginHeader->version = fileHeader.version;
     // Code size must be page aligned
-    exeHdr = &header->executable;
+    exeHdr = &fileHeader.executable;
     pluginHeader->exeSize = (sizeof(PluginHeader) + exeHdr->codeSize + exeHdr->rodataSize + exeHdr->dataSize + exeHdr->bssSize + 0x1000) & ~0xFFF;
     pluginHeader->heapVA = 0x06000000;
     pluginHeader->heapSize = g_memBlockSize - pluginHeader->exeSize;
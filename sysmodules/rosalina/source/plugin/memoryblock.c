@@ -4,6 +4,7 @@
 #include "plugin.h"
 #include "ifile.h"
 #include "utils.h"
+#include "lz.h"
 
 #define MEMPERM_RW (MEMPERM_READ | MEMPERM_WRITE)
 
@@ -18,6 +19,8 @@ Result     MemoryBlock__SetSize(u32 size) {
     if (memblock->isReady)
         return MAKERESULT(RL_PERMANENT, RS_INVALIDSTATE, RM_LDR, RD_ALREADY_INITIALIZED);
     
+    if (size != g_memBlockSize)
+        MemoryBlock__InvalidateSwapFile();
     g_memBlockSize = size;
     return 0;
 }
@@ -122,13 +125,96 @@ Result      MemoryBlock__Free(void)
 
 #define FS_OPEN_RWC (FS_OPEN_READ | FS_OPEN_WRITE | FS_OPEN_CREATE)
 
+// Swap file layout: SwapFileHeader, the stored size of each chunk (u32), then the chunks themselves, each in
+// its own slot at SWAP_DATA_OFFSET + index * SWAP_CHUNK_SIZE. A chunk is either all zeroes (size 0, nothing
+// stored), raw (size SWAP_CHUNK_SIZE) or LZ-compressed.
+// Chunks whose contents are already in the file (same hash as when they were last written) are skipped.
+// Compressing a chunk uses the slot of the next one as output buffer (swapping out goes backwards), and
+// decompressing a chunk reads it into the slot of the next one (swapping in goes forwards): no additional
+// buffer is needed, and the last chunk is always stored raw.
+#define SWAP_FILE_MAGIC     0x50575353 // "SSWP"
+#define SWAP_FILE_VERSION   2
+#define SWAP_CHUNK_SIZE     LZ_MAX_BLOCK_SIZE
+#define SWAP_MAX_CHUNKS     ((5 * 1024 * 1024) / SWAP_CHUNK_SIZE)
+#define SWAP_DATA_OFFSET    0x1000
+
+typedef struct
+{
+    u32     magic;
+    u32     version;
+    u32     memBlockSize;
+    u32     chunkSize;
+}   SwapFileHeader;
+
+static u32  g_swapChunkSizes[SWAP_MAX_CHUNKS];
+static u64  g_swapChunkHashes[SWAP_MAX_CHUNKS];
+static bool g_swapFileInSync = false; ///< The swap file holds the chunks described by the two arrays above
+static char g_swapFileSyncedName[256];
+
+static inline u32   rotl32(u32 x, u32 n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+// Returns a 64-bit hash of the chunk, and whether it only contains zeroes
+static u64      MemoryBlock__HashChunk(const u32 *chunk, bool *isZero)
+{
+    u32 h1 = 0x811C9DC5, h2 = 0x9E3779B9, acc = 0;
+
+    for (u32 i = 0; i < SWAP_CHUNK_SIZE / 4; i += 2)
+    {
+        u32 a = chunk[i], b = chunk[i + 1];
+
+        acc |= a | b;
+        h1 = (rotl32(h1, 5) ^ a) * 0x9E3779B1 + b;
+        h2 = (rotl32(h2, 7) ^ b) * 0x85EBCA77 + a;
+    }
+
+    *isZero = acc == 0;
+    return ((u64)h1 << 32) | h2;
+}
+
+void        MemoryBlock__InvalidateSwapFile(void)
+{
+    g_swapFileInSync = false;
+}
+
+// Compresses chunk i if possible (i.e. if it isn't the last one and it's worth it) and writes it into its slot
+static Result   MemoryBlock__WriteSwapChunk(IFile *file, u32 i, u32 nbChunks)
+{
+    u8      *chunk = PluginLoaderCtx.memblock.memblock + i * SWAP_CHUNK_SIZE;
+    u8      *data = chunk;
+    u32     size = SWAP_CHUNK_SIZE;
+    u64     written = 0;
+    Result  res;
+
+    if (i + 1 < nbChunks)
+    {
+        u32 compressedSize = LZ_Compress(chunk + SWAP_CHUNK_SIZE, SWAP_CHUNK_SIZE - 1, chunk, SWAP_CHUNK_SIZE);
+        if (compressedSize != 0)
+        {
+            data = chunk + SWAP_CHUNK_SIZE;
+            size = compressedSize;
+        }
+    }
+
+    file->pos = SWAP_DATA_OFFSET + i * SWAP_CHUNK_SIZE;
+    res = IFile_Write(file, &written, data, size, 0);
+    if (R_SUCCEEDED(res) && written != size)
+        res = -1;
+
+    g_swapChunkSizes[i] = size;
+    return res;
+}
+
 Result      MemoryBlock__ToSwapFile(void)
 {
     MemoryBlock *memblock = &PluginLoaderCtx.memblock;
     PluginLoaderContext *ctx = &PluginLoaderCtx;
 
     u64     written = 0;
-    u64     toWrite = g_memBlockSize;
+    u32     nbChunks = g_memBlockSize / SWAP_CHUNK_SIZE;
+    u32     dirtyMask[(SWAP_MAX_CHUNKS + 31) / 32] = { 0 };
     IFile   file;
     Result  res = 0;
 
@@ -146,26 +232,103 @@ Result      MemoryBlock__ToSwapFile(void)
         svcKernelSetState(7);
     }
     ctx->swapLoadChecksum = saveSwapFunc(memblock->memblock, memblock->memblock + g_memBlockSize, g_loadSaveSwapArgs);
-    
-    res = IFile_Write(&file, &written, memblock->memblock, toWrite, FS_WRITE_FLUSH);
 
-    if (R_FAILED(res) || written != toWrite) {
+    // Only trust the previous contents of the file if we wrote them ourselves, with the same layout
+    u64     fileSize = 0;
+    bool    inSync = g_swapFileInSync && strcmp(g_swapFileSyncedName, g_swapFileName) == 0
+                    && R_SUCCEEDED(IFile_GetSize(&file, &fileSize)) && fileSize >= sizeof(SwapFileHeader) + 4 * nbChunks;
+
+    g_swapFileInSync = false;
+
+    // Find out what needs to be written before anything gets overwritten by the compressor
+    for (u32 i = 0; i < nbChunks; i++)
+    {
+        bool    isZero;
+        u64     hash = MemoryBlock__HashChunk((const u32 *)(memblock->memblock + i * SWAP_CHUNK_SIZE), &isZero);
+
+        if (isZero)
+            g_swapChunkSizes[i] = 0;
+        else if (!inSync || g_swapChunkSizes[i] == 0 || g_swapChunkHashes[i] != hash)
+            dirtyMask[i / 32] |= 1u << (i % 32);
+        g_swapChunkHashes[i] = hash;
+    }
+
+    for (u32 i = nbChunks; R_SUCCEEDED(res) && i > 0; i--)
+    {
+        if (dirtyMask[(i - 1) / 32] & (1u << ((i - 1) % 32)))
+            res = MemoryBlock__WriteSwapChunk(&file, i - 1, nbChunks);
+    }
+
+    // Write the chunk index last, so that it always describes data that is in the file
+    if (R_SUCCEEDED(res))
+    {
+        SwapFileHeader  header = { SWAP_FILE_MAGIC, SWAP_FILE_VERSION, g_memBlockSize, SWAP_CHUNK_SIZE };
+
+        file.pos = sizeof(SwapFileHeader);
+        res = IFile_Write(&file, &written, g_swapChunkSizes, 4 * nbChunks, 0);
+        if (R_SUCCEEDED(res) && written == 4 * nbChunks)
+        {
+            file.pos = 0;
+            res = IFile_Write(&file, &written, &header, sizeof(SwapFileHeader), FS_WRITE_FLUSH);
+            if (R_SUCCEEDED(res) && written != sizeof(SwapFileHeader))
+                res = -1;
+        }
+        else if (R_SUCCEEDED(res))
+            res = -1;
+    }
+
+    if (R_FAILED(res)) {
         PluginLoader__Error("CRITICO: No se puede scribir swap\na la SD.\n\nLa consola se reiniciara.", res);
         svcKernelSetState(7);
     }
+    else {
+        strcpy(g_swapFileSyncedName, g_swapFileName);
+        g_swapFileInSync = true;
+    }
 
     IFile_Close(&file);
     return res;
 }
 
+// Reads chunk i from its slot, decompressing it if needed
+static Result   MemoryBlock__ReadSwapChunk(IFile *file, u32 i, u32 nbChunks)
+{
+    u8      *chunk = PluginLoaderCtx.memblock.memblock + i * SWAP_CHUNK_SIZE;
+    u32     size = g_swapChunkSizes[i];
+    u64     read = 0;
+    Result  res;
+
+    if (size == 0)
+    {
+        // May have been used to decompress the previous chunk
+        memset(chunk, 0, SWAP_CHUNK_SIZE);
+        return 0;
+    }
+    else if (size > SWAP_CHUNK_SIZE || (size < SWAP_CHUNK_SIZE && i + 1 >= nbChunks))
+        return -1;
+
+    u8      *data = size == SWAP_CHUNK_SIZE ? chunk : chunk + SWAP_CHUNK_SIZE;
+
+    file->pos = SWAP_DATA_OFFSET + i * SWAP_CHUNK_SIZE;
+    res = IFile_Read(file, &read, data, size);
+    if (R_SUCCEEDED(res) && read != size)
+        res = -1;
+
+    if (R_SUCCEEDED(res) && data != chunk && LZ_Decompress(chunk, SWAP_CHUNK_SIZE, data, size) != SWAP_CHUNK_SIZE)
+        res = -1;
+
+    return res;
+}
+
 Result      MemoryBlock__FromSwapFile(void)
 {
     MemoryBlock *memblock = &PluginLoaderCtx.memblock;
 
     u64     read = 0;
-    u64     toRead = g_memBlockSize;
+    u32     nbChunks = g_memBlockSize / SWAP_CHUNK_SIZE;
     IFile   file;
     Result  res = 0;
+    SwapFileHeader  header;
 
     res = IFile_Open(&file, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""),
                     fsMakePath(PATH_ASCII, g_swapFileName), FS_OPEN_READ);
@@ -175,9 +338,23 @@ Result      MemoryBlock__FromSwapFile(void)
         svcKernelSetState(7);
     }
 
-    res = IFile_Read(&file, &read, memblock->memblock, toRead);
+    res = IFile_Read(&file, &read, &header, sizeof(SwapFileHeader));
+    if (R_SUCCEEDED(res) && (read != sizeof(SwapFileHeader) || header.magic != SWAP_FILE_MAGIC || header.version != SWAP_FILE_VERSION
+        || header.memBlockSize != g_memBlockSize || header.chunkSize != SWAP_CHUNK_SIZE))
+        res = -1;
+
+    if (R_SUCCEEDED(res))
+    {
+        res = IFile_Read(&file, &read, g_swapChunkSizes, 4 * nbChunks);
+        if (R_SUCCEEDED(res) && read != 4 * nbChunks)
+            res = -1;
+    }
+
+    for (u32 i = 0; R_SUCCEEDED(res) && i < nbChunks; i++)
+        res = MemoryBlock__ReadSwapChunk(&file, i, nbChunks);
 
-    if (R_FAILED(res) || read != toRead) {
+    if (R_FAILED(res)) {
+        g_swapFileInSync = false;
         PluginLoader__Error("CRITICO: No se puede leer swap\ndesde la SD.\n\nLa consola se reiniciara.", res);
         svcKernelSetState(7);
     }
@@ -187,6 +364,7 @@ Result      MemoryBlock__FromSwapFile(void)
     PluginLoaderContext *ctx = &PluginLoaderCtx;
     if (checksum != ctx->swapLoadChecksum) {
         res = -1;
+        g_swapFileInSync = false;
         PluginLoader__Error("CRITICO: Archivo swap corrupto.\n\nLa consola se reiniciara.", res);
         svcKernelSetState(7); 
     }
@@ -268,6 +446,7 @@ void       MemoryBlock__ResetSwapSettings(void)
 
 	strcpy(g_swapFileName, "/luma/plugins/.swap");
     ctx->isSwapFunctionset = false;
+    MemoryBlock__InvalidateSwapFile();
 
 	svcInvalidateEntireInstructionCache();
 }
\ No newline at end of file
@@ -57,6 +57,7 @@ void        PluginLoader__MenuCallback(void)
 {
     PluginLoaderCtx.isEnabled = !PluginLoaderCtx.isEnabled;
     LumaConfig_RequestSaveSettings();
+    PluginLoader__InvalidatePluginIndex();
     PluginLoader__UpdateMenu();
 }
 
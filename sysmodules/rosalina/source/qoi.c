@@ -0,0 +1,141 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include <string.h>
+#include "qoi.h"
+
+#define QOI_OP_INDEX    0x00
+#define QOI_OP_DIFF     0x40
+#define QOI_OP_LUMA     0x80
+#define QOI_OP_RUN      0xC0
+#define QOI_OP_RGB      0xFE
+
+#define QOI_MAX_RUN     62
+
+// Pixels are stored as 0xAABBGGRR, alpha is always 255
+#define QOI_PIXEL(r, g, b)  ((u32)(r) | ((u32)(g) << 8) | ((u32)(b) << 16) | 0xFF000000u)
+
+static inline void Qoi_WriteBigEndian32(u8 *dst, u32 val)
+{
+    dst[0] = val >> 24;
+    dst[1] = val >> 16;
+    dst[2] = val >> 8;
+    dst[3] = val;
+}
+
+void Qoi_WriteHeader(u8 *dst, u32 width, u32 height)
+{
+    memcpy(dst, "qoif", 4);
+    Qoi_WriteBigEndian32(dst + 4, width);
+    Qoi_WriteBigEndian32(dst + 8, height);
+    dst[12] = 3; // RGB
+    dst[13] = 0; // sRGB with linear alpha
+}
+
+void Qoi_InitEncoder(QoiEncoder *enc)
+{
+    memset(enc->index, 0, sizeof(enc->index));
+    enc->prev = QOI_PIXEL(0, 0, 0);
+    enc->run = 0;
+}
+
+u32 Qoi_EncodeBgr8Line(QoiEncoder *enc, u8 *dst, const u8 *src, u32 width)
+{
+    u8 *out = dst;
+    u32 prev = enc->prev;
+    u32 run = enc->run;
+
+    for(u32 x = 0; x < width; x++, src += 3)
+    {
+        u8 r = src[2], g = src[1], b = src[0];
+        u32 px = QOI_PIXEL(r, g, b);
+
+        if(px == prev)
+        {
+            if(++run == QOI_MAX_RUN)
+            {
+                *out++ = QOI_OP_RUN | (run - 1);
+                run = 0;
+            }
+            continue;
+        }
+
+        if(run != 0)
+        {
+            *out++ = QOI_OP_RUN | (run - 1);
+            run = 0;
+        }
+
+        u32 hash = (r * 3 + g * 5 + b * 7 + 255 * 11) % 64;
+        if(enc->index[hash] == px)
+            *out++ = QOI_OP_INDEX | hash;
+        else
+        {
+            enc->index[hash] = px;
+
+            s8 vr = (s8)(r - (u8)prev);
+            s8 vg = (s8)(g - (u8)(prev >> 8));
+            s8 vb = (s8)(b - (u8)(prev >> 16));
+            s8 vgr = vr - vg, vgb = vb - vg;
+
+            if(vr >= -2 && vr <= 1 && vg >= -2 && vg <= 1 && vb >= -2 && vb <= 1)
+                *out++ = QOI_OP_DIFF | ((vr + 2) << 4) | ((vg + 2) << 2) | (vb + 2);
+            else if(vg >= -32 && vg <= 31 && vgr >= -8 && vgr <= 7 && vgb >= -8 && vgb <= 7)
+            {
+                *out++ = QOI_OP_LUMA | (vg + 32);
+                *out++ = ((vgr + 8) << 4) | (vgb + 8);
+            }
+            else
+            {
+                *out++ = QOI_OP_RGB;
+                *out++ = r;
+                *out++ = g;
+                *out++ = b;
+            }
+        }
+
+        prev = px;
+    }
+
+    enc->prev = prev;
+    enc->run = run;
+    return out - dst;
+}
+
+u32 Qoi_FinishEncoding(QoiEncoder *enc, u8 *dst)
+{
+    static const u8 endMarker[QOI_END_MARKER_SIZE] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    u8 *out = dst;
+
+    if(enc->run != 0)
+    {
+        *out++ = QOI_OP_RUN | (enc->run - 1);
+        enc->run = 0;
+    }
+
+    memcpy(out, endMarker, QOI_END_MARKER_SIZE);
+    return out + QOI_END_MARKER_SIZE - dst;
+}
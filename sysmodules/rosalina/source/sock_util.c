@@ -20,30 +20,27 @@ extern Handle preTerminationEvent;
 extern bool preTerminationRequested;
 
 // soc's poll function is odd, and doesn't like -1 as fd.
-// so this compacts everything together
+// so this compacts everything together, in place
 
 static void compact(struct sock_server *serv)
 {
-    int new_fds[MAX_CTXS];
-    struct sock_ctx *new_ctxs[MAX_CTXS];
     nfds_t n = 0;
 
     for(nfds_t i = 0; i < serv->nfds; i++)
     {
         if(serv->poll_fds[i].fd != -1)
         {
-            new_fds[n] = serv->poll_fds[i].fd;
-            new_ctxs[n] = serv->ctx_ptrs[i];
+            serv->poll_fds[n].fd = serv->poll_fds[i].fd;
+            serv->poll_fds[n].events = serv->poll_fds[i].events;
+            serv->ctx_ptrs[n] = serv->ctx_ptrs[i];
+            serv->ctx_ptrs[n]->i = n;
             n++;
         }
     }
 
-    for(nfds_t i = 0; i < n; i++)
-    {
-        serv->poll_fds[i].fd = new_fds[i];
-        serv->ctx_ptrs[i] = new_ctxs[i];
-        serv->ctx_ptrs[i]->i = i;
-    }
+    for(nfds_t i = n; i < serv->nfds; i++)
+        serv->ctx_ptrs[i] = NULL;
+
     serv->nfds = n;
     serv->compact_needed = false;
 }
@@ -163,9 +160,14 @@ Result server_bind(struct sock_server *serv, u16 port)
     return 0;
 }
 
-static bool server_should_exit(struct sock_server *serv)
+// Waits for at most timeout ns for a termination request, and returns true if there is one.
+// Both events are checked with a single syscall.
+static bool server_wait_for_exit(struct sock_server *serv, s64 timeout)
 {
-    return svcWaitSynchronization(serv->shall_terminate_event, 0) == 0 || svcWaitSynchronization(preTerminationEvent, 0) == 0;
+    Handle handles[2] = { preTerminationEvent, serv->shall_terminate_event };
+    s32 idx = -1;
+
+    return preTerminationRequested || svcWaitSynchronizationN(&idx, handles, 2, false, timeout) == 0;
 }
 
 void server_run(struct sock_server *serv)
@@ -174,15 +176,17 @@ void server_run(struct sock_server *serv)
 
     serv->running = true;
     svcSignalEvent(serv->started_event);
-    while(serv->running && !preTerminationRequested)
-    {
-        if(server_should_exit(serv))
-            goto abort_connections;
 
+    // No need to poll at a fixed interval: termination requests go through server_kill_connections,
+    // which closes the sockets and thus makes socPoll return right away
+    while(serv->running && !server_wait_for_exit(serv, 0))
+    {
         if(serv->nfds == 0)
         {
-            svcSleepThread(12 * 1000 * 1000LL);
-            continue;
+            // Only listening sockets can add fds, so none will ever be added: just wait to be told to exit.
+            // (This can only happen if no port was bound, the server used to sleep and loop until exit instead.)
+            server_wait_for_exit(serv, -1LL);
+            goto abort_connections;
         }
 
         for(nfds_t i = 0; i < serv->nfds; i++)
@@ -190,21 +194,27 @@ void server_run(struct sock_server *serv)
 
         if (Sleep__Status())
         {
-            while (!Wifi__IsConnected()
-                    && serv->running && !preTerminationRequested)
-                svcSleepThread(1000000000ULL);
+            while (!Wifi__IsConnected() && serv->running)
+            {
+                if(server_wait_for_exit(serv, 1000 * 1000 * 1000LL))
+                    goto abort_connections;
+            }
         }
 
-        int pollres = socPoll(fds, serv->nfds, 50);
+        int pollres = socPoll(fds, serv->nfds, SOCK_POLL_TIMEOUT_MS);
 
-        if(server_should_exit(serv) || pollres < -10000)
+        if(pollres < -10000 || server_wait_for_exit(serv, 0))
             goto abort_connections;
 
-        for(nfds_t i = 0; pollres > 0 && i < serv->nfds; i++)
+        // Every context is checked for should_close, not only the ready ones; newly accepted clients are only polled next time
+        nfds_t nfds = serv->nfds;
+        for(nfds_t i = 0; i < nfds; i++)
         {
             struct sock_ctx *curr_ctx = serv->ctx_ptrs[i];
 
-            if((fds[i].revents & (POLLHUP | POLLERR | POLLNVAL)) || curr_ctx->should_close)
+            if(curr_ctx == NULL)
+                continue;
+            else if((fds[i].revents & (POLLHUP | POLLERR | POLLNVAL)) || curr_ctx->should_close)
                 server_close_ctx(serv, curr_ctx);
 
             else if(fds[i].revents & POLLIN)
@@ -215,9 +225,6 @@ void server_run(struct sock_server *serv)
                     socklen_t len = sizeof(struct sockaddr_in);
                     int client_sockfd = socAccept(fds[i].fd, (struct sockaddr *)&saddr, &len);
 
-                    if(server_should_exit(serv))
-                        goto abort_connections;
-
                     if(client_sockfd < 0 || curr_ctx->n == serv->clients_per_server || serv->nfds == MAX_CTXS)
                         socClose(client_sockfd);
 
@@ -260,13 +267,13 @@ void server_run(struct sock_server *serv)
             }
         }
 
-        if(server_should_exit(serv))
-            goto abort_connections;
-
         if(serv->compact_needed)
             compact(serv);
     }
 
+    if(serv->running)
+        goto abort_connections;
+
     // Clean up.
     for(unsigned int i = 0; i < serv->nfds; i++)
     {
@@ -285,12 +292,24 @@ abort_connections:
     svcSignalEvent(serv->shall_terminate_event);
 }
 
+// Asks the server thread to close a context. socPoll may block for a while, shutting the socket down
+// makes it report the socket right away
+void server_request_close(struct sock_ctx *ctx)
+{
+    ctx->should_close = true;
+    if(ctx->type == SOCK_CLIENT)
+        socShutdown(ctx->sockfd, SHUT_RDWR);
+}
+
 void server_set_should_close_all(struct sock_server *serv)
 {
     nfds_t nfds = serv->nfds;
 
     for(unsigned int i = 0; i < nfds; i++)
-        serv->ctx_ptrs[i]->should_close = true;
+    {
+        if(serv->ctx_ptrs[i] != NULL)
+            server_request_close(serv->ctx_ptrs[i]);
+    }
 }
 
 void server_kill_connections(struct sock_server *serv)
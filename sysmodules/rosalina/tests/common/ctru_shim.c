@@ -0,0 +1,278 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+// Host implementations of the libctru and custom SVC functions declared in include/3ds.h and csvc.h.
+// Everything is weak so that a test can replace any of them with a mock; by default kernel objects and services
+// don't exist (the calls fail), except for events, locks and memory allocation which are emulated.
+
+#include <3ds.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include "csvc.h"
+#include "minisoc.h"
+#include "pmdbgext.h"
+#include "utils.h"
+
+#define WEAK __attribute__((weak))
+
+#define SHIM_NOT_IMPLEMENTED MAKERESULT(RL_PERMANENT, RS_NOTSUPPORTED, RM_APPLICATION, RD_NOT_IMPLEMENTED)
+
+static Handle nextHandle = 0x100;
+
+static u64 shimNanoseconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// IPC
+
+WEAK u32 *getThreadCommandBuffer(void)
+{
+    static __thread u32 cmdbuf[64];
+    return cmdbuf;
+}
+
+WEAK u32 *getThreadStaticBuffers(void)
+{
+    static __thread u32 staticbufs[32];
+    return staticbufs;
+}
+
+// Synchronization, the tests are single-threaded as far as the code under test is concerned
+
+WEAK void LightLock_Init(LightLock *lock) { *lock = 1; }
+WEAK void LightLock_Lock(LightLock *lock) { (void)lock; }
+WEAK int LightLock_TryLock(LightLock *lock) { (void)lock; return 0; }
+WEAK void LightLock_Unlock(LightLock *lock) { (void)lock; }
+WEAK void RecursiveLock_Init(RecursiveLock *lock) { memset(lock, 0, sizeof(RecursiveLock)); }
+WEAK void RecursiveLock_Lock(RecursiveLock *lock) { lock->counter++; }
+WEAK int RecursiveLock_TryLock(RecursiveLock *lock) { lock->counter++; return 0; }
+WEAK void RecursiveLock_Unlock(RecursiveLock *lock) { lock->counter--; }
+WEAK void LightEvent_Init(LightEvent *event, int reset_type) { event->state = reset_type; }
+WEAK void LightEvent_Clear(LightEvent *event) { (void)event; }
+WEAK void LightEvent_Signal(LightEvent *event) { (void)event; }
+WEAK void LightEvent_Wait(LightEvent *event) { (void)event; }
+
+// Memory: MEMOP_ALLOC and MEMOP_FREE map and unmap anonymous memory at the requested (fixed) address
+
+WEAK Result svcControlMemory(u32 *addr_out, u32 addr0, u32 addr1, u32 size, MemOp op, MemPerm perm)
+{
+    (void)addr1;
+    (void)perm;
+    switch(op & 0xFF)
+    {
+        case MEMOP_ALLOC:
+        {
+            void *p = mmap((void *)(uintptr_t)addr0, size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+            if(p == MAP_FAILED || (uintptr_t)p != addr0)
+                return MAKERESULT(RL_PERMANENT, RS_OUTOFRESOURCE, RM_OS, RD_OUT_OF_MEMORY);
+            *addr_out = addr0;
+            return 0;
+        }
+        case MEMOP_FREE:
+            munmap((void *)(uintptr_t)addr0, size);
+            return 0;
+        default:
+            return SHIM_NOT_IMPLEMENTED;
+    }
+}
+
+WEAK Result svcControlMemoryEx(u32 *addr_out, u32 addr0, u32 addr1, u32 size, MemOp op, MemPerm perm, bool isLoader)
+{
+    (void)isLoader;
+    return svcControlMemory(addr_out, addr0, addr1, size, op, perm);
+}
+
+WEAK Result svcControlMemoryUnsafe(u32 *out, u32 addr0, u32 size, MemOp op, MemPerm perm)
+{
+    return svcControlMemory(out, addr0, 0, size, op, perm);
+}
+
+WEAK Result svcQueryMemory(MemInfo *info, PageInfo *out, u32 addr) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcQueryProcessMemory(MemInfo *info, PageInfo *out, Handle process, u32 addr) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcCreateMemoryBlock(Handle *memblock, u32 addr, u32 size, MemPerm my_perm, MemPerm other_perm) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcMapProcessMemoryEx(Handle dstProcessHandle, u32 destAddress, Handle srcProcessHandle, u32 srcAddress, u32 size) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcUnmapProcessMemoryEx(Handle process, u32 destAddress, u32 size) { return SHIM_NOT_IMPLEMENTED; }
+WEAK u32 svcConvertVAToPA(const void *VA, bool writeCheck) { return 0; }
+WEAK void svcFlushDataCacheRange(void *addr, u32 len) { }
+WEAK void svcFlushEntireDataCache(void) { }
+WEAK void svcInvalidateInstructionCacheRange(void *addr, u32 len) { }
+WEAK void svcInvalidateEntireInstructionCache(void) { }
+WEAK Result svcFlushProcessDataCache(Handle process, u32 addr, u32 size) { return 0; }
+WEAK Result svcInvalidateProcessDataCache(Handle process, u32 addr, u32 size) { return 0; }
+
+// Processes and threads
+
+WEAK Result svcOpenProcess(Handle *process, u32 processId) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcGetProcessId(u32 *out, Handle handle) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcGetProcessInfo(s64 *out, Handle process, u32 type) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcGetProcessList(s32 *processCount, u32 *processIds, s32 processIdMaxCount) { *processCount = 0; return 0; }
+WEAK Result svcGetThreadList(s32 *threadCount, u32 *threadIds, s32 threadIdMaxCount, Handle process) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcOpenThread(Handle *thread, Handle process, u32 threadId) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcGetThreadId(u32 *out, Handle handle) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcGetThreadPriority(s32 *out, Handle handle) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcGetSystemInfo(s64 *out, u32 type, s32 param) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcGetHandleInfo(s64 *out, Handle handle, u32 param) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcSendSyncRequest(Handle session) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcDuplicateHandle(Handle *out, Handle original) { *out = nextHandle++; return 0; }
+WEAK Result svcCopyHandle(Handle *out, Handle outProcess, Handle in, Handle inProcess) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcTranslateHandle(u32 *outKAddr, char *outClassName, Handle in) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcControlProcess(Handle process, ProcessOp op, u32 varg2, u32 varg3) { return SHIM_NOT_IMPLEMENTED; }
+WEAK void svcBreak(UserBreakType breakReason) { fprintf(stderr, "svcBreak(%d)\n", breakReason); abort(); }
+
+WEAK Result svcKernelSetState(u32 type, ...) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcCustomBackdoor(void *func, ...) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcControlService(ServiceOp op, ...) { return SHIM_NOT_IMPLEMENTED; }
+
+// Events are always signaled, waits return at once
+
+WEAK Result svcCreateEvent(Handle *event, ResetType reset_type) { *event = nextHandle++; return 0; }
+WEAK Result svcSignalEvent(Handle handle) { return 0; }
+WEAK Result svcClearEvent(Handle handle) { return 0; }
+WEAK Result svcWaitSynchronization(Handle handle, s64 nanoseconds) { return 0; }
+WEAK Result svcWaitSynchronizationN(s32 *out, const Handle *handles, s32 handles_num, bool wait_all, s64 nanoseconds) { *out = 0; return 0; }
+WEAK Result svcCloseHandle(Handle handle) { return 0; }
+
+WEAK void svcSleepThread(s64 ns)
+{
+    struct timespec ts = { ns / 1000000000, ns % 1000000000 };
+    if(ns <= 0)
+        sched_yield();
+    else
+        nanosleep(&ts, NULL);
+}
+
+WEAK u64 svcGetSystemTick(void)
+{
+    return (u64)((double)shimNanoseconds() * SYSCLOCK_ARM11 / 1e9);
+}
+
+// Debugging, no process can be debugged by default
+
+WEAK Result svcDebugActiveProcess(Handle *debug, u32 processId) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcBreakDebugProcess(Handle debug) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcTerminateDebugProcess(Handle debug) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcGetProcessDebugEvent(DebugEventInfo *info, Handle debug) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcContinueDebugEvent(Handle debug, DebugFlags flags) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcGetDebugThreadContext(ThreadContext *context, Handle debug, u32 threadId, ThreadContextControlFlags controlFlags) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcSetDebugThreadContext(Handle debug, u32 threadId, const ThreadContext *context, ThreadContextControlFlags controlFlags) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcQueryDebugProcessMemory(MemInfo *info, PageInfo *out, Handle debug, u32 addr) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcReadProcessMemory(void *buffer, Handle debug, u32 addr, u32 size) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcWriteProcessMemory(Handle debug, const void *buffer, u32 addr, u32 size) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcSetHardwareBreakPoint(s32 registerId, u32 control, u32 value) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result svcGetDebugThreadParam(s64 *unused, u32 *out, Handle debug, u32 threadId, DebugThreadParameter parameter) { return SHIM_NOT_IMPLEMENTED; }
+
+// OS
+
+WEAK u32 osGetKernelVersion(void) { return SYSTEM_VERSION(2, 58, 0); }
+WEAK u32 osGetFirmVersion(void) { return SYSTEM_VERSION(2, 58, 0); }
+WEAK s64 osGetMemRegionFree(MemRegion region) { return 0; }
+WEAK s64 osGetMemRegionUsed(MemRegion region) { return 0; }
+WEAK u64 osGetTime(void) { return shimNanoseconds() / 1000000; }
+
+// Services
+
+WEAK Result srvGetServiceHandle(Handle *out, const char *name) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result srvIsServiceRegistered(bool *registered, const char *name) { *registered = false; return 0; }
+WEAK Result ndmuInit(void) { return SHIM_NOT_IMPLEMENTED; }
+WEAK void ndmuExit(void) { }
+WEAK Result NDMU_EnterExclusiveState(NDM_ExclusiveState state) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result NDMU_LeaveExclusiveState(void) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result NDMU_LockState(void) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result NDMU_UnlockState(void) { return SHIM_NOT_IMPLEMENTED; }
+
+WEAK Result PMDBG_GetCurrentAppInfo(FS_ProgramInfo *outProgramInfo, u32 *outPid, u32 *outLaunchFlags) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result PMDBG_DebugNextApplicationByForce(bool debug) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result PMDBG_LaunchAppDebug(Handle *outDebug, const FS_ProgramInfo *programInfo, u32 launchFlags) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result PMAPP_TerminateTitle(u64 titleId, s64 timeout) { return SHIM_NOT_IMPLEMENTED; }
+
+// FS, no archive can be opened by default
+
+WEAK FS_Path fsMakePath(FS_PathType type, const void *path)
+{
+    FS_Path p = { type, 0, path };
+    if(type == PATH_ASCII)
+        p.size = strlen((const char *)path) + 1;
+    else if(type == PATH_UTF16)
+    {
+        const u16 *str = (const u16 *)path;
+        while(str[p.size / 2] != 0)
+            p.size += 2;
+        p.size += 2;
+    }
+    else if(type == PATH_EMPTY)
+        p.size = 1;
+    return p;
+}
+
+WEAK Result FSUSER_OpenArchive(FS_Archive *archive, FS_ArchiveID id, FS_Path path) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result FSUSER_CloseArchive(FS_Archive archive) { return 0; }
+WEAK Result FSUSER_OpenFile(Handle *out, FS_Archive archive, FS_Path path, u32 openFlags, u32 attributes) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result FSUSER_OpenFileDirectly(Handle *out, FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, u32 openFlags, u32 attributes) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result FSUSER_OpenDirectory(Handle *out, FS_Archive archive, FS_Path path) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result FSUSER_DeleteFile(FS_Archive archive, FS_Path path) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result FSUSER_CreateFile(FS_Archive archive, FS_Path path, u32 attributes, u64 fileSize) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result FSUSER_CreateDirectory(FS_Archive archive, FS_Path path, u32 attributes) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result FSFILE_Read(Handle handle, u32 *bytesRead, u64 offset, void *buffer, u32 size) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result FSFILE_Write(Handle handle, u32 *bytesWritten, u64 offset, const void *buffer, u32 size, u32 flags) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result FSFILE_GetSize(Handle handle, u64 *size) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result FSFILE_SetSize(Handle handle, u64 size) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result FSFILE_Close(Handle handle) { return 0; }
+WEAK Result FSDIR_Read(Handle handle, u32 *entriesRead, u32 entryCount, FS_DirectoryEntry *entries) { return SHIM_NOT_IMPLEMENTED; }
+WEAK Result FSDIR_Close(Handle handle) { return 0; }
+
+// Unicode, ASCII is enough for the tests
+
+WEAK ssize_t utf8_to_utf16(u16 *out, const u8 *in, size_t len)
+{
+    size_t n = 0;
+    for(; in[n] != 0; n++)
+    {
+        if(n < len)
+            out[n] = in[n];
+    }
+    return n;
+}
+
+WEAK ssize_t utf16_to_utf8(u8 *out, const u16 *in, size_t len)
+{
+    size_t n = 0;
+    for(; in[n] != 0; n++)
+    {
+        if(n < len)
+            out[n] = (u8)in[n];
+    }
+    return n;
+}
+
+// Rosalina functions from outside of the code under test
+
+WEAK bool isN3DS = false;
+
+WEAK u32 formatMemoryMapOfProcess(char *outbuf, u32 bufLen, Handle handle) { return 0; }
+WEAK Result PMDBG_LaunchTitleDebug(Handle *outDebug, const FS_ProgramInfo *programInfo, u32 launchFlags) { return SHIM_NOT_IMPLEMENTED; }
+
+// soc:U can't be used on the host: these replace minisoc's versions (which the Makefile makes weak) and go to the
+// host sockets instead. Like minisoc's, they return -1 on failure
+
+ssize_t socRecvfrom(int sockfd, void *buf, size_t len, int flags, struct sockaddr *src_addr, socklen_t *addrlen)
+{
+    return recvfrom(sockfd, buf, len, flags, src_addr, addrlen);
+}
+
+ssize_t socSendto(int sockfd, const void *buf, size_t len, int flags, const struct sockaddr *dest_addr, socklen_t addrlen)
+{
+    return sendto(sockfd, buf, len, flags | MSG_NOSIGNAL, dest_addr, addrlen);
+}
@@ -0,0 +1,258 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+#include <stdio.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "gdb_test.h"
+#include "gdb/net.h"
+#include "gdb/server.h"
+#include "test.h"
+
+u8 gdbTestMemory[GDB_TEST_MEM_SIZE];
+bool gdbTestPageUnreadable[GDB_TEST_MEM_SIZE / 0x1000];
+u32 gdbTestNbMemoryReads, gdbTestNbMemoryWrites;
+
+int gdbTestPeer = -1;
+
+// Static, see the Makefile
+static GDBServer gdbTestServer;
+static GDBContextTables gdbTestTables[MAX_DEBUG];
+static char gdbTestBuffers[MAX_DEBUG][2][GDB_PACKET_BUF_LEN + 4];
+static u8 gdbTestReadAheadBuffer[GDB_TIO_READ_AHEAD_LEN];
+static int gdbTestPeers[MAX_DEBUG] = { -1, -1, -1 };
+
+// What was received from the context but not consumed yet
+static u8 gdbTestRecvData[0x10000];
+static u32 gdbTestRecvDataStart, gdbTestRecvDataEnd;
+
+static bool gdbTestRangeReadable(u32 addr, u32 size)
+{
+    if(addr < GDB_TEST_MEM_BASE || size > GDB_TEST_MEM_SIZE || addr - GDB_TEST_MEM_BASE > GDB_TEST_MEM_SIZE - size)
+        return false;
+
+    for(u32 off = (addr - GDB_TEST_MEM_BASE) & ~0xFFF; off < addr - GDB_TEST_MEM_BASE + size; off += 0x1000)
+    {
+        if(gdbTestPageUnreadable[off / 0x1000])
+            return false;
+    }
+
+    return true;
+}
+
+Result svcGetSystemInfo(s64 *out, u32 type, s32 param)
+{
+    if(type != 0x10002)
+        return -1;
+
+    *out = 1; // TTBCR: user space is below 0x80000000
+    return 0;
+}
+
+Result svcReadProcessMemory(void *buffer, Handle debug, u32 addr, u32 size)
+{
+    gdbTestNbMemoryReads++;
+    if(!gdbTestRangeReadable(addr, size))
+        return 0xE0E01BF5;
+
+    memcpy(buffer, gdbTestMemory + addr - GDB_TEST_MEM_BASE, size);
+    return 0;
+}
+
+Result svcWriteProcessMemory(Handle debug, const void *buffer, u32 addr, u32 size)
+{
+    gdbTestNbMemoryWrites++;
+    if(!gdbTestRangeReadable(addr, size))
+        return 0xE0E01BF5;
+
+    memcpy(gdbTestMemory + addr - GDB_TEST_MEM_BASE, buffer, size);
+    return 0;
+}
+
+Result svcQueryDebugProcessMemory(MemInfo *info, PageInfo *out, Handle debug, u32 addr)
+{
+    out->flags = 0;
+    if(addr < GDB_TEST_MEM_BASE)
+    {
+        *info = (MemInfo){ 0, GDB_TEST_MEM_BASE, 0, MEMSTATE_FREE };
+        return 0;
+    }
+    else if(addr - GDB_TEST_MEM_BASE < GDB_TEST_MEM_SIZE)
+    {
+        *info = (MemInfo){ GDB_TEST_MEM_BASE, GDB_TEST_MEM_SIZE, MEMPERM_READWRITE, MEMSTATE_PRIVATE };
+        return 0;
+    }
+    else
+        return 0xE0E01BF5;
+}
+
+GDBContext *gdbTestOpen(void)
+{
+    u32 i;
+    int fds[2];
+
+    for(i = 0; i < MAX_DEBUG && gdbTestPeers[i] != -1; i++);
+    if(i == MAX_DEBUG || socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+    {
+        fprintf(stderr, "gdbTestOpen failed\n");
+        exit(1);
+    }
+
+    // As in GDB_InitializeServer
+    GDBContext *ctx = &gdbTestServer.ctxs[i];
+    memset(&gdbTestTables[i], 0, sizeof(GDBContextTables));
+    GDB_InitializeContext(ctx);
+    ctx->threadInfos = gdbTestTables[i].threadInfos;
+    ctx->threadContextSnapshots = gdbTestTables[i].threadContextSnapshots;
+    ctx->breakpoints = gdbTestTables[i].breakpoints;
+    ctx->breakpointIndex = gdbTestTables[i].breakpointIndex;
+    ctx->buffer = gdbTestBuffers[i][0];
+    ctx->recvBuffer = gdbTestBuffers[i][1];
+    gdbTestServer.tioReadAheadBuffer = gdbTestReadAheadBuffer;
+
+    // As after GDB_AcceptClient, attached to the mock debuggee
+    ctx->parent = &gdbTestServer;
+    ctx->super.sockfd = fds[0];
+    ctx->flags |= GDB_FLAG_USED;
+    ctx->state = GDB_STATE_ATTACHED;
+    ctx->debug = 0x1234;
+    ctx->pid = 0x42;
+
+    gdbTestPeers[i] = fds[1];
+    gdbTestSelect(ctx);
+    return ctx;
+}
+
+void gdbTestSelect(GDBContext *ctx)
+{
+    gdbTestPeer = gdbTestPeers[ctx - gdbTestServer.ctxs];
+    gdbTestRecvDataStart = gdbTestRecvDataEnd = 0;
+}
+
+void gdbTestClose(GDBContext *ctx)
+{
+    u32 i = ctx - gdbTestServer.ctxs;
+
+    close(ctx->super.sockfd);
+    close(gdbTestPeers[i]);
+    GDB_FinalizeContext(ctx);
+
+    if(gdbTestPeer == gdbTestPeers[i])
+        gdbTestPeer = -1;
+    gdbTestPeers[i] = -1;
+    gdbTestRecvDataStart = gdbTestRecvDataEnd = 0;
+}
+
+void gdbTestSendRaw(const void *data, size_t len)
+{
+    for(size_t total = 0; total < len; )
+    {
+        ssize_t r = send(gdbTestPeer, (const u8 *)data + total, len - total, MSG_NOSIGNAL);
+        if(r <= 0)
+        {
+            perror("send");
+            exit(1);
+        }
+        total += r;
+    }
+}
+
+void gdbTestSendPacket(const char *payload)
+{
+    gdbTestSendPacketData(payload, strlen(payload));
+}
+
+void gdbTestSendPacketData(const void *payload, size_t len)
+{
+    char *packet = malloc(len + 4);
+    char trailer[4];
+
+    packet[0] = '$';
+    memcpy(packet + 1, payload, len);
+    sprintf(trailer, "#%02x", GDB_ComputeChecksum(payload, len));
+    memcpy(packet + 1 + len, trailer, 3);
+
+    gdbTestSendRaw(packet, len + 4);
+    free(packet);
+}
+
+static int gdbTestRecvByte(int timeoutMs)
+{
+    if(gdbTestRecvDataStart == gdbTestRecvDataEnd)
+    {
+        struct pollfd pfd = { gdbTestPeer, POLLIN, 0 };
+        if(poll(&pfd, 1, timeoutMs) != 1)
+            return -1;
+
+        ssize_t r = recv(gdbTestPeer, gdbTestRecvData, sizeof(gdbTestRecvData), 0);
+        if(r <= 0)
+            return -1;
+
+        gdbTestRecvDataStart = 0;
+        gdbTestRecvDataEnd = r;
+    }
+
+    return gdbTestRecvData[gdbTestRecvDataStart++];
+}
+
+int gdbTestRecvPacket(char *payload, size_t maxLen, u32 *nbAcks, int timeoutMs)
+{
+    int c;
+    size_t len = 0;
+    u8 checksum = 0;
+    char trailer[3] = { 0 };
+
+    if(nbAcks != NULL)
+        *nbAcks = 0;
+
+    while((c = gdbTestRecvByte(timeoutMs)) != '$')
+    {
+        if(c == -1)
+            return -1;
+        else if(c == '+' && nbAcks != NULL)
+            ++*nbAcks;
+    }
+
+    while((c = gdbTestRecvByte(timeoutMs)) != '#')
+    {
+        if(c == -1 || len + 1 >= maxLen)
+            return -1;
+        payload[len++] = (char)c;
+        checksum += (u8)c;
+    }
+    payload[len] = 0;
+
+    for(u32 i = 0; i < 2; i++)
+    {
+        if((c = gdbTestRecvByte(timeoutMs)) == -1)
+            return -1;
+        trailer[i] = (char)c;
+    }
+
+    return strtoul(trailer, NULL, 16) == checksum ? (int)len : -1;
+}
+
+int gdbTestRecvRaw(void *buf, size_t maxLen, int timeoutMs)
+{
+    size_t len = 0;
+    int c;
+
+    while(len < maxLen && (c = gdbTestRecvByte(len == 0 ? timeoutMs : 10)) != -1)
+        ((u8 *)buf)[len++] = (u8)c;
+
+    return (int)len;
+}
+
+int gdbTestCommand(GDBContext *ctx, const char *payload, char *reply, size_t maxLen)
+{
+    gdbTestSendPacket(payload);
+    if(GDB_DoPacket(ctx) == -1)
+        return -1;
+
+    return gdbTestRecvPacket(reply, maxLen, NULL, 1000);
+}
@@ -0,0 +1,42 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+#pragma once
+
+#include "gdb.h"
+
+// GDB contexts connected to the test through socketpairs, set up like GDB_InitializeServer does, and a
+// mock debuggee whose memory is gdbTestMemory, mapped at GDB_TEST_MEM_BASE
+
+#define GDB_TEST_MEM_BASE   0x00100000
+#define GDB_TEST_MEM_SIZE   0x40000
+
+extern u8 gdbTestMemory[GDB_TEST_MEM_SIZE];
+extern bool gdbTestPageUnreadable[GDB_TEST_MEM_SIZE / 0x1000];
+extern u32 gdbTestNbMemoryReads, gdbTestNbMemoryWrites;
+
+// The other end of the socketpair of the selected context, which the functions below use
+extern int gdbTestPeer;
+
+// Up to MAX_DEBUG contexts of the same server can be open at the same time. Opening one selects it
+GDBContext *gdbTestOpen(void);
+void gdbTestSelect(GDBContext *ctx);
+void gdbTestClose(GDBContext *ctx);
+
+void gdbTestSendRaw(const void *data, size_t len);
+void gdbTestSendPacket(const char *payload);
+void gdbTestSendPacketData(const void *payload, size_t len);
+
+// Receives the next packet's payload (NUL-terminated) within the timeout, skipping and counting the acks before it.
+// Returns the payload length, or -1 on timeout or if the checksum is wrong
+int gdbTestRecvPacket(char *payload, size_t maxLen, u32 *nbAcks, int timeoutMs);
+
+// Receives whatever is available within the timeout
+int gdbTestRecvRaw(void *buf, size_t maxLen, int timeoutMs);
+
+// Sends a packet, handles it like the server does and returns the reply
+int gdbTestCommand(GDBContext *ctx, const char *payload, char *reply, size_t maxLen);
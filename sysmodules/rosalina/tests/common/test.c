@@ -0,0 +1,27 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+#include "test.h"
+
+int testFailures = 0;
+bool testBench = false;
+
+void testInit(int argc, char **argv)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--bench") == 0)
+            testBench = true;
+    }
+}
+
+int testExit(void)
+{
+    if(testFailures != 0)
+        printf("%d check(s) failed\n", testFailures);
+    return testFailures == 0 ? 0 : 1;
+}
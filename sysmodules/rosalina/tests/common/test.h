@@ -0,0 +1,65 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <3ds/types.h>
+
+// Minimal test helpers: CHECK records a failure and carries on, TEST_MAIN's return value is the exit status
+
+extern int testFailures;
+
+#define CHECK(cond) do {                                                                \
+    if(!(cond))                                                                         \
+    {                                                                                   \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);        \
+        testFailures++;                                                                 \
+    }                                                                                   \
+} while(0)
+
+#define CHECK_EQ(a, b) do {                                                             \
+    long long _a = (long long)(a), _b = (long long)(b);                                 \
+    if(_a != _b)                                                                        \
+    {                                                                                   \
+        fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n",               \
+                __FILE__, __LINE__, #a, #b, _a, _b);                                    \
+        testFailures++;                                                                 \
+    }                                                                                   \
+} while(0)
+
+#define RUN_TEST(fn) do {                                                               \
+    int _before = testFailures;                                                         \
+    fn();                                                                               \
+    printf("%s %s\n", testFailures == _before ? "ok  " : "FAIL", #fn);                  \
+} while(0)
+
+// Whether the benchmarks were asked for (--bench)
+extern bool testBench;
+
+void testInit(int argc, char **argv);
+int testExit(void);
+
+static inline u64 testNanoseconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Deterministic pseudo-random numbers (xorshift32), so that failures can be reproduced
+static inline u32 testRand(u32 *state)
+{
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
@@ -0,0 +1,510 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+// Host stand-in for the part of libctru used by the sources under test. Only what these sources need is here,
+// with the same names and signatures as libctru. The functions are implemented in ctru_shim.c, or by the tests.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/types.h>
+
+///@name Types
+///@{
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef volatile u8 vu8;
+typedef volatile u16 vu16;
+typedef volatile u32 vu32;
+typedef volatile u64 vu64;
+typedef volatile s8 vs8;
+typedef volatile s16 vs16;
+typedef volatile s32 vs32;
+typedef volatile s64 vs64;
+
+typedef u32 Handle;
+typedef s32 Result;
+typedef void (*ThreadFunc)(void *);
+
+#define U64_MAX UINT64_MAX
+
+#define BIT(n) (1U<<(n))
+#define ALIGN(m) __attribute__((aligned(m)))
+#define PACKED __attribute__((packed))
+#define NORETURN __attribute__((noreturn))
+#define CUR_PROCESS_HANDLE 0xFFFF8001
+///@}
+
+///@name Results
+///@{
+#define R_SUCCEEDED(res)   ((res)>=0)
+#define R_FAILED(res)      ((res)<0)
+#define R_LEVEL(res)       (((res)>>27)&0x1F)
+#define R_SUMMARY(res)     (((res)>>21)&0x3F)
+#define R_MODULE(res)      (((res)>>10)&0xFF)
+#define R_DESCRIPTION(res) ((res)&0x3FF)
+#define MAKERESULT(level,summary,module,description) \
+    ((((level)&0x1F)<<27) | (((summary)&0x3F)<<21) | (((module)&0xFF)<<10) | ((description)&0x3FF))
+
+enum { RL_SUCCESS = 0, RL_INFO = 1, RL_FATAL = 0x1F, RL_RESET = 0x1E, RL_REINITIALIZE = 0x1D, RL_USAGE = 0x1C,
+       RL_PERMANENT = 0x1B, RL_TEMPORARY = 0x1A, RL_STATUS = 0x19 };
+enum { RS_SUCCESS = 0, RS_NOP = 1, RS_WOULDBLOCK = 2, RS_OUTOFRESOURCE = 3, RS_NOTFOUND = 4, RS_INVALIDSTATE = 5,
+       RS_NOTSUPPORTED = 6, RS_INVALIDARG = 7, RS_WRONGARG = 8, RS_CANCELED = 9, RS_STATUSCHANGED = 10,
+       RS_INTERNAL = 11, RS_INVALIDRESVAL = 63 };
+enum { RM_COMMON = 0, RM_KERNEL = 1, RM_OS = 3, RM_FS = 17, RM_LDR = 40, RM_APPLICATION = 254 };
+enum { RD_SUCCESS = 0, RD_INVALID_RESULT_VALUE = 0x3FF, RD_TIMEOUT = 0x3FE, RD_OUT_OF_RANGE = 0x3FD,
+       RD_ALREADY_EXISTS = 0x3FC, RD_CANCEL_REQUESTED = 0x3FB, RD_NOT_FOUND = 0x3FA, RD_ALREADY_INITIALIZED = 0x3F9,
+       RD_NOT_INITIALIZED = 0x3F8, RD_INVALID_HANDLE = 0x3F7, RD_INVALID_POINTER = 0x3F6, RD_INVALID_ADDRESS = 0x3F5,
+       RD_NOT_IMPLEMENTED = 0x3F4, RD_OUT_OF_MEMORY = 0x3F3, RD_MISALIGNED_SIZE = 0x3F2,
+       RD_MISALIGNED_ADDRESS = 0x3F1, RD_BUSY = 0x3F0, RD_NO_DATA = 0x3EF, RD_INVALID_COMBINATION = 0x3EE,
+       RD_INVALID_ENUM_VALUE = 0x3ED, RD_INVALID_SIZE = 0x3EC, RD_ALREADY_DONE = 0x3EB, RD_NOT_AUTHORIZED = 0x3EA,
+       RD_TOO_LARGE = 0x3E9, RD_INVALID_SELECTION = 0x3E8 };
+///@}
+
+///@name IPC
+///@{
+typedef enum
+{
+    IPC_BUFFER_R  = BIT(1),
+    IPC_BUFFER_W  = BIT(2),
+    IPC_BUFFER_RW = IPC_BUFFER_R | IPC_BUFFER_W,
+} IPC_BufferRights;
+
+static inline u32 IPC_MakeHeader(u16 command_id, unsigned normal_params, unsigned translate_params)
+{
+    return ((u32)command_id << 16) | (((u32)normal_params & 0x3F) << 6) | (((u32)translate_params & 0x3F) << 0);
+}
+
+static inline u32 IPC_Desc_SharedHandles(unsigned number) { return ((u32)(number - 1) << 26); }
+static inline u32 IPC_Desc_CurProcessId(void) { return 0x20; }
+static inline u32 IPC_Desc_StaticBuffer(size_t size, unsigned buffer_id) { return (size << 14) | ((buffer_id & 0xF) << 10) | 0x2; }
+static inline u32 IPC_Desc_Buffer(size_t size, IPC_BufferRights rights) { return (size << 4) | 0x8 | rights; }
+
+u32 *getThreadCommandBuffer(void);
+u32 *getThreadStaticBuffers(void);
+///@}
+
+///@name Synchronization
+///@{
+typedef s32 LightLock;
+
+typedef struct
+{
+    LightLock lock;
+    u32 thread_tag;
+    u32 counter;
+} RecursiveLock;
+
+typedef struct
+{
+    s32 state;
+    LightLock lock;
+} LightEvent;
+
+typedef struct
+{
+    s32 current_count;
+    s16 num_threads;
+    s16 max_count;
+} LightSemaphore;
+
+#define AtomicIncrement(ptr)        __atomic_add_fetch((u32 *)(ptr), 1, __ATOMIC_SEQ_CST)
+#define AtomicDecrement(ptr)        __atomic_sub_fetch((u32 *)(ptr), 1, __ATOMIC_SEQ_CST)
+#define AtomicPostIncrement(ptr)    __atomic_fetch_add((u32 *)(ptr), 1, __ATOMIC_SEQ_CST)
+#define AtomicPostDecrement(ptr)    __atomic_fetch_sub((u32 *)(ptr), 1, __ATOMIC_SEQ_CST)
+#define AtomicSwap(ptr, value)      __atomic_exchange_n((u32 *)(ptr), (value), __ATOMIC_SEQ_CST)
+
+static inline void __dmb(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+static inline void __dsb(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+
+void LightLock_Init(LightLock *lock);
+void LightLock_Lock(LightLock *lock);
+int LightLock_TryLock(LightLock *lock);
+void LightLock_Unlock(LightLock *lock);
+void RecursiveLock_Init(RecursiveLock *lock);
+void RecursiveLock_Lock(RecursiveLock *lock);
+int RecursiveLock_TryLock(RecursiveLock *lock);
+void RecursiveLock_Unlock(RecursiveLock *lock);
+void LightEvent_Init(LightEvent *event, int reset_type);
+void LightEvent_Clear(LightEvent *event);
+void LightEvent_Signal(LightEvent *event);
+void LightEvent_Wait(LightEvent *event);
+///@}
+
+///@name SVCs
+///@{
+typedef enum
+{
+    MEMOP_FREE = 1, MEMOP_RESERVE = 2, MEMOP_ALLOC = 3, MEMOP_MAP = 4, MEMOP_UNMAP = 5, MEMOP_PROT = 6,
+    MEMOP_REGION_APP = 0x100, MEMOP_REGION_SYSTEM = 0x200, MEMOP_REGION_BASE = 0x300, MEMOP_REGION_MASK = 0xF00,
+    MEMOP_LINEAR_FLAG = 0x10000, MEMOP_ALLOC_LINEAR = MEMOP_LINEAR_FLAG | MEMOP_ALLOC,
+} MemOp;
+
+typedef enum
+{
+    MEMSTATE_FREE = 0, MEMSTATE_RESERVED = 1, MEMSTATE_IO = 2, MEMSTATE_STATIC = 3, MEMSTATE_CODE = 4,
+    MEMSTATE_PRIVATE = 5, MEMSTATE_SHARED = 6, MEMSTATE_CONTINUOUS = 7, MEMSTATE_ALIASED = 8, MEMSTATE_ALIAS = 9,
+    MEMSTATE_ALIASCODE = 10, MEMSTATE_LOCKED = 11,
+} MemState;
+
+typedef enum
+{
+    MEMPERM_READ = 1, MEMPERM_WRITE = 2, MEMPERM_EXECUTE = 4, MEMPERM_READWRITE = MEMPERM_READ | MEMPERM_WRITE,
+    MEMPERM_READEXECUTE = MEMPERM_READ | MEMPERM_EXECUTE, MEMPERM_DONTCARE = 0x10000000,
+} MemPerm;
+
+typedef enum
+{
+    MEMREGION_ALL = 0, MEMREGION_APPLICATION = 1, MEMREGION_SYSTEM = 2, MEMREGION_BASE = 3,
+} MemRegion;
+
+typedef struct
+{
+    u32 base_addr;
+    u32 size;
+    u32 perm;
+    u32 state;
+} MemInfo;
+
+typedef struct
+{
+    u32 flags;
+} PageInfo;
+
+typedef enum
+{
+    RESET_ONESHOT = 0, RESET_STICKY = 1, RESET_PULSE = 2,
+} ResetType;
+
+typedef enum
+{
+    USERBREAK_PANIC = 0, USERBREAK_ASSERT = 1, USERBREAK_USER = 2, USERBREAK_LOAD_RO = 3, USERBREAK_UNLOAD_RO = 4,
+} UserBreakType;
+
+typedef enum
+{
+    DBGEVENT_ATTACH_PROCESS = 0, DBGEVENT_ATTACH_THREAD = 1, DBGEVENT_EXIT_THREAD = 2, DBGEVENT_EXIT_PROCESS = 3,
+    DBGEVENT_EXCEPTION = 4, DBGEVENT_DLL_LOAD = 5, DBGEVENT_DLL_UNLOAD = 6, DBGEVENT_SCHEDULE_IN = 7,
+    DBGEVENT_SCHEDULE_OUT = 8, DBGEVENT_SYSCALL_IN = 9, DBGEVENT_SYSCALL_OUT = 10, DBGEVENT_OUTPUT_STRING = 11,
+    DBGEVENT_MAP = 12,
+} DebugEventType;
+
+typedef enum
+{
+    EXITPROCESS_EVENT_EXIT = 0, EXITPROCESS_EVENT_TERMINATE = 1, EXITPROCESS_EVENT_DEBUG_TERMINATE = 2,
+} ExitProcessEventReason;
+
+typedef enum
+{
+    EXITTHREAD_EVENT_EXIT = 0, EXITTHREAD_EVENT_TERMINATE = 1, EXITTHREAD_EVENT_EXIT_PROCESS = 2,
+    EXITTHREAD_EVENT_TERMINATE_PROCESS = 3,
+} ExitThreadEventReason;
+
+typedef enum
+{
+    EXCEVENT_UNDEFINED_INSTRUCTION = 0, EXCEVENT_PREFETCH_ABORT = 1, EXCEVENT_DATA_ABORT = 2,
+    EXCEVENT_UNALIGNED_DATA_ACCESS = 3, EXCEVENT_ATTACH_BREAK = 4, EXCEVENT_STOP_POINT = 5, EXCEVENT_USER_BREAK = 6,
+    EXCEVENT_DEBUGGER_BREAK = 7, EXCEVENT_UNDEFINED_SYSCALL = 8,
+} ExceptionEventType;
+
+typedef enum
+{
+    STOPPOINT_SVC_FF = 0, STOPPOINT_BREAKPOINT = 1, STOPPOINT_WATCHPOINT = 2,
+} StopPointType;
+
+typedef struct { u64 program_id; char process_name[8]; u32 process_id; u32 other_flags; } AttachProcessEvent;
+typedef struct { u32 creator_thread_id; u32 thread_local_storage; u32 entry_point; } AttachThreadEvent;
+typedef struct { ExitThreadEventReason reason; } ExitThreadEvent;
+typedef struct { ExitProcessEventReason reason; } ExitProcessEvent;
+typedef struct { u32 fault_information; } FaultExceptionEvent;
+typedef struct { StopPointType type; u32 fault_information; } StopPointExceptionEvent;
+typedef struct { UserBreakType type; u32 croInfo; u32 croInfoSize; } UserBreakExceptionEvent;
+typedef struct { s32 thread_ids[4]; } DebuggerBreakExceptionEvent;
+
+typedef struct
+{
+    ExceptionEventType type;
+    u32 address;
+    union
+    {
+        FaultExceptionEvent fault;
+        StopPointExceptionEvent stop_point;
+        UserBreakExceptionEvent user_break;
+        DebuggerBreakExceptionEvent debugger_break;
+    };
+} ExceptionEvent;
+
+typedef struct { u64 clock_tick; } ScheduleInOutEvent;
+typedef struct { u64 clock_tick; u32 syscall; } SyscallInOutEvent;
+typedef struct { u32 string_addr; u32 string_size; } OutputStringEvent;
+typedef struct { u32 mapped_addr; u32 mapped_size; MemPerm memperm; MemState memstate; } MapEvent;
+
+typedef struct
+{
+    DebugEventType type;
+    u32 thread_id;
+    u32 flags;
+    u8 remnants[4];
+    union
+    {
+        AttachProcessEvent attach_process;
+        AttachThreadEvent attach_thread;
+        ExitThreadEvent exit_thread;
+        ExitProcessEvent exit_process;
+        ExceptionEvent exception;
+        ScheduleInOutEvent scheduler;
+        SyscallInOutEvent syscall;
+        OutputStringEvent output_string;
+        MapEvent map;
+    };
+} DebugEventInfo;
+
+typedef enum
+{
+    DBG_INHIBIT_USER_CPU_EXCEPTION_HANDLERS = BIT(0), DBG_SIGNAL_FAULT_EXCEPTION_EVENTS = BIT(1),
+    DBG_SIGNAL_SCHEDULE_EVENTS = BIT(2), DBG_SIGNAL_SYSCALL_EVENTS = BIT(3), DBG_SIGNAL_MAP_EVENTS = BIT(4),
+} DebugFlags;
+
+typedef struct { u32 r[13]; u32 sp; u32 lr; u32 pc; u32 cpsr; } CpuRegisters;
+
+typedef struct
+{
+    union
+    {
+        struct PACKED { double d[16]; };
+        float s[32];
+    };
+    u32 fpscr;
+    u32 fpexc;
+} FpuRegisters;
+
+typedef struct
+{
+    CpuRegisters cpu_registers;
+    FpuRegisters fpu_registers;
+} ThreadContext;
+
+typedef enum
+{
+    THREADCONTEXT_CONTROL_CPU_GPRS = BIT(0), THREADCONTEXT_CONTROL_CPU_SPRS = BIT(1),
+    THREADCONTEXT_CONTROL_FPU_GPRS = BIT(2), THREADCONTEXT_CONTROL_FPU_SPRS = BIT(3),
+    THREADCONTEXT_CONTROL_CPU_REGS = BIT(0) | BIT(1), THREADCONTEXT_CONTROL_FPU_REGS = BIT(2) | BIT(3),
+    THREADCONTEXT_CONTROL_ALL = BIT(0) | BIT(1) | BIT(2) | BIT(3),
+} ThreadContextControlFlags;
+
+typedef enum
+{
+    DBGTHREAD_PARAMETER_PRIORITY = 0, DBGTHREAD_PARAMETER_SCHEDULING_MASK_LOW = 1,
+    DBGTHREAD_PARAMETER_CPU_IDEAL = 2, DBGTHREAD_PARAMETER_CPU_CREATOR = 3,
+} DebugThreadParameter;
+
+Result svcControlMemory(u32 *addr_out, u32 addr0, u32 addr1, u32 size, MemOp op, MemPerm perm);
+Result svcQueryMemory(MemInfo *info, PageInfo *out, u32 addr);
+Result svcQueryProcessMemory(MemInfo *info, PageInfo *out, Handle process, u32 addr);
+Result svcCreateMemoryBlock(Handle *memblock, u32 addr, u32 size, MemPerm my_perm, MemPerm other_perm);
+Result svcOpenProcess(Handle *process, u32 processId);
+Result svcGetProcessId(u32 *out, Handle handle);
+Result svcGetProcessInfo(s64 *out, Handle process, u32 type);
+Result svcGetProcessList(s32 *processCount, u32 *processIds, s32 processIdMaxCount);
+Result svcGetThreadList(s32 *threadCount, u32 *threadIds, s32 threadIdMaxCount, Handle process);
+Result svcOpenThread(Handle *thread, Handle process, u32 threadId);
+Result svcGetThreadId(u32 *out, Handle handle);
+Result svcGetThreadPriority(s32 *out, Handle handle);
+Result svcCreateEvent(Handle *event, ResetType reset_type);
+Result svcSignalEvent(Handle handle);
+Result svcClearEvent(Handle handle);
+Result svcWaitSynchronization(Handle handle, s64 nanoseconds);
+Result svcWaitSynchronizationN(s32 *out, const Handle *handles, s32 handles_num, bool wait_all, s64 nanoseconds);
+Result svcCloseHandle(Handle handle);
+Result svcDuplicateHandle(Handle *out, Handle original);
+void svcSleepThread(s64 ns);
+u64 svcGetSystemTick(void);
+Result svcGetSystemInfo(s64 *out, u32 type, s32 param);
+Result svcGetHandleInfo(s64 *out, Handle handle, u32 param);
+Result svcKernelSetState(u32 type, ...);
+void svcBreak(UserBreakType breakReason);
+Result svcSendSyncRequest(Handle session);
+Result svcDebugActiveProcess(Handle *debug, u32 processId);
+Result svcBreakDebugProcess(Handle debug);
+Result svcTerminateDebugProcess(Handle debug);
+Result svcGetProcessDebugEvent(DebugEventInfo *info, Handle debug);
+Result svcContinueDebugEvent(Handle debug, DebugFlags flags);
+Result svcGetDebugThreadContext(ThreadContext *context, Handle debug, u32 threadId, ThreadContextControlFlags controlFlags);
+Result svcSetDebugThreadContext(Handle debug, u32 threadId, const ThreadContext *context, ThreadContextControlFlags controlFlags);
+Result svcQueryDebugProcessMemory(MemInfo *info, PageInfo *out, Handle debug, u32 addr);
+Result svcReadProcessMemory(void *buffer, Handle debug, u32 addr, u32 size);
+Result svcWriteProcessMemory(Handle debug, const void *buffer, u32 addr, u32 size);
+Result svcSetHardwareBreakPoint(s32 registerId, u32 control, u32 value);
+Result svcGetDebugThreadParam(s64 *unused, u32 *out, Handle debug, u32 threadId, DebugThreadParameter parameter);
+Result svcFlushProcessDataCache(Handle process, u32 addr, u32 size);
+Result svcInvalidateProcessDataCache(Handle process, u32 addr, u32 size);
+///@}
+
+///@name OS
+///@{
+#define SYSCLOCK_SOC       (16756991)
+#define SYSCLOCK_ARM9      (SYSCLOCK_SOC * 8)
+#define SYSCLOCK_ARM11     (SYSCLOCK_ARM9 * 2)
+#define SYSCLOCK_ARM11_NEW (SYSCLOCK_ARM11 * 3)
+#define CPU_TICKS_PER_MSEC (SYSCLOCK_ARM11 / 1000.0)
+#define CPU_TICKS_PER_USEC (SYSCLOCK_ARM11 / 1000000.0)
+
+#define SYSTEM_VERSION(major, minor, revision) (((major)<<24)|((minor)<<16)|((revision)<<8))
+#define GET_VERSION_MAJOR(version)    ((version) >>24)
+#define GET_VERSION_MINOR(version)    (((version)>>16)&0xFF)
+#define GET_VERSION_REVISION(version) (((version)>> 8)&0xFF)
+
+u32 osGetKernelVersion(void);
+u32 osGetFirmVersion(void);
+s64 osGetMemRegionFree(MemRegion region);
+s64 osGetMemRegionUsed(MemRegion region);
+u64 osGetTime(void);
+///@}
+
+///@name Services
+///@{
+Result srvGetServiceHandle(Handle *out, const char *name);
+Result srvIsServiceRegistered(bool *registered, const char *name);
+
+typedef enum
+{
+    NDM_EXCLUSIVE_STATE_NONE = 0, NDM_EXCLUSIVE_STATE_INFRASTRUCTURE = 1, NDM_EXCLUSIVE_STATE_LOCAL_COMMUNICATIONS = 2,
+    NDM_EXCLUSIVE_STATE_STREETPASS = 3, NDM_EXCLUSIVE_STATE_STREETPASS_DATA = 4,
+} NDM_ExclusiveState;
+
+Result ndmuInit(void);
+void ndmuExit(void);
+Result NDMU_EnterExclusiveState(NDM_ExclusiveState state);
+Result NDMU_LeaveExclusiveState(void);
+Result NDMU_LockState(void);
+Result NDMU_UnlockState(void);
+
+typedef enum
+{
+    PATH_INVALID = 0, PATH_EMPTY = 1, PATH_BINARY = 2, PATH_ASCII = 3, PATH_UTF16 = 4,
+} FS_PathType;
+
+typedef enum
+{
+    ARCHIVE_ROMFS = 0x00000003, ARCHIVE_SAVEDATA = 0x00000004, ARCHIVE_EXTDATA = 0x00000006,
+    ARCHIVE_SDMC = 0x00000009, ARCHIVE_SDMC_WRITE_ONLY = 0x0000000A, ARCHIVE_NAND_RW = 0x1234567D,
+    ARCHIVE_NAND_RO = 0x1234567E, ARCHIVE_NAND_RO_WRITE_ACCESS = 0x1234567F, ARCHIVE_NAND_CTR_FS = 0x567890AB,
+    ARCHIVE_NAND_TWL_FS = 0x567890AC,
+} FS_ArchiveID;
+
+typedef enum
+{
+    MEDIATYPE_NAND = 0, MEDIATYPE_SD = 1, MEDIATYPE_GAME_CARD = 2,
+} FS_MediaType;
+
+#define FS_OPEN_READ   BIT(0)
+#define FS_OPEN_WRITE  BIT(1)
+#define FS_OPEN_CREATE BIT(2)
+#define FS_WRITE_FLUSH       BIT(0)
+#define FS_WRITE_UPDATE_TIME BIT(8)
+#define FS_ATTRIBUTE_DIRECTORY BIT(0)
+
+typedef u64 FS_Archive;
+
+typedef struct
+{
+    FS_PathType type;
+    u32 size;
+    const void *data;
+} FS_Path;
+
+typedef struct
+{
+    u16 name[0x106];
+    char shortName[0x0A];
+    char shortExt[0x04];
+    u8 valid;
+    u8 reserved;
+    u32 attributes;
+    u64 fileSize;
+} FS_DirectoryEntry;
+
+typedef struct PACKED
+{
+    u64 programId;
+    FS_MediaType mediaType : 8;
+    u8 padding[7];
+} FS_ProgramInfo;
+
+FS_Path fsMakePath(FS_PathType type, const void *path);
+Result FSUSER_OpenArchive(FS_Archive *archive, FS_ArchiveID id, FS_Path path);
+Result FSUSER_CloseArchive(FS_Archive archive);
+Result FSUSER_OpenFile(Handle *out, FS_Archive archive, FS_Path path, u32 openFlags, u32 attributes);
+Result FSUSER_OpenFileDirectly(Handle *out, FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, u32 openFlags, u32 attributes);
+Result FSUSER_OpenDirectory(Handle *out, FS_Archive archive, FS_Path path);
+Result FSUSER_DeleteFile(FS_Archive archive, FS_Path path);
+Result FSUSER_CreateFile(FS_Archive archive, FS_Path path, u32 attributes, u64 fileSize);
+Result FSUSER_CreateDirectory(FS_Archive archive, FS_Path path, u32 attributes);
+Result FSFILE_Read(Handle handle, u32 *bytesRead, u64 offset, void *buffer, u32 size);
+Result FSFILE_Write(Handle handle, u32 *bytesWritten, u64 offset, const void *buffer, u32 size, u32 flags);
+Result FSFILE_GetSize(Handle handle, u64 *size);
+Result FSFILE_SetSize(Handle handle, u64 size);
+Result FSFILE_Close(Handle handle);
+Result FSDIR_Read(Handle handle, u32 *entriesRead, u32 entryCount, FS_DirectoryEntry *entries);
+Result FSDIR_Close(Handle handle);
+
+#define PMLAUNCHFLAG_NORMAL_APPLICATION         BIT(0)
+#define PMLAUNCHFLAG_LOAD_DEPENDENCIES          BIT(1)
+#define PMLAUNCHFLAG_NOTIFY_TERMINATION         BIT(2)
+#define PMLAUNCHFLAG_QUEUE_DEBUG_APPLICATION    BIT(3)
+#define PMLAUNCHFLAG_TERMINATION_NOTIFICATION_MASK 0xF0
+#define PMLAUNCHFLAG_FORCE_USE_O3DS_APP_MEM     BIT(8)
+#define PMLAUNCHFLAG_USE_UPDATE_TITLE           BIT(16)
+
+Result PMDBG_GetCurrentAppInfo(FS_ProgramInfo *outProgramInfo, u32 *outPid, u32 *outLaunchFlags);
+Result PMDBG_DebugNextApplicationByForce(bool debug);
+Result PMDBG_LaunchAppDebug(Handle *outDebug, const FS_ProgramInfo *programInfo, u32 launchFlags);
+Result PMAPP_TerminateTitle(u64 titleId, s64 timeout);
+
+typedef enum
+{
+    KEY_A = BIT(0), KEY_B = BIT(1), KEY_SELECT = BIT(2), KEY_START = BIT(3), KEY_DRIGHT = BIT(4), KEY_DLEFT = BIT(5),
+    KEY_DUP = BIT(6), KEY_DDOWN = BIT(7), KEY_R = BIT(8), KEY_L = BIT(9), KEY_X = BIT(10), KEY_Y = BIT(11),
+    KEY_ZL = BIT(14), KEY_ZR = BIT(15), KEY_TOUCH = BIT(20), KEY_CSTICK_RIGHT = BIT(24), KEY_CSTICK_LEFT = BIT(25),
+    KEY_CSTICK_UP = BIT(26), KEY_CSTICK_DOWN = BIT(27), KEY_CPAD_RIGHT = BIT(28), KEY_CPAD_LEFT = BIT(29),
+    KEY_CPAD_UP = BIT(30), KEY_CPAD_DOWN = BIT(31),
+    KEY_UP = KEY_DUP | KEY_CPAD_UP, KEY_DOWN = KEY_DDOWN | KEY_CPAD_DOWN, KEY_LEFT = KEY_DLEFT | KEY_CPAD_LEFT,
+    KEY_RIGHT = KEY_DRIGHT | KEY_CPAD_RIGHT,
+} PAD_KEY;
+
+typedef struct
+{
+    u16 px;
+    u16 py;
+} touchPosition;
+///@}
+
+///@name GFX
+///@{
+typedef enum
+{
+    GSP_RGBA8_OES = 0, GSP_BGR8_OES = 1, GSP_RGB565_OES = 2, GSP_RGB5_A1_OES = 3, GSP_RGBA4_OES = 4,
+} GSPGPU_FramebufferFormat;
+
+#define RGB565(r,g,b)  (((b)&0x1f)|(((g)&0x3f)<<5)|(((r)&0x1f)<<11))
+#define RGB8_to_565(r,g,b)  (((b)>>3)&0x1f)|((((g)>>2)&0x3f)<<5)|((((r)>>3)&0x1f)<<11)
+///@}
+
+///@name Unicode
+///@{
+ssize_t utf8_to_utf16(u16 *out, const u8 *in, size_t len);
+ssize_t utf16_to_utf8(u8 *out, const u16 *in, size_t len);
+///@}
@@ -0,0 +1,4 @@
+#pragma once
+
+#include <3ds.h>
+#include <netinet/in.h>
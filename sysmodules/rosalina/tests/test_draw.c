@@ -0,0 +1,229 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+// Screenshot framebuffer conversion (Draw_ConvertFrameBufferLines), compared against a pixel by pixel conversion.
+// The GPU registers and the framebuffers are mapped where Rosalina expects them
+
+#include <stdarg.h>
+#include <sys/mman.h>
+#include "test.h"
+#include "draw.h"
+
+#define REGS_VA         0x90400000  // PA_PTR(0x10400000)
+#define FB_PA           0x18000000
+#define FB_VA           (FB_PA + 0xC0000000)  // KERNPA2VA, recent kernels
+#define FB_MAX_SIZE     0xC0000
+
+static u8 *framebuffer = (u8 *)FB_VA;
+static u8 output[800 * 240 * 3 + 8], refOutput[800 * 240 * 3 + 8];
+
+static const u8 formatSizes[] = { 4, 3, 2, 2, 2 };
+static const char *formatNames[] = { "RGBA8", "BGR8", "RGB565", "RGB5A1", "RGBA4" };
+
+// What converting used to look like: a switch per pixel
+static void referenceConvertPixel(u8 *dst, const u8 *src, GSPGPU_FramebufferFormat srcFormat)
+{
+    u8 red, green, blue;
+    u16 px;
+
+    switch(srcFormat)
+    {
+        case GSP_RGBA8_OES:
+            dst[0] = src[1];
+            dst[1] = src[2];
+            dst[2] = src[3];
+            break;
+        case GSP_BGR8_OES:
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+            break;
+        case GSP_RGB565_OES:
+            px = src[0] | (src[1] << 8);
+            blue = px & 0x1F;
+            green = (px >> 5) & 0x3F;
+            red = (px >> 11) & 0x1F;
+            dst[0] = (blue << 3) | (blue >> 2);
+            dst[1] = (green << 2) | (green >> 4);
+            dst[2] = (red << 3) | (red >> 2);
+            break;
+        case GSP_RGB5_A1_OES:
+            px = src[0] | (src[1] << 8);
+            blue = (px >> 1) & 0x1F;
+            green = (px >> 6) & 0x1F;
+            red = (px >> 11) & 0x1F;
+            dst[0] = (blue << 3) | (blue >> 2);
+            dst[1] = (green << 3) | (green >> 2);
+            dst[2] = (red << 3) | (red >> 2);
+            break;
+        case GSP_RGBA4_OES:
+            px = src[0] | (src[1] << 8);
+            blue = (px >> 4) & 0xF;
+            green = (px >> 8) & 0xF;
+            red = (px >> 12) & 0xF;
+            dst[0] = (blue << 4) | blue;
+            dst[1] = (green << 4) | green;
+            dst[2] = (red << 4) | red;
+            break;
+        default:
+            break;
+    }
+}
+
+static void referenceConvertLines(u8 *buf, u32 width, u32 startingLine, u32 numLines, GSPGPU_FramebufferFormat fmt, u32 stride)
+{
+    for(u32 y = startingLine; y < startingLine + numLines; y++)
+    {
+        for(u32 x = 0; x < width; x++)
+            referenceConvertPixel(buf + (x + width * (y - startingLine)) * 3, framebuffer + x * stride + y * formatSizes[fmt], fmt);
+    }
+}
+
+// Runs the kernel function right away
+Result svcCustomBackdoor(void *func, ...)
+{
+    va_list args;
+    va_start(args, func);
+    ((void (*)(void *))func)(va_arg(args, void *));
+    va_end(args);
+    return 0;
+}
+
+static void mapFixed(u32 addr, u32 size)
+{
+    if(mmap((void *)(uintptr_t)addr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) != (void *)(uintptr_t)addr)
+    {
+        perror("mmap");
+        exit(1);
+    }
+}
+
+static void setupScreen(bool top, GSPGPU_FramebufferFormat fmt, u32 stride)
+{
+    GPU_FB_TOP_SEL = GPU_FB_BOTTOM_SEL = 0;
+    GPU_FB_TOP_LEFT_ADDR_1 = GPU_FB_TOP_RIGHT_ADDR_1 = GPU_FB_BOTTOM_ADDR_1 = FB_PA;
+    if(top)
+    {
+        GPU_FB_TOP_FMT = fmt;
+        GPU_FB_TOP_STRIDE = stride;
+        GPU_FB_BOTTOM_FMT = 7; // garbage, not used
+    }
+    else
+    {
+        GPU_FB_BOTTOM_FMT = fmt;
+        GPU_FB_BOTTOM_STRIDE = stride;
+        GPU_FB_TOP_FMT = 7;
+    }
+}
+
+static void fillFramebuffer(u32 seed)
+{
+    for(u32 i = 0; i < FB_MAX_SIZE; i++)
+        framebuffer[i] = testRand(&seed);
+}
+
+static void testAllFormats(void)
+{
+    static const u32 widths[] = { 400, 320, 800, 4, 7, 398 };
+    static const u32 lines[][2] = { { 0, 240 }, { 0, 1 }, { 1, 1 }, { 1, 2 }, { 3, 7 }, { 17, 16 }, { 238, 2 }, { 5, 0 } };
+    u32 nbMismatches = 0;
+
+    fillFramebuffer(1);
+    for(u32 fmt = 0; fmt < 5; fmt++)
+    {
+        for(u32 w = 0; w < sizeof(widths) / sizeof(widths[0]); w++)
+        {
+            for(u32 l = 0; l < sizeof(lines) / sizeof(lines[0]); l++)
+            {
+                // Packed columns, and padded ones
+                for(u32 pad = 0; pad <= 8; pad += 8)
+                {
+                    // Word-aligned output buffer, and not
+                    for(u32 bufOff = 0; bufOff <= 1; bufOff++)
+                    {
+                        u32 width = widths[w], startingLine = lines[l][0], numLines = lines[l][1];
+                        u32 stride = 240 * formatSizes[fmt] + pad;
+                        bool top = width != 320;
+
+                        memset(output, 0xCC, sizeof(output));
+                        memset(refOutput, 0xCC, sizeof(refOutput));
+                        setupScreen(top, (GSPGPU_FramebufferFormat)fmt, stride);
+
+                        Draw_ConvertFrameBufferLines(output + bufOff, width, startingLine, numLines, top, true);
+                        referenceConvertLines(refOutput + bufOff, width, startingLine, numLines, (GSPGPU_FramebufferFormat)fmt, stride);
+
+                        if(memcmp(output, refOutput, sizeof(output)) != 0 && nbMismatches++ < 5)
+                            printf("    mismatch: %s, width %lu, lines %lu-%lu, stride %lu, offset %lu\n", formatNames[fmt],
+                                   (unsigned long)width, (unsigned long)startingLine, (unsigned long)(startingLine + numLines),
+                                   (unsigned long)stride, (unsigned long)bufOff);
+                    }
+                }
+            }
+        }
+    }
+
+    CHECK_EQ(nbMismatches, 0);
+}
+
+static void testInvalidFormat(void)
+{
+    // Formats 5 to 7 don't exist: nothing is converted
+    for(u32 fmt = 5; fmt < 8; fmt++)
+    {
+        setupScreen(true, (GSPGPU_FramebufferFormat)fmt, 240 * 4);
+        memset(output, 0xCC, sizeof(output));
+        Draw_ConvertFrameBufferLines(output, 400, 0, 240, true, true);
+        CHECK(output[0] == 0xCC && output[400 * 240 * 3 - 1] == 0xCC);
+    }
+}
+
+static void benchConversion(void)
+{
+    u32 nb = 100;
+
+    fillFramebuffer(2);
+    for(u32 fmt = 0; fmt < 5; fmt++)
+    {
+        u32 stride = 240 * formatSizes[fmt];
+        setupScreen(true, (GSPGPU_FramebufferFormat)fmt, stride);
+
+        // Screenshots are taken in chunks of lines
+        u64 start = testNanoseconds();
+        for(u32 i = 0; i < nb; i++)
+        {
+            for(u32 y = 0; y < 240; y += 48)
+                Draw_ConvertFrameBufferLines(output, 400, y, 48, true, true);
+        }
+        u64 elapsed = testNanoseconds() - start;
+
+        start = testNanoseconds();
+        for(u32 i = 0; i < nb; i++)
+        {
+            for(u32 y = 0; y < 240; y += 48)
+                referenceConvertLines(refOutput, 400, y, 48, (GSPGPU_FramebufferFormat)fmt, stride);
+        }
+        u64 refElapsed = testNanoseconds() - start;
+
+        printf("%-6s: %.3f ms per top screen, pixel by pixel: %.3f ms\n", formatNames[fmt], elapsed / 1e6 / nb, refElapsed / 1e6 / nb);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    testInit(argc, argv);
+
+    mapFixed(REGS_VA, 0x2000);
+    mapFixed(FB_VA, FB_MAX_SIZE);
+
+    RUN_TEST(testAllFormats);
+    RUN_TEST(testInvalidFormat);
+
+    if(testBench)
+        benchConversion();
+
+    return testExit();
+}
@@ -0,0 +1,318 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+// Hash-indexed breakpoint table and deferred memory patching, against a model of what should be in memory
+
+#include "test.h"
+#include "gdb_test.h"
+#include "gdb/breakpoints.h"
+#include "gdb/mem.h"
+
+#define _REENT_ONLY
+#include <errno.h>
+
+// Breakpoint addresses are taken from a pool of words, a third of them for Thumb breakpoints
+#define POOL_SIZE   0x300
+
+static u8 originalMemory[GDB_TEST_MEM_SIZE];
+static u8 memoryView[POOL_SIZE * 4];
+static u8 wanted[POOL_SIZE], installed[POOL_SIZE]; // the model: instruction sizes, 0 if none
+static char reply[64];
+
+static inline u32 poolAddress(u32 i)
+{
+    return GDB_TEST_MEM_BASE + 4 * i;
+}
+
+static inline u8 poolSize(u32 i)
+{
+    return i % 3 == 0 ? 2 : 4;
+}
+
+static void resetMemory(u32 seed)
+{
+    for(u32 i = 0; i < GDB_TEST_MEM_SIZE; i++)
+        gdbTestMemory[i] = testRand(&seed);
+    memcpy(originalMemory, gdbTestMemory, GDB_TEST_MEM_SIZE);
+    memset(wanted, 0, sizeof(wanted));
+    memset(installed, 0, sizeof(installed));
+}
+
+// Whether the memory at the pool address has the breakpoint instruction of the given size, or the original instruction
+static bool hasBreakpoint(const u8 *mem, u32 i, u8 size)
+{
+    u32 instr = size == 2 ? BREAKPOINT_INSTRUCTION_THUMB : BREAKPOINT_INSTRUCTION_ARM;
+    return memcmp(mem + 4 * i, &instr, size) == 0;
+}
+
+static bool hasOriginalInstruction(const u8 *mem, u32 i)
+{
+    return memcmp(mem + 4 * i, originalMemory + 4 * i, 4) == 0;
+}
+
+static u32 tableSize(void)
+{
+    u32 n = 0;
+    for(u32 i = 0; i < POOL_SIZE; i++)
+        n += wanted[i] != 0 || installed[i] != 0;
+    return n;
+}
+
+// The table and its index against the model
+static bool checkTable(GDBContext *ctx)
+{
+    u32 nbIndexed = 0;
+    for(u32 slot = 0; slot < GDB_BREAKPOINT_HASH_SIZE; slot++)
+        nbIndexed += ctx->breakpointIndex[slot] != 0;
+    if(nbIndexed != ctx->nbBreakpoints || ctx->nbBreakpoints != tableSize())
+        return false;
+
+    for(u32 i = 0; i < ctx->nbBreakpoints; i++)
+    {
+        if(GDB_FindBreakpoint(ctx, ctx->breakpoints[i].address) != &ctx->breakpoints[i])
+            return false;
+    }
+
+    for(u32 i = 0; i < POOL_SIZE; i++)
+    {
+        Breakpoint *bkpt = GDB_FindBreakpoint(ctx, poolAddress(i));
+        if((bkpt != NULL) != (wanted[i] != 0 || installed[i] != 0))
+            return false;
+        else if(bkpt != NULL && (bkpt->enabled != (wanted[i] != 0) || bkpt->installed != (installed[i] != 0) ||
+                                 bkpt->instructionSize != poolSize(i)))
+            return false;
+    }
+
+    return true;
+}
+
+// What the client sees: pending removals are hidden
+static bool checkMemoryView(GDBContext *ctx)
+{
+    if(GDB_ReadTargetMemory(memoryView, ctx, GDB_TEST_MEM_BASE, sizeof(memoryView)) != sizeof(memoryView))
+        return false;
+
+    for(u32 i = 0; i < POOL_SIZE; i++)
+    {
+        if(wanted[i] != 0 && installed[i] != 0 ? !hasBreakpoint(memoryView, i, poolSize(i)) : !hasOriginalInstruction(memoryView, i))
+            return false;
+    }
+
+    return true;
+}
+
+static void testRandomEdits(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    u32 seed = 1;
+    u32 nbMismatches = 0, nbSyncs = 0, nbBusy = 0;
+
+    resetMemory(seed);
+    for(u32 t = 0; t < 20000; t++)
+    {
+        u32 i = testRand(&seed) % POOL_SIZE;
+        u32 r = testRand(&seed) % 100;
+        bool usePacket = testRand(&seed) % 4 == 0;
+        u32 nbReads = gdbTestNbMemoryReads;
+        int res;
+
+        if(r < 55)
+        {
+            // Add: new entries read the original instruction once, and there's room for MAX_BREAKPOINT of them
+            bool isNew = wanted[i] == 0 && installed[i] == 0;
+            int expected = isNew && tableSize() == MAX_BREAKPOINT ? -EBUSY : 0;
+
+            if(usePacket)
+            {
+                char cmd[32];
+                sprintf(cmd, "Z0,%lx,%x", (unsigned long)poolAddress(i), poolSize(i));
+                gdbTestCommand(ctx, cmd, reply, sizeof(reply));
+                res = strcmp(reply, "OK") == 0 ? 0 : strcmp(reply, "E10") == 0 ? -EBUSY : -1000;
+            }
+            else
+                res = GDB_AddBreakpoint(ctx, poolAddress(i), poolSize(i) == 2, false);
+
+            nbMismatches += res != expected || gdbTestNbMemoryReads - nbReads != (isNew && expected == 0 ? 1u : 0u);
+            if(res == 0)
+                wanted[i] = poolSize(i);
+            else
+                nbBusy++;
+        }
+        else if(r < 98)
+        {
+            // Remove: only what was added can be removed
+            int expected = wanted[i] != 0 ? 0 : -EINVAL;
+            if(usePacket)
+            {
+                char cmd[32];
+                sprintf(cmd, "z0,%lx,%x", (unsigned long)poolAddress(i), poolSize(i));
+                gdbTestCommand(ctx, cmd, reply, sizeof(reply));
+                res = strcmp(reply, "OK") == 0 ? 0 : strcmp(reply, "E16") == 0 ? -EINVAL : -1000;
+            }
+            else
+                res = GDB_RemoveBreakpoint(ctx, poolAddress(i));
+
+            nbMismatches += res != expected;
+            wanted[i] = 0;
+        }
+        else
+        {
+            // Continue: exactly the breakpoints which changed are written, once
+            u32 nbChanges = 0;
+            for(u32 j = 0; j < POOL_SIZE; j++)
+                nbChanges += wanted[j] != installed[j];
+
+            u32 nbWrites = gdbTestNbMemoryWrites;
+            GDB_SyncBreakpoints(ctx);
+            nbMismatches += gdbTestNbMemoryWrites - nbWrites != nbChanges;
+            memcpy(installed, wanted, sizeof(installed));
+            nbSyncs++;
+
+            for(u32 j = 0; j < POOL_SIZE; j++)
+                nbMismatches += installed[j] != 0 ? !hasBreakpoint(gdbTestMemory, j, poolSize(j)) : !hasOriginalInstruction(gdbTestMemory, j);
+            nbMismatches += ctx->nbPendingBreakpoints != 0;
+        }
+
+        if(t % 64 == 0 || r >= 98)
+            nbMismatches += !checkTable(ctx) + !checkMemoryView(ctx);
+
+        if(nbMismatches != 0)
+        {
+            printf("    mismatch at %lu\n", (unsigned long)t);
+            break;
+        }
+    }
+
+    CHECK_EQ(nbMismatches, 0);
+    CHECK(nbSyncs > 100);
+    CHECK(nbBusy > 0); // the table did get full
+
+    GDB_RemoveAllBreakpoints(ctx);
+    CHECK(memcmp(gdbTestMemory, originalMemory, GDB_TEST_MEM_SIZE) == 0);
+    CHECK_EQ(ctx->nbBreakpoints, 0);
+
+    gdbTestClose(ctx);
+}
+
+static void testBatchedReinsertion(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+
+    resetMemory(2);
+
+    // GDB removes every breakpoint when the process stops and adds them back before continuing: nothing is written
+    for(u32 i = 0; i < 100; i++)
+        CHECK_EQ(GDB_AddBreakpoint(ctx, poolAddress(i), poolSize(i) == 2, false), 0);
+    GDB_SyncBreakpoints(ctx);
+
+    u32 nbWrites = gdbTestNbMemoryWrites, nbReads = gdbTestNbMemoryReads;
+    for(u32 i = 0; i < 100; i++)
+        CHECK_EQ(GDB_RemoveBreakpoint(ctx, poolAddress(i)), 0);
+    for(u32 i = 0; i < 100; i++)
+        CHECK_EQ(GDB_AddBreakpoint(ctx, poolAddress(i), poolSize(i) == 2, false), 0);
+    GDB_SyncBreakpoints(ctx);
+    CHECK_EQ(gdbTestNbMemoryWrites - nbWrites, 0);
+    CHECK_EQ(gdbTestNbMemoryReads - nbReads, 0);
+
+    GDB_RemoveAllBreakpoints(ctx);
+    CHECK(memcmp(gdbTestMemory, originalMemory, GDB_TEST_MEM_SIZE) == 0);
+    gdbTestClose(ctx);
+}
+
+static void testSizeChangeAndPersistence(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    u32 addr = GDB_TEST_MEM_BASE + 0x100;
+
+    resetMemory(3);
+
+    // ARM breakpoint replaced by a Thumb one at the same address before continuing
+    CHECK_EQ(GDB_AddBreakpoint(ctx, addr, false, false), 0);
+    GDB_SyncBreakpoints(ctx);
+    CHECK_EQ(GDB_RemoveBreakpoint(ctx, addr), 0);
+    CHECK_EQ(GDB_AddBreakpoint(ctx, addr | 1, true, false), 0);
+    GDB_SyncBreakpoints(ctx);
+    CHECK(hasBreakpoint(gdbTestMemory, 0x40, 2));
+    CHECK(memcmp(gdbTestMemory + 0x102, originalMemory + 0x102, 2) == 0);
+    CHECK_EQ(GDB_FindBreakpoint(ctx, addr)->instructionSize, 2);
+
+    u32 instr;
+    CHECK_EQ(GDB_GetBreakpointInstruction(&instr, ctx, addr), 0);
+    CHECK(memcmp(&instr, originalMemory + 0x100, 2) == 0);
+
+    // Misaligned ARM breakpoints and invalid addresses are refused right away
+    CHECK_EQ(GDB_AddBreakpoint(ctx, addr + 2, false, false), -EINVAL);
+    CHECK_EQ(GDB_AddBreakpoint(ctx, GDB_TEST_MEM_BASE + GDB_TEST_MEM_SIZE, false, false), -EFAULT);
+
+    // Persistent breakpoints stay after detaching, the others are removed
+    CHECK_EQ(GDB_AddBreakpoint(ctx, addr + 0x10, false, true), 0);
+    CHECK_EQ(GDB_AddBreakpoint(ctx, addr + 0x20, false, true), 0);
+    GDB_SyncBreakpoints(ctx);
+    CHECK_EQ(GDB_RemoveBreakpoint(ctx, addr + 0x20), 0);
+    CHECK_EQ(GDB_AddBreakpoint(ctx, addr + 0x30, false, true), 0); // not installed yet
+    GDB_RemoveAllBreakpoints(ctx);
+
+    CHECK(memcmp(gdbTestMemory + 0x100, originalMemory + 0x100, 4) == 0);
+    CHECK(hasBreakpoint(gdbTestMemory, 0x44, 4));
+    CHECK(memcmp(gdbTestMemory + 0x120, originalMemory + 0x120, 4) == 0);
+    CHECK(hasBreakpoint(gdbTestMemory, 0x4C, 4));
+    CHECK_EQ(ctx->nbBreakpoints, 0);
+    CHECK(GDB_FindBreakpoint(ctx, addr + 0x10) == NULL);
+
+    gdbTestClose(ctx);
+}
+
+static void benchBreakpoints(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    u32 nb = 200;
+    volatile u32 sink = 0;
+
+    resetMemory(4);
+
+    u64 start = testNanoseconds();
+    for(u32 k = 0; k < nb; k++)
+    {
+        for(u32 i = 0; i < MAX_BREAKPOINT; i++)
+            GDB_AddBreakpoint(ctx, poolAddress(i), false, false);
+        GDB_SyncBreakpoints(ctx);
+        for(u32 i = 0; i < MAX_BREAKPOINT; i++)
+            GDB_RemoveBreakpoint(ctx, poolAddress(i));
+        GDB_SyncBreakpoints(ctx);
+    }
+    u64 elapsed = testNanoseconds() - start;
+    printf("add, install, remove and uninstall: %.1f ns per breakpoint\n", (double)elapsed / nb / MAX_BREAKPOINT);
+
+    for(u32 i = 0; i < MAX_BREAKPOINT; i++)
+        GDB_AddBreakpoint(ctx, poolAddress(i), false, false);
+
+    start = testNanoseconds();
+    for(u32 k = 0; k < nb; k++)
+    {
+        for(u32 i = 0; i < 2 * MAX_BREAKPOINT; i++)
+            sink += GDB_FindBreakpoint(ctx, poolAddress(i)) != NULL;
+    }
+    elapsed = testNanoseconds() - start;
+    printf("lookup with %u breakpoints: %.1f ns\n", MAX_BREAKPOINT, (double)elapsed / nb / (2 * MAX_BREAKPOINT));
+
+    GDB_RemoveAllBreakpoints(ctx);
+    gdbTestClose(ctx);
+}
+
+int main(int argc, char **argv)
+{
+    testInit(argc, argv);
+
+    RUN_TEST(testRandomEdits);
+    RUN_TEST(testBatchedReinsertion);
+    RUN_TEST(testSizeChangeAndPersistence);
+
+    if(testBench)
+        benchBreakpoints();
+
+    return testExit();
+}
@@ -0,0 +1,236 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+// Word-at-a-time hex and checksum helpers, compared against byte-by-byte implementations
+
+#include "test.h"
+#include "gdb/net.h"
+
+// The ARM11 has no vector unit: don't let the host compiler vectorize the references, so that the benchmark is
+// representative of what the word-at-a-time versions gain over them
+#define REFERENCE __attribute__((optimize("no-tree-vectorize")))
+
+REFERENCE static u8 referenceChecksum(const char *data, u32 len)
+{
+    u8 cksum = 0;
+    for(u32 i = 0; i < len; i++)
+        cksum += (u8)data[i];
+    return cksum;
+}
+
+REFERENCE static void referenceEncodeHex(char *dst, const void *src, u32 len)
+{
+    static const char *alphabet = "0123456789abcdef";
+    const u8 *src8 = (const u8 *)src;
+
+    for(u32 i = 0; i < len; i++)
+    {
+        dst[2 * i] = alphabet[src8[i] >> 4];
+        dst[2 * i + 1] = alphabet[src8[i] & 0xF];
+    }
+}
+
+static int referenceHexDigitValue(char c)
+{
+    if(c >= '0' && c <= '9')
+        return c - '0';
+    else if(c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    else if(c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    else
+        return -1;
+}
+
+REFERENCE static u32 referenceDecodeHex(void *dst, const char *src, u32 len)
+{
+    u8 *dst8 = (u8 *)dst;
+    u32 i;
+
+    for(i = 0; i < len; i++)
+    {
+        int hi = referenceHexDigitValue(src[2 * i]);
+        if(hi < 0)
+            break;
+        int lo = referenceHexDigitValue(src[2 * i + 1]);
+        if(lo < 0)
+            break;
+        dst8[i] = (hi << 4) | lo;
+    }
+
+    return i;
+}
+
+static u8 data[0x20000];
+static char hex[2 * sizeof(data) + 16], refHex[2 * sizeof(data) + 16];
+static u8 decoded[sizeof(data) + 16], refDecoded[sizeof(data) + 16];
+
+static void fillData(u32 seed)
+{
+    for(u32 i = 0; i < sizeof(data); i++)
+        data[i] = testRand(&seed);
+}
+
+static void testChecksum(void)
+{
+    fillData(1);
+
+    for(u32 off = 0; off < 8; off++)
+    {
+        for(u32 len = 0; len <= 600; len++)
+            CHECK_EQ(GDB_ComputeChecksum((const char *)data + off, len), referenceChecksum((const char *)data + off, len));
+    }
+
+    // Long enough for the 16-bit lanes of the portable version to need folding
+    CHECK_EQ(GDB_ComputeChecksum((const char *)data + 3, sizeof(data) - 3), referenceChecksum((const char *)data + 3, sizeof(data) - 3));
+    memset(data, 0xFF, sizeof(data));
+    CHECK_EQ(GDB_ComputeChecksum((const char *)data, sizeof(data)), referenceChecksum((const char *)data, sizeof(data)));
+}
+
+static void testEncode(void)
+{
+    // Every byte value, in every lane
+    for(u32 i = 0; i < 0x400; i++)
+        data[i] = i;
+    for(u32 off = 0; off < 4; off++)
+    {
+        GDB_EncodeHex(hex, data + off, 0x400 - off);
+        referenceEncodeHex(refHex, data + off, 0x400 - off);
+        CHECK(memcmp(hex, refHex, 2 * (0x400 - off)) == 0);
+    }
+
+    // All lengths and alignments, without writing past the end
+    fillData(2);
+    for(u32 srcOff = 0; srcOff < 4; srcOff++)
+    {
+        for(u32 dstOff = 0; dstOff < 4; dstOff++)
+        {
+            for(u32 len = 0; len <= 100; len++)
+            {
+                memset(hex, 1, 2 * len + 16);
+                memset(refHex, 1, 2 * len + 16);
+                GDB_EncodeHex(hex + dstOff, data + srcOff, len);
+                referenceEncodeHex(refHex + dstOff, data + srcOff, len);
+                CHECK(memcmp(hex, refHex, 2 * len + 16) == 0);
+            }
+        }
+    }
+
+    // In place, with the data at the end of the buffer as GDB_SendHexPacket does
+    for(u32 len = 0; len <= 2000; len += 7)
+    {
+        memcpy(hex + len, data, len);
+        GDB_EncodeHex(hex, hex + len, len);
+        referenceEncodeHex(refHex, data, len);
+        CHECK(memcmp(hex, refHex, 2 * len) == 0);
+    }
+}
+
+static void testDecode(void)
+{
+    // Every pair of characters, in front of a valid digit pair: how much is decoded and what
+    for(u32 c1 = 0; c1 < 256; c1++)
+    {
+        for(u32 c2 = 0; c2 < 256; c2++)
+        {
+            char src[8] = { (char)c1, (char)c2, '4', '2', 0 };
+            u8 dst[4] = { 0 }, refDst[4] = { 0 };
+            u32 n = GDB_DecodeHex(dst, src, 2), refN = referenceDecodeHex(refDst, src, 2);
+
+            CHECK_EQ(n, refN);
+            CHECK(memcmp(dst, refDst, n) == 0);
+        }
+    }
+
+    // Valid data of all lengths and alignments, mixed case, with an invalid digit anywhere
+    fillData(3);
+    referenceEncodeHex(refHex, data, 0x400);
+    for(u32 i = 0; i < 0x800; i += 3)
+        refHex[i] = refHex[i] >= 'a' ? refHex[i] - 'a' + 'A' : refHex[i];
+
+    for(u32 off = 0; off < 8; off++)
+    {
+        for(u32 len = 0; len <= 200; len++)
+        {
+            CHECK_EQ(GDB_DecodeHex(decoded, refHex + off, len), len);
+            CHECK_EQ(referenceDecodeHex(refDecoded, refHex + off, len), len);
+            CHECK(memcmp(decoded, refDecoded, len) == 0);
+        }
+    }
+
+    for(u32 pos = 0; pos < 64; pos++)
+    {
+        memcpy(hex, refHex, 128);
+        hex[pos] = pos % 2 == 0 ? 'g' : 0;
+        CHECK_EQ(GDB_DecodeHex(decoded, hex, 64), pos / 2);
+        CHECK(memcmp(decoded, data, pos / 2) == 0);
+    }
+
+    // In place
+    for(u32 len = 0; len <= 2000; len += 7)
+    {
+        referenceEncodeHex(hex, data, len);
+        CHECK_EQ(GDB_DecodeHex(hex, hex, len), len);
+        CHECK(memcmp(hex, data, len) == 0);
+    }
+}
+
+static void benchHex(void)
+{
+    u32 nb = 200;
+    volatile u32 sink = 0;
+    u64 start, elapsed[2];
+
+    fillData(4);
+
+    start = testNanoseconds();
+    for(u32 i = 0; i < nb; i++)
+        sink += referenceChecksum((const char *)data, sizeof(data));
+    elapsed[0] = testNanoseconds() - start;
+    start = testNanoseconds();
+    for(u32 i = 0; i < nb; i++)
+        sink += GDB_ComputeChecksum((const char *)data, sizeof(data));
+    elapsed[1] = testNanoseconds() - start;
+    printf("checksum: %.0f MB/s, byte by byte: %.0f MB/s\n", (double)sizeof(data) * nb / elapsed[1] * 1e3,
+           (double)sizeof(data) * nb / elapsed[0] * 1e3);
+
+    start = testNanoseconds();
+    for(u32 i = 0; i < nb; i++)
+        referenceEncodeHex(refHex, data, sizeof(data));
+    elapsed[0] = testNanoseconds() - start;
+    start = testNanoseconds();
+    for(u32 i = 0; i < nb; i++)
+        GDB_EncodeHex(hex, data, sizeof(data));
+    elapsed[1] = testNanoseconds() - start;
+    printf("encode: %.0f MB/s, byte by byte: %.0f MB/s\n", (double)sizeof(data) * nb / elapsed[1] * 1e3,
+           (double)sizeof(data) * nb / elapsed[0] * 1e3);
+
+    start = testNanoseconds();
+    for(u32 i = 0; i < nb; i++)
+        sink += referenceDecodeHex(refDecoded, hex, sizeof(data));
+    elapsed[0] = testNanoseconds() - start;
+    start = testNanoseconds();
+    for(u32 i = 0; i < nb; i++)
+        sink += GDB_DecodeHex(decoded, hex, sizeof(data));
+    elapsed[1] = testNanoseconds() - start;
+    printf("decode: %.0f MB/s, byte by byte: %.0f MB/s\n", (double)sizeof(data) * nb / elapsed[1] * 1e3,
+           (double)sizeof(data) * nb / elapsed[0] * 1e3);
+}
+
+int main(int argc, char **argv)
+{
+    testInit(argc, argv);
+
+    RUN_TEST(testChecksum);
+    RUN_TEST(testEncode);
+    RUN_TEST(testDecode);
+
+    if(testBench)
+        benchHex();
+
+    return testExit();
+}
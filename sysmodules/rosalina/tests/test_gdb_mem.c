@@ -0,0 +1,192 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+// Binary memory reads (x) and writes (X) against the mock debuggee
+
+#include "test.h"
+#include "gdb_test.h"
+#include "gdb/net.h"
+#include "gdb/server.h"
+
+static char reply[GDB_PACKET_BUF_LEN + 4];
+static u8 data[GDB_PACKET_BUF_LEN];
+
+// Fills the memory with random bytes, one in 'escapeOneIn' being one of the characters which must be escaped
+static void fillMemory(u32 seed, u32 escapeOneIn)
+{
+    static const u8 escaped[] = { '$', '#', '}', '*' };
+    for(u32 i = 0; i < GDB_TEST_MEM_SIZE; i++)
+    {
+        u32 r = testRand(&seed);
+        gdbTestMemory[i] = escapeOneIn != 0 && r % escapeOneIn == 0 ? escaped[(r >> 8) & 3] : (u8)(r >> 16);
+    }
+}
+
+// Sends "x<addr>,<len>", checks the data against the memory and returns how many bytes were in the reply
+static int readRaw(GDBContext *ctx, u32 addr, u32 len)
+{
+    char cmd[32];
+    sprintf(cmd, "x%lx,%lx", (unsigned long)addr, (unsigned long)len);
+
+    int n = gdbTestCommand(ctx, cmd, reply, sizeof(reply));
+    if(n < 1 || reply[0] != 'b')
+        return -1;
+
+    CHECK(n <= GDB_PACKET_BUF_LEN);
+    u32 total = GDB_UnescapeBinaryData(data, reply + 1, n - 1);
+    CHECK(total <= len);
+    CHECK(memcmp(data, gdbTestMemory + addr - GDB_TEST_MEM_BASE, total) == 0);
+    return (int)total;
+}
+
+static void testRead(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+
+    fillMemory(1, 0);
+    CHECK_EQ(readRaw(ctx, GDB_TEST_MEM_BASE, 16), 16);
+    CHECK_EQ(readRaw(ctx, GDB_TEST_MEM_BASE + 0xFFE, 4), 4); // across pages
+    CHECK_EQ(readRaw(ctx, GDB_TEST_MEM_BASE + 0x123, 0), 0);
+
+    // Without anything to escape, the whole packet is filled: twice what an m packet can return. The very last byte
+    // may be left out, as it could have needed escaping
+    memset(gdbTestMemory, 'a', GDB_TEST_MEM_SIZE);
+    CHECK(readRaw(ctx, GDB_TEST_MEM_BASE + 0x123, 0x10000) >= GDB_PACKET_BUF_LEN - 2);
+
+    // With everything escaped, half of it
+    memset(gdbTestMemory, '}', GDB_TEST_MEM_SIZE);
+    CHECK_EQ(readRaw(ctx, GDB_TEST_MEM_BASE + 0x123, 0x10000), (GDB_PACKET_BUF_LEN - 1) / 2);
+
+    // In between, the reply is as large as it can be
+    for(u32 seed = 2; seed < 50; seed++)
+    {
+        u32 addr = GDB_TEST_MEM_BASE + (seed * 0x357) % 0x3000;
+        fillMemory(seed, 1 + seed % 8);
+        int n = readRaw(ctx, addr, GDB_PACKET_BUF_LEN);
+        CHECK(n > 0);
+
+        u32 encodedCount;
+        GDB_EscapeBinaryData(&encodedCount, reply, gdbTestMemory + addr - GDB_TEST_MEM_BASE, n, sizeof(reply));
+        CHECK(encodedCount <= GDB_PACKET_BUF_LEN - 1);
+        CHECK(n == GDB_PACKET_BUF_LEN || encodedCount + 2 > GDB_PACKET_BUF_LEN - 1);
+    }
+
+    gdbTestClose(ctx);
+}
+
+static void testReadOnePerPage(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+
+    fillMemory(3, 16);
+    gdbTestNbMemoryReads = 0;
+    int n = readRaw(ctx, GDB_TEST_MEM_BASE + 0x800, 0x2000);
+    CHECK(n > 0);
+    CHECK_EQ(gdbTestNbMemoryReads, (0x800 + n + 0xFFF) / 0x1000);
+
+    gdbTestClose(ctx);
+}
+
+static void testReadFaults(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    char cmd[32];
+
+    fillMemory(4, 0);
+
+    // Stops at the first unreadable page
+    gdbTestPageUnreadable[2] = true;
+    CHECK_EQ(readRaw(ctx, GDB_TEST_MEM_BASE + 0x1800, 0x2000), 0x800);
+
+    // Nothing readable at all
+    sprintf(cmd, "x%x,10", GDB_TEST_MEM_BASE + 0x2000);
+    CHECK_EQ(gdbTestCommand(ctx, cmd, reply, sizeof(reply)), 3);
+    CHECK(strcmp(reply, "E0e") == 0); // EFAULT
+    gdbTestPageUnreadable[2] = false;
+
+    sprintf(cmd, "x%x,10", GDB_TEST_MEM_BASE + GDB_TEST_MEM_SIZE);
+    CHECK_EQ(gdbTestCommand(ctx, cmd, reply, sizeof(reply)), 3);
+    CHECK(strcmp(reply, "E0e") == 0);
+
+    CHECK_EQ(gdbTestCommand(ctx, "x1234", reply, sizeof(reply)), 3);
+    CHECK(strcmp(reply, "E54") == 0); // EILSEQ
+
+    gdbTestClose(ctx);
+}
+
+static void testWriteRaw(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    static char cmd[GDB_PACKET_BUF_LEN];
+    static u8 src[0x1000];
+    u32 seed = 5, encodedCount;
+
+    memset(gdbTestMemory, 0, GDB_TEST_MEM_SIZE);
+    for(u32 i = 0; i < sizeof(src); i++)
+        src[i] = i % 3 == 0 ? '}' : (u8)testRand(&seed);
+
+    // X with escaped data, including '}' and friends, then read back with x
+    u32 len = sprintf(cmd, "X%x,%x:", GDB_TEST_MEM_BASE + 0xF00, (u32)sizeof(src));
+    GDB_EscapeBinaryData(&encodedCount, cmd + len, src, sizeof(src), sizeof(cmd) - len - 1);
+
+    gdbTestSendPacketData(cmd, len + encodedCount);
+    CHECK(GDB_DoPacket(ctx) != -1);
+    CHECK_EQ(gdbTestRecvPacket(reply, sizeof(reply), NULL, 1000), 2);
+    CHECK(strcmp(reply, "OK") == 0);
+    CHECK(memcmp(gdbTestMemory + 0xF00, src, sizeof(src)) == 0);
+    CHECK_EQ(readRaw(ctx, GDB_TEST_MEM_BASE + 0xF00, sizeof(src)), sizeof(src));
+
+    gdbTestClose(ctx);
+}
+
+static void benchReads(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    char cmd[32];
+    u32 nb = 2000;
+
+    fillMemory(6, 64);
+
+    for(u32 pass = 0; pass < 2; pass++)
+    {
+        u64 bytes = 0, wire = 0;
+        u64 start = testNanoseconds();
+        for(u32 i = 0; i < nb; i++)
+        {
+            u32 addr = GDB_TEST_MEM_BASE + (i * 0x1000) % 0x20000;
+            if(pass == 0)
+                sprintf(cmd, "m%lx,%x", (unsigned long)addr, GDB_PACKET_BUF_LEN / 2);
+            else
+                sprintf(cmd, "x%lx,%x", (unsigned long)addr, GDB_PACKET_BUF_LEN);
+
+            int n = gdbTestCommand(ctx, cmd, reply, sizeof(reply));
+            wire += n + 4;
+            bytes += pass == 0 ? (u32)n / 2 : GDB_UnescapeBinaryData(data, reply + 1, n - 1);
+        }
+        u64 elapsed = testNanoseconds() - start;
+
+        printf("%c: %.1f us per packet, %.2f wire bytes per byte, %.1f MB/s\n", pass == 0 ? 'm' : 'x',
+               elapsed / 1e3 / nb, (double)wire / bytes, bytes / (elapsed / 1e9) / 1e6);
+    }
+
+    gdbTestClose(ctx);
+}
+
+int main(int argc, char **argv)
+{
+    testInit(argc, argv);
+
+    RUN_TEST(testRead);
+    RUN_TEST(testReadOnePerPage);
+    RUN_TEST(testReadFaults);
+    RUN_TEST(testWriteRaw);
+
+    if(testBench)
+        benchReads();
+
+    return testExit();
+}
@@ -0,0 +1,235 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+// Packet framing at GDB_PACKET_BUF_LEN, driving GDB_DoPacket over a socketpair like the server does
+
+#include "test.h"
+#include "gdb_test.h"
+#include "gdb/net.h"
+#include "gdb/server.h"
+
+static char reply[GDB_PACKET_BUF_LEN + 4];
+
+static void fillMemory(u32 seed)
+{
+    for(u32 i = 0; i < GDB_TEST_MEM_SIZE; i++)
+        gdbTestMemory[i] = (u8)testRand(&seed);
+}
+
+static void testSupported(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    char expected[32];
+    u32 nbAcks;
+
+    // The ack is sent together with the reply, in the same send
+    gdbTestSendPacket("qSupported:multiprocess+;swbreak+");
+    CHECK(GDB_DoPacket(ctx) != -1);
+    sprintf(expected, "+$PacketSize=%x;", GDB_PACKET_BUF_LEN);
+    CHECK(gdbTestRecvRaw(reply, sizeof(reply) - 1, 1000) > (int)strlen(expected));
+    CHECK(strncmp(reply, expected, strlen(expected)) == 0);
+
+    gdbTestSendPacket("qSupported");
+    CHECK(GDB_DoPacket(ctx) != -1);
+    CHECK(gdbTestRecvPacket(reply, sizeof(reply), &nbAcks, 1000) > 0);
+    CHECK_EQ(nbAcks, 1);
+    CHECK(strncmp(reply, expected + 2, strlen(expected) - 2) == 0);
+    CHECK(strstr(reply, "binary-upload+") != NULL);
+
+    gdbTestClose(ctx);
+}
+
+static void testLargeRead(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    static u8 decoded[GDB_PACKET_BUF_LEN / 2];
+    char cmd[64];
+    u32 len = GDB_PACKET_BUF_LEN / 2, addr = GDB_TEST_MEM_BASE + 0x123;
+
+    fillMemory(1);
+
+    // The largest read whose reply fits in a packet, spanning several pages
+    sprintf(cmd, "m%lx,%lx", (unsigned long)addr, (unsigned long)len);
+    CHECK_EQ(gdbTestCommand(ctx, cmd, reply, sizeof(reply)), 2 * len);
+    CHECK_EQ(GDB_DecodeHex(decoded, reply, len), len);
+    CHECK(memcmp(decoded, gdbTestMemory + 0x123, len) == 0);
+
+    // One more byte doesn't fit
+    sprintf(cmd, "m%lx,%lx", (unsigned long)addr, (unsigned long)len + 1);
+    CHECK_EQ(gdbTestCommand(ctx, cmd, reply, sizeof(reply)), 3);
+    CHECK(strcmp(reply, "E0c") == 0); // ENOMEM
+
+    gdbTestClose(ctx);
+}
+
+static void testLargeWrite(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    static char cmd[GDB_PACKET_BUF_LEN + 1];
+    static u8 data[GDB_PACKET_BUF_LEN / 2];
+    u32 addr = GDB_TEST_MEM_BASE + 0x2FF0, seed = 2;
+
+    memset(gdbTestMemory, 0, GDB_TEST_MEM_SIZE);
+
+    // Fill the packet buffer, less room for the "$" and "#xx"
+    u32 headerLen = sprintf(cmd, "M%lx,", (unsigned long)addr);
+    u32 len = (GDB_PACKET_BUF_LEN - 1 - headerLen - 1 - 8) / 2;
+    headerLen = sprintf(cmd, "M%lx,%lx:", (unsigned long)addr, (unsigned long)len);
+
+    for(u32 i = 0; i < len; i++)
+        data[i] = (u8)testRand(&seed);
+    GDB_EncodeHex(cmd + headerLen, data, len);
+    cmd[headerLen + 2 * len] = 0;
+
+    // Sent in small fragments, each of them received by a GDB_DoPacket call
+    size_t packetLen = strlen(cmd) + 4;
+    char *packet = malloc(packetLen + 1);
+    sprintf(packet, "$%s#%02x", cmd, GDB_ComputeChecksum(cmd, strlen(cmd)));
+    for(size_t off = 0; off < packetLen; off += 1400)
+    {
+        gdbTestSendRaw(packet + off, packetLen - off < 1400 ? packetLen - off : 1400);
+        CHECK(GDB_DoPacket(ctx) != -1);
+    }
+    free(packet);
+
+    CHECK_EQ(gdbTestRecvPacket(reply, sizeof(reply), NULL, 1000), 2);
+    CHECK(strcmp(reply, "OK") == 0);
+    CHECK(memcmp(gdbTestMemory + 0x2FF0, data, len) == 0);
+    CHECK_EQ(gdbTestMemory[0x2FF0 + len], 0);
+
+    gdbTestClose(ctx);
+}
+
+static void testCoalescedPackets(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    char all[256];
+    u32 nbAcks;
+
+    gdbTestMemory[0] = 0xAB;
+    gdbTestMemory[1] = 0xCD;
+
+    // Two packets in a single segment, preceded by an ack, are handled by the same GDB_DoPacket call
+    char first[32], second[32];
+    sprintf(first, "m%x,1", GDB_TEST_MEM_BASE);
+    sprintf(second, "m%x,1", GDB_TEST_MEM_BASE + 1);
+    sprintf(all, "+$%s#%02x$%s#%02x", first, GDB_ComputeChecksum(first, strlen(first)),
+            second, GDB_ComputeChecksum(second, strlen(second)));
+    gdbTestSendRaw(all, strlen(all));
+    CHECK(GDB_DoPacket(ctx) != -1);
+
+    CHECK_EQ(gdbTestRecvPacket(reply, sizeof(reply), &nbAcks, 1000), 2);
+    CHECK_EQ(nbAcks, 1);
+    CHECK(strcmp(reply, "ab") == 0);
+    CHECK_EQ(gdbTestRecvPacket(reply, sizeof(reply), &nbAcks, 1000), 2);
+    CHECK_EQ(nbAcks, 1);
+    CHECK(strcmp(reply, "cd") == 0);
+
+    gdbTestClose(ctx);
+}
+
+static void testBadChecksumAndRetransmit(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    char raw[16];
+
+    gdbTestSendRaw("$OK#00", 6);
+    CHECK(GDB_DoPacket(ctx) != -1);
+    CHECK_EQ(gdbTestRecvRaw(raw, sizeof(raw), 1000), 1);
+    CHECK_EQ(raw[0], '-');
+
+    // A '-' from the client gets the latest reply sent again
+    CHECK_EQ(gdbTestCommand(ctx, "qSupported", reply, sizeof(reply)) > 0, 1);
+    char first[256];
+    strcpy(first, reply);
+    gdbTestSendRaw("-", 1);
+    CHECK(GDB_DoPacket(ctx) != -1);
+    CHECK(gdbTestRecvPacket(reply, sizeof(reply), NULL, 1000) > 0);
+    CHECK(strcmp(reply, first) == 0);
+
+    gdbTestClose(ctx);
+}
+
+static void testNoAckMode(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    u32 nbAcks;
+
+    // QStartNoAckMode is acknowledged, and so is the packet after it (when the mode actually changes)
+    gdbTestSendPacket("QStartNoAckMode");
+    CHECK(GDB_DoPacket(ctx) != -1);
+    CHECK_EQ(gdbTestRecvPacket(reply, sizeof(reply), &nbAcks, 1000), 2);
+    CHECK_EQ(nbAcks, 1);
+
+    gdbTestSendPacket("qSupported");
+    CHECK(GDB_DoPacket(ctx) != -1);
+    CHECK(gdbTestRecvPacket(reply, sizeof(reply), &nbAcks, 1000) > 0);
+    CHECK_EQ(nbAcks, 1);
+
+    gdbTestSendPacket("qSupported");
+    CHECK(GDB_DoPacket(ctx) != -1);
+    CHECK(gdbTestRecvPacket(reply, sizeof(reply), &nbAcks, 1000) > 0);
+    CHECK_EQ(nbAcks, 0);
+
+    gdbTestClose(ctx);
+}
+
+static void testOversizedPacket(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    static char junk[GDB_PACKET_BUF_LEN + 8];
+
+    // A packet which can't fit in the receive buffer drops the connection instead of overflowing
+    memset(junk, 'a', sizeof(junk));
+    junk[0] = '$';
+    gdbTestSendRaw(junk, sizeof(junk));
+
+    int r = 0;
+    for(u32 i = 0; i < 8 && r != -1; i++)
+        r = GDB_DoPacket(ctx);
+    CHECK_EQ(r, -1);
+
+    gdbTestClose(ctx);
+}
+
+static void benchLargeReads(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    char cmd[64];
+    u32 len = GDB_PACKET_BUF_LEN / 2, nb = 2000;
+
+    fillMemory(3);
+    sprintf(cmd, "m%x,%lx", GDB_TEST_MEM_BASE, (unsigned long)len);
+
+    u64 start = testNanoseconds();
+    for(u32 i = 0; i < nb; i++)
+        gdbTestCommand(ctx, cmd, reply, sizeof(reply));
+    u64 elapsed = testNanoseconds() - start;
+
+    printf("m packets of %lu bytes: %.1f us each, %.1f MB/s\n", (unsigned long)len, elapsed / 1e3 / nb,
+           (double)len * nb / (elapsed / 1e9) / 1e6);
+
+    gdbTestClose(ctx);
+}
+
+int main(int argc, char **argv)
+{
+    testInit(argc, argv);
+
+    RUN_TEST(testSupported);
+    RUN_TEST(testLargeRead);
+    RUN_TEST(testLargeWrite);
+    RUN_TEST(testCoalescedPackets);
+    RUN_TEST(testBadChecksumAndRetransmit);
+    RUN_TEST(testNoAckMode);
+    RUN_TEST(testOversizedPacket);
+
+    if(testBench)
+        benchLargeReads();
+
+    return testExit();
+}
@@ -0,0 +1,252 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+// Packet framing in GDB_ReceivePacket/GDB_NextPacket, with the input split and merged the way TCP does
+
+#include <poll.h>
+#include "test.h"
+#include "gdb_test.h"
+#include "gdb/net.h"
+#include "gdb/server.h"
+
+#define MAX_PACKETS 256
+
+static char stream[0x20000];
+static u32 streamLen;
+
+static char expectedReplies[MAX_PACKETS][0x100];
+static u32 nbExpectedReplies, nbExpectedAcks;
+
+static char reply[GDB_PACKET_BUF_LEN + 4];
+
+static void appendRaw(const char *data, u32 len)
+{
+    memcpy(stream + streamLen, data, len);
+    streamLen += len;
+}
+
+static void appendPacket(const char *payload, bool corrupt)
+{
+    char trailer[4];
+    u32 len = strlen(payload);
+
+    sprintf(trailer, "#%02x", (u8)(GDB_ComputeChecksum(payload, len) + (corrupt ? 1 : 0)));
+    appendRaw("$", 1);
+    appendRaw(payload, len);
+    appendRaw(trailer, 3);
+}
+
+// A memory read, whose reply can be checked, possibly preceded by acks and garbage, possibly corrupted.
+// Corrupted packets are nacked and not handled
+static void appendRandomPacket(u32 *seed)
+{
+    char cmd[32];
+    u32 addr = GDB_TEST_MEM_BASE + testRand(seed) % 0x1000;
+    u32 len = 1 + testRand(seed) % 64;
+    u32 r = testRand(seed) % 16;
+
+    if(r == 0)
+        appendRaw("+", 1);
+    else if(r == 1)
+        appendRaw("\r\n garbage ", 11);
+
+    sprintf(cmd, "m%lx,%lx", (unsigned long)addr, (unsigned long)len);
+    if(r == 2)
+    {
+        appendPacket(cmd, true);
+        return;
+    }
+
+    appendPacket(cmd, false);
+    GDB_EncodeHex(expectedReplies[nbExpectedReplies++], gdbTestMemory + addr - GDB_TEST_MEM_BASE, len);
+    expectedReplies[nbExpectedReplies - 1][2 * len] = 0;
+    nbExpectedAcks++;
+}
+
+static void resetStream(void)
+{
+    streamLen = 0;
+    nbExpectedReplies = nbExpectedAcks = 0;
+}
+
+static bool dataAvailable(int fd)
+{
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    return poll(&pfd, 1, 0) == 1;
+}
+
+static u32 nbReplies, nbAcks, nbBadReplies;
+
+// Receives the replies sent so far and checks them against the expected ones, in order
+static void receiveReplies(void)
+{
+    for(;;)
+    {
+        u32 acks;
+        int n = gdbTestRecvPacket(reply, sizeof(reply), &acks, 0);
+        nbAcks += acks;
+        if(n == -1)
+            break;
+
+        if(nbReplies >= nbExpectedReplies || strcmp(reply, expectedReplies[nbReplies]) != 0)
+            nbBadReplies++;
+        nbReplies++;
+    }
+}
+
+// Sends the stream in fragments of random sizes, letting the context handle each of them as it arrives
+static void sendFragmented(GDBContext *ctx, u32 *seed, u32 maxFragmentLen)
+{
+    nbReplies = nbAcks = nbBadReplies = 0;
+    for(u32 pos = 0; pos < streamLen; )
+    {
+        u32 len = 1 + testRand(seed) % maxFragmentLen;
+        len = len > streamLen - pos ? streamLen - pos : len;
+        gdbTestSendRaw(stream + pos, len);
+        pos += len;
+
+        while(dataAvailable(ctx->super.sockfd))
+        {
+            CHECK(GDB_DoPacket(ctx) != -1);
+            receiveReplies();
+        }
+    }
+}
+
+static void testFragmented(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    u32 seed = 1;
+
+    for(u32 i = 0; i < GDB_TEST_MEM_SIZE; i++)
+        gdbTestMemory[i] = testRand(&seed);
+
+    for(u32 t = 0; t < 40; t++)
+    {
+        resetStream();
+        for(u32 i = 0; i < MAX_PACKETS; i++)
+            appendRandomPacket(&seed);
+
+        // From one byte at a time to several packets at once
+        sendFragmented(ctx, &seed, t < 10 ? 1 + t : 1 + testRand(&seed) % 4000);
+        CHECK_EQ(nbBadReplies, 0);
+        CHECK_EQ(nbReplies, nbExpectedReplies);
+        CHECK_EQ(nbAcks, nbExpectedAcks);
+        CHECK_EQ(ctx->recvEnd - ctx->recvStart, 0);
+    }
+
+    gdbTestClose(ctx);
+}
+
+static void testCoalesced(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    u32 seed = 2;
+
+    // All the packets received at once are handled by a single GDB_DoPacket call
+    resetStream();
+    for(u32 i = 0; i < 20; i++)
+        appendRandomPacket(&seed);
+
+    nbReplies = nbAcks = nbBadReplies = 0;
+    gdbTestSendRaw(stream, streamLen);
+    CHECK(GDB_DoPacket(ctx) != -1);
+    CHECK(!dataAvailable(ctx->super.sockfd));
+    receiveReplies();
+    CHECK_EQ(nbBadReplies, 0);
+    CHECK_EQ(nbReplies, nbExpectedReplies);
+
+    // Including a break, and a packet whose trailer arrives later
+    resetStream();
+    appendRaw("\x03", 1);
+    appendPacket("m100000,1", false);
+    gdbTestSendRaw(stream, streamLen - 2);
+    CHECK(GDB_DoPacket(ctx) != -1);
+    CHECK_EQ(gdbTestRecvPacket(reply, sizeof(reply), NULL, 1000), 3);
+    CHECK(strcmp(reply, "S02") == 0);
+    CHECK_EQ(gdbTestRecvRaw(reply, sizeof(reply), 10), 0);
+
+    gdbTestSendRaw(stream + streamLen - 2, 2);
+    CHECK(GDB_DoPacket(ctx) != -1);
+    CHECK_EQ(gdbTestRecvPacket(reply, sizeof(reply), NULL, 1000), 2);
+
+    gdbTestClose(ctx);
+}
+
+static void testNackRetransmits(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    char expected[8];
+
+    memcpy(gdbTestMemory, "\x12\x34", 2);
+    CHECK_EQ(gdbTestCommand(ctx, "m100000,2", reply, sizeof(reply)), 4);
+    strcpy(expected, reply);
+
+    // '-' from the client: the last packet is sent again, as is
+    gdbTestSendRaw("-", 1);
+    CHECK(GDB_DoPacket(ctx) != -1);
+    CHECK_EQ(gdbTestRecvPacket(reply, sizeof(reply), NULL, 1000), 4);
+    CHECK(strcmp(reply, expected) == 0);
+
+    // Bad checksum: '-' and nothing else
+    resetStream();
+    appendPacket("m100000,2", true);
+    gdbTestSendRaw(stream, streamLen);
+    CHECK(GDB_DoPacket(ctx) != -1);
+    CHECK_EQ(gdbTestRecvRaw(reply, sizeof(reply), 100), 1);
+    CHECK_EQ(reply[0], '-');
+
+    gdbTestClose(ctx);
+}
+
+static void testTooLarge(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    static char data[GDB_PACKET_BUF_LEN + 8];
+
+    // A packet which can't fit in the receive buffer closes the connection
+    data[0] = '$';
+    memset(data + 1, 'm', sizeof(data) - 1);
+    gdbTestSendRaw(data, sizeof(data));
+
+    int ret = 0;
+    for(u32 i = 0; i < 4 && ret != -1; i++)
+        ret = GDB_DoPacket(ctx);
+    CHECK_EQ(ret, -1);
+
+    gdbTestClose(ctx);
+}
+
+static void benchPacketRate(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    u32 nb = 20000;
+
+    u64 start = testNanoseconds();
+    for(u32 i = 0; i < nb; i++)
+        gdbTestCommand(ctx, "m100000,4", reply, sizeof(reply));
+    u64 elapsed = testNanoseconds() - start;
+
+    printf("one packet at a time: %.2f us per round trip\n", elapsed / 1e3 / nb);
+
+    gdbTestClose(ctx);
+}
+
+int main(int argc, char **argv)
+{
+    testInit(argc, argv);
+
+    RUN_TEST(testFragmented);
+    RUN_TEST(testCoalesced);
+    RUN_TEST(testNackRetransmits);
+    RUN_TEST(testTooLarge);
+
+    if(testBench)
+        benchPacketRate();
+
+    return testExit();
+}
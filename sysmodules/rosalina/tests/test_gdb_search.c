@@ -0,0 +1,227 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+// Streaming memory search (qSearch:memory, qSearch:patterns), compared against a byte-by-byte search
+
+#include "test.h"
+#include "gdb_test.h"
+#include "gdb/mem.h"
+
+static char reply[GDB_PACKET_BUF_LEN + 4];
+static char cmd[GDB_PACKET_BUF_LEN];
+
+static bool referenceReadable(u32 addr)
+{
+    return addr >= GDB_TEST_MEM_BASE && addr - GDB_TEST_MEM_BASE < GDB_TEST_MEM_SIZE &&
+           !gdbTestPageUnreadable[(addr - GDB_TEST_MEM_BASE) / 0x1000];
+}
+
+// Lowest address first, then lowest pattern index
+static u32 referenceSearch(bool *found, u32 *patternId, u32 addr, u32 len, const GDBSearchPattern *patterns, u32 nbPatterns)
+{
+    for(u32 a = addr; a - addr < len; a++)
+    {
+        for(u32 i = 0; i < nbPatterns; i++)
+        {
+            const GDBSearchPattern *p = &patterns[i];
+            bool matches = p->len <= len - (a - addr);
+            for(u32 k = 0; k < p->len && matches; k++)
+            {
+                u8 mask = p->mask != NULL ? p->mask[k] : 0xFF;
+                matches = referenceReadable(a + k) && ((gdbTestMemory[a + k - GDB_TEST_MEM_BASE] ^ p->data[k]) & mask) == 0;
+            }
+
+            if(matches)
+            {
+                *found = true;
+                *patternId = i;
+                return a;
+            }
+        }
+    }
+
+    *found = false;
+    return 0;
+}
+
+static void fillMemory(u32 *seed, u32 nbValues)
+{
+    for(u32 i = 0; i < GDB_TEST_MEM_SIZE; i++)
+        gdbTestMemory[i] = testRand(seed) % nbValues;
+}
+
+static void testRandom(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    static u8 patternData[GDB_SEARCH_MAX_PATTERNS][0x400], patternMasks[GDB_SEARCH_MAX_PATTERNS][0x400];
+    GDBSearchPattern patterns[GDB_SEARCH_MAX_PATTERNS];
+    u32 seed = 1, nbMismatches = 0;
+
+    for(u32 t = 0; t < 1500; t++)
+    {
+        // Few distinct values so that partial matches are common
+        fillMemory(&seed, 4);
+        memset(gdbTestPageUnreadable, 0, sizeof(gdbTestPageUnreadable));
+        if(t % 4 == 0)
+            gdbTestPageUnreadable[testRand(&seed) % (GDB_TEST_MEM_SIZE / 0x1000)] = true;
+
+        // Patterns taken from the memory, sometimes altered, sometimes masked, some of them over a page long
+        u32 nbPatterns = 1 + testRand(&seed) % (t % 2 == 0 ? 1 : 4);
+        for(u32 i = 0; i < nbPatterns; i++)
+        {
+            GDBSearchPattern *p = &patterns[i];
+            p->len = 1 + testRand(&seed) % (t % 3 == 0 ? sizeof(patternData[0]) : 9);
+            memcpy(patternData[i], gdbTestMemory + testRand(&seed) % (GDB_TEST_MEM_SIZE - p->len), p->len);
+            if(testRand(&seed) % 2)
+                patternData[i][testRand(&seed) % p->len] ^= 1;
+
+            p->data = patternData[i];
+            p->mask = NULL;
+            if(testRand(&seed) % 2)
+            {
+                for(u32 k = 0; k < p->len; k++)
+                    patternMasks[i][k] = testRand(&seed) % 3 != 0 ? 0xFF : 0x02;
+                p->mask = patternMasks[i];
+            }
+        }
+
+        // Sometimes starting or ending outside of the debuggee's memory
+        u32 addr = GDB_TEST_MEM_BASE - 0x100 + testRand(&seed) % (GDB_TEST_MEM_SIZE + 0x100);
+        u32 len = testRand(&seed) % (GDB_TEST_MEM_BASE + GDB_TEST_MEM_SIZE + 0x100 - addr);
+
+        bool found, refFound;
+        u32 patternId = 0, refPatternId = 0;
+        u32 foundAddr = GDB_SearchMemoryEx(&found, &patternId, ctx, addr, len, patterns, nbPatterns);
+        u32 refAddr = referenceSearch(&refFound, &refPatternId, addr, len, patterns, nbPatterns);
+
+        if(found != refFound || (found && (foundAddr != refAddr || patternId != refPatternId)))
+        {
+            if(nbMismatches++ < 5)
+                printf("    mismatch at %lu: %d %lx %lu instead of %d %lx %lu\n", (unsigned long)t, found,
+                       (unsigned long)foundAddr, (unsigned long)patternId, refFound, (unsigned long)refAddr,
+                       (unsigned long)refPatternId);
+        }
+    }
+
+    memset(gdbTestPageUnreadable, 0, sizeof(gdbTestPageUnreadable));
+    CHECK_EQ(nbMismatches, 0);
+    gdbTestClose(ctx);
+}
+
+static void testPackets(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+
+    memset(gdbTestMemory, 0, GDB_TEST_MEM_SIZE);
+    memcpy(gdbTestMemory + 0x1FFE, "\xde\xad\xbe\xef", 4); // across pages
+    memcpy(gdbTestMemory + 0x5000, "\x12\x34\x56", 3);
+    memcpy(gdbTestMemory + 0x6000, "}#", 2);
+
+    // Each page read once, even though the match is across two of them
+    gdbTestNbMemoryReads = 0;
+    sprintf(cmd, "qSearch:patterns:%x;%x;deadbeef", GDB_TEST_MEM_BASE, GDB_TEST_MEM_SIZE);
+    CHECK(gdbTestCommand(ctx, cmd, reply, sizeof(reply)) > 0);
+    CHECK_EQ(strtoul(reply + 2, NULL, 16), GDB_TEST_MEM_BASE + 0x1FFE);
+    CHECK(strcmp(strchr(reply + 2, ','), ",0") == 0);
+    CHECK_EQ(gdbTestNbMemoryReads, 3);
+
+    // The lowest match wins, whatever the pattern order
+    sprintf(cmd, "qSearch:patterns:%x;%x;123456;de00be:ff00ff", GDB_TEST_MEM_BASE, GDB_TEST_MEM_SIZE);
+    CHECK(gdbTestCommand(ctx, cmd, reply, sizeof(reply)) > 0);
+    CHECK_EQ(strtoul(reply + 2, NULL, 16), GDB_TEST_MEM_BASE + 0x1FFE);
+    CHECK(strcmp(strchr(reply + 2, ','), ",1") == 0);
+
+    sprintf(cmd, "qSearch:patterns:%x;%x;de00be:ff00ff;1234", GDB_TEST_MEM_BASE + 0x2000, GDB_TEST_MEM_SIZE - 0x2000);
+    CHECK(gdbTestCommand(ctx, cmd, reply, sizeof(reply)) > 0);
+    CHECK_EQ(strtoul(reply + 2, NULL, 16), GDB_TEST_MEM_BASE + 0x5000);
+    CHECK(strcmp(strchr(reply + 2, ','), ",1") == 0);
+
+    sprintf(cmd, "qSearch:patterns:%x;%x;aabb", GDB_TEST_MEM_BASE, GDB_TEST_MEM_SIZE);
+    CHECK_EQ(gdbTestCommand(ctx, cmd, reply, sizeof(reply)), 1);
+    CHECK(strcmp(reply, "0") == 0);
+
+    // Binary pattern "}#", escaped
+    sprintf(cmd, "qSearch:memory:%x;%x;}]}\x03", GDB_TEST_MEM_BASE, GDB_TEST_MEM_SIZE);
+    CHECK(gdbTestCommand(ctx, cmd, reply, sizeof(reply)) > 0);
+    CHECK_EQ(strtoul(reply + 2, NULL, 16), GDB_TEST_MEM_BASE + 0x6000);
+
+    // Malformed, and too many or too long patterns
+    sprintf(cmd, "qSearch:patterns:%x;%x;1234xx", GDB_TEST_MEM_BASE, GDB_TEST_MEM_SIZE);
+    CHECK_EQ(gdbTestCommand(ctx, cmd, reply, sizeof(reply)), 3);
+    CHECK(strcmp(reply, "E54") == 0);
+
+    sprintf(cmd, "qSearch:patterns:%x;%x;12:ff00", GDB_TEST_MEM_BASE, GDB_TEST_MEM_SIZE);
+    CHECK_EQ(gdbTestCommand(ctx, cmd, reply, sizeof(reply)), 3);
+    CHECK(strcmp(reply, "E54") == 0);
+
+    u32 len = sprintf(cmd, "qSearch:patterns:%x;%x", GDB_TEST_MEM_BASE, GDB_TEST_MEM_SIZE);
+    for(u32 i = 0; i <= GDB_SEARCH_MAX_PATTERNS; i++)
+        len += sprintf(cmd + len, ";%02lx", (unsigned long)i);
+    CHECK_EQ(gdbTestCommand(ctx, cmd, reply, sizeof(reply)), 3);
+    CHECK(strcmp(reply, "E0c") == 0);
+
+    len = sprintf(cmd, "qSearch:patterns:%x;%x;", GDB_TEST_MEM_BASE, GDB_TEST_MEM_SIZE);
+    memset(cmd + len, 'a', 2 * (GDB_SEARCH_MAX_PATTERN_LEN + 1));
+    cmd[len + 2 * (GDB_SEARCH_MAX_PATTERN_LEN + 1)] = 0;
+    CHECK_EQ(gdbTestCommand(ctx, cmd, reply, sizeof(reply)), 3);
+    CHECK(strcmp(reply, "E16") == 0); // EINVAL
+
+    len = sprintf(cmd, "qSearch:memory:%x;%x;", GDB_TEST_MEM_BASE, GDB_TEST_MEM_SIZE);
+    memset(cmd + len, 'a', GDB_SEARCH_MAX_PATTERN_LEN + 1);
+    cmd[len + GDB_SEARCH_MAX_PATTERN_LEN + 1] = 0;
+    CHECK_EQ(gdbTestCommand(ctx, cmd, reply, sizeof(reply)), 3);
+    CHECK(strcmp(reply, "E16") == 0);
+
+    // The longest pattern is fine
+    memset(gdbTestMemory + 0x10001, 'a', GDB_SEARCH_MAX_PATTERN_LEN);
+    cmd[len + GDB_SEARCH_MAX_PATTERN_LEN] = 0;
+    CHECK(gdbTestCommand(ctx, cmd, reply, sizeof(reply)) > 0);
+    CHECK_EQ(strtoul(reply + 2, NULL, 16), GDB_TEST_MEM_BASE + 0x10001);
+
+    gdbTestClose(ctx);
+}
+
+static void benchSearch(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    static const u8 mask[8] = { 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0xFF, 0xFF };
+    GDBSearchPattern patterns[4];
+    u32 seed = 7;
+
+    fillMemory(&seed, 256);
+    for(u32 i = 0; i < 4; i++)
+        patterns[i] = (GDBSearchPattern){ (const u8 *)"\x01\x02\x03\x04\x05\x06\x07\x08" + i, i % 2 == 0 ? NULL : mask, 4 };
+
+    for(u32 nbPatterns = 1; nbPatterns <= 4; nbPatterns += 3)
+    {
+        u32 nb = 200;
+        bool found;
+        u32 patternId;
+        u64 start = testNanoseconds();
+        for(u32 i = 0; i < nb; i++)
+            GDB_SearchMemoryEx(&found, &patternId, ctx, GDB_TEST_MEM_BASE, GDB_TEST_MEM_SIZE, patterns, nbPatterns);
+        u64 elapsed = testNanoseconds() - start;
+
+        printf("%lu pattern(s): %.1f MB/s\n", (unsigned long)nbPatterns,
+               (double)GDB_TEST_MEM_SIZE * nb / (elapsed / 1e9) / 1e6);
+    }
+
+    gdbTestClose(ctx);
+}
+
+int main(int argc, char **argv)
+{
+    testInit(argc, argv);
+
+    RUN_TEST(testRandom);
+    RUN_TEST(testPackets);
+
+    if(testBench)
+        benchSearch();
+
+    return testExit();
+}
@@ -0,0 +1,390 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+// vFile host I/O (pread read-ahead, pwrite, truncation, unlink) against an in-memory SD card
+
+#include "test.h"
+#include "gdb_test.h"
+#include "gdb/net.h"
+#include "gdb/server.h"
+
+#define FAKE_FILE_MAX_SIZE  0x40000
+#define FAKE_NB_FILES       2
+#define FAKE_NB_HANDLES     8
+
+typedef struct FakeFile
+{
+    const char *name;
+    bool exists;
+    u32 size;
+    u8 data[FAKE_FILE_MAX_SIZE];
+} FakeFile;
+
+static FakeFile fakeFiles[FAKE_NB_FILES] = { { .name = "/a.bin" }, { .name = "/b.bin" } };
+static FakeFile *fakeHandles[FAKE_NB_HANDLES];
+static u32 fakeNbReads;
+
+static char reply[GDB_PACKET_BUF_LEN + 4];
+static u8 data[GDB_PACKET_BUF_LEN];
+
+static FakeFile *fakeFindFile(FS_Path path)
+{
+    const u16 *p16 = (const u16 *)path.data;
+    for(u32 i = 0; i < FAKE_NB_FILES; i++)
+    {
+        const char *name = fakeFiles[i].name;
+        u32 j;
+        for(j = 0; name[j] != 0 && p16[j] == (u8)name[j]; j++);
+        if(name[j] == 0 && p16[j] == 0)
+            return &fakeFiles[i];
+    }
+
+    return NULL;
+}
+
+static FakeFile *fakeFromHandle(Handle handle)
+{
+    return handle >= 1 && handle <= FAKE_NB_HANDLES ? fakeHandles[handle - 1] : NULL;
+}
+
+Result FSUSER_OpenArchive(FS_Archive *archive, FS_ArchiveID id, FS_Path path)
+{
+    *archive = id;
+    return 0;
+}
+
+Result FSUSER_OpenFile(Handle *out, FS_Archive archive, FS_Path path, u32 openFlags, u32 attributes)
+{
+    FakeFile *f = fakeFindFile(path);
+    if(f == NULL)
+        return 0xC8804478; // ENOENT
+
+    if(!f->exists)
+    {
+        if(!(openFlags & FS_OPEN_CREATE))
+            return 0xC8804478;
+        f->exists = true;
+        f->size = 0;
+    }
+
+    for(u32 i = 0; i < FAKE_NB_HANDLES; i++)
+    {
+        if(fakeHandles[i] == NULL)
+        {
+            fakeHandles[i] = f;
+            *out = i + 1;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+Result FSUSER_DeleteFile(FS_Archive archive, FS_Path path)
+{
+    FakeFile *f = fakeFindFile(path);
+    if(f == NULL || !f->exists)
+        return 0xC8804478;
+
+    f->exists = false;
+    f->size = 0;
+    return 0;
+}
+
+Result FSFILE_Read(Handle handle, u32 *bytesRead, u64 offset, void *buffer, u32 size)
+{
+    FakeFile *f = fakeFromHandle(handle);
+    if(f == NULL)
+        return -1;
+
+    fakeNbReads++;
+    *bytesRead = offset >= f->size ? 0 : (f->size - offset < size ? f->size - offset : size);
+    memcpy(buffer, f->data + offset, *bytesRead);
+    return 0;
+}
+
+Result FSFILE_Write(Handle handle, u32 *bytesWritten, u64 offset, const void *buffer, u32 size, u32 flags)
+{
+    FakeFile *f = fakeFromHandle(handle);
+    if(f == NULL || offset + size > FAKE_FILE_MAX_SIZE)
+        return -1;
+
+    memcpy(f->data + offset, buffer, size);
+    f->size = offset + size > f->size ? offset + size : f->size;
+    *bytesWritten = size;
+    return 0;
+}
+
+Result FSFILE_GetSize(Handle handle, u64 *size)
+{
+    FakeFile *f = fakeFromHandle(handle);
+    if(f == NULL)
+        return -1;
+
+    *size = f->size;
+    return 0;
+}
+
+Result FSFILE_SetSize(Handle handle, u64 size)
+{
+    FakeFile *f = fakeFromHandle(handle);
+    if(f == NULL || size > FAKE_FILE_MAX_SIZE)
+        return -1;
+
+    f->size = size;
+    return 0;
+}
+
+Result FSFILE_Close(Handle handle)
+{
+    if(fakeFromHandle(handle) == NULL)
+        return -1;
+
+    fakeHandles[handle - 1] = NULL;
+    return 0;
+}
+
+static void fakeCreateFile(FakeFile *f, u32 size, u32 seed, u32 escapeOneIn)
+{
+    f->exists = true;
+    f->size = size;
+    for(u32 i = 0; i < size; i++)
+    {
+        u32 r = testRand(&seed);
+        f->data[i] = escapeOneIn != 0 && r % escapeOneIn == 0 ? '}' : (u8)(r >> 16);
+    }
+}
+
+static int tioOpen(GDBContext *ctx, const char *name, u32 flags)
+{
+    char cmd[128], hexName[64];
+
+    GDB_EncodeHex(hexName, name, strlen(name));
+    hexName[2 * strlen(name)] = 0;
+    sprintf(cmd, "vFile:open:%s,%lx,1b6", hexName, (unsigned long)flags);
+
+    if(gdbTestCommand(ctx, cmd, reply, sizeof(reply)) < 2 || reply[0] != 'F')
+        return -1;
+    return (int)strtol(reply + 1, NULL, 16);
+}
+
+static void tioClose(GDBContext *ctx, int fd)
+{
+    char cmd[32];
+    sprintf(cmd, "vFile:close:%x", fd);
+    CHECK(gdbTestCommand(ctx, cmd, reply, sizeof(reply)) == 2 && strcmp(reply, "F0") == 0);
+}
+
+// Returns the number of bytes read (and the data in 'data'), or -1 with the errno in *err
+static int tioPread(GDBContext *ctx, int fd, u32 count, u32 offset, int *err)
+{
+    char cmd[64];
+    sprintf(cmd, "vFile:pread:%x,%lx,%lx", fd, (unsigned long)count, (unsigned long)offset);
+
+    int n = gdbTestCommand(ctx, cmd, reply, sizeof(reply));
+    if(n < 2 || reply[0] != 'F')
+        return -1;
+
+    if(strncmp(reply, "F-1,", 4) == 0)
+    {
+        *err = (int)strtol(reply + 4, NULL, 16);
+        return -1;
+    }
+
+    char *semicolon = memchr(reply, ';', n);
+    if(semicolon == NULL)
+        return -1;
+
+    u32 len = strtoul(reply + 1, NULL, 16);
+    CHECK_EQ(GDB_UnescapeBinaryData(data, semicolon + 1, reply + n - semicolon - 1), len);
+    return (int)len;
+}
+
+static int tioPwrite(GDBContext *ctx, int fd, u32 offset, const void *buf, u32 len)
+{
+    static char cmd[GDB_PACKET_BUF_LEN];
+    u32 hdrLen = sprintf(cmd, "vFile:pwrite:%x,%lx,", fd, (unsigned long)offset), encodedCount;
+
+    GDB_EscapeBinaryData(&encodedCount, cmd + hdrLen, buf, len, sizeof(cmd) - hdrLen);
+    gdbTestSendPacketData(cmd, hdrLen + encodedCount);
+    if(GDB_DoPacket(ctx) == -1 || gdbTestRecvPacket(reply, sizeof(reply), NULL, 1000) < 2 || reply[0] != 'F')
+        return -1;
+
+    return (int)strtol(reply + 1, NULL, 16);
+}
+
+// Reads a whole file like "remote get" does, checking the data. Returns the number of preads
+static u32 readWholeFile(GDBContext *ctx, int fd, const FakeFile *f, u32 chunkSize)
+{
+    u32 offset = 0, nbPreads = 0;
+    int n, err;
+
+    do
+    {
+        n = tioPread(ctx, fd, chunkSize, offset, &err);
+        nbPreads++;
+        CHECK(n >= 0);
+        CHECK(n <= 0 || memcmp(data, f->data + offset, n) == 0);
+        offset += n > 0 ? n : 0;
+    }
+    while(n > 0);
+
+    CHECK_EQ(offset, f->size);
+    return nbPreads;
+}
+
+static void testSequentialRead(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    FakeFile *f = &fakeFiles[0];
+
+    fakeCreateFile(f, 100000, 1, 0);
+    int fd = tioOpen(ctx, f->name, 0);
+    CHECK(fd >= 3);
+
+    // One FS read per read-ahead buffer, plus the one which hits the end of the file
+    fakeNbReads = 0;
+    readWholeFile(ctx, fd, f, GDB_PACKET_BUF_LEN);
+    CHECK(fakeNbReads <= (f->size + GDB_TIO_READ_AHEAD_LEN - 1) / GDB_TIO_READ_AHEAD_LEN + 2);
+
+    // Replies cut short by escaping are continued from the buffer
+    fakeCreateFile(f, 100000, 2, 4);
+    tioClose(ctx, fd);
+    fd = tioOpen(ctx, f->name, 0);
+    fakeNbReads = 0;
+    u32 nbPreads = readWholeFile(ctx, fd, f, GDB_PACKET_BUF_LEN);
+    CHECK(nbPreads > f->size / GDB_PACKET_BUF_LEN + 1);
+    CHECK(fakeNbReads <= (f->size + GDB_TIO_READ_AHEAD_LEN - 1) / GDB_TIO_READ_AHEAD_LEN + 2);
+
+    // Random access still works
+    u32 seed = 3;
+    for(u32 i = 0; i < 100; i++)
+    {
+        int err;
+        u32 offset = testRand(&seed) % (f->size + 10), count = 1 + testRand(&seed) % GDB_PACKET_BUF_LEN;
+        int n = tioPread(ctx, fd, count, offset, &err);
+        CHECK(n >= 0 && (u32)n <= count);
+        CHECK(offset < f->size ? n > 0 : n == 0);
+        CHECK(n <= 0 || memcmp(data, f->data + offset, n) == 0);
+    }
+
+    tioClose(ctx, fd);
+    gdbTestClose(ctx);
+}
+
+static void testInvalidation(void)
+{
+    GDBContext *reader = gdbTestOpen();
+    GDBContext *writer = gdbTestOpen();
+    FakeFile *f = &fakeFiles[0];
+    u8 patch[64];
+    int err;
+
+    fakeCreateFile(f, 50000, 4, 0);
+    memset(patch, 0x5A, sizeof(patch));
+
+    gdbTestSelect(reader);
+    int rfd = tioOpen(reader, f->name, 0);
+    CHECK_EQ(tioPread(reader, rfd, 256, 0, &err), 256);
+
+    // A write from another context (other fd, other ctx) is seen by the reader's next pread
+    gdbTestSelect(writer);
+    int wfd = tioOpen(writer, f->name, 2); // O_RDWR
+    CHECK(wfd >= 3);
+    CHECK_EQ(tioPwrite(writer, wfd, 100, patch, sizeof(patch)), sizeof(patch));
+
+    gdbTestSelect(reader);
+    CHECK_EQ(tioPread(reader, rfd, 256, 0, &err), 256);
+    CHECK(memcmp(data + 100, patch, sizeof(patch)) == 0);
+
+    // Same with truncation on open
+    gdbTestSelect(writer);
+    tioClose(writer, wfd);
+    wfd = tioOpen(writer, f->name, 0x401); // O_WRONLY | O_TRUNC
+    CHECK(wfd >= 3);
+    CHECK_EQ(f->size, 0);
+
+    gdbTestSelect(reader);
+    CHECK_EQ(tioPread(reader, rfd, 256, 0, &err), 0);
+
+    // And with unlink
+    gdbTestSelect(writer);
+    CHECK_EQ(tioPwrite(writer, wfd, 0, patch, sizeof(patch)), sizeof(patch));
+    gdbTestSelect(reader);
+    CHECK_EQ(tioPread(reader, rfd, 256, 0, &err), sizeof(patch));
+
+    gdbTestSelect(writer);
+    char cmd[64], hexName[32];
+    GDB_EncodeHex(hexName, f->name, strlen(f->name));
+    hexName[2 * strlen(f->name)] = 0;
+    sprintf(cmd, "vFile:unlink:%s", hexName);
+    CHECK(gdbTestCommand(writer, cmd, reply, sizeof(reply)) == 2 && strcmp(reply, "F0") == 0);
+
+    gdbTestSelect(reader);
+    CHECK_EQ(tioPread(reader, rfd, 256, 0, &err), 0);
+
+    gdbTestSelect(writer);
+    tioClose(writer, wfd);
+    gdbTestClose(writer);
+    gdbTestSelect(reader);
+    tioClose(reader, rfd);
+    gdbTestClose(reader);
+}
+
+static void testErrors(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    int err = 0;
+
+    CHECK_EQ(tioOpen(ctx, "/missing", 0), -1);
+    CHECK(strcmp(reply, "F-1,2") == 0); // ENOENT
+
+    CHECK_EQ(tioPread(ctx, 3, 16, 0, &err), -1);
+    CHECK_EQ(err, 9); // EBADF
+    CHECK_EQ(tioPread(ctx, 1000, 16, 0, &err), -1);
+    CHECK_EQ(err, 9);
+
+    gdbTestClose(ctx);
+}
+
+static void benchRead(void)
+{
+    GDBContext *ctx = gdbTestOpen();
+    FakeFile *f = &fakeFiles[1];
+    u32 nb = 50;
+
+    fakeCreateFile(f, FAKE_FILE_MAX_SIZE, 5, 64);
+    int fd = tioOpen(ctx, f->name, 0);
+
+    fakeNbReads = 0;
+    u64 start = testNanoseconds();
+    u32 nbPreads = 0;
+    for(u32 i = 0; i < nb; i++)
+        nbPreads += readWholeFile(ctx, fd, f, GDB_PACKET_BUF_LEN);
+    u64 elapsed = testNanoseconds() - start;
+
+    printf("vFile:pread: %.1f MB/s, %.1f preads and %.1f FS reads per MB\n",
+           (double)f->size * nb / (elapsed / 1e9) / 1e6, nbPreads / (f->size * nb / 1e6),
+           fakeNbReads / (f->size * nb / 1e6));
+
+    tioClose(ctx, fd);
+    gdbTestClose(ctx);
+}
+
+int main(int argc, char **argv)
+{
+    testInit(argc, argv);
+
+    RUN_TEST(testSequentialRead);
+    RUN_TEST(testInvalidation);
+    RUN_TEST(testErrors);
+
+    if(testBench)
+        benchRead();
+
+    return testExit();
+}
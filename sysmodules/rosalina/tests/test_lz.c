@@ -0,0 +1,365 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+// LZ codec: round trips, LZ4 block format conformance, and malformed input
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include "test.h"
+#include "lz.h"
+
+#define MAX_COMPRESSED_SIZE(n)  ((n) + (n) / 255 + 16)
+
+static u8 input[LZ_MAX_BLOCK_SIZE];
+static u8 compressed[MAX_COMPRESSED_SIZE(LZ_MAX_BLOCK_SIZE)];
+static u8 output[LZ_MAX_BLOCK_SIZE];
+
+// Two buffers (destination and source) followed by an inaccessible page, so that reading or writing past the end
+// of what's used of them crashes
+static u8 *guardedBuffer(u32 which, u32 size)
+{
+    static u8 *pages[2];
+    u32 pageSize = sysconf(_SC_PAGESIZE);
+    u32 len = (MAX_COMPRESSED_SIZE(LZ_MAX_BLOCK_SIZE) + pageSize - 1) / pageSize * pageSize;
+
+    if(pages[which] == NULL)
+    {
+        pages[which] = mmap(NULL, len + pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(pages[which] == MAP_FAILED || mprotect(pages[which] + len, pageSize, PROT_NONE) != 0)
+        {
+            perror("mmap");
+            exit(1);
+        }
+    }
+
+    return pages[which] + len - size;
+}
+
+enum
+{
+    DATA_ZERO,
+    DATA_RUNS,
+    DATA_TEXT,
+    DATA_CODE,
+    DATA_RANDOM,
+    DATA_KINDS,
+};
+
+static const char *dataKindNames[DATA_KINDS] = { "zero", "runs", "text", "code", "random" };
+
+static void fillInput(u32 kind, u32 size, u32 seed)
+{
+    static const char *words[] = { "the ", "plugin ", "swap ", "file ", "is ", "mostly ", "zero ", "and ", "code ", "\n" };
+    static const u32 instructions[] = { 0xE92D4010, 0xE1A04000, 0xEB000000, 0xE8BD8010, 0xE3A00000, 0xE5940000 };
+
+    for(u32 i = 0; i < size; )
+    {
+        u32 r = testRand(&seed);
+        switch(kind)
+        {
+            case DATA_ZERO:
+                input[i++] = 0;
+                break;
+            case DATA_RUNS:
+                for(u32 n = 1 + r % 40; n > 0 && i < size; n--)
+                    input[i++] = (u8)(r >> 8);
+                break;
+            case DATA_TEXT:
+                for(const char *w = words[r % 10]; *w != 0 && i < size; w++)
+                    input[i++] = *w;
+                break;
+            case DATA_CODE:
+            {
+                u32 instr = instructions[r % 6] | (r % 4 == 0 ? (r >> 8) & 0xFFF : 0);
+                for(u32 b = 0; b < 4 && i < size; b++)
+                    input[i++] = (u8)(instr >> (8 * b));
+                break;
+            }
+            default:
+                input[i++] = (u8)r;
+                break;
+        }
+    }
+}
+
+// Byte-by-byte decoder following the LZ4 block format description. Returns the decompressed size or -1
+static s32 referenceDecompress(u8 *dst, u32 dstCapacity, const u8 *src, u32 srcSize)
+{
+    u32 ip = 0, op = 0;
+
+    for(;;)
+    {
+        if(ip >= srcSize)
+            return -1;
+
+        u32 token = src[ip++];
+        u32 len = token >> 4;
+        if(len == 15)
+        {
+            u32 b;
+            do
+            {
+                if(ip >= srcSize)
+                    return -1;
+                b = src[ip++];
+                len += b;
+            }
+            while(b == 255);
+        }
+
+        for(; len > 0; len--)
+        {
+            if(ip >= srcSize || op >= dstCapacity)
+                return -1;
+            dst[op++] = src[ip++];
+        }
+
+        if(ip == srcSize)
+            return op;
+
+        // Not the last sequence: a match must follow, and it can't start in the last 12 bytes of the block
+        if(ip + 2 > srcSize)
+            return -1;
+        u32 offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+
+        len = token & 15;
+        if(len == 15)
+        {
+            u32 b;
+            do
+            {
+                if(ip >= srcSize)
+                    return -1;
+                b = src[ip++];
+                len += b;
+            }
+            while(b == 255);
+        }
+        len += 4;
+
+        if(offset == 0 || offset > op)
+            return -1;
+        for(; len > 0; len--, op++)
+        {
+            if(op >= dstCapacity)
+                return -1;
+            dst[op] = dst[op - offset];
+        }
+    }
+}
+
+// Checks the end of block restrictions of the LZ4 format on a whole compressed block of the given decompressed size
+static bool checkEndOfBlock(const u8 *src, u32 srcSize, u32 size)
+{
+    u32 ip = 0, op = 0, lastMatchStart = 0, lastMatchEnd = 0;
+    bool hasMatch = false;
+
+    for(;;)
+    {
+        u32 token = src[ip++];
+        u32 len = token >> 4;
+        if(len == 15)
+            for(u32 b = 255; b == 255; len += (b = src[ip++]));
+        ip += len;
+        op += len;
+        if(ip == srcSize)
+            break;
+
+        ip += 2;
+        len = token & 15;
+        if(len == 15)
+            for(u32 b = 255; b == 255; len += (b = src[ip++]));
+        hasMatch = true;
+        lastMatchStart = op;
+        op += len + 4;
+        lastMatchEnd = op;
+    }
+
+    return op == size && (!hasMatch || (size - lastMatchStart >= 12 && size - lastMatchEnd >= 5));
+}
+
+static const u32 sizes[] = { 0, 1, 4, 5, 11, 12, 13, 16, 17, 100, 255, 256, 270, 1000, 4096, 0x7FFF, 0xFFFF, LZ_MAX_BLOCK_SIZE };
+
+static void testRoundTrip(void)
+{
+    for(u32 kind = 0; kind < DATA_KINDS; kind++)
+    {
+        for(u32 s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        {
+            for(u32 seed = 1; seed < 4; seed++)
+            {
+                u32 size = sizes[s];
+                fillInput(kind, size, seed);
+
+                u32 n = LZ_Compress(compressed, sizeof(compressed), input, size);
+                CHECK(n > 0 && n <= MAX_COMPRESSED_SIZE(size));
+                CHECK(checkEndOfBlock(compressed, n, size));
+
+                memset(output, 0xCC, sizeof(output));
+                CHECK_EQ(LZ_Decompress(output, sizeof(output), compressed, n), size);
+                CHECK(memcmp(output, input, size) == 0);
+
+                memset(output, 0xCC, sizeof(output));
+                CHECK_EQ(referenceDecompress(output, sizeof(output), compressed, n), size);
+                CHECK(memcmp(output, input, size) == 0);
+            }
+        }
+    }
+
+    // Compressible data does get compressed
+    fillInput(DATA_ZERO, LZ_MAX_BLOCK_SIZE, 1);
+    CHECK(LZ_Compress(compressed, sizeof(compressed), input, LZ_MAX_BLOCK_SIZE) < LZ_MAX_BLOCK_SIZE / 100);
+    fillInput(DATA_TEXT, LZ_MAX_BLOCK_SIZE, 1);
+    CHECK(LZ_Compress(compressed, sizeof(compressed), input, LZ_MAX_BLOCK_SIZE) < LZ_MAX_BLOCK_SIZE * 3 / 5);
+    fillInput(DATA_CODE, LZ_MAX_BLOCK_SIZE, 1);
+    CHECK(LZ_Compress(compressed, sizeof(compressed), input, LZ_MAX_BLOCK_SIZE) < LZ_MAX_BLOCK_SIZE * 3 / 4);
+}
+
+static void testCapacity(void)
+{
+    for(u32 kind = 0; kind < DATA_KINDS; kind++)
+    {
+        u32 size = 5000;
+        fillInput(kind, size, 2);
+        u32 n = LZ_Compress(compressed, sizeof(compressed), input, size);
+
+        // The output fits exactly, or is refused without writing past the end
+        u8 *dst = guardedBuffer(0, n);
+        CHECK_EQ(LZ_Compress(dst, n, input, size), n);
+        CHECK(memcmp(dst, compressed, n) == 0);
+        for(u32 capacity = 0; capacity < n; capacity += 1 + capacity / 8)
+            CHECK_EQ(LZ_Compress(guardedBuffer(0, capacity), capacity, input, size), 0);
+
+        // Same when decompressing
+        const u8 *src = guardedBuffer(1, n);
+        memcpy((u8 *)src, compressed, n);
+        dst = guardedBuffer(0, size);
+        CHECK_EQ(LZ_Decompress(dst, size, src, n), size);
+        CHECK(memcmp(dst, input, size) == 0);
+        for(u32 capacity = 0; capacity < size; capacity += 1 + capacity / 8)
+            CHECK_EQ(LZ_Decompress(guardedBuffer(0, capacity), capacity, src, n), -1);
+    }
+
+    CHECK_EQ(LZ_Compress(compressed, sizeof(compressed), input, LZ_MAX_BLOCK_SIZE + 1), 0);
+}
+
+static void testTruncated(void)
+{
+    for(u32 kind = 0; kind < DATA_KINDS; kind++)
+    {
+        u32 size = 3000;
+        fillInput(kind, size, 3);
+        u32 n = LZ_Compress(compressed, sizeof(compressed), input, size);
+
+        // Either refused, or a prefix of the original data (when cut right after a match)
+        for(u32 len = 0; len < n; len++)
+        {
+            u8 *src = guardedBuffer(1, len);
+            memcpy(src, compressed, len);
+
+            u8 *dst = guardedBuffer(0, size);
+            s32 r = LZ_Decompress(dst, size, src, len);
+            CHECK(r < (s32)size);
+            if(r > 0)
+                CHECK(memcmp(dst, input, r) == 0);
+        }
+    }
+}
+
+static void testMalformed(void)
+{
+    u32 seed = 4;
+    u32 nbAccepted = 0;
+
+    // Hand-made: offset 0, offset before the start, lengths running past the input
+    static const u8 zeroOffset[] = { 0x14, 'a', 0x00, 0x00, 0x00 };
+    static const u8 offsetTooLarge[] = { 0x14, 'a', 0x02, 0x00, 0x00 };
+    static const u8 literalsPastEnd[] = { 0x50, 'a', 'b' };
+    static const u8 unfinishedLength[] = { 0xF0, 0xFF, 0xFF };
+    static const u8 missingOffset[] = { 0x10, 'a', 0x01 };
+    CHECK_EQ(LZ_Decompress(output, sizeof(output), zeroOffset, sizeof(zeroOffset)), -1);
+    CHECK_EQ(LZ_Decompress(output, sizeof(output), offsetTooLarge, sizeof(offsetTooLarge)), -1);
+    CHECK_EQ(LZ_Decompress(output, sizeof(output), literalsPastEnd, sizeof(literalsPastEnd)), -1);
+    CHECK_EQ(LZ_Decompress(output, sizeof(output), unfinishedLength, sizeof(unfinishedLength)), -1);
+    CHECK_EQ(LZ_Decompress(output, sizeof(output), missingOffset, sizeof(missingOffset)), -1);
+
+    // Overlapping match: a run
+    static const u8 run[] = { 0x1F, 'a', 0x01, 0x00, 0x10, 0x50, 'b', 'c', 'd', 'e', 'f' };
+    CHECK_EQ(LZ_Decompress(output, sizeof(output), run, sizeof(run)), 1 + 4 + 15 + 16 + 5);
+    CHECK(output[0] == 'a' && output[35] == 'a' && output[36] == 'b');
+
+    // Random and mutated data: nothing read or written out of bounds (which would crash), and anything accepted
+    // stays within the output buffer
+    for(u32 t = 0; t < 20000; t++)
+    {
+        u32 capacity = 1 + testRand(&seed) % 4096;
+        u32 len;
+
+        if(t % 2 == 0)
+        {
+            len = testRand(&seed) % 512;
+            for(u32 i = 0; i < len; i++)
+                compressed[i] = testRand(&seed);
+        }
+        else
+        {
+            fillInput(testRand(&seed) % DATA_KINDS, 2048, t);
+            len = LZ_Compress(compressed, sizeof(compressed), input, 2048);
+            for(u32 k = 1 + testRand(&seed) % 4; k > 0; k--)
+                compressed[testRand(&seed) % len] ^= 1 << (testRand(&seed) % 8);
+        }
+
+        u8 *src = guardedBuffer(1, len);
+        memcpy(src, compressed, len);
+        s32 r = LZ_Decompress(guardedBuffer(0, capacity), capacity, src, len);
+        CHECK(r >= -1 && r <= (s32)capacity);
+        nbAccepted += r >= 0;
+    }
+
+    CHECK(nbAccepted > 0);
+}
+
+static void benchLz(void)
+{
+    u32 size = LZ_MAX_BLOCK_SIZE;
+    u32 nb = 200;
+
+    for(u32 kind = 0; kind < DATA_KINDS; kind++)
+    {
+        u32 n = 0;
+        fillInput(kind, size, 5);
+
+        u64 start = testNanoseconds();
+        for(u32 i = 0; i < nb; i++)
+            n = LZ_Compress(compressed, sizeof(compressed), input, size);
+        u64 compressTime = testNanoseconds() - start;
+
+        start = testNanoseconds();
+        for(u32 i = 0; i < nb; i++)
+            LZ_Decompress(output, sizeof(output), compressed, n);
+        u64 decompressTime = testNanoseconds() - start;
+
+        printf("%-6s: ratio %5.1f%%, compression %6.0f MB/s, decompression %6.0f MB/s\n", dataKindNames[kind],
+               100.0 * n / size, (double)size * nb / compressTime * 1e3, (double)size * nb / decompressTime * 1e3);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    testInit(argc, argv);
+
+    RUN_TEST(testRoundTrip);
+    RUN_TEST(testCapacity);
+    RUN_TEST(testTruncated);
+    RUN_TEST(testMalformed);
+
+    if(testBench)
+        benchLz();
+
+    return testExit();
+}
@@ -0,0 +1,421 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+// Plugin swap file (MemoryBlock__ToSwapFile/FromSwapFile) against an in-memory swap file
+
+#include "test.h"
+#include "plugin.h"
+#include "ifile.h"
+
+// Same layout as in memoryblock.c
+#define CHUNK_SIZE          0x10000
+#define NB_CHUNKS           (5 * 1024 * 1024 / CHUNK_SIZE)
+#define CHUNK_INDEX_OFFSET  16
+#define DATA_OFFSET         0x1000
+
+PluginLoaderContext PluginLoaderCtx;
+
+// Static, see the Makefile
+static u8 memblock[NB_CHUNKS * CHUNK_SIZE];
+static u8 snapshot[NB_CHUNKS * CHUNK_SIZE];
+
+static u8 swapFile[DATA_OFFSET + NB_CHUNKS * CHUNK_SIZE];
+static u64 swapFileSize;
+static u32 nbWrites, nbReads, nbErrors;
+static u64 nbBytesWritten, nbBytesRead;
+
+// When not 0, file accesses take as long as they would on a SD card this fast
+static u32 sdBytesPerSecond, sdNanosecondsPerRequest;
+
+static void simulateSdAccess(u32 len)
+{
+    if(sdBytesPerSecond == 0)
+        return;
+
+    u64 ns = sdNanosecondsPerRequest + (u64)len * 1000000000ULL / sdBytesPerSecond;
+    struct timespec ts = { ns / 1000000000ULL, ns % 1000000000ULL };
+    nanosleep(&ts, NULL);
+}
+
+Result IFile_Open(IFile *file, FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, u32 flags)
+{
+    file->handle = 1;
+    file->pos = 0;
+    file->size = 0;
+    return 0;
+}
+
+Result IFile_Close(IFile *file)
+{
+    file->handle = 0;
+    return 0;
+}
+
+Result IFile_GetSize(IFile *file, u64 *size)
+{
+    *size = file->size = swapFileSize;
+    return 0;
+}
+
+Result IFile_Read(IFile *file, u64 *total, void *buffer, u32 len)
+{
+    u32 n = file->pos >= swapFileSize ? 0 : swapFileSize - file->pos < len ? swapFileSize - file->pos : len;
+
+    simulateSdAccess(n);
+    memcpy(buffer, swapFile + file->pos, n);
+    file->pos += n;
+    *total = n;
+    nbReads++;
+    nbBytesRead += n;
+    return 0;
+}
+
+Result IFile_Write(IFile *file, u64 *total, const void *buffer, u32 len, u32 flags)
+{
+    if(file->pos + len > sizeof(swapFile))
+        return -1;
+
+    simulateSdAccess(len);
+    memcpy(swapFile + file->pos, buffer, len);
+    file->pos += len;
+    swapFileSize = file->pos > swapFileSize ? file->pos : swapFileSize;
+    *total = len;
+    nbWrites++;
+    nbBytesWritten += len;
+    return 0;
+}
+
+void PluginLoader__Error(const char *message, Result res)
+{
+    nbErrors++;
+}
+
+// The console would reboot
+Result svcKernelSetState(u32 type, ...)
+{
+    return 0;
+}
+
+// Stand-ins for the functions plugins patch in: a checksum of the whole block
+static u32 checksumBlock(const u8 *start, const u8 *end)
+{
+    u32 checksum = 0x811C9DC5;
+    for(const u32 *p = (const u32 *)start; p < (const u32 *)end; p++)
+        checksum = (checksum ^ *p) * 0x01000193;
+    return checksum;
+}
+
+u32 saveSwapFunc(void *startAddr, void *endAddr, void *args)
+{
+    return checksumBlock(startAddr, endAddr);
+}
+
+u32 loadSwapFunc(void *startAddr, void *endAddr, void *args)
+{
+    return checksumBlock(startAddr, endAddr);
+}
+
+// A plugin heap is mostly zero, the rest is code and data of varying compressibility
+static void fillChunk(u32 i, u32 *seed)
+{
+    u8 *chunk = memblock + i * CHUNK_SIZE;
+    u32 kind = testRand(seed) % 4;
+
+    memset(chunk, 0, CHUNK_SIZE);
+    if(kind == 1)
+    {
+        // Code-like: a few repeating instruction words
+        static const u32 words[] = { 0xE92D4010, 0xE1A04000, 0xEB000000, 0xE8BD8010, 0xE3A00000, 0xE5940000 };
+        for(u32 k = 0; k < CHUNK_SIZE / 4; k++)
+            ((u32 *)chunk)[k] = words[testRand(seed) % 6] | (testRand(seed) % 4 == 0 ? testRand(seed) & 0xFFF : 0);
+    }
+    else if(kind == 2)
+    {
+        // Sparse data
+        for(u32 k = 0; k < CHUNK_SIZE; k += 1 + testRand(seed) % 64)
+            chunk[k] = testRand(seed);
+    }
+    else if(kind == 3)
+    {
+        // Incompressible
+        for(u32 k = 0; k < CHUNK_SIZE; k++)
+            chunk[k] = testRand(seed);
+    }
+}
+
+static void fillBlock(u32 seed)
+{
+    for(u32 i = 0; i < NB_CHUNKS; i++)
+        fillChunk(i, &seed);
+}
+
+static void resetSwap(const char *name)
+{
+    swapFileSize = 0;
+    strcpy(g_swapFileName, name);
+    MemoryBlock__InvalidateSwapFile();
+}
+
+// Swaps out then in, after filling the block with garbage: returns whether the block was restored
+static bool swapOutAndIn(u32 *nbChunkWrites)
+{
+    u32 nbErrorsBefore = nbErrors, nbWritesBefore = nbWrites;
+
+    memcpy(snapshot, memblock, sizeof(memblock));
+    if(R_FAILED(MemoryBlock__ToSwapFile()))
+        return false;
+
+    // Every chunk written, then the chunk index and the header
+    if(nbChunkWrites != NULL)
+        *nbChunkWrites = nbWrites - nbWritesBefore - 2;
+
+    memset(memblock, 0xA5, sizeof(memblock));
+    return R_SUCCEEDED(MemoryBlock__FromSwapFile()) && nbErrors == nbErrorsBefore &&
+           memcmp(memblock, snapshot, sizeof(memblock)) == 0;
+}
+
+static u32 nbNonZeroChunks(void)
+{
+    u32 n = 0;
+    for(u32 i = 0; i < NB_CHUNKS; i++)
+    {
+        for(u32 k = 0; k < CHUNK_SIZE; k++)
+        {
+            if(memblock[i * CHUNK_SIZE + k] != 0)
+            {
+                n++;
+                break;
+            }
+        }
+    }
+
+    return n;
+}
+
+static void testRoundTrip(void)
+{
+    u32 nbChunkWrites;
+
+    resetSwap("/luma/plugins/test.swap");
+    for(u32 seed = 1; seed < 6; seed++)
+    {
+        MemoryBlock__InvalidateSwapFile();
+        fillBlock(seed);
+        CHECK(swapOutAndIn(&nbChunkWrites));
+        CHECK_EQ(nbChunkWrites, nbNonZeroChunks());
+    }
+
+    // All zero, then everything incompressible
+    MemoryBlock__InvalidateSwapFile();
+    memset(memblock, 0, sizeof(memblock));
+    CHECK(swapOutAndIn(&nbChunkWrites));
+    CHECK_EQ(nbChunkWrites, 0);
+
+    u32 seed = 6;
+    for(u32 i = 0; i < sizeof(memblock); i++)
+        memblock[i] = testRand(&seed);
+    CHECK(swapOutAndIn(&nbChunkWrites));
+    CHECK_EQ(nbChunkWrites, NB_CHUNKS);
+}
+
+static void testOnlyDirtyChunksWritten(void)
+{
+    u32 nbChunkWrites, seed = 7;
+
+    resetSwap("/luma/plugins/test.swap");
+    fillBlock(seed);
+    CHECK(swapOutAndIn(&nbChunkWrites));
+
+    // Nothing changed since the last swap
+    u64 bytesBefore = nbBytesWritten;
+    CHECK(swapOutAndIn(&nbChunkWrites));
+    CHECK_EQ(nbChunkWrites, 0);
+    CHECK_EQ(nbBytesWritten - bytesBefore, CHUNK_INDEX_OFFSET + 4 * NB_CHUNKS);
+
+    // One byte changed in two chunks, one chunk cleared (nothing to write for it) and a zero chunk filled
+    u32 cleared = 0, filled = 0;
+    for(u32 i = 0; i < NB_CHUNKS && (cleared == 0 || filled == 0); i++)
+    {
+        bool isZero = true;
+        for(u32 k = 0; k < CHUNK_SIZE && isZero; k++)
+            isZero = memblock[i * CHUNK_SIZE + k] == 0;
+
+        if(isZero && filled == 0)
+            filled = i;
+        else if(!isZero && cleared == 0 && i != 3 && i != 40)
+            cleared = i;
+    }
+    CHECK(cleared != 0 && filled != 0);
+
+    memblock[3 * CHUNK_SIZE + 123]++;
+    memblock[40 * CHUNK_SIZE + CHUNK_SIZE - 1]++;
+    memset(memblock + cleared * CHUNK_SIZE, 0, CHUNK_SIZE);
+    memset(memblock + filled * CHUNK_SIZE + 0x100, 0x42, 0x100);
+    CHECK(swapOutAndIn(&nbChunkWrites));
+    CHECK_EQ(nbChunkWrites, 3);
+
+    // The chunk which was zero before gets written when it's not anymore
+    memset(memblock + cleared * CHUNK_SIZE, 0x11, 4);
+    CHECK(swapOutAndIn(&nbChunkWrites));
+    CHECK_EQ(nbChunkWrites, 1);
+}
+
+static void testRewriteWhenNotInSync(void)
+{
+    u32 nbChunkWrites;
+
+    resetSwap("/luma/plugins/a.swap");
+    fillBlock(8);
+    CHECK(swapOutAndIn(&nbChunkWrites));
+
+    // Another swap file: everything is written again
+    strcpy(g_swapFileName, "/luma/plugins/b.swap");
+    CHECK(swapOutAndIn(&nbChunkWrites));
+    CHECK_EQ(nbChunkWrites, nbNonZeroChunks());
+
+    // The file may have been changed behind our back
+    MemoryBlock__InvalidateSwapFile();
+    CHECK(swapOutAndIn(&nbChunkWrites));
+    CHECK_EQ(nbChunkWrites, nbNonZeroChunks());
+
+    // Or be too small
+    CHECK(swapOutAndIn(&nbChunkWrites));
+    CHECK_EQ(nbChunkWrites, 0);
+    swapFileSize = CHUNK_INDEX_OFFSET;
+    CHECK(swapOutAndIn(&nbChunkWrites));
+    CHECK_EQ(nbChunkWrites, nbNonZeroChunks());
+}
+
+static void testCorruption(void)
+{
+    u32 nbChunkWrites;
+    u32 sizes[NB_CHUNKS];
+
+    resetSwap("/luma/plugins/test.swap");
+    fillBlock(9);
+    CHECK(swapOutAndIn(&nbChunkWrites));
+    memcpy(sizes, swapFile + CHUNK_INDEX_OFFSET, sizeof(sizes));
+
+    // Corrupted data is caught by the plugin's checksum or by the decompressor, unless it decompresses to the same
+    // data (e.g. a match offset now pointing to identical bytes)
+    u32 nbDetected = 0;
+    for(u32 i = 0; i < NB_CHUNKS; i++)
+    {
+        if(sizes[i] == 0)
+            continue;
+
+        u32 nbErrorsBefore = nbErrors;
+        swapFile[DATA_OFFSET + i * CHUNK_SIZE + sizes[i] / 2] ^= 0x10;
+        if(R_FAILED(MemoryBlock__FromSwapFile()))
+        {
+            CHECK(nbErrors > nbErrorsBefore);
+            nbDetected++;
+        }
+        else
+            CHECK(memcmp(memblock, snapshot, sizeof(memblock)) == 0);
+        swapFile[DATA_OFFSET + i * CHUNK_SIZE + sizes[i] / 2] ^= 0x10;
+    }
+    CHECK(nbDetected > 0);
+
+    // As are bad chunk sizes and headers
+    u32 nbErrorsBefore = nbErrors;
+    ((u32 *)(swapFile + CHUNK_INDEX_OFFSET))[NB_CHUNKS - 1] = CHUNK_SIZE - 1;
+    CHECK(R_FAILED(MemoryBlock__FromSwapFile()));
+    ((u32 *)(swapFile + CHUNK_INDEX_OFFSET))[NB_CHUNKS - 1] = CHUNK_SIZE + 1;
+    CHECK(R_FAILED(MemoryBlock__FromSwapFile()));
+    swapFile[0] ^= 1;
+    CHECK(R_FAILED(MemoryBlock__FromSwapFile()));
+    CHECK(nbErrors >= nbErrorsBefore + 3);
+
+    // After a failure, the file isn't trusted anymore
+    memcpy(memblock, snapshot, sizeof(memblock));
+    CHECK(swapOutAndIn(&nbChunkWrites));
+    CHECK_EQ(nbChunkWrites, nbNonZeroChunks());
+}
+
+static void testCompressedChunks(void)
+{
+    u32 sizes[NB_CHUNKS];
+
+    // Every chunk compressible, except the last one which is always stored raw
+    resetSwap("/luma/plugins/test.swap");
+    for(u32 i = 0; i < sizeof(memblock); i++)
+        memblock[i] = "plugin heap "[i % 12];
+
+    u64 bytesBefore = nbBytesWritten;
+    CHECK(swapOutAndIn(NULL));
+    CHECK(nbBytesWritten - bytesBefore < sizeof(memblock) / 10);
+
+    memcpy(sizes, swapFile + CHUNK_INDEX_OFFSET, sizeof(sizes));
+    for(u32 i = 0; i < NB_CHUNKS - 1; i++)
+        CHECK(sizes[i] > 0 && sizes[i] < CHUNK_SIZE / 10);
+    CHECK_EQ(sizes[NB_CHUNKS - 1], CHUNK_SIZE);
+}
+
+static void benchSwap(void)
+{
+    // Roughly what a 3DS gets from a class 10 card through FS
+    sdBytesPerSecond = 10 * 1000 * 1000;
+    sdNanosecondsPerRequest = 1000000;
+
+    resetSwap("/luma/plugins/test.swap");
+    fillBlock(10);
+
+    for(u32 pass = 0; pass < 3; pass++)
+    {
+        // First swap, then with a few chunks changed, then with nothing changed
+        if(pass == 1)
+        {
+            for(u32 i = 0; i < NB_CHUNKS; i += 10)
+                memblock[i * CHUNK_SIZE + 0x800]++;
+        }
+
+        u64 bytesWritten = nbBytesWritten, bytesRead = nbBytesRead;
+        memcpy(snapshot, memblock, sizeof(memblock));
+
+        u64 start = testNanoseconds();
+        MemoryBlock__ToSwapFile();
+        u64 swapOut = testNanoseconds() - start;
+
+        start = testNanoseconds();
+        MemoryBlock__FromSwapFile();
+        u64 swapIn = testNanoseconds() - start;
+        CHECK(memcmp(memblock, snapshot, sizeof(memblock)) == 0);
+
+        printf("%s: swap out %.1f ms (%.0f KB written), swap in %.1f ms (%.0f KB read)\n",
+               pass == 0 ? "first swap" : pass == 1 ? "10% changed" : "unchanged", swapOut / 1e6,
+               (nbBytesWritten - bytesWritten) / 1024.0, swapIn / 1e6, (nbBytesRead - bytesRead) / 1024.0);
+    }
+
+    // What writing and reading the whole block costs
+    u64 start = testNanoseconds();
+    simulateSdAccess(sizeof(memblock));
+    simulateSdAccess(sizeof(memblock));
+    printf("whole block, written then read: %.1f ms\n", (testNanoseconds() - start) / 1e6);
+
+    sdBytesPerSecond = 0;
+}
+
+int main(int argc, char **argv)
+{
+    testInit(argc, argv);
+
+    PluginLoaderCtx.memblock.memblock = memblock;
+    PluginLoaderCtx.memblock.isReady = true;
+    PluginLoaderCtx.isSwapFunctionset = true;
+
+    RUN_TEST(testRoundTrip);
+    RUN_TEST(testOnlyDirtyChunksWritten);
+    RUN_TEST(testRewriteWhenNotInSync);
+    RUN_TEST(testCorruption);
+    RUN_TEST(testCompressedChunks);
+
+    if(testBench)
+        benchSwap();
+
+    return testExit();
+}
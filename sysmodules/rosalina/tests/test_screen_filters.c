@@ -0,0 +1,471 @@
+/*
+*   This file is part of Luma3DS.
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   SPDX-License-Identifier: (MIT OR GPL-2.0-or-later)
+*/
+
+// Screen filter color LUTs (the table-based ScreenFiltersMenu_FastPow and the LUT caches), compared against powf,
+// and the night mode schedule, simulated over whole days.
+// The source is included to reach its static functions and caches. The GPU registers are mapped where Rosalina
+// expects them.
+
+#include <sys/mman.h>
+#include "test.h"
+#include "../source/menus/screen_filters.c"
+
+#define REGS_VA         0x90400000  // PA_PTR(0x10400000)
+#define SECONDS_PER_DAY (24 * 60 * 60)
+
+// Simulated clock (the system tick, and the RTC which can be changed), and LUT updates (GSP is paused and resumed
+// around each of them)
+static u64 simMilliseconds;
+static s64 simRtcOffset;
+static u32 nbGspPauses;
+
+u64 osGetTime(void)
+{
+    return simMilliseconds + simRtcOffset;
+}
+
+u64 svcGetSystemTick(void)
+{
+    return simMilliseconds * (SYSCLOCK_ARM11 / 1000);
+}
+
+void svcSleepThread(s64 ns)
+{
+}
+
+Result svcKernelSetState(u32 type, ...)
+{
+    nbGspPauses++;
+    return 0;
+}
+
+// What the LUT levels used to be
+static u8 referenceLevel(float level, float gamma)
+{
+    level = powf(CLAMP(level, 0.0f, 1.0f), gamma);
+    s32 levelInt = (s32)(255.0f * level + 0.5f);
+    return (u8)CLAMP(levelInt, 0, 255);
+}
+
+static u8 fastLevel(float level, float gamma)
+{
+    u32 levelQ16 = ScreenFiltersMenu_FastPow(CLAMP(level, 0.0f, 1.0f), gamma);
+    u32 levelInt = (255 * levelQ16 + 0x8000) >> 16;
+    return (u8)(levelInt >= 255 ? 255 : levelInt);
+}
+
+static void referenceLut(u32 *lut, const ScreenFilter *filter)
+{
+    float wp[3];
+    colorramp_get_white_point(wp, filter->cct);
+
+    for(u32 i = 0; i < 256; i++)
+    {
+        float x = (filter->invert ? 255 - i : i) / 255.0f;
+        Pixel px;
+        px.r = referenceLevel(filter->brightness + filter->contrast * wp[0] * x, filter->gamma);
+        px.g = referenceLevel(filter->brightness + filter->contrast * wp[1] * x, filter->gamma);
+        px.b = referenceLevel(filter->brightness + filter->contrast * wp[2] * x, filter->gamma);
+        px.z = 0;
+        lut[i] = px.raw;
+    }
+}
+
+static u32 maxLutDifference(const u32 *a, const u32 *b)
+{
+    u32 maxDiff = 0;
+    for(u32 i = 0; i < 256 * 4; i++)
+    {
+        u32 diff = abs((int)((const u8 *)a)[i] - (int)((const u8 *)b)[i]);
+        maxDiff = diff > maxDiff ? diff : maxDiff;
+    }
+    return maxDiff;
+}
+
+static float randFloat(u32 *seed, float min, float max)
+{
+    return min + (max - min) * (testRand(seed) >> 8) / 16777216.0f;
+}
+
+static void testFastPow(void)
+{
+    static const float gammas[] = { 0.0f, 0.01f, 0.1f, 0.5f, 0.8f, 1.0f, 1.2f, 2.2f, 3.0f, 10.0f, 100.0f, 1411.0f };
+    u32 nb = 0, nbOff = 0, maxDiff = 0, seed = 1;
+
+    ScreenFiltersMenu_InitGammaTables();
+
+    // Every gamma the menu can be set to, over the whole input range, then random values
+    for(u32 g = 0; g < sizeof(gammas) / sizeof(gammas[0]); g++)
+    {
+        for(u32 i = 0; i <= 20000; i++)
+        {
+            float x = i / 20000.0f;
+            u32 diff = abs((int)fastLevel(x, gammas[g]) - (int)referenceLevel(x, gammas[g]));
+            nb++;
+            nbOff += diff != 0;
+            maxDiff = diff > maxDiff ? diff : maxDiff;
+        }
+    }
+
+    for(u32 i = 0; i < 1000000; i++)
+    {
+        float x = randFloat(&seed, -0.1f, 1.1f), gamma = randFloat(&seed, 0.0f, 5.0f);
+        u32 diff = abs((int)fastLevel(x, gamma) - (int)referenceLevel(x, gamma));
+        nb++;
+        nbOff += diff != 0;
+        maxDiff = diff > maxDiff ? diff : maxDiff;
+    }
+
+    // Off by one level at most, and rarely
+    CHECK(maxDiff <= 1);
+    CHECK(nbOff * 1000 < nb);
+
+    // Exact where it matters
+    CHECK_EQ(ScreenFiltersMenu_FastPow(0.0f, 0.0f), 0x10000);
+    CHECK_EQ(ScreenFiltersMenu_FastPow(0.0f, 2.2f), 0);
+    CHECK_EQ(ScreenFiltersMenu_FastPow(-0.0f, 2.2f), 0);
+    CHECK_EQ(ScreenFiltersMenu_FastPow(NAN, 2.2f), 0);
+    CHECK_EQ(ScreenFiltersMenu_FastPow(1.0f, 2.2f), 0x10000);
+    CHECK_EQ(ScreenFiltersMenu_FastPow(0.5f, 0.0f), 0x10000);
+    CHECK_EQ(ScreenFiltersMenu_FastPow(0.5f, 1.0f), 0x8000);
+    CHECK_EQ(ScreenFiltersMenu_FastPow(0.5f, 2.0f), 0x4000);
+    CHECK_EQ(ScreenFiltersMenu_FastPow(1e-3f, 1411.0f), 0);
+}
+
+static void testLut(void)
+{
+    u32 lut[256], seed = 2;
+
+    for(u32 i = 0; i < 2000; i++)
+    {
+        ScreenFilter filter = {
+            .cct = 1000 + testRand(&seed) % 24101,
+            .invert = testRand(&seed) % 2 != 0,
+            .gamma = i % 4 == 0 ? 1.0f : randFloat(&seed, 0.0f, 4.0f),
+            .contrast = randFloat(&seed, 0.0f, 2.0f),
+            .brightness = randFloat(&seed, -1.0f, 1.0f),
+        };
+
+        ScreenFiltersMenu_InvalidateLutCaches();
+        ScreenFiltersMenu_ApplyFilter(i % 2 == 0, &filter);
+        referenceLut(lut, &filter);
+        CHECK(maxLutDifference(lutCaches[i % 2 == 0 ? 0 : 1].lut, lut) <= 1);
+    }
+}
+
+static void testLutCache(void)
+{
+    ScreenFilter filter = { 6500, false, 1.0f, 1.0f, 0.0f };
+
+    ScreenFiltersMenu_InvalidateLutCaches();
+    GPU_FB_TOP_COL_LUT_INDEX = 0xDEAD;
+    ScreenFiltersMenu_ApplyFilter(true, &filter);
+    CHECK_EQ(GPU_FB_TOP_COL_LUT_INDEX, 0);
+    CHECK_EQ(GPU_FB_TOP_COL_LUT_ELEM, lutCaches[0].lut[255]);
+
+    // Same filter: nothing is written
+    GPU_FB_TOP_COL_LUT_INDEX = 0xDEAD;
+    ScreenFiltersMenu_ApplyFilter(true, &filter);
+    CHECK_EQ(GPU_FB_TOP_COL_LUT_INDEX, 0xDEAD);
+
+    // Different filter, same LUT: nothing is written either
+    filter.contrast = 1.0001f;
+    ScreenFiltersMenu_ApplyFilter(true, &filter);
+    CHECK_EQ(GPU_FB_TOP_COL_LUT_INDEX, 0xDEAD);
+
+    // Only the part that changes is written, starting at the first level that differs
+    u32 old[256];
+    memcpy(old, lutCaches[0].lut, sizeof(old));
+    filter.contrast = 0.5f;
+    ScreenFiltersMenu_ApplyFilter(true, &filter);
+    u32 first = 0;
+    while(first < 256 && old[first] == lutCaches[0].lut[first])
+        first++;
+    CHECK(first > 0 && first < 256);
+    CHECK_EQ(GPU_FB_TOP_COL_LUT_INDEX, first);
+
+    // The other screen has its own cache
+    GPU_FB_BOTTOM_COL_LUT_INDEX = 0xDEAD;
+    ScreenFiltersMenu_ApplyFilter(false, &filter);
+    CHECK_EQ(GPU_FB_BOTTOM_COL_LUT_INDEX, 0);
+    CHECK(memcmp(lutCaches[0].lut, lutCaches[1].lut, sizeof(old)) == 0);
+}
+
+static float nightModeWeight(u32 startMinutes, u32 endMinutes, u32 transitionMinutes, u32 timeOfDay)
+{
+    ScreenFilterNightMode nightMode = { true, startMinutes, endMinutes, transitionMinutes, 2700, 1.0f, 0.0f };
+    u32 secondsUntilChange;
+    return ScreenFiltersMenu_GetNightModeWeight(&nightMode, timeOfDay % SECONDS_PER_DAY, &secondsUntilChange);
+}
+
+#define HM(h, m) (3600 * (h) + 60 * (m))
+
+static void testNightModeWeight(void)
+{
+    // 21:00 to 07:00, 30 minute transitions starting at both times: wraps at midnight
+    CHECK(nightModeWeight(21 * 60, 7 * 60, 30, HM(12, 0)) == 0.0f);
+    CHECK(nightModeWeight(21 * 60, 7 * 60, 30, HM(21, 0)) == 0.0f);
+    CHECK(nightModeWeight(21 * 60, 7 * 60, 30, HM(21, 15)) == 0.5f);
+    CHECK(nightModeWeight(21 * 60, 7 * 60, 30, HM(21, 30)) == 1.0f);
+    CHECK(nightModeWeight(21 * 60, 7 * 60, 30, HM(23, 59) + 59) == 1.0f);
+    CHECK(nightModeWeight(21 * 60, 7 * 60, 30, HM(0, 0)) == 1.0f);
+    CHECK(nightModeWeight(21 * 60, 7 * 60, 30, HM(7, 0)) == 1.0f);
+    CHECK(nightModeWeight(21 * 60, 7 * 60, 30, HM(7, 15)) == 0.5f);
+    CHECK(nightModeWeight(21 * 60, 7 * 60, 30, HM(7, 30)) == 0.0f);
+
+    // The transition into night mode can itself cross midnight
+    CHECK(nightModeWeight(23 * 60 + 50, 6 * 60, 20, HM(0, 0)) == 0.5f);
+
+    // Night during the day
+    CHECK(nightModeWeight(7 * 60, 21 * 60, 60, HM(7, 30)) == 0.5f);
+    CHECK(nightModeWeight(7 * 60, 21 * 60, 60, HM(12, 0)) == 1.0f);
+    CHECK(nightModeWeight(7 * 60, 21 * 60, 60, HM(0, 0)) == 0.0f);
+
+    // Same start and end: never
+    for(u32 t = 0; t < SECONDS_PER_DAY; t += 7)
+        CHECK(nightModeWeight(12 * 60, 12 * 60, 30, t) == 0.0f);
+
+    // Transitions are clamped so that they don't overlap: to the night's duration...
+    CHECK(nightModeWeight(20 * 60, 20 * 60 + 10, 30, HM(20, 5)) == 0.5f);
+    CHECK(nightModeWeight(20 * 60, 20 * 60 + 10, 30, HM(20, 10)) == 1.0f);
+    CHECK(nightModeWeight(20 * 60, 20 * 60 + 10, 30, HM(20, 15)) == 0.5f);
+    CHECK(nightModeWeight(20 * 60, 20 * 60 + 10, 30, HM(20, 20)) == 0.0f);
+
+    // ...and to the day's
+    CHECK(nightModeWeight(10 * 60, 8 * 60, 12 * 60, HM(9, 0)) == 0.5f);
+    CHECK(nightModeWeight(10 * 60, 8 * 60, 12 * 60, HM(10, 0)) == 0.0f);
+    CHECK(nightModeWeight(10 * 60, 8 * 60, 12 * 60, HM(11, 0)) == 0.5f);
+    CHECK(nightModeWeight(10 * 60, 8 * 60, 12 * 60, HM(12, 0)) == 1.0f);
+
+    // No transition: switches at once
+    CHECK(nightModeWeight(21 * 60, 7 * 60, 0, HM(20, 59) + 59) == 0.0f);
+    CHECK(nightModeWeight(21 * 60, 7 * 60, 0, HM(21, 0)) == 1.0f);
+    CHECK(nightModeWeight(21 * 60, 7 * 60, 0, HM(6, 59) + 59) == 1.0f);
+    CHECK(nightModeWeight(21 * 60, 7 * 60, 0, HM(7, 0)) == 0.0f);
+}
+
+// Over every second of the day: the curve is continuous (one step per second during transitions), and the weight
+// really doesn't change for as long as GetNightModeWeight says
+static void testNightModeCurve(void)
+{
+    static const u16 schedules[][3] = {
+        { 21 * 60, 7 * 60, 30 }, { 7 * 60, 21 * 60, 60 }, { 23 * 60 + 50, 6 * 60, 20 }, { 12 * 60, 12 * 60, 30 },
+        { 20 * 60, 20 * 60 + 10, 30 }, { 100, 1400, 12 * 60 }, { 21 * 60, 7 * 60, 0 }, { 0, 1, 1 },
+    };
+
+    for(u32 i = 0; i < sizeof(schedules) / sizeof(schedules[0]); i++)
+    {
+        ScreenFilterNightMode nightMode = { true, schedules[i][0], schedules[i][1], schedules[i][2], 2700, 1.0f, 0.0f };
+        u32 nightDuration = 60 * ((24 * 60 + schedules[i][1] - schedules[i][0]) % (24 * 60));
+        u32 transition = 60 * schedules[i][2], nbBad = 0, nbJumps = 0, secondsUntilChange, unused;
+        float stepMax = 0.0f, prev = ScreenFiltersMenu_GetNightModeWeight(&nightMode, SECONDS_PER_DAY - 1, &unused);
+
+        for(u32 t = 0; t < SECONDS_PER_DAY; t++)
+        {
+            float w = ScreenFiltersMenu_GetNightModeWeight(&nightMode, t, &secondsUntilChange);
+            float step = fabsf(w - prev);
+
+            nbBad += !(w >= 0.0f && w <= 1.0f) || secondsUntilChange == 0 || secondsUntilChange > SECONDS_PER_DAY;
+            if(step > 1e-6f)
+                stepMax = step > stepMax ? step : stepMax;
+            if(step > 0.5f)
+                nbJumps++;
+            if(secondsUntilChange > 1)
+                nbBad += ScreenFiltersMenu_GetNightModeWeight(&nightMode, (t + secondsUntilChange - 1) % SECONDS_PER_DAY, &unused) != w;
+            prev = w;
+        }
+
+        transition = transition > nightDuration ? nightDuration : transition;
+        transition = transition > SECONDS_PER_DAY - nightDuration ? SECONDS_PER_DAY - nightDuration : transition;
+
+        CHECK_EQ(nbBad, 0);
+        // Only without transitions does the weight jump, twice a day (unless there's no night at all)
+        CHECK_EQ(nbJumps, transition == 0 && nightDuration != 0 ? 2 : 0);
+        CHECK(transition == 0 || stepMax <= 1.0f / transition + 1e-6f);
+    }
+}
+
+static void simulateDay(u32 stepMilliseconds, u32 *nbEvaluations, u32 *nbLutUpdates)
+{
+    *nbEvaluations = *nbLutUpdates = 0;
+    for(u64 end = simMilliseconds + 1000ULL * SECONDS_PER_DAY; simMilliseconds < end; simMilliseconds += stepMilliseconds)
+    {
+        u64 nextUpdate = nightModeNextUpdateTick;
+        u32 nbPauses = nbGspPauses;
+
+        ScreenFiltersMenu_UpdateNightMode();
+        *nbEvaluations += nightModeNextUpdateTick != nextUpdate;
+        *nbLutUpdates += (nbGspPauses - nbPauses) / 2;
+    }
+}
+
+static void testNightModeSchedule(void)
+{
+    static const ScreenFilter dayFilter = { 6500, false, 1.0f, 1.0f, 0.0f };
+    u32 nbEvaluations, nbLutUpdates;
+
+    topScreenFilter = bottomScreenFilter = dayFilter;
+    screenFilterNightMode = (ScreenFilterNightMode){ false, 21 * 60, 7 * 60, 30, 2700, 1.2f, -0.1f };
+    ScreenFiltersMenu_InvalidateLutCaches();
+    ScreenFiltersMenu_RefreshNightMode();
+
+    // Disabled: nothing at all
+    simMilliseconds = 0;
+    simulateDay(1000 / 60, &nbEvaluations, &nbLutUpdates);
+    CHECK_EQ(nbEvaluations, 0);
+    CHECK_EQ(nbLutUpdates, 0);
+
+    // Called every frame: the schedule is looked at once per second during the two transitions, once a minute
+    // otherwise, and the LUTs are only written when the transitions change them
+    screenFilterNightMode.enabled = true;
+    ScreenFiltersMenu_RefreshNightMode();
+    simMilliseconds = 0;
+    simulateDay(1000 / 60, &nbEvaluations, &nbLutUpdates);
+    CHECK(nbEvaluations <= 2 * 30 * 60 + 24 * 60 + 2);
+    CHECK(nbLutUpdates > 100 && nbLutUpdates <= 2 * 30 * 60 + 2);
+
+    // A second day is the same
+    u32 nbEvaluations2, nbLutUpdates2;
+    simulateDay(1000 / 60, &nbEvaluations2, &nbLutUpdates2);
+    CHECK(abs((int)nbEvaluations2 - (int)nbEvaluations) <= 2);
+    CHECK(abs((int)nbLutUpdates2 - (int)nbLutUpdates) <= 2);
+
+    // The night filters are applied during the night, and the saved ones during the day
+    simMilliseconds = 1000ULL * HM(2, 0);
+    ScreenFiltersMenu_RefreshNightMode();
+    ScreenFiltersMenu_UpdateNightMode();
+    CHECK_EQ(lutCaches[0].filter.cct, 2700);
+    CHECK(lutCaches[1].filter.gamma == 1.2f && lutCaches[1].filter.brightness == -0.1f);
+
+    simMilliseconds = 1000ULL * HM(21, 15);
+    ScreenFiltersMenu_RefreshNightMode();
+    ScreenFiltersMenu_UpdateNightMode();
+    CHECK_EQ(lutCaches[0].filter.cct, 4600);
+
+    simMilliseconds = 1000ULL * HM(12, 0);
+    ScreenFiltersMenu_RefreshNightMode();
+    ScreenFiltersMenu_UpdateNightMode();
+    CHECK(ScreenFiltersMenu_FiltersEqual(&lutCaches[0].filter, &dayFilter));
+    CHECK(ScreenFiltersMenu_FiltersEqual(&lutCaches[1].filter, &dayFilter));
+
+    // The clock being changed to 03:00 is noticed within a minute
+    u32 nbPauses = nbGspPauses;
+    simRtcOffset = 1000LL * (HM(3, 0) - HM(12, 0));
+    for(u64 end = simMilliseconds + 61 * 1000; simMilliseconds < end; simMilliseconds += 1000 / 60)
+        ScreenFiltersMenu_UpdateNightMode();
+    CHECK_EQ(nbGspPauses - nbPauses, 2);
+    CHECK_EQ(lutCaches[0].filter.cct, 2700);
+
+    simRtcOffset = 0;
+
+    screenFilterNightMode.enabled = false;
+}
+
+static void benchLut(void)
+{
+    u32 nb = 2000, lut[256];
+    ScreenFilter filter = { 6500, false, 2.2f, 1.0f, 0.0f };
+
+    // A filter change, e.g. a key repeat in the advanced configuration. glibc's powf is a lot faster than newlib's
+    // on the ARM11 (no FPU pow, doubles in software), only the 3DS numbers tell how much the tables save.
+    u64 start = testNanoseconds();
+    for(u32 i = 0; i < nb; i++)
+    {
+        filter.cct = 1000 + 10 * i;
+        ScreenFiltersMenu_ApplyFilter(true, &filter);
+    }
+    u64 elapsed = testNanoseconds() - start;
+
+    start = testNanoseconds();
+    for(u32 i = 0; i < nb; i++)
+    {
+        filter.cct = 1000 + 10 * i;
+        referenceLut(lut, &filter);
+    }
+    u64 refElapsed = testNanoseconds() - start;
+
+    printf("LUT: %.1f us per filter change, with powf: %.1f us\n", elapsed / 1e3 / nb, refElapsed / 1e3 / nb);
+
+    // An animated transition between two filters, a frame at a time
+    ScreenFilter from = { 6500, false, 1.0f, 1.0f, 0.0f }, to = { 2700, false, 1.2f, 1.0f, -0.1f };
+    u32 nbFrames = 60 * 10;
+    start = testNanoseconds();
+    for(u32 i = 0; i <= nbFrames; i++)
+    {
+        ScreenFiltersMenu_InterpolateFilter(&filter, &from, &to, (float)i / nbFrames);
+        ScreenFiltersMenu_ApplyFilter(true, &filter);
+        ScreenFiltersMenu_ApplyFilter(false, &filter);
+    }
+    elapsed = testNanoseconds() - start;
+
+    printf("transition: %.1f us per frame (both screens)\n", elapsed / 1e3 / (nbFrames + 1));
+}
+
+static void benchNightMode(void)
+{
+    u32 nb = 100000;
+    u64 start, elapsed;
+
+    topScreenFilter = bottomScreenFilter = (ScreenFilter){ 6500, false, 1.0f, 1.0f, 0.0f };
+    screenFilterNightMode = (ScreenFilterNightMode){ true, 21 * 60, 7 * 60, 30, 2700, 1.2f, -0.1f };
+
+    // Nothing due: what every frame costs
+    simMilliseconds = 1000ULL * HM(12, 0);
+    ScreenFiltersMenu_RefreshNightMode();
+    ScreenFiltersMenu_UpdateNightMode();
+    start = testNanoseconds();
+    for(u32 i = 0; i < nb; i++)
+        ScreenFiltersMenu_UpdateNightMode();
+    elapsed = testNanoseconds() - start;
+    printf("night mode: %.1f ns per frame when idle\n", (double)elapsed / nb);
+
+    // Due, but nothing changes
+    start = testNanoseconds();
+    for(u32 i = 0; i < nb; i++)
+    {
+        ScreenFiltersMenu_RefreshNightMode();
+        ScreenFiltersMenu_UpdateNightMode();
+    }
+    elapsed = testNanoseconds() - start;
+    printf("night mode: %.1f ns per evaluation outside of transitions\n", (double)elapsed / nb);
+
+    // One step per second through the transition, both LUTs updated
+    u32 nbSteps = 30 * 60, nbPauses = nbGspPauses;
+    simMilliseconds = 1000ULL * HM(21, 0);
+    start = testNanoseconds();
+    for(u32 i = 0; i < nbSteps; i++, simMilliseconds += 1000)
+        ScreenFiltersMenu_UpdateNightMode();
+    elapsed = testNanoseconds() - start;
+    printf("night mode: %.1f us per transition step, %lu LUT updates in %lu steps\n", elapsed / 1e3 / nbSteps,
+           (unsigned long)(nbGspPauses - nbPauses) / 2, (unsigned long)nbSteps);
+}
+
+int main(int argc, char **argv)
+{
+    testInit(argc, argv);
+
+    if(mmap((void *)REGS_VA, 0x2000, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) != (void *)REGS_VA)
+    {
+        perror("mmap");
+        return 1;
+    }
+
+    RUN_TEST(testFastPow);
+    RUN_TEST(testLut);
+    RUN_TEST(testLutCache);
+    RUN_TEST(testNightModeWeight);
+    RUN_TEST(testNightModeCurve);
+    RUN_TEST(testNightModeSchedule);
+
+    if(testBench)
+    {
+        benchLut();
+        benchNightMode();
+    }
+
+    return testExit();
+}
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+#
+#   This file is part of Luma3DS
+#   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+#
+#   This program is free software: you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation, either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+"""Packs a directory of <TitleID>.txt cheat files into a Rosalina cheat database.
+
+Copy the output to /cheats/cheats.db on the SD card. Per-title .txt files, when
+present, still take precedence over the database.
+"""
+
+import os
+import re
+import struct
+import sys
+
+CHEAT_DB_MAGIC = 0x42444843 # "CHDB"
+CHEAT_DB_VERSION = 1
+CHEAT_DB_BUCKET_COUNT = 256
+
+def bucket(titleId):
+    return (titleId >> 8) & 0xFF
+
+def main(argv):
+    if len(argv) != 3:
+        print("Usage: {0} <cheats directory> <output cheats.db>".format(argv[0]), file=sys.stderr)
+        return 1
+
+    titles = {}
+    for name in os.listdir(argv[1]):
+        m = re.fullmatch(r"([0-9A-Fa-f]{16})\.txt", name)
+        if m is not None:
+            with open(os.path.join(argv[1], name), "rb") as f:
+                titles[int(m.group(1), 16)] = f.read()
+
+    tids = sorted(titles, key=lambda tid: (bucket(tid), tid))
+
+    bucketStart = [0] * (CHEAT_DB_BUCKET_COUNT + 1)
+    for tid in tids:
+        bucketStart[bucket(tid) + 1] += 1
+    for i in range(CHEAT_DB_BUCKET_COUNT):
+        bucketStart[i + 1] += bucketStart[i]
+
+    header = struct.pack("<4I{0}I".format(CHEAT_DB_BUCKET_COUNT + 1), CHEAT_DB_MAGIC, CHEAT_DB_VERSION, len(tids), 0, *bucketStart)
+    offset = len(header) + 16 * len(tids)
+
+    entries = b""
+    for tid in tids:
+        entries += struct.pack("<QII", tid, offset, len(titles[tid]))
+        offset += len(titles[tid])
+
+    with open(argv[2], "wb") as f:
+        f.write(header)
+        f.write(entries)
+        for tid in tids:
+            f.write(titles[tid])
+
+    print("Packed {0} titles into {1}".format(len(tids), argv[2]))
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
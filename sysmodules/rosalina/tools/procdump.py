@@ -0,0 +1,253 @@
+#!/usr/bin/env python3
+#
+#   This file is part of Luma3DS
+#   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+#
+#   This program is free software: you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation, either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+"""Reads, verifies and converts Rosalina full process dumps (/luma/dumps/memory/*.dmp).
+
+    procdump.py info <dump>             lists the regions of the dump
+    procdump.py verify <dump>           decompresses every region and checks it against its checksum
+    procdump.py elf <dump> <output>     converts the dump to an ARM ELF core file
+"""
+
+import struct
+import sys
+import zlib
+
+PROCESS_DUMP_MAGIC = 0x504D4452 # "RDMP"
+PROCESS_DUMP_VERSION = 1
+PROCESS_DUMP_CANCELLED = 1
+PROCESS_DUMP_TRUNCATED = 2
+
+PROCESS_DUMP_BLOCK_RAW = 0x80000000
+
+PROCESS_DUMP_REGION_SKIPPED = 1
+PROCESS_DUMP_REGION_INCOMPLETE = 2
+
+HEADER_FORMAT = "<4IQ8s2IQ"
+REGION_FORMAT = "<8I"
+
+MEMSTATE_NAMES = ["free", "reserved", "io", "static", "code", "private", "shared", "continuous",
+                  "aliased", "alias", "aliascode", "locked"]
+
+class DumpError(Exception):
+    pass
+
+def lz_decompress(src, size):
+    """Decompresses a LZ4 block (as produced by LZ_Compress) of size bytes."""
+    dst = bytearray()
+    pos = 0
+    while pos < len(src):
+        token = src[pos]
+        pos += 1
+
+        length = token >> 4
+        if length == 15:
+            while True:
+                if pos >= len(src):
+                    raise DumpError("truncated literal length")
+                b = src[pos]
+                pos += 1
+                length += b
+                if b != 255:
+                    break
+        if pos + length > len(src):
+            raise DumpError("truncated literals")
+        dst += src[pos:pos + length]
+        pos += length
+        if pos == len(src):
+            break
+
+        if pos + 2 > len(src):
+            raise DumpError("truncated match offset")
+        offset = src[pos] | (src[pos + 1] << 8)
+        pos += 2
+        if offset == 0 or offset > len(dst):
+            raise DumpError("invalid match offset")
+
+        length = token & 15
+        if length == 15:
+            while True:
+                if pos >= len(src):
+                    raise DumpError("truncated match length")
+                b = src[pos]
+                pos += 1
+                length += b
+                if b != 255:
+                    break
+        length += 4
+
+        start = len(dst) - offset
+        if offset >= length:
+            dst += dst[start:start + length]
+        else:
+            for i in range(length):
+                dst.append(dst[start + i])
+
+    if len(dst) != size:
+        raise DumpError("decompressed {0} bytes instead of {1}".format(len(dst), size))
+    return bytes(dst)
+
+class Region:
+    def __init__(self, fields):
+        (self.address, self.size, self.perm, self.state, self.flags,
+         self.dataOffset, self.dataSize, self.checksum) = fields
+
+    def describe(self):
+        perm = "".join(c if self.perm & (1 << i) else "-" for i, c in enumerate("rwx"))
+        state = MEMSTATE_NAMES[self.state] if self.state < len(MEMSTATE_NAMES) else str(self.state)
+        notes = []
+        if self.flags & PROCESS_DUMP_REGION_SKIPPED:
+            notes.append("skipped")
+        if self.flags & PROCESS_DUMP_REGION_INCOMPLETE:
+            notes.append("incomplete")
+        return "{0:08x}-{1:08x} {2} {3:<10} {4:>10} {5}".format(self.address, self.address + self.size, perm, state,
+                                                             self.dataSize, " ".join(notes))
+
+class Dump:
+    def __init__(self, data):
+        self.data = data
+        headerSize = struct.calcsize(HEADER_FORMAT)
+        if len(data) < headerSize:
+            raise DumpError("file too small")
+
+        (magic, version, self.pid, numRegions, self.titleId, name, self.blockSize,
+         self.flags, self.dumpedSize) = struct.unpack_from(HEADER_FORMAT, data)
+        if magic != PROCESS_DUMP_MAGIC:
+            raise DumpError("not a process dump")
+        if version != PROCESS_DUMP_VERSION:
+            raise DumpError("unsupported version {0}".format(version))
+
+        self.name = name.split(b"\0", 1)[0].decode("ascii", "replace")
+        regionSize = struct.calcsize(REGION_FORMAT)
+        if len(data) < headerSize + numRegions * regionSize:
+            raise DumpError("truncated region index")
+        self.regions = [Region(struct.unpack_from(REGION_FORMAT, data, headerSize + i * regionSize)) for i in range(numRegions)]
+
+    def contents(self, region):
+        """Returns the dumped contents of a region, which are shorter than the region if it is incomplete."""
+        if region.flags & PROCESS_DUMP_REGION_SKIPPED:
+            return b""
+        if region.dataOffset + region.dataSize > len(self.data):
+            raise DumpError("region data out of bounds")
+
+        out = []
+        pos, end, left = region.dataOffset, region.dataOffset + region.dataSize, region.size
+        while pos < end:
+            if left == 0 or pos + 4 > end:
+                raise DumpError("trailing data")
+            blockSize = min(left, self.blockSize)
+            word, = struct.unpack_from("<I", self.data, pos)
+            pos += 4
+            if word == 0:
+                out.append(bytes(blockSize))
+            elif word & PROCESS_DUMP_BLOCK_RAW:
+                if word & ~PROCESS_DUMP_BLOCK_RAW != blockSize or pos + blockSize > end:
+                    raise DumpError("invalid stored block")
+                out.append(self.data[pos:pos + blockSize])
+                pos += blockSize
+            else:
+                if pos + word > end:
+                    raise DumpError("truncated compressed block")
+                out.append(lz_decompress(self.data[pos:pos + word], blockSize))
+                pos += word
+            left -= blockSize
+
+        contents = b"".join(out)
+        if len(contents) != region.size and not region.flags & PROCESS_DUMP_REGION_INCOMPLETE:
+            raise DumpError("missing data")
+        if zlib.adler32(contents) != region.checksum:
+            raise DumpError("checksum mismatch")
+        return contents
+
+def info(dump):
+    print("Process {0} (pid {1}, title ID {2:016x}), {3} regions, {4} bytes dumped{5}{6}".format(
+          dump.name, dump.pid, dump.titleId, len(dump.regions), dump.dumpedSize,
+          " (cancelled)" if dump.flags & PROCESS_DUMP_CANCELLED else "",
+          " (truncated: regions above the last one are missing)" if dump.flags & PROCESS_DUMP_TRUNCATED else ""))
+    for region in dump.regions:
+        print(region.describe())
+    return 0
+
+def verify(dump):
+    errors = 0
+    total = 0
+    for region in dump.regions:
+        try:
+            total += len(dump.contents(region))
+        except DumpError as e:
+            print("{0:08x}: {1}".format(region.address, e), file=sys.stderr)
+            errors += 1
+
+    if total != dump.dumpedSize:
+        print("dumped size mismatch: {0} bytes instead of {1}".format(total, dump.dumpedSize), file=sys.stderr)
+        errors += 1
+
+    print("{0} regions, {1} bytes: {2}".format(len(dump.regions), total, "OK" if errors == 0 else "{0} errors".format(errors)))
+    return 0 if errors == 0 else 1
+
+def elf(dump, outPath):
+    regions = [(region, dump.contents(region)) for region in dump.regions]
+
+    # ELF32 little-endian ARM core file: one PT_LOAD program header per region; regions that weren't (fully)
+    # dumped get a p_filesz smaller than their p_memsz. Regions are page-aligned, so are their file offsets
+    # (p_offset must be congruent to p_vaddr modulo p_align)
+    ehsize, phentsize, align = 52, 32, 0x1000
+    offset = (ehsize + phentsize * len(regions) + align - 1) & ~(align - 1)
+    offsets = []
+    header = struct.pack("<4s5B7x2H5I6H", b"\x7fELF", 1, 1, 1, 0, 0, 4, 40, 1, 0, ehsize, 0, 0x5000000,
+                         ehsize, phentsize, len(regions), 40, 0, 0)
+
+    phdrs = b""
+    for region, contents in regions:
+        flags = (4 if region.perm & 1 else 0) | (2 if region.perm & 2 else 0) | (1 if region.perm & 4 else 0)
+        offset += (region.address - offset) % align
+        offsets.append(offset)
+        phdrs += struct.pack("<8I", 1, offset, region.address, region.address, len(contents), region.size, flags, align)
+        offset += len(contents)
+
+    with open(outPath, "wb") as f:
+        f.write(header)
+        f.write(phdrs)
+        for (region, contents), offset in zip(regions, offsets):
+            f.write(bytes(offset - f.tell()))
+            f.write(contents)
+
+    print("Wrote {0} regions to {1}".format(len(regions), outPath))
+    return 0
+
+def main(argv):
+    if len(argv) < 3 or argv[1] not in ("info", "verify", "elf") or (argv[1] == "elf") != (len(argv) == 4):
+        print(__doc__, file=sys.stderr)
+        return 1
+
+    with open(argv[2], "rb") as f:
+        data = f.read()
+
+    try:
+        dump = Dump(data)
+        if argv[1] == "info":
+            return info(dump)
+        elif argv[1] == "verify":
+            return verify(dump)
+        else:
+            return elf(dump, argv[3])
+    except DumpError as e:
+        print("{0}: {1}".format(argv[2], e), file=sys.stderr)
+        return 1
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))